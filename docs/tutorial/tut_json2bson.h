@@ -94,4 +94,10 @@
  * line of JSON into BSON.
  *
  * @until }
+ *
+ * @note The library itself provides a native JSON parser as well:
+ * bson_new_from_json() and the newline-delimited JSON reader built
+ * around bson_json_reader_next() parse JSON straight into BSON, in a
+ * single pass, without an intermediate tree like JSON-C's. This
+ * program remains a good example of building BSON objects by hand.
  */
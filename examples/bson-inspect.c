@@ -16,11 +16,8 @@
 
 #include <glib.h>
 #include <bson.h>
+#include <bson-stream.h>
 
-#include <sys/mman.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
@@ -39,218 +36,250 @@ _indent (gint level, gboolean verbose)
     printf ("  ");
 }
 
-static void
-bson_dump (bson *b, gint ilevel, gboolean verbose, gboolean as_array)
+/* The state of the dumper, for each nesting level. */
+typedef struct
+{
+  gboolean verbose;
+  gboolean first[BSON_VALIDATE_MAX_DEPTH + 2];
+  gboolean as_array[BSON_VALIDATE_MAX_DEPTH + 2];
+} dump_state;
+
+static gboolean
+_dump_before (const bson_iter *i, gint depth, gpointer user_data)
 {
-  bson_cursor *c;
-  gboolean first = TRUE;
+  dump_state *st = (dump_state *)user_data;
 
-  c = bson_cursor_new (b);
-  while (bson_cursor_next (c))
+  if (!st->first[depth])
     {
-      if (!first)
-        {
-          printf (", ");
-          if (verbose)
-            printf ("\n");
-        }
-      first = FALSE;
-      if (verbose)
-        {
-          _indent (ilevel, verbose);
-          printf ("/* type='%s'; */\n",
-                  bson_cursor_type_as_string (c) + 10);
-        }
-      _indent (ilevel, verbose);
-      if (!as_array)
-        {
-          printf ("\"%s\" : ", bson_cursor_key (c));
-        }
-      switch (bson_cursor_type (c))
-        {
-        case BSON_TYPE_DOUBLE:
-          {
-            gdouble d;
-            bson_cursor_get_double (c, &d);
-            printf ("%f", d);
-            break;
-          }
-        case BSON_TYPE_STRING:
-          {
-            const gchar *s;
-            gchar *s2;
-            bson_cursor_get_string (c, &s);
-            s2 = g_strescape (s, NULL);
-            printf ("\"%s\"", s2);
-            g_free (s2);
-            break;
-          }
-        case BSON_TYPE_OID:
-          {
-            const guint8 *oid;
-            gint j;
-            bson_cursor_get_oid (c, &oid);
-            printf ("ObjectId( \"");
-            for (j = 0; j < 12; j++)
-              printf ("%02x", oid[j]);
-            printf ("\" )");
-            break;
-          }
-        case BSON_TYPE_BOOLEAN:
-          {
-            gboolean b;
-            bson_cursor_get_boolean (c, &b);
-            printf ((b) ? "true" : "false");
-            break;
-          }
-        case BSON_TYPE_REGEXP:
-          {
-            const gchar *r, *o;
-            gchar *r2, *o2;
-            bson_cursor_get_regex (c, &r, &o);
-            r2 = g_strescape (r, NULL);
-            o2 = g_strescape (o, NULL);
-            printf ("Regex(\"/%s/%s\")", r2, o2);
-            g_free (r2);
-            g_free (o2);
-            break;
-          }
-        case BSON_TYPE_NULL:
-          {
-            printf ("null");
-            break;
-          }
-        case BSON_TYPE_JS_CODE:
-          {
-            const gchar *js;
-            gchar *js2;
-            bson_cursor_get_javascript (c, &js);
-            js2 = g_strescape (js, NULL);
-            printf ("%s", js2);
-            g_free (js2);
-            break;
-          }
-        case BSON_TYPE_SYMBOL:
-          {
-            const gchar *s;
-            gchar *s2;
-            bson_cursor_get_symbol (c, &s);
-            s2 = g_strescape (s, NULL);
-            printf ("%s", s2);
-            g_free (s2);
-            break;
-          }
-        case BSON_TYPE_INT32:
-          {
-            gint32 l32;
-            bson_cursor_get_int32 (c, &l32);
-            printf ("%d", l32);
-            break;
-          }
-        case BSON_TYPE_INT64:
-          {
-            gint64 l64;
-            bson_cursor_get_int64 (c, &l64);
-            printf ("%" G_GINT64_FORMAT, l64);
-            break;
-          }
-        case BSON_TYPE_DOCUMENT:
-          {
-            bson *sd;
-            bson_cursor_get_document (c, &sd);
-            printf ("{ ");
-            if (verbose)
-              printf ("/* size='%d' */\n", bson_size (sd));
-            bson_dump (sd, ilevel + 1, verbose, FALSE);
-            if (verbose)
-              {
-                printf ("\n");
-                _indent (ilevel, verbose);
-                printf ("}");
-              }
-            else
-              printf (" }");
-            bson_free (sd);
-            break;
-          }
-        case BSON_TYPE_ARRAY:
-          {
-            bson *sa;
-
-            bson_cursor_get_array (c, &sa);
-            printf ("[ ");
-            if (verbose)
-              printf ("/* size='%d' */\n", bson_size (sa));
-            bson_dump (sa, ilevel + 1, verbose, TRUE);
-            if (verbose)
-              {
-                printf ("\n");
-                _indent (ilevel, verbose);
-                printf ("]");
-              }
-            else
-              printf (" ]");
-            bson_free (sa);
-            break;
-          }
-        case BSON_TYPE_BINARY:
-          {
-            const guint8 *data;
-            gint32 size;
-            bson_binary_subtype t;
-            gchar *b64;
-
-            bson_cursor_get_binary (c, &t, &data, &size);
-            b64 = g_base64_encode (data, size);
-            printf ("{ ");
-            if (verbose)
-              {
-                printf ("/* size='%d' */\n", size);
-                _indent (ilevel + 1, verbose);
-              }
-            printf ("\"$binary\" : \"%s\",", b64);
-            if (verbose)
-              {
-                printf ("\n");
-                _indent (ilevel + 1, verbose);
-              }
-            else
-              printf (" ");
-            printf ("\"$type\" : \"%02d\"", t);
-            if (verbose)
-              {
-                printf ("\n");
-                _indent (ilevel, verbose);
-              }
-            else
-              printf (" ");
-            printf ("}");
-            g_free (b64);
-            break;
-          }
-        case BSON_TYPE_JS_CODE_W_SCOPE:
-        case BSON_TYPE_UNDEFINED:
-        case BSON_TYPE_UTC_DATETIME:
-        case BSON_TYPE_DBPOINTER:
-        case BSON_TYPE_TIMESTAMP:
-        case BSON_TYPE_MIN:
-        case BSON_TYPE_MAX:
-        default:
-          printf ("\"<unimplemented>\"");
-          break;
-        }
+      printf (", ");
+      if (st->verbose)
+        printf ("\n");
+    }
+  st->first[depth] = FALSE;
+  if (st->verbose)
+    {
+      _indent (depth + 1, st->verbose);
+      printf ("/* type='%s'; */\n",
+              bson_type_as_string (bson_iter_type (i)) + 10);
+    }
+  _indent (depth + 1, st->verbose);
+  if (!st->as_array[depth])
+    printf ("\"%s\" : ", bson_iter_key (i));
+  return TRUE;
+}
+
+static gboolean
+_dump_after (const bson_iter *i, gint depth, gpointer user_data)
+{
+  switch (bson_iter_type (i))
+    {
+    case BSON_TYPE_JS_CODE_W_SCOPE:
+    case BSON_TYPE_UNDEFINED:
+    case BSON_TYPE_UTC_DATETIME:
+    case BSON_TYPE_DBPOINTER:
+    case BSON_TYPE_TIMESTAMP:
+    case BSON_TYPE_MIN:
+    case BSON_TYPE_MAX:
+      printf ("\"<unimplemented>\"");
+      break;
+    default:
+      break;
+    }
+  return TRUE;
+}
+
+static gboolean
+_dump_double (const bson_iter *i, gint depth, gdouble d, gpointer user_data)
+{
+  printf ("%f", d);
+  return TRUE;
+}
+
+static gboolean
+_dump_string (const bson_iter *i, gint depth, const gchar *s, gint32 length,
+              gpointer user_data)
+{
+  gchar *s2;
+
+  s2 = g_strescape (s, NULL);
+  printf ("\"%s\"", s2);
+  g_free (s2);
+  return TRUE;
+}
+
+static gboolean
+_dump_code (const bson_iter *i, gint depth, const gchar *s, gint32 length,
+            gpointer user_data)
+{
+  gchar *s2;
+
+  s2 = g_strescape (s, NULL);
+  printf ("%s", s2);
+  g_free (s2);
+  return TRUE;
+}
+
+static gboolean
+_dump_oid (const bson_iter *i, gint depth, const guint8 *oid,
+           gpointer user_data)
+{
+  gint j;
+
+  printf ("ObjectId( \"");
+  for (j = 0; j < 12; j++)
+    printf ("%02x", oid[j]);
+  printf ("\" )");
+  return TRUE;
+}
+
+static gboolean
+_dump_boolean (const bson_iter *i, gint depth, gboolean b,
+               gpointer user_data)
+{
+  printf ((b) ? "true" : "false");
+  return TRUE;
+}
+
+static gboolean
+_dump_regex (const bson_iter *i, gint depth, const gchar *r, const gchar *o,
+             gpointer user_data)
+{
+  gchar *r2, *o2;
+
+  r2 = g_strescape (r, NULL);
+  o2 = g_strescape (o, NULL);
+  printf ("Regex(\"/%s/%s\")", r2, o2);
+  g_free (r2);
+  g_free (o2);
+  return TRUE;
+}
+
+static gboolean
+_dump_null (const bson_iter *i, gint depth, gpointer user_data)
+{
+  printf ("null");
+  return TRUE;
+}
+
+static gboolean
+_dump_int32 (const bson_iter *i, gint depth, gint32 l32, gpointer user_data)
+{
+  printf ("%d", l32);
+  return TRUE;
+}
+
+static gboolean
+_dump_int64 (const bson_iter *i, gint depth, gint64 l64, gpointer user_data)
+{
+  printf ("%" G_GINT64_FORMAT, l64);
+  return TRUE;
+}
+
+static gboolean
+_dump_container (const bson_iter *i, gint depth, gint32 size,
+                 gpointer user_data)
+{
+  dump_state *st = (dump_state *)user_data;
+  gboolean as_array = (bson_iter_type (i) == BSON_TYPE_ARRAY);
+
+  printf ((as_array) ? "[ " : "{ ");
+  if (st->verbose)
+    printf ("/* size='%d' */\n", size);
+  st->first[depth + 1] = TRUE;
+  st->as_array[depth + 1] = as_array;
+  return TRUE;
+}
+
+static gboolean
+_dump_container_end (const bson_iter *i, gint depth, gpointer user_data)
+{
+  dump_state *st = (dump_state *)user_data;
+  gboolean as_array = (bson_iter_type (i) == BSON_TYPE_ARRAY);
+
+  if (st->verbose)
+    {
+      printf ("\n");
+      _indent (depth + 1, st->verbose);
+      printf ((as_array) ? "]" : "}");
+    }
+  else
+    printf ((as_array) ? " ]" : " }");
+  return TRUE;
+}
+
+static gboolean
+_dump_binary (const bson_iter *i, gint depth, bson_binary_subtype t,
+              const guint8 *data, gint32 size, gpointer user_data)
+{
+  dump_state *st = (dump_state *)user_data;
+  gchar *b64;
+
+  b64 = g_base64_encode (data, size);
+  printf ("{ ");
+  if (st->verbose)
+    {
+      printf ("/* size='%d' */\n", size);
+      _indent (depth + 2, st->verbose);
+    }
+  printf ("\"$binary\" : \"%s\",", b64);
+  if (st->verbose)
+    {
+      printf ("\n");
+      _indent (depth + 2, st->verbose);
+    }
+  else
+    printf (" ");
+  printf ("\"$type\" : \"%02d\"", t);
+  if (st->verbose)
+    {
+      printf ("\n");
+      _indent (depth + 1, st->verbose);
     }
-  bson_cursor_free (c);
+  else
+    printf (" ");
+  printf ("}");
+  g_free (b64);
+  return TRUE;
+}
+
+static const bson_visitor bson_dump_visitor =
+  {
+    .visit_before = _dump_before,
+    .visit_after = _dump_after,
+    .visit_double = _dump_double,
+    .visit_string = _dump_string,
+    .visit_document = _dump_container,
+    .visit_document_end = _dump_container_end,
+    .visit_array = _dump_container,
+    .visit_array_end = _dump_container_end,
+    .visit_binary = _dump_binary,
+    .visit_oid = _dump_oid,
+    .visit_boolean = _dump_boolean,
+    .visit_null = _dump_null,
+    .visit_regex = _dump_regex,
+    .visit_javascript = _dump_code,
+    .visit_symbol = _dump_code,
+    .visit_int32 = _dump_int32,
+    .visit_int64 = _dump_int64
+  };
+
+static void
+bson_dump (const bson *b, gboolean verbose)
+{
+  dump_state st;
+
+  memset (&st, 0, sizeof (st));
+  st.verbose = verbose;
+  st.first[0] = TRUE;
+
+  bson_visit (b, &bson_dump_visitor, BSON_VISIT_RECURSE, &st);
 }
 
 int
 main (int argc, char *argv[])
 {
-  int fd;
-  off_t offs = 0;
-  bson *b;
-  guint8 *data;
-  struct stat st;
+  bson_stream_reader *r;
+  const bson *b;
   gint64 i = 1;
   GOptionContext *context;
   gboolean verbose = FALSE;
@@ -286,44 +315,24 @@ main (int argc, char *argv[])
       exit (1);
     }
 
-  fd = open (argv[1], O_RDONLY);
-  if (fd == -1)
+  r = bson_stream_reader_new_from_file (argv[1],
+                                        BSON_STREAM_READER_SEQUENTIAL);
+  if (!r)
     {
       fprintf (stderr, "Error opening file '%s': %s\n",
                argv[1], strerror (errno));
       exit (1);
     }
-  if (fstat (fd, &st) != 0)
-    {
-      fprintf (stderr, "Error fstat()ing file '%s': %s\n",
-               argv[1], strerror (errno));
-      close (fd);
-      exit (1);
-    }
-
-  data = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
-  if (data == MAP_FAILED)
-    {
-      fprintf (stderr, "Error mmap()ing file '%s': %s\n",
-               argv[1], strerror (errno));
-      close (fd);
-      exit (1);
-    }
 
-  while (offs < st.st_size)
+  while ((b = bson_stream_reader_next (r)) != NULL)
     {
-      b = bson_new_from_data ((const guint8 *)(data + offs),
-                              bson_stream_doc_size (data, offs) - 1);
-      bson_finish (b);
-      offs += bson_size (b);
-
       if (verbose)
         printf ("/* Document #%" G_GUINT64_FORMAT "; size='%d' */\n", i,
                 bson_size (b));
       printf ("{ ");
       if (verbose)
         printf ("\n");
-      bson_dump (b, 1, verbose, FALSE);
+      bson_dump (b, verbose);
       if (verbose)
         printf ("\n}\n");
       else
@@ -331,11 +340,12 @@ main (int argc, char *argv[])
       if (verbose)
         printf ("\n");
 
-      bson_free (b);
       i++;
     }
-  munmap (data, st.st_size);
-  close (fd);
+  if (errno != 0)
+    fprintf (stderr, "Error reading document #%" G_GUINT64_FORMAT
+             " from '%s': %s\n", i, argv[1], strerror (errno));
+  bson_stream_reader_free (r);
 
   return 0;
 }
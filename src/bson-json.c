@@ -0,0 +1,1911 @@
+/* bson-json.c - libmongo-client's BSON to JSON conversion
+ * Copyright 2011, 2012 Gergely Nagy <algernon@balabit.hu>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file src/bson-json.c
+ * Implementation of the BSON to JSON conversion.
+ */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bson.h"
+#include "bson-json.h"
+#include "libmongo-macros.h"
+
+/** @internal Size of the output buffer of the JSON writer. */
+#define BSON_JSON_BUFFER_SIZE 4096
+
+/** @internal JSON writer state.
+ */
+typedef struct
+{
+  bson_json_sink sink; /**< The sink to pass the output to. */
+  gpointer user_data; /**< User data for the sink. */
+  bson_json_mode mode; /**< The output mode. */
+  gboolean failed; /**< Whether the sink aborted the conversion. */
+  gsize len; /**< The number of bytes used in @a buf. */
+  gchar buf[BSON_JSON_BUFFER_SIZE]; /**< The output buffer. */
+} bson_json_writer;
+
+/** @internal Pass the buffered output to the sink.
+ *
+ * @param w is the writer to flush.
+ */
+static void
+_bson_json_flush (bson_json_writer *w)
+{
+  if (w->len && !w->failed && !w->sink (w->buf, w->len, w->user_data))
+    w->failed = TRUE;
+  w->len = 0;
+}
+
+/** @internal Write data to the JSON output.
+ *
+ * @param w is the writer to write to.
+ * @param data is the data to write.
+ * @param size is the size of @a data.
+ */
+static inline void
+_bson_json_write (bson_json_writer *w, const gchar *data, gsize size)
+{
+  if (G_UNLIKELY (w->len + size > BSON_JSON_BUFFER_SIZE))
+    {
+      _bson_json_flush (w);
+      if (size > BSON_JSON_BUFFER_SIZE)
+        {
+          if (!w->failed && !w->sink (data, size, w->user_data))
+            w->failed = TRUE;
+          return;
+        }
+    }
+
+  memcpy (w->buf + w->len, data, size);
+  w->len += size;
+}
+
+/** @internal Write a single character to the JSON output.
+ *
+ * @param w is the writer to write to.
+ * @param c is the character to write.
+ */
+static inline void
+_bson_json_write_c (bson_json_writer *w, gchar c)
+{
+  if (G_UNLIKELY (w->len == BSON_JSON_BUFFER_SIZE))
+    _bson_json_flush (w);
+  w->buf[w->len++] = c;
+}
+
+/** @internal Write a string literal to the JSON output. */
+#define _bson_json_write_literal(w, s) \
+  _bson_json_write (w, s, sizeof (s) - 1)
+
+/** @internal Bytes with only their lowest bit set. */
+#define BSON_JSON_ONES G_GUINT64_CONSTANT (0x0101010101010101)
+/** @internal Bytes with only their highest bit set. */
+#define BSON_JSON_HIGHS G_GUINT64_CONSTANT (0x8080808080808080)
+
+/** @internal Check whether any byte of a word needs escaping.
+ *
+ * Looks for quotes, backslashes and control characters in eight
+ * bytes at once, using the well known "has zero byte" and "has byte
+ * less than" bit tricks.
+ *
+ * @param v is the word to check.
+ *
+ * @returns TRUE if any of the bytes needs escaping, FALSE otherwise.
+ */
+static inline gboolean
+_bson_json_word_needs_escape (guint64 v)
+{
+  guint64 q = v ^ (BSON_JSON_ONES * '"');
+  guint64 b = v ^ (BSON_JSON_ONES * '\\');
+
+  return ((((q - BSON_JSON_ONES) & ~q) |
+           ((b - BSON_JSON_ONES) & ~b) |
+           ((v - BSON_JSON_ONES * 0x20) & ~v)) & BSON_JSON_HIGHS) != 0;
+}
+
+/** @internal Write a quoted, escaped JSON string.
+ *
+ * Runs of characters that need no escaping are found eight bytes at a
+ * time, and copied to the output in one go.
+ *
+ * @param w is the writer to write to.
+ * @param s is the string to write.
+ * @param len is the length of @a s.
+ */
+static void
+_bson_json_write_string (bson_json_writer *w, const gchar *s, gsize len)
+{
+  static const gchar hex[] = "0123456789abcdef";
+  gsize i = 0, start = 0;
+  guint64 v;
+  guint8 c;
+  gchar esc[6];
+
+  _bson_json_write_c (w, '"');
+
+  while (i < len)
+    {
+      if (i + sizeof (v) <= len)
+        {
+          memcpy (&v, s + i, sizeof (v));
+          if (!_bson_json_word_needs_escape (v))
+            {
+              i += sizeof (v);
+              continue;
+            }
+        }
+
+      c = (guint8) s[i];
+      if (c >= 0x20 && c != '"' && c != '\\')
+        {
+          i++;
+          continue;
+        }
+
+      _bson_json_write (w, s + start, i - start);
+      esc[0] = '\\';
+      switch (c)
+        {
+        case '"':
+        case '\\':
+          esc[1] = c;
+          break;
+        case '\b':
+          esc[1] = 'b';
+          break;
+        case '\f':
+          esc[1] = 'f';
+          break;
+        case '\n':
+          esc[1] = 'n';
+          break;
+        case '\r':
+          esc[1] = 'r';
+          break;
+        case '\t':
+          esc[1] = 't';
+          break;
+        default:
+          esc[1] = 'u';
+          esc[2] = '0';
+          esc[3] = '0';
+          esc[4] = hex[c >> 4];
+          esc[5] = hex[c & 0x0f];
+          _bson_json_write (w, esc, 6);
+          i++;
+          start = i;
+          continue;
+        }
+      _bson_json_write (w, esc, 2);
+      i++;
+      start = i;
+    }
+  _bson_json_write (w, s + start, len - start);
+
+  _bson_json_write_c (w, '"');
+}
+
+/** @internal Write a 64-bit integer in decimal.
+ *
+ * @param w is the writer to write to.
+ * @param i is the integer to write.
+ */
+static void
+_bson_json_write_int64 (bson_json_writer *w, gint64 i)
+{
+  gchar buf[24];
+  gchar *p = buf + sizeof (buf);
+  guint64 u = (i < 0) ? -(guint64) i : (guint64) i;
+
+  do
+    {
+      *--p = '0' + (u % 10);
+      u /= 10;
+    }
+  while (u);
+  if (i < 0)
+    *--p = '-';
+
+  _bson_json_write (w, p, buf + sizeof (buf) - p);
+}
+
+/** @internal Write a 64-bit integer in decimal, as a quoted string.
+ *
+ * @param w is the writer to write to.
+ * @param i is the integer to write.
+ */
+static void
+_bson_json_write_int64_quoted (bson_json_writer *w, gint64 i)
+{
+  _bson_json_write_c (w, '"');
+  _bson_json_write_int64 (w, i);
+  _bson_json_write_c (w, '"');
+}
+
+/** @internal Write a double.
+ *
+ * Finite values are written in their shortest form that reads back
+ * exactly, always with a decimal point or an exponent.
+ *
+ * @param w is the writer to write to.
+ * @param d is the double to write.
+ */
+static void
+_bson_json_write_double (bson_json_writer *w, gdouble d)
+{
+  static const gchar *formats[] = { "%.15g", "%.16g", "%.17g" };
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE + 2];
+  gboolean relaxed = (w->mode == BSON_JSON_RELAXED);
+  guint i;
+
+  if (isnan (d) || isinf (d))
+    {
+      _bson_json_write_literal (w, "{\"$numberDouble\":\"");
+      if (isnan (d))
+        _bson_json_write_literal (w, "NaN");
+      else if (d < 0)
+        _bson_json_write_literal (w, "-Infinity");
+      else
+        _bson_json_write_literal (w, "Infinity");
+      _bson_json_write_literal (w, "\"}");
+      return;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++)
+    {
+      g_ascii_formatd (buf, G_ASCII_DTOSTR_BUF_SIZE, formats[i], d);
+      if (g_ascii_strtod (buf, NULL) == d)
+        break;
+    }
+  if (!strpbrk (buf, ".e"))
+    strcat (buf, ".0");
+
+  if (!relaxed)
+    _bson_json_write_literal (w, "{\"$numberDouble\":\"");
+  _bson_json_write (w, buf, strlen (buf));
+  if (!relaxed)
+    _bson_json_write_literal (w, "\"}");
+}
+
+/** @internal Write an ObjectID as a hexadecimal string.
+ *
+ * @param w is the writer to write to.
+ * @param oid is the ObjectID to write.
+ */
+static void
+_bson_json_write_oid (bson_json_writer *w, const guint8 *oid)
+{
+  static const gchar hex[] = "0123456789abcdef";
+  gchar buf[24];
+  gint i;
+
+  for (i = 0; i < 12; i++)
+    {
+      buf[i * 2] = hex[oid[i] >> 4];
+      buf[i * 2 + 1] = hex[oid[i] & 0x0f];
+    }
+
+  _bson_json_write_literal (w, "{\"$oid\":\"");
+  _bson_json_write (w, buf, sizeof (buf));
+  _bson_json_write_literal (w, "\"}");
+}
+
+/** @internal Write binary data, base64 encoded.
+ *
+ * @param w is the writer to write to.
+ * @param data is the data to encode.
+ * @param size is the size of @a data.
+ */
+static void
+_bson_json_write_base64 (bson_json_writer *w, const guint8 *data,
+                         gint32 size)
+{
+  static const gchar b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  gchar buf[256];
+  gint32 i = 0, n = 0;
+  guint32 v;
+
+  for (; i + 3 <= size; i += 3)
+    {
+      v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+      buf[n++] = b64[(v >> 18) & 0x3f];
+      buf[n++] = b64[(v >> 12) & 0x3f];
+      buf[n++] = b64[(v >> 6) & 0x3f];
+      buf[n++] = b64[v & 0x3f];
+      if (n == sizeof (buf))
+        {
+          _bson_json_write (w, buf, n);
+          n = 0;
+        }
+    }
+
+  if (i < size)
+    {
+      v = data[i] << 16;
+      if (i + 1 < size)
+        v |= data[i + 1] << 8;
+      buf[n++] = b64[(v >> 18) & 0x3f];
+      buf[n++] = b64[(v >> 12) & 0x3f];
+      buf[n++] = (i + 1 < size) ? b64[(v >> 6) & 0x3f] : '=';
+      buf[n++] = '=';
+    }
+  _bson_json_write (w, buf, n);
+}
+
+/** @internal Write an UTC datetime.
+ *
+ * In relaxed mode, dates between the years 1970 and 9999 are written
+ * as ISO-8601 strings, everything else is written as the number of
+ * milliseconds since the epoch.
+ *
+ * @param w is the writer to write to.
+ * @param ms is the datetime to write.
+ */
+static void
+_bson_json_write_date (bson_json_writer *w, gint64 ms)
+{
+  gchar buf[32];
+  struct tm tm;
+  time_t t;
+  gint l;
+
+  _bson_json_write_literal (w, "{\"$date\":");
+
+  if (w->mode == BSON_JSON_RELAXED && ms >= 0 &&
+      ms < G_GINT64_CONSTANT (253402300800000))
+    {
+      t = (time_t) (ms / 1000);
+      gmtime_r (&t, &tm);
+      l = g_snprintf (buf, sizeof (buf), "\"%04d-%02d-%02dT%02d:%02d:%02d",
+                      tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                      tm.tm_hour, tm.tm_min, tm.tm_sec);
+      if (ms % 1000)
+        l += g_snprintf (buf + l, sizeof (buf) - l, ".%03d",
+                         (gint) (ms % 1000));
+      _bson_json_write (w, buf, l);
+      _bson_json_write_literal (w, "Z\"}");
+      return;
+    }
+
+  _bson_json_write_literal (w, "{\"$numberLong\":");
+  _bson_json_write_int64_quoted (w, ms);
+  _bson_json_write_literal (w, "}}");
+}
+
+static void _bson_json_write_document (bson_json_writer *w,
+                                       const guint8 *d, gboolean array);
+
+/** @internal Write a single BSON value.
+ *
+ * @param w is the writer to write to.
+ * @param type is the type of the value.
+ * @param d is the start of the value.
+ *
+ * @returns The size of the value.
+ */
+static gint32
+_bson_json_write_value (bson_json_writer *w, bson_type type,
+                        const guint8 *d)
+{
+  gboolean relaxed = (w->mode == BSON_JSON_RELAXED);
+  gint32 i32, l, sl;
+  gint64 i64;
+  gdouble dbl;
+
+  switch (type)
+    {
+    case BSON_TYPE_DOUBLE:
+      memcpy (&dbl, d, sizeof (dbl));
+      _bson_json_write_double (w, GDOUBLE_FROM_LE (dbl));
+      return sizeof (dbl);
+    case BSON_TYPE_STRING:
+      l = bson_stream_doc_size (d, 0);
+      _bson_json_write_string (w, (const gchar *) d + sizeof (gint32),
+                               l - 1);
+      return l + sizeof (gint32);
+    case BSON_TYPE_DOCUMENT:
+    case BSON_TYPE_ARRAY:
+      _bson_json_write_document (w, d, type == BSON_TYPE_ARRAY);
+      return bson_stream_doc_size (d, 0);
+    case BSON_TYPE_BINARY:
+      l = bson_stream_doc_size (d, 0);
+      _bson_json_write_literal (w, "{\"$binary\":{\"base64\":\"");
+      _bson_json_write_base64 (w, d + sizeof (gint32) + 1, l);
+      _bson_json_write_literal (w, "\",\"subType\":\"");
+      _bson_json_write_c (w, "0123456789abcdef"[d[sizeof (gint32)] >> 4]);
+      _bson_json_write_c (w, "0123456789abcdef"[d[sizeof (gint32)] & 0xf]);
+      _bson_json_write_literal (w, "\"}}");
+      return l + sizeof (gint32) + 1;
+    case BSON_TYPE_UNDEFINED:
+      _bson_json_write_literal (w, "{\"$undefined\":true}");
+      return 0;
+    case BSON_TYPE_OID:
+      _bson_json_write_oid (w, d);
+      return 12;
+    case BSON_TYPE_BOOLEAN:
+      if (d[0])
+        _bson_json_write_literal (w, "true");
+      else
+        _bson_json_write_literal (w, "false");
+      return 1;
+    case BSON_TYPE_UTC_DATETIME:
+      memcpy (&i64, d, sizeof (i64));
+      _bson_json_write_date (w, GINT64_FROM_LE (i64));
+      return sizeof (i64);
+    case BSON_TYPE_NULL:
+      _bson_json_write_literal (w, "null");
+      return 0;
+    case BSON_TYPE_REGEXP:
+      l = strlen ((const gchar *) d);
+      sl = strlen ((const gchar *) d + l + 1);
+      _bson_json_write_literal (w, "{\"$regularExpression\":{\"pattern\":");
+      _bson_json_write_string (w, (const gchar *) d, l);
+      _bson_json_write_literal (w, ",\"options\":");
+      _bson_json_write_string (w, (const gchar *) d + l + 1, sl);
+      _bson_json_write_literal (w, "}}");
+      return l + sl + 2;
+    case BSON_TYPE_DBPOINTER:
+      l = bson_stream_doc_size (d, 0);
+      _bson_json_write_literal (w, "{\"$dbPointer\":{\"$ref\":");
+      _bson_json_write_string (w, (const gchar *) d + sizeof (gint32),
+                               l - 1);
+      _bson_json_write_literal (w, ",\"$id\":");
+      _bson_json_write_oid (w, d + sizeof (gint32) + l);
+      _bson_json_write_literal (w, "}}");
+      return l + sizeof (gint32) + 12;
+    case BSON_TYPE_JS_CODE:
+    case BSON_TYPE_SYMBOL:
+      l = bson_stream_doc_size (d, 0);
+      if (type == BSON_TYPE_JS_CODE)
+        _bson_json_write_literal (w, "{\"$code\":");
+      else
+        _bson_json_write_literal (w, "{\"$symbol\":");
+      _bson_json_write_string (w, (const gchar *) d + sizeof (gint32),
+                               l - 1);
+      _bson_json_write_c (w, '}');
+      return l + sizeof (gint32);
+    case BSON_TYPE_JS_CODE_W_SCOPE:
+      l = bson_stream_doc_size (d, sizeof (gint32));
+      _bson_json_write_literal (w, "{\"$code\":");
+      _bson_json_write_string (w, (const gchar *) d + sizeof (gint32) * 2,
+                               l - 1);
+      _bson_json_write_literal (w, ",\"$scope\":");
+      _bson_json_write_document (w, d + sizeof (gint32) * 2 + l, FALSE);
+      _bson_json_write_c (w, '}');
+      return bson_stream_doc_size (d, 0);
+    case BSON_TYPE_INT32:
+      i32 = bson_stream_doc_size (d, 0);
+      if (relaxed)
+        _bson_json_write_int64 (w, i32);
+      else
+        {
+          _bson_json_write_literal (w, "{\"$numberInt\":");
+          _bson_json_write_int64_quoted (w, i32);
+          _bson_json_write_c (w, '}');
+        }
+      return sizeof (gint32);
+    case BSON_TYPE_TIMESTAMP:
+      memcpy (&i64, d, sizeof (i64));
+      i64 = GINT64_FROM_LE (i64);
+      _bson_json_write_literal (w, "{\"$timestamp\":{\"t\":");
+      _bson_json_write_int64 (w, (guint32) (i64 >> 32));
+      _bson_json_write_literal (w, ",\"i\":");
+      _bson_json_write_int64 (w, (guint32) i64);
+      _bson_json_write_literal (w, "}}");
+      return sizeof (i64);
+    case BSON_TYPE_INT64:
+      memcpy (&i64, d, sizeof (i64));
+      i64 = GINT64_FROM_LE (i64);
+      if (relaxed)
+        _bson_json_write_int64 (w, i64);
+      else
+        {
+          _bson_json_write_literal (w, "{\"$numberLong\":");
+          _bson_json_write_int64_quoted (w, i64);
+          _bson_json_write_c (w, '}');
+        }
+      return sizeof (i64);
+    case BSON_TYPE_MIN:
+      _bson_json_write_literal (w, "{\"$minKey\":1}");
+      return 0;
+    case BSON_TYPE_MAX:
+      _bson_json_write_literal (w, "{\"$maxKey\":1}");
+      return 0;
+    case BSON_TYPE_NONE:
+    default:
+      /* Validated objects never get here. */
+      return -1;
+    }
+}
+
+/** @internal Write a BSON document or array.
+ *
+ * @param w is the writer to write to.
+ * @param d is the start of the document.
+ * @param array is whether the document is an array.
+ */
+static void
+_bson_json_write_document (bson_json_writer *w, const guint8 *d,
+                           gboolean array)
+{
+  gint32 size = bson_stream_doc_size (d, 0);
+  gint32 pos = sizeof (gint32), key_len;
+
+  _bson_json_write_c (w, (array) ? '[' : '{');
+
+  while (pos < size - 1 && !w->failed)
+    {
+      if (pos > (gint32) sizeof (gint32))
+        _bson_json_write_c (w, ',');
+
+      key_len = strlen ((const gchar *) d + pos + 1);
+      if (!array)
+        {
+          _bson_json_write_string (w, (const gchar *) d + pos + 1, key_len);
+          _bson_json_write_c (w, ':');
+        }
+
+      pos += key_len + 2 +
+        _bson_json_write_value (w, (bson_type) d[pos], d + pos + key_len + 2);
+    }
+
+  _bson_json_write_c (w, (array) ? ']' : '}');
+}
+
+gboolean
+bson_to_json (const bson *b, bson_json_mode mode, bson_json_sink sink,
+              gpointer user_data)
+{
+  bson_json_writer w;
+
+  if (!sink || !bson_validate (b, BSON_VALIDATE_NONE,
+                               BSON_VALIDATE_MAX_DEPTH))
+    {
+      errno = EINVAL;
+      return FALSE;
+    }
+
+  w.sink = sink;
+  w.user_data = user_data;
+  w.mode = mode;
+  w.failed = FALSE;
+  w.len = 0;
+
+  _bson_json_write_document (&w, bson_data (b), FALSE);
+  _bson_json_flush (&w);
+
+  return !w.failed;
+}
+
+/** @internal State of bson_to_json_buffer().
+ */
+typedef struct
+{
+  gchar *buf; /**< The buffer to write to. */
+  gsize size; /**< The size of the buffer. */
+  gsize len; /**< The length of the output so far. */
+} bson_json_buffer;
+
+/** @internal Sink used by bson_to_json_buffer().
+ */
+static gboolean
+_bson_json_buffer_sink (const gchar *data, gsize size, gpointer user_data)
+{
+  bson_json_buffer *out = (bson_json_buffer *) user_data;
+
+  if (out->len + 1 < out->size)
+    memcpy (out->buf + out->len, data,
+            MIN (size, out->size - out->len - 1));
+  out->len += size;
+
+  return TRUE;
+}
+
+gssize
+bson_to_json_buffer (const bson *b, bson_json_mode mode, gchar *buf,
+                     gsize size)
+{
+  bson_json_buffer out;
+
+  if (!buf && size)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  out.buf = buf;
+  out.size = size;
+  out.len = 0;
+
+  if (!bson_to_json (b, mode, _bson_json_buffer_sink, &out))
+    return -1;
+
+  if (size)
+    buf[MIN (out.len, size - 1)] = '\0';
+  return out.len;
+}
+
+/** @internal JSON parser state.
+ */
+typedef struct
+{
+  const gchar *pos; /**< The current position within the input. */
+  const gchar *end; /**< The end of the input. */
+  gint depth; /**< The current nesting depth. */
+  GString *key; /**< Scratch buffer for key names. */
+  GString *str; /**< Scratch buffer for unescaped string values. */
+} bson_json_parser;
+
+/** @internal JSON reader object.
+ */
+struct _bson_json_reader
+{
+  gint fd; /**< The file descriptor to read from, or -1. */
+  const gchar *data; /**< The data to parse: either borrowed from the
+                        caller, or the same as @a buf. */
+  gchar *buf; /**< The read buffer, when reading from @a fd. */
+  gsize alloc; /**< The size of @a buf. */
+  gsize start; /**< The start of the next line within @a data. */
+  gsize scan; /**< The position to look for the next newline from. */
+  gsize end; /**< The end of the available data. */
+  gboolean eof; /**< Whether @a fd reached end of file. */
+  bson_json_parser parser; /**< The parser, with its scratch buffers
+                              reused between documents. */
+};
+
+/** @internal Initial size of the read buffer of JSON readers. */
+#define BSON_JSON_READ_SIZE 65536
+
+/** @internal Skip whitespace in the JSON input.
+ *
+ * @param p is the parser to advance.
+ */
+static inline void
+_bson_json_skip_ws (bson_json_parser *p)
+{
+  while (p->pos < p->end &&
+         (*p->pos == ' ' || *p->pos == '\n' || *p->pos == '\r' ||
+          *p->pos == '\t'))
+    p->pos++;
+}
+
+/** @internal Consume a single character, after optional whitespace.
+ *
+ * @param p is the parser to advance.
+ * @param c is the character expected.
+ *
+ * @returns TRUE if the next character was @a c, FALSE otherwise.
+ */
+static inline gboolean
+_bson_json_expect (bson_json_parser *p, gchar c)
+{
+  _bson_json_skip_ws (p);
+  if (p->pos < p->end && *p->pos == c)
+    {
+      p->pos++;
+      return TRUE;
+    }
+  return FALSE;
+}
+
+/** @internal Consume a literal string.
+ *
+ * @param p is the parser to advance.
+ * @param lit is the literal expected.
+ * @param len is the length of @a lit.
+ *
+ * @returns TRUE if the input continued with @a lit, FALSE otherwise.
+ */
+static inline gboolean
+_bson_json_match (bson_json_parser *p, const gchar *lit, gsize len)
+{
+  if ((gsize)(p->end - p->pos) < len || memcmp (p->pos, lit, len) != 0)
+    return FALSE;
+  p->pos += len;
+  return TRUE;
+}
+
+/** @internal Get the value of a hexadecimal digit.
+ *
+ * @param c is the digit.
+ *
+ * @returns The value of the digit, or -1 if it is not one.
+ */
+static inline gint
+_bson_json_hex_value (gchar c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/** @internal Parse four hexadecimal digits.
+ *
+ * @param s is the start of the digits.
+ * @param out is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_hex4 (const gchar *s, guint32 *out)
+{
+  gint i, v;
+
+  *out = 0;
+  for (i = 0; i < 4; i++)
+    {
+      if ((v = _bson_json_hex_value (s[i])) < 0)
+        return FALSE;
+      *out = (*out << 4) | v;
+    }
+  return TRUE;
+}
+
+/** @internal Parse a JSON string.
+ *
+ * Strings without escape sequences - found eight bytes at a time, the
+ * same way the serializer does - are not copied: @a s will point into
+ * the input. Otherwise the unescaped string is appended to @a buf,
+ * and @a s will point there.
+ *
+ * @param p is the parser, positioned at the opening quote.
+ * @param buf is the buffer to unescape into, if need be.
+ * @param s is where the start of the string will be stored.
+ * @param len is where the length of the string will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_string (bson_json_parser *p, GString *buf,
+                         const gchar **s, gsize *len)
+{
+  const gchar *pos, *run;
+  gsize offset;
+  guint32 cp, lo;
+  guint64 v;
+  guint8 c;
+
+  if (p->pos >= p->end || *p->pos != '"')
+    return FALSE;
+  run = pos = p->pos + 1;
+
+  for (;;)
+    {
+      if (pos + sizeof (v) <= p->end)
+        {
+          memcpy (&v, pos, sizeof (v));
+          if (!_bson_json_word_needs_escape (v))
+            {
+              pos += sizeof (v);
+              continue;
+            }
+        }
+      if (pos >= p->end)
+        return FALSE;
+
+      c = (guint8) *pos;
+      if (c == '"')
+        {
+          *s = run;
+          *len = pos - run;
+          p->pos = pos + 1;
+          return TRUE;
+        }
+      if (c == '\\')
+        break;
+      if (c < 0x20)
+        return FALSE;
+      pos++;
+    }
+
+  offset = buf->len;
+  while (pos < p->end)
+    {
+      c = (guint8) *pos;
+      if (c == '"')
+        {
+          g_string_append_len (buf, run, pos - run);
+          *s = buf->str + offset;
+          *len = buf->len - offset;
+          p->pos = pos + 1;
+          return TRUE;
+        }
+      if (c < 0x20)
+        return FALSE;
+      if (c != '\\')
+        {
+          pos++;
+          continue;
+        }
+
+      g_string_append_len (buf, run, pos - run);
+      if (++pos >= p->end)
+        return FALSE;
+      switch (*pos)
+        {
+        case '"':
+        case '\\':
+        case '/':
+          g_string_append_c (buf, *pos);
+          break;
+        case 'b':
+          g_string_append_c (buf, '\b');
+          break;
+        case 'f':
+          g_string_append_c (buf, '\f');
+          break;
+        case 'n':
+          g_string_append_c (buf, '\n');
+          break;
+        case 'r':
+          g_string_append_c (buf, '\r');
+          break;
+        case 't':
+          g_string_append_c (buf, '\t');
+          break;
+        case 'u':
+          if (p->end - pos < 5 || !_bson_json_parse_hex4 (pos + 1, &cp))
+            return FALSE;
+          pos += 4;
+          if (cp >= 0xdc00 && cp <= 0xdfff)
+            return FALSE;
+          if (cp >= 0xd800 && cp <= 0xdbff)
+            {
+              if (p->end - pos < 7 || pos[1] != '\\' || pos[2] != 'u' ||
+                  !_bson_json_parse_hex4 (pos + 3, &lo) ||
+                  lo < 0xdc00 || lo > 0xdfff)
+                return FALSE;
+              cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+              pos += 6;
+            }
+          g_string_append_unichar (buf, cp);
+          break;
+        default:
+          return FALSE;
+        }
+      run = ++pos;
+    }
+  return FALSE;
+}
+
+/** @internal Parse a key name.
+ *
+ * @param p is the parser, positioned at the opening quote.
+ *
+ * @returns The NUL terminated key name, in the parser's key buffer,
+ * or NULL on error.
+ */
+static const gchar *
+_bson_json_parse_key (bson_json_parser *p)
+{
+  const gchar *s;
+  gsize len;
+
+  g_string_truncate (p->key, 0);
+  if (!_bson_json_parse_string (p, p->key, &s, &len) ||
+      memchr (s, 0, len))
+    return NULL;
+  if (s != p->key->str)
+    g_string_append_len (p->key, s, len);
+  return p->key->str;
+}
+
+/** @internal Parse a string into the parser's string buffer.
+ *
+ * Unlike _bson_json_parse_string(), the string always ends up in
+ * the string buffer, appended to whatever is there already, and NUL
+ * terminated.
+ *
+ * @param p is the parser to advance.
+ * @param offset is where the offset of the string within the buffer
+ * will be stored.
+ * @param len is where the length of the string will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_string_copy (bson_json_parser *p, gsize *offset,
+                              gsize *len)
+{
+  const gchar *s;
+
+  _bson_json_skip_ws (p);
+  *offset = p->str->len;
+  if (!_bson_json_parse_string (p, p->str, &s, len))
+    return FALSE;
+  if (p->str->len == *offset)
+    g_string_append_len (p->str, s, *len);
+  return TRUE;
+}
+
+/** @internal Parse a decimal 64-bit integer from a string.
+ *
+ * @param s is the string to parse.
+ * @param len is the length of @a s.
+ * @param out is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_string_to_int64 (const gchar *s, gsize len, gint64 *out)
+{
+  gboolean neg = FALSE;
+  guint64 u = 0;
+  gsize i = 0;
+
+  if (len && s[0] == '-')
+    {
+      neg = TRUE;
+      i++;
+    }
+  if (i == len)
+    return FALSE;
+
+  for (; i < len; i++)
+    {
+      if (s[i] < '0' || s[i] > '9' || u > G_MAXUINT64 / 10)
+        return FALSE;
+      u = u * 10 + (s[i] - '0');
+    }
+
+  if (u > (guint64) G_MAXINT64 + neg)
+    return FALSE;
+  *out = (neg) ? -(gint64) (u - 1) - 1 : (gint64) u;
+  return TRUE;
+}
+
+/** @internal Parse an unsigned 32-bit JSON integer.
+ *
+ * @param p is the parser to advance.
+ * @param out is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_uint32 (bson_json_parser *p, guint32 *out)
+{
+  guint64 u = 0;
+  const gchar *start;
+
+  _bson_json_skip_ws (p);
+  start = p->pos;
+  while (p->pos < p->end && *p->pos >= '0' && *p->pos <= '9' &&
+         u <= G_MAXUINT32)
+    u = u * 10 + (*p->pos++ - '0');
+
+  if (p->pos == start || u > G_MAXUINT32)
+    return FALSE;
+  *out = (guint32) u;
+  return TRUE;
+}
+
+/** @internal Convert a proleptic Gregorian date to days since the epoch.
+ *
+ * @param y is the year.
+ * @param m is the month, starting from 1.
+ * @param d is the day of the month, starting from 1.
+ *
+ * @returns The number of days since 1970-01-01.
+ */
+static gint64
+_bson_json_days_from_civil (gint64 y, gint m, gint d)
+{
+  gint64 era, yoe, doy, doe;
+
+  y -= (m <= 2);
+  era = ((y >= 0) ? y : y - 399) / 400;
+  yoe = y - era * 400;
+  doy = (153 * (m + ((m > 2) ? -3 : 9)) + 2) / 5 + d - 1;
+  doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/** @internal Parse a fixed number of decimal digits.
+ *
+ * @param s is the start of the digits.
+ * @param n is the number of digits.
+ *
+ * @returns The value of the digits, or -1 if they are not all digits.
+ */
+static gint
+_bson_json_digits (const gchar *s, gint n)
+{
+  gint v = 0;
+
+  while (n--)
+    {
+      if (*s < '0' || *s > '9')
+        return -1;
+      v = v * 10 + (*s++ - '0');
+    }
+  return v;
+}
+
+/** @internal Parse an ISO-8601 date.
+ *
+ * Accepts the YYYY-MM-DDTHH:MM:SS[.fff](Z|+HH:MM|-HH:MM) format, as
+ * used by extended JSON.
+ *
+ * @param s is the string to parse.
+ * @param len is the length of @a s.
+ * @param ms is where the milliseconds since the epoch will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_iso8601 (const gchar *s, gsize len, gint64 *ms)
+{
+  const gchar *end = s + len;
+  gint year, mon, mday, hour, min, sec, frac = 0, scale = 100, off = 0;
+  gint oh, om;
+
+  if (len < 20 || s[4] != '-' || s[7] != '-' || s[10] != 'T' ||
+      s[13] != ':' || s[16] != ':' ||
+      (year = _bson_json_digits (s, 4)) < 0 ||
+      (mon = _bson_json_digits (s + 5, 2)) < 1 || mon > 12 ||
+      (mday = _bson_json_digits (s + 8, 2)) < 1 || mday > 31 ||
+      (hour = _bson_json_digits (s + 11, 2)) < 0 || hour > 23 ||
+      (min = _bson_json_digits (s + 14, 2)) < 0 || min > 59 ||
+      (sec = _bson_json_digits (s + 17, 2)) < 0 || sec > 60)
+    return FALSE;
+  s += 19;
+
+  if (*s == '.')
+    {
+      if (++s == end || *s < '0' || *s > '9')
+        return FALSE;
+      for (; s < end && *s >= '0' && *s <= '9'; s++)
+        {
+          frac += (*s - '0') * scale;
+          scale /= 10;
+        }
+    }
+
+  if (s < end && *s == 'Z')
+    s++;
+  else if (s < end && (*s == '+' || *s == '-'))
+    {
+      if (end - s == 6 && s[3] == ':')
+        om = _bson_json_digits (s + 4, 2);
+      else if (end - s == 5)
+        om = _bson_json_digits (s + 3, 2);
+      else
+        return FALSE;
+      if ((oh = _bson_json_digits (s + 1, 2)) < 0 || om < 0)
+        return FALSE;
+      off = (oh * 60 + om) * 60 * ((*s == '-') ? -1 : 1);
+      s = end;
+    }
+  if (s != end)
+    return FALSE;
+
+  *ms = ((_bson_json_days_from_civil (year, mon, mday) * 86400 +
+          hour * 3600 + min * 60 + sec - off) * 1000) + frac;
+  return TRUE;
+}
+
+/** @internal Get the value of a base64 digit.
+ *
+ * @param c is the digit.
+ *
+ * @returns The value of the digit, or -1 if it is not one.
+ */
+static inline gint
+_bson_json_base64_value (gchar c)
+{
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+')
+    return 62;
+  if (c == '/')
+    return 63;
+  return -1;
+}
+
+/** @internal Decode base64 data in place.
+ *
+ * @param data is the data to decode.
+ * @param len is the length of @a data.
+ * @param out_len is where the length of the decoded data will be
+ * stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_base64_decode (gchar *data, gsize len, gsize *out_len)
+{
+  gsize i, o = 0, pad = 0;
+  guint32 v;
+  gint j, d;
+
+  if (len % 4)
+    return FALSE;
+  if (len && data[len - 1] == '=')
+    pad++;
+  if (len > 1 && data[len - 2] == '=')
+    pad++;
+
+  for (i = 0; i < len; i += 4)
+    {
+      v = 0;
+      for (j = 0; j < 4; j++)
+        {
+          if (i + j >= len - pad)
+            d = 0;
+          else if ((d = _bson_json_base64_value (data[i + j])) < 0)
+            return FALSE;
+          v = (v << 6) | d;
+        }
+      data[o++] = (v >> 16) & 0xff;
+      data[o++] = (v >> 8) & 0xff;
+      data[o++] = v & 0xff;
+    }
+
+  *out_len = o - pad;
+  return TRUE;
+}
+
+/** @internal Consume a key of an extended JSON wrapper object.
+ *
+ * Keys of extended JSON wrappers never need escaping, so they are
+ * matched against the raw input.
+ *
+ * @param p is the parser to advance.
+ * @param key is the key to look for.
+ *
+ * @returns TRUE if the key and the following colon were found, FALSE
+ * otherwise.
+ */
+static gboolean
+_bson_json_match_key (bson_json_parser *p, const gchar *key)
+{
+  gsize len = strlen (key);
+
+  _bson_json_skip_ws (p);
+  if ((gsize)(p->end - p->pos) < len + 2 || p->pos[0] != '"' ||
+      memcmp (p->pos + 1, key, len) != 0 || p->pos[len + 1] != '"')
+    return FALSE;
+  p->pos += len + 2;
+  return _bson_json_expect (p, ':');
+}
+
+static gboolean _bson_json_parse_object (bson_json_parser *p, bson *b);
+
+/** @internal Append an empty binary to a BSON object.
+ *
+ * @param b is the BSON object to append to.
+ * @param name is the key name.
+ * @param subtype is the binary subtype.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_append_empty_binary (bson *b, const gchar *name, guint8 subtype)
+{
+  /* A document with a single, empty binary element, without a key. */
+  guint8 raw[] = { 12, 0, 0, 0, BSON_TYPE_BINARY, 0, 0, 0, 0, 0, 0, 0 };
+  bson *view;
+  bson_cursor *c;
+  gboolean ok;
+
+  raw[10] = subtype;
+  view = bson_new_view (raw, sizeof (raw));
+  c = bson_cursor_new (view);
+  ok = bson_cursor_next (c) && bson_append_element_from_cursor (b, name, c);
+  bson_cursor_free (c);
+  bson_free (view);
+  return ok;
+}
+
+/** @internal Parse an extended JSON wrapper object.
+ *
+ * Recognises the wrappers bson_to_json() produces for values that
+ * have no plain JSON counterpart, in the same key order. Anything
+ * else - including wrappers this parser does not know about - is left
+ * to be parsed as a plain embedded document.
+ *
+ * @param p is the parser, positioned at the opening brace.
+ * @param b is the BSON object to append to.
+ * @param name is the key name to append the value with.
+ *
+ * @returns TRUE if the wrapper was recognised and appended, FALSE
+ * otherwise, in which case the parser is left where it was.
+ */
+static gboolean
+_bson_json_parse_extended (bson_json_parser *p, bson *b, const gchar *name)
+{
+  const gchar *save = p->pos;
+  gsize offset, len, olen;
+  gint64 i64;
+  guint32 t, i;
+  gdouble d;
+  gchar *code;
+  GString *key;
+  bson *scope;
+  gint hi, lo;
+  gboolean ok;
+
+  p->pos++;
+  _bson_json_skip_ws (p);
+  if (p->end - p->pos < 2 || p->pos[0] != '"' || p->pos[1] != '$')
+    goto fallback;
+  g_string_truncate (p->str, 0);
+
+  if (_bson_json_match_key (p, "$oid"))
+    {
+      guint8 oid[12];
+      gint k;
+
+      if (!_bson_json_parse_string_copy (p, &offset, &len) || len != 24 ||
+          !_bson_json_expect (p, '}'))
+        goto fallback;
+      for (k = 0; k < 12; k++)
+        {
+          hi = _bson_json_hex_value (p->str->str[k * 2]);
+          lo = _bson_json_hex_value (p->str->str[k * 2 + 1]);
+          if (hi < 0 || lo < 0)
+            goto fallback;
+          oid[k] = (hi << 4) | lo;
+        }
+      ok = bson_append_oid (b, name, oid);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$date"))
+    {
+      _bson_json_skip_ws (p);
+      if (p->pos < p->end && *p->pos == '"')
+        {
+          if (!_bson_json_parse_string_copy (p, &offset, &len) ||
+              !_bson_json_parse_iso8601 (p->str->str, len, &i64))
+            goto fallback;
+        }
+      else if (!_bson_json_expect (p, '{') ||
+               !_bson_json_match_key (p, "$numberLong") ||
+               !_bson_json_parse_string_copy (p, &offset, &len) ||
+               !_bson_json_string_to_int64 (p->str->str, len, &i64) ||
+               !_bson_json_expect (p, '}'))
+        goto fallback;
+      if (!_bson_json_expect (p, '}'))
+        goto fallback;
+      ok = bson_append_utc_datetime (b, name, i64);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$numberInt"))
+    {
+      if (!_bson_json_parse_string_copy (p, &offset, &len) ||
+          !_bson_json_string_to_int64 (p->str->str, len, &i64) ||
+          i64 < G_MININT32 || i64 > G_MAXINT32 ||
+          !_bson_json_expect (p, '}'))
+        goto fallback;
+      ok = bson_append_int32 (b, name, (gint32) i64);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$numberLong"))
+    {
+      if (!_bson_json_parse_string_copy (p, &offset, &len) ||
+          !_bson_json_string_to_int64 (p->str->str, len, &i64) ||
+          !_bson_json_expect (p, '}'))
+        goto fallback;
+      ok = bson_append_int64 (b, name, i64);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$numberDouble"))
+    {
+      gchar *e;
+
+      if (!_bson_json_parse_string_copy (p, &offset, &len) ||
+          !_bson_json_expect (p, '}'))
+        goto fallback;
+      if (strcmp (p->str->str, "Infinity") == 0)
+        d = HUGE_VAL;
+      else if (strcmp (p->str->str, "-Infinity") == 0)
+        d = -HUGE_VAL;
+      else if (strcmp (p->str->str, "NaN") == 0)
+        d = NAN;
+      else
+        {
+          d = g_ascii_strtod (p->str->str, &e);
+          if (len == 0 || e != p->str->str + len)
+            goto fallback;
+        }
+      ok = bson_append_double (b, name, d);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$binary"))
+    {
+      if (!_bson_json_expect (p, '{') ||
+          !_bson_json_match_key (p, "base64") ||
+          !_bson_json_parse_string_copy (p, &offset, &len) ||
+          !_bson_json_base64_decode (p->str->str, len, &len))
+        goto fallback;
+      g_string_truncate (p->str, len);
+
+      if (!_bson_json_expect (p, ',') ||
+          !_bson_json_match_key (p, "subType") ||
+          !_bson_json_parse_string_copy (p, &offset, &olen) ||
+          olen < 1 || olen > 2 ||
+          (hi = _bson_json_hex_value (p->str->str[offset])) < 0 ||
+          (lo = (olen == 2) ?
+           _bson_json_hex_value (p->str->str[offset + 1]) : 0) < 0 ||
+          !_bson_json_expect (p, '}') || !_bson_json_expect (p, '}'))
+        goto fallback;
+      if (olen == 1)
+        lo = hi, hi = 0;
+      /* Empty binaries are valid BSON, but bson_append_binary()
+         refuses them. */
+      if (len == 0)
+        ok = _bson_json_append_empty_binary (b, name, (hi << 4) | lo);
+      else
+        ok = bson_append_binary (b, name, (bson_binary_subtype)
+                                 ((hi << 4) | lo),
+                                 (const guint8 *) p->str->str, len);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$timestamp"))
+    {
+      if (!_bson_json_expect (p, '{') ||
+          !_bson_json_match_key (p, "t") ||
+          !_bson_json_parse_uint32 (p, &t) ||
+          !_bson_json_expect (p, ',') ||
+          !_bson_json_match_key (p, "i") ||
+          !_bson_json_parse_uint32 (p, &i) ||
+          !_bson_json_expect (p, '}') || !_bson_json_expect (p, '}'))
+        goto fallback;
+      ok = bson_append_timestamp (b, name,
+                                  (gint64) (((guint64) t << 32) | i));
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$regularExpression"))
+    {
+      if (!_bson_json_expect (p, '{') ||
+          !_bson_json_match_key (p, "pattern") ||
+          !_bson_json_parse_string_copy (p, &offset, &len))
+        goto fallback;
+      g_string_append_c (p->str, '\0');
+      if (!_bson_json_expect (p, ',') ||
+          !_bson_json_match_key (p, "options") ||
+          !_bson_json_parse_string_copy (p, &offset, &olen) ||
+          !_bson_json_expect (p, '}') || !_bson_json_expect (p, '}') ||
+          memchr (p->str->str, 0, len) ||
+          memchr (p->str->str + offset, 0, olen))
+        goto fallback;
+      ok = bson_append_regex (b, name, p->str->str,
+                              p->str->str + offset);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$symbol"))
+    {
+      if (!_bson_json_parse_string_copy (p, &offset, &len) ||
+          !_bson_json_expect (p, '}'))
+        goto fallback;
+      ok = bson_append_symbol (b, name, p->str->str,
+                               (len) ? (gint32) len : -1);
+      goto done;
+    }
+
+  if (_bson_json_match_key (p, "$code"))
+    {
+      if (!_bson_json_parse_string_copy (p, &offset, &len))
+        goto fallback;
+      if (_bson_json_expect (p, '}'))
+        {
+          ok = bson_append_javascript (b, name, p->str->str,
+                                       (len) ? (gint32) len : -1);
+          goto done;
+        }
+
+      if (!_bson_json_expect (p, ',') ||
+          !_bson_json_match_key (p, "$scope") ||
+          !(_bson_json_skip_ws (p), p->pos < p->end && *p->pos == '{') ||
+          p->depth >= BSON_VALIDATE_MAX_DEPTH)
+        goto fallback;
+
+      /* Parsing the scope reuses the value buffer, and would reuse
+         the key buffer too, which @a name points into: the caller
+         still needs that if this turns out not to be a wrapper, so
+         the scope gets a key buffer of its own. */
+      code = g_strndup (p->str->str, len);
+      key = p->key;
+      p->key = g_string_sized_new (32);
+      scope = bson_new ();
+      p->depth++;
+      ok = _bson_json_parse_object (p, scope) && bson_finish (scope) &&
+        _bson_json_expect (p, '}');
+      p->depth--;
+      g_string_free (p->key, TRUE);
+      p->key = key;
+      if (ok)
+        ok = bson_append_javascript_w_scope (b, name, code,
+                                             (len) ? (gint32) len : -1,
+                                             scope);
+      bson_free (scope);
+      g_free (code);
+      goto done;
+    }
+
+  goto fallback;
+
+ done:
+  if (ok)
+    return TRUE;
+ fallback:
+  p->pos = save;
+  return FALSE;
+}
+
+/** @internal Parse a JSON number.
+ *
+ * Integers are appended as 32-bit integers if they fit, as 64-bit
+ * ones otherwise, everything else is appended as a double.
+ *
+ * @param p is the parser, positioned at the start of the number.
+ * @param b is the BSON object to append to.
+ * @param name is the key name to append the value with.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_number (bson_json_parser *p, bson *b, const gchar *name)
+{
+  const gchar *pos = p->pos, *start = p->pos;
+  gboolean neg = FALSE, fp = FALSE, overflow = FALSE;
+  guint64 u = 0;
+  gchar buf[64], *tmp;
+  gint64 i;
+  gdouble d;
+
+  if (pos < p->end && *pos == '-')
+    {
+      neg = TRUE;
+      pos++;
+    }
+  if (pos >= p->end || *pos < '0' || *pos > '9')
+    return FALSE;
+  if (*pos == '0')
+    pos++;
+  else
+    for (; pos < p->end && *pos >= '0' && *pos <= '9'; pos++)
+      {
+        if (u > G_MAXINT64 / 10)
+          overflow = TRUE;
+        else
+          u = u * 10 + (*pos - '0');
+      }
+
+  if (pos < p->end && *pos == '.')
+    {
+      fp = TRUE;
+      if (++pos >= p->end || *pos < '0' || *pos > '9')
+        return FALSE;
+      while (pos < p->end && *pos >= '0' && *pos <= '9')
+        pos++;
+    }
+  if (pos < p->end && (*pos == 'e' || *pos == 'E'))
+    {
+      fp = TRUE;
+      if (++pos < p->end && (*pos == '+' || *pos == '-'))
+        pos++;
+      if (pos >= p->end || *pos < '0' || *pos > '9')
+        return FALSE;
+      while (pos < p->end && *pos >= '0' && *pos <= '9')
+        pos++;
+    }
+  p->pos = pos;
+
+  if (!fp && !overflow && u <= (guint64) G_MAXINT64 + neg)
+    {
+      i = (neg) ? -(gint64) (u - 1) - 1 : (gint64) u;
+      if (u == 0)
+        i = 0;
+      if (i >= G_MININT32 && i <= G_MAXINT32)
+        return bson_append_int32 (b, name, (gint32) i);
+      return bson_append_int64 (b, name, i);
+    }
+
+  if ((gsize)(pos - start) < sizeof (buf))
+    {
+      memcpy (buf, start, pos - start);
+      buf[pos - start] = '\0';
+      d = g_ascii_strtod (buf, NULL);
+    }
+  else
+    {
+      tmp = g_strndup (start, pos - start);
+      d = g_ascii_strtod (tmp, NULL);
+      g_free (tmp);
+    }
+  return bson_append_double (b, name, d);
+}
+
+static gboolean _bson_json_parse_array (bson_json_parser *p, bson *b);
+
+/** @internal Parse a JSON value.
+ *
+ * @param p is the parser to advance.
+ * @param b is the BSON object to append to.
+ * @param name is the key name to append the value with.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_value (bson_json_parser *p, bson *b, const gchar *name)
+{
+  const gchar *s;
+  gsize len;
+  bson *child;
+  gboolean ok;
+
+  _bson_json_skip_ws (p);
+  if (p->pos >= p->end)
+    return FALSE;
+
+  switch (*p->pos)
+    {
+    case '"':
+      g_string_truncate (p->str, 0);
+      if (!_bson_json_parse_string (p, p->str, &s, &len))
+        return FALSE;
+      return bson_append_string (b, name, (len) ? s : "",
+                                 (len) ? (gint32) len : -1);
+    case '{':
+      if (_bson_json_parse_extended (p, b, name))
+        return TRUE;
+      if (p->depth >= BSON_VALIDATE_MAX_DEPTH ||
+          !bson_append_document_begin (b, name, &child))
+        return FALSE;
+      p->depth++;
+      ok = _bson_json_parse_object (p, child);
+      p->depth--;
+      return bson_append_document_end (b, child) && ok;
+    case '[':
+      if (p->depth >= BSON_VALIDATE_MAX_DEPTH ||
+          !bson_append_array_begin (b, name, &child))
+        return FALSE;
+      p->depth++;
+      ok = _bson_json_parse_array (p, child);
+      p->depth--;
+      return bson_append_array_end (b, child) && ok;
+    case 't':
+      return _bson_json_match (p, "true", 4) &&
+        bson_append_boolean (b, name, TRUE);
+    case 'f':
+      return _bson_json_match (p, "false", 5) &&
+        bson_append_boolean (b, name, FALSE);
+    case 'n':
+      return _bson_json_match (p, "null", 4) &&
+        bson_append_null (b, name);
+    default:
+      return _bson_json_parse_number (p, b, name);
+    }
+}
+
+/** @internal Parse the members of a JSON object.
+ *
+ * @param p is the parser, positioned at the opening brace.
+ * @param b is the BSON object to append the members to.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_object (bson_json_parser *p, bson *b)
+{
+  const gchar *name;
+
+  p->pos++;
+  if (_bson_json_expect (p, '}'))
+    return TRUE;
+
+  do
+    {
+      _bson_json_skip_ws (p);
+      if (!(name = _bson_json_parse_key (p)) ||
+          !_bson_json_expect (p, ':') ||
+          !_bson_json_parse_value (p, b, name))
+        return FALSE;
+    }
+  while (_bson_json_expect (p, ','));
+
+  return _bson_json_expect (p, '}');
+}
+
+/** @internal Parse the elements of a JSON array.
+ *
+ * @param p is the parser, positioned at the opening bracket.
+ * @param b is the BSON array to append the elements to.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_json_parse_array (bson_json_parser *p, bson *b)
+{
+  gchar name[16], digits[12];
+  guint32 idx = 0, v;
+  gint n, k;
+
+  p->pos++;
+  if (_bson_json_expect (p, ']'))
+    return TRUE;
+
+  do
+    {
+      v = idx++;
+      n = 0;
+      do
+        {
+          digits[n++] = '0' + (v % 10);
+          v /= 10;
+        }
+      while (v);
+      for (k = 0; k < n; k++)
+        name[k] = digits[n - k - 1];
+      name[n] = '\0';
+
+      if (!_bson_json_parse_value (p, b, name))
+        return FALSE;
+    }
+  while (_bson_json_expect (p, ','));
+
+  return _bson_json_expect (p, ']');
+}
+
+/** @internal Parse a complete JSON document.
+ *
+ * @param p is the parser to use.
+ * @param json is the JSON text.
+ * @param size is the size of @a json.
+ *
+ * @returns A newly allocated, finished BSON object, or NULL if @a
+ * json is not a valid JSON object.
+ */
+static bson *
+_bson_json_parse_document (bson_json_parser *p, const gchar *json,
+                           gsize size)
+{
+  bson *b;
+
+  p->pos = json;
+  p->end = json + size;
+  p->depth = 1;
+
+  if (!_bson_json_expect (p, '{'))
+    return NULL;
+  p->pos--;
+
+  b = bson_new_sized ((gint32) MIN (size, G_MAXINT32));
+  if (!_bson_json_parse_object (p, b) ||
+      (_bson_json_skip_ws (p), p->pos != p->end) ||
+      !bson_finish (b))
+    {
+      bson_free (b);
+      return NULL;
+    }
+  return b;
+}
+
+bson *
+bson_new_from_json (const gchar *json, gssize size)
+{
+  bson_json_parser p;
+  bson *b;
+
+  if (!json)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+  if (size < 0)
+    size = strlen (json);
+
+  p.key = g_string_sized_new (64);
+  p.str = g_string_sized_new (64);
+  b = _bson_json_parse_document (&p, json, size);
+  g_string_free (p.key, TRUE);
+  g_string_free (p.str, TRUE);
+
+  if (!b)
+    errno = EINVAL;
+  return b;
+}
+
+/** @internal Allocate a JSON reader.
+ *
+ * @param fd is the file descriptor to read from, or -1.
+ *
+ * @returns A newly allocated reader.
+ */
+static bson_json_reader *
+_bson_json_reader_new (gint fd)
+{
+  bson_json_reader *r = g_new0 (bson_json_reader, 1);
+
+  r->fd = fd;
+  r->parser.key = g_string_sized_new (64);
+  r->parser.str = g_string_sized_new (64);
+
+  return r;
+}
+
+bson_json_reader *
+bson_json_reader_new_from_data (const gchar *data, gsize size)
+{
+  bson_json_reader *r;
+
+  if (!data)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  r = _bson_json_reader_new (-1);
+  r->data = data;
+  r->end = size;
+  r->eof = TRUE;
+
+  return r;
+}
+
+bson_json_reader *
+bson_json_reader_new_from_fd (gint fd)
+{
+  bson_json_reader *r;
+
+  if (fd < 0)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  r = _bson_json_reader_new (fd);
+  r->alloc = BSON_JSON_READ_SIZE;
+  r->buf = (gchar *) g_malloc (r->alloc);
+  r->data = r->buf;
+
+  return r;
+}
+
+/** @internal Read more data into a JSON reader.
+ *
+ * Moves the unconsumed data to the start of the buffer, grows it if
+ * it is full, and reads as much as fits.
+ *
+ * @param r is the reader to read into.
+ *
+ * @returns TRUE if some data was read, FALSE on end of file (with
+ * errno set to zero) or error.
+ */
+static gboolean
+_bson_json_reader_fill (bson_json_reader *r)
+{
+  gssize n;
+
+  if (r->start > 0)
+    {
+      memmove (r->buf, r->buf + r->start, r->end - r->start);
+      r->end -= r->start;
+      r->scan -= r->start;
+      r->start = 0;
+    }
+  if (r->end == r->alloc)
+    {
+      r->alloc *= 2;
+      r->buf = (gchar *) g_realloc (r->buf, r->alloc);
+      r->data = r->buf;
+    }
+
+  do
+    n = read (r->fd, r->buf + r->end, r->alloc - r->end);
+  while (n < 0 && errno == EINTR);
+
+  if (n <= 0)
+    {
+      if (n == 0)
+        {
+          r->eof = TRUE;
+          errno = 0;
+        }
+      return FALSE;
+    }
+
+  r->end += n;
+  return TRUE;
+}
+
+bson *
+bson_json_reader_next (bson_json_reader *r)
+{
+  const gchar *line, *nl;
+  bson *b;
+
+  if (!r)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  for (;;)
+    {
+      nl = (const gchar *) memchr (r->data + r->scan, '\n',
+                                   r->end - r->scan);
+      if (!nl)
+        {
+          r->scan = r->end;
+          if (!r->eof)
+            {
+              if (!_bson_json_reader_fill (r) && !r->eof)
+                return NULL;
+              continue;
+            }
+          if (r->start == r->end)
+            {
+              errno = 0;
+              return NULL;
+            }
+          nl = r->data + r->end;
+        }
+
+      line = r->data + r->start;
+      r->start = r->scan = MIN ((gsize) (nl - r->data) + 1, r->end);
+
+      r->parser.pos = line;
+      r->parser.end = nl;
+      _bson_json_skip_ws (&r->parser);
+      if (r->parser.pos == nl)
+        continue;
+
+      b = _bson_json_parse_document (&r->parser, line, nl - line);
+      if (!b)
+        errno = EINVAL;
+      return b;
+    }
+}
+
+void
+bson_json_reader_free (bson_json_reader *r)
+{
+  if (!r)
+    return;
+
+  g_string_free (r->parser.key, TRUE);
+  g_string_free (r->parser.str, TRUE);
+  g_free (r->buf);
+  g_free (r);
+}
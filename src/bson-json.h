@@ -0,0 +1,171 @@
+/* bson-json.h - libmongo-client's BSON to JSON conversion
+ * Copyright 2011, 2012 Gergely Nagy <algernon@balabit.hu>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file src/bson-json.h
+ * Public header for converting between BSON and JSON.
+ */
+
+#ifndef LIBMONGO_CLIENT_BSON_JSON_H
+#define LIBMONGO_CLIENT_BSON_JSON_H 1
+
+#include <glib.h>
+#include <bson.h>
+
+G_BEGIN_DECLS
+
+/** @defgroup bson_json BSON & JSON
+ *
+ * Functions to serialise BSON objects as MongoDB Extended JSON
+ * (version 2), and to parse JSON text into BSON objects.
+ *
+ * @addtogroup bson_json
+ * @{
+ */
+
+/** Extended JSON output modes.
+ */
+typedef enum
+  {
+    BSON_JSON_RELAXED = 0, /**< Relaxed mode: numbers and dates are
+                              written in their most natural JSON form,
+                              at the cost of losing some type
+                              information. */
+    BSON_JSON_CANONICAL /**< Canonical mode: every value is written
+                           so that its exact BSON type is
+                           preserved. */
+  } bson_json_mode;
+
+/** JSON output sink.
+ *
+ * Called by bson_to_json() with consecutive chunks of the output.
+ *
+ * @param data is the chunk of output, not NUL terminated.
+ * @param size is the size of the chunk.
+ * @param user_data is the user data passed to bson_to_json().
+ *
+ * @returns TRUE to continue, FALSE to abort the conversion.
+ */
+typedef gboolean (*bson_json_sink) (const gchar *data, gsize size,
+                                    gpointer user_data);
+
+/** Convert a BSON object to Extended JSON, through a sink.
+ *
+ * The output is assembled in a fixed-size internal buffer, which is
+ * handed to @a sink whenever it fills up, and once more at the end.
+ * No memory is allocated during the conversion.
+ *
+ * @param b is the finished BSON object to convert. It is validated
+ * with bson_validate() first.
+ * @param mode is the output mode to use.
+ * @param sink is the function to pass the output to.
+ * @param user_data is passed to @a sink unchanged.
+ *
+ * @returns TRUE on success, FALSE otherwise. If the object is
+ * invalid, errno is set to EINVAL. If @a sink aborted the conversion,
+ * errno is left as the sink left it.
+ */
+gboolean bson_to_json (const bson *b, bson_json_mode mode,
+                       bson_json_sink sink, gpointer user_data);
+
+/** Convert a BSON object to Extended JSON, into a buffer.
+ *
+ * Works like snprintf(): at most @a size bytes are written to @a
+ * buf, including a terminating NUL byte, and the return value is the
+ * length of the complete output. If it is @a size or more, the output
+ * was truncated.
+ *
+ * @param b is the finished BSON object to convert.
+ * @param mode is the output mode to use.
+ * @param buf is the buffer to write to. Can be NULL if @a size is
+ * zero, to measure the output.
+ * @param size is the size of @a buf.
+ *
+ * @returns The length of the JSON output (not counting the
+ * terminating NUL byte), or -1 on error.
+ */
+gssize bson_to_json_buffer (const bson *b, bson_json_mode mode,
+                            gchar *buf, gsize size);
+
+/** Opaque newline-delimited JSON reader object. */
+typedef struct _bson_json_reader bson_json_reader;
+
+/** Parse a JSON object into a BSON object.
+ *
+ * The text is parsed in a single pass, straight into the BSON object,
+ * without building any intermediate representation. Integers become
+ * 32-bit integers when they fit, 64-bit ones otherwise, other numbers
+ * become doubles.
+ *
+ * The extended JSON wrappers produced by bson_to_json() (in either
+ * mode) are converted back to the BSON types they stand for, with
+ * the exception of $dbPointer, $undefined, $minKey and $maxKey, which
+ * are kept as embedded documents.
+ *
+ * @param json is the JSON text to parse. It must contain a single
+ * JSON object, optionally surrounded by whitespace.
+ * @param size is the size of @a json, or -1 if it is NUL terminated.
+ *
+ * @returns A newly allocated, finished BSON object, or NULL on error,
+ * with errno set to EINVAL.
+ */
+bson *bson_new_from_json (const gchar *json, gssize size);
+
+/** Create a newline-delimited JSON reader over a buffer.
+ *
+ * @param data is the buffer to read JSON objects from, one per
+ * line. It is not copied, and must remain valid until the reader is
+ * freed.
+ * @param size is the size of @a data.
+ *
+ * @returns A newly allocated reader, or NULL on error.
+ */
+bson_json_reader *bson_json_reader_new_from_data (const gchar *data,
+                                                  gsize size);
+
+/** Create a newline-delimited JSON reader over a file descriptor.
+ *
+ * @param fd is the file descriptor to read JSON objects from, one
+ * per line. It is not closed when the reader is freed.
+ *
+ * @returns A newly allocated reader, or NULL on error.
+ */
+bson_json_reader *bson_json_reader_new_from_fd (gint fd);
+
+/** Read the next document from a newline-delimited JSON reader.
+ *
+ * Empty lines are skipped. A line that is not a valid JSON object is
+ * consumed, and reported as an error; reading can continue with the
+ * next line.
+ *
+ * @param r is the reader to read from.
+ *
+ * @returns A newly allocated, finished BSON object, or NULL at the
+ * end of the input (with errno set to zero) or on error (with errno
+ * set to EINVAL for invalid lines, or as set by read()).
+ */
+bson *bson_json_reader_next (bson_json_reader *r);
+
+/** Free a newline-delimited JSON reader.
+ *
+ * @param r is the reader to free.
+ */
+void bson_json_reader_free (bson_json_reader *r);
+
+/** @} */
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,373 @@
+/* bson-stream.c - libmongo-client's BSON stream reader
+ * Copyright 2011, 2012 Gergely Nagy <algernon@balabit.hu>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file src/bson-stream.c
+ * Implementation of the BSON stream reader.
+ */
+
+#include <glib.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bson.h"
+#include "bson-stream.h"
+#include "libmongo-private.h"
+
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+/** @internal BSON stream reader.
+ */
+struct _bson_stream_reader
+{
+  const guint8 *data; /**< The stream of documents. */
+  gsize size; /**< The size of @a data. */
+  gsize offset; /**< The offset of the next document in @a data. */
+
+  gboolean mapped; /**< Whether @a data was mapped by the reader, and
+                      must be unmapped when it is freed. */
+  gboolean owned; /**< Whether @a data was read into memory by the
+                     reader, and must be freed with it. */
+
+  gsize *index; /**< The offsets of the documents, if the index was
+                   built. */
+  gint64 count; /**< The number of documents in @a index. */
+
+  bson current; /**< The view handed out to the caller. */
+};
+
+/** @internal Check the framing of a document within a stream.
+ *
+ * @param r is the reader whose stream to check.
+ * @param offset is the offset of the document.
+ *
+ * @returns The size of the document, or -1 if the stream does not
+ * hold a properly framed document at @a offset.
+ */
+static gint32
+_bson_stream_reader_doc_size (const bson_stream_reader *r, gsize offset)
+{
+  gint32 size;
+
+  if (offset > r->size ||
+      r->size - offset < sizeof (gint32) + sizeof (guint8))
+    return -1;
+
+  size = bson_stream_doc_size (r->data + offset, 0);
+  if (size < (gint32)(sizeof (gint32) + sizeof (guint8)) ||
+      (gsize)size > r->size - offset ||
+      r->data[offset + size - 1] != 0)
+    return -1;
+
+  return size;
+}
+
+/** @internal Point the view of a reader at a document.
+ *
+ * @param r is the reader to update.
+ * @param offset is the offset of the document.
+ * @param size is the size of the document.
+ *
+ * @returns The view, now pointing at the document.
+ */
+static const bson *
+_bson_stream_reader_view (bson_stream_reader *r, gsize offset, gint32 size)
+{
+  r->current.data = (guint8 *)r->data + offset;
+  r->current.len = r->current.alloc = size;
+  r->offset = offset + size;
+
+  return &r->current;
+}
+
+/** @internal Build the offset index of a stream.
+ *
+ * @param r is the reader to build the index of.
+ *
+ * @returns TRUE on success, FALSE if the stream is malformed, with
+ * errno set to EINVAL.
+ */
+static gboolean
+_bson_stream_reader_build_index (bson_stream_reader *r)
+{
+  gsize offset = 0, alloc = 64;
+  gint32 size;
+  gsize *index;
+  gint64 count = 0;
+
+  if (r->index)
+    return TRUE;
+
+  index = g_new (gsize, alloc);
+  while (offset < r->size)
+    {
+      size = _bson_stream_reader_doc_size (r, offset);
+      if (size == -1)
+        {
+          g_free (index);
+          errno = EINVAL;
+          return FALSE;
+        }
+
+      if ((gsize)count == alloc)
+        {
+          alloc *= 2;
+          index = g_renew (gsize, index, alloc);
+        }
+      index[count++] = offset;
+      offset += size;
+    }
+
+  r->index = index;
+  r->count = count;
+
+  return TRUE;
+}
+
+/** @internal Create a new BSON stream reader.
+ *
+ * @param data is the stream to read.
+ * @param size is the size of @a data.
+ *
+ * @returns A newly allocated reader.
+ */
+static bson_stream_reader *
+_bson_stream_reader_new (const guint8 *data, gsize size)
+{
+  bson_stream_reader *r;
+
+  r = g_new0 (bson_stream_reader, 1);
+  r->data = data;
+  r->size = size;
+  r->current.view = TRUE;
+  r->current.finished = TRUE;
+
+  return r;
+}
+
+bson_stream_reader *
+bson_stream_reader_new_from_data (const guint8 *data, gsize size,
+                                  gint flags)
+{
+  bson_stream_reader *r;
+
+  if (!data && size)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  r = _bson_stream_reader_new (data, size);
+  if ((flags & BSON_STREAM_READER_INDEX) &&
+      !_bson_stream_reader_build_index (r))
+    {
+      bson_stream_reader_free (r);
+      errno = EINVAL;
+      return NULL;
+    }
+
+  return r;
+}
+
+bson_stream_reader *
+bson_stream_reader_new_from_file (const gchar *filename, gint flags)
+{
+  bson_stream_reader *r;
+  struct stat st;
+  guint8 *data = NULL;
+  gboolean mapped = FALSE;
+  gint fd, e;
+
+  if (!filename)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  fd = open (filename, O_RDONLY);
+  if (fd == -1)
+    return NULL;
+  if (fstat (fd, &st) != 0)
+    {
+      e = errno;
+      close (fd);
+      errno = e;
+      return NULL;
+    }
+
+  if (st.st_size > 0)
+    {
+#if HAVE_MMAP
+      data = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+        {
+          e = errno;
+          close (fd);
+          errno = e;
+          return NULL;
+        }
+      mapped = TRUE;
+#if HAVE_MADVISE
+      if (flags & BSON_STREAM_READER_SEQUENTIAL)
+        madvise (data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+#else
+      gsize pos = 0;
+      gssize n;
+
+      data = (guint8 *)g_malloc (st.st_size);
+      while (pos < (gsize)st.st_size)
+        {
+          n = read (fd, data + pos, st.st_size - pos);
+          if (n == -1 && errno == EINTR)
+            continue;
+          if (n <= 0)
+            {
+              e = (n == 0) ? EIO : errno;
+              g_free (data);
+              close (fd);
+              errno = e;
+              return NULL;
+            }
+          pos += n;
+        }
+#endif
+    }
+  close (fd);
+
+  r = _bson_stream_reader_new (data, (gsize)st.st_size);
+  r->mapped = mapped;
+  r->owned = (data && !mapped);
+
+  if ((flags & BSON_STREAM_READER_INDEX) &&
+      !_bson_stream_reader_build_index (r))
+    {
+      bson_stream_reader_free (r);
+      errno = EINVAL;
+      return NULL;
+    }
+
+  return r;
+}
+
+const bson *
+bson_stream_reader_next (bson_stream_reader *r)
+{
+  gint32 size;
+
+  if (!r)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  if (r->offset == r->size)
+    {
+      errno = 0;
+      return NULL;
+    }
+
+  size = _bson_stream_reader_doc_size (r, r->offset);
+  if (size == -1)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  return _bson_stream_reader_view (r, r->offset, size);
+}
+
+gint64
+bson_stream_reader_tell (const bson_stream_reader *r)
+{
+  if (!r)
+    return -1;
+
+  return (gint64)r->offset;
+}
+
+gboolean
+bson_stream_reader_seek (bson_stream_reader *r, gint64 offset)
+{
+  if (!r || offset < 0 || (guint64)offset > r->size)
+    return FALSE;
+
+  r->offset = (gsize)offset;
+
+  return TRUE;
+}
+
+gint64
+bson_stream_reader_count (bson_stream_reader *r)
+{
+  if (!r)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (!_bson_stream_reader_build_index (r))
+    return -1;
+
+  return r->count;
+}
+
+const bson *
+bson_stream_reader_nth (bson_stream_reader *r, gint64 n)
+{
+  gsize offset;
+
+  if (!r)
+    {
+      errno = EINVAL;
+      return NULL;
+    }
+
+  if (!_bson_stream_reader_build_index (r))
+    return NULL;
+
+  if (n < 0 || n >= r->count)
+    {
+      errno = ERANGE;
+      return NULL;
+    }
+
+  offset = r->index[n];
+  return _bson_stream_reader_view (r, offset,
+                                   bson_stream_doc_size (r->data + offset, 0));
+}
+
+void
+bson_stream_reader_free (bson_stream_reader *r)
+{
+  if (!r)
+    return;
+
+#if HAVE_MMAP
+  if (r->mapped)
+    munmap ((void *)r->data, r->size);
+#endif
+  if (r->owned)
+    g_free ((guint8 *)r->data);
+  g_free (r->index);
+  g_free (r);
+}
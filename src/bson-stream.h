@@ -0,0 +1,169 @@
+/* bson-stream.h - libmongo-client's BSON stream reader
+ * Copyright 2011, 2012 Gergely Nagy <algernon@balabit.hu>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file src/bson-stream.h
+ * Public header for reading streams of concatenated BSON documents.
+ */
+
+#ifndef LIBMONGO_CLIENT_BSON_STREAM_H
+#define LIBMONGO_CLIENT_BSON_STREAM_H 1
+
+#include <glib.h>
+#include <bson.h>
+
+G_BEGIN_DECLS
+
+/** @defgroup bson_stream BSON Streams
+ *
+ * Functions to read streams of concatenated BSON documents, such as
+ * the dumps written by the mongo-dump example, or the output of
+ * mongodump.
+ *
+ * Files are mapped into memory, and documents are handed out as
+ * views into the mapping, so reading a stream involves neither
+ * copying, nor allocating memory per document.
+ *
+ * @addtogroup bson_stream
+ * @{
+ */
+
+/** Opaque BSON stream reader object. */
+typedef struct _bson_stream_reader bson_stream_reader;
+
+/** BSON stream reader flags.
+ */
+typedef enum
+  {
+    BSON_STREAM_READER_DEFAULT = 0, /**< No special behaviour. */
+    BSON_STREAM_READER_SEQUENTIAL = 1 << 0, /**< Hint the operating
+                                               system that the file
+                                               will be read
+                                               sequentially, so it
+                                               can read ahead more
+                                               aggressively. Only has
+                                               an effect on mapped
+                                               files. */
+    BSON_STREAM_READER_INDEX = 1 << 1 /**< Build the offset index
+                                         used for random access right
+                                         away, verifying the framing
+                                         of the whole stream up
+                                         front. */
+  } bson_stream_reader_flags;
+
+/** Create a BSON stream reader over a file.
+ *
+ * The file is mapped into memory (or, on systems without mmap(),
+ * read into memory), and stays so until the reader is freed.
+ *
+ * @param filename is the file to read.
+ * @param flags is a combination of #bson_stream_reader_flags.
+ *
+ * @returns A newly allocated reader, or NULL on error, with errno
+ * set. If #BSON_STREAM_READER_INDEX is set and the stream is
+ * malformed, errno is set to EINVAL.
+ */
+bson_stream_reader *bson_stream_reader_new_from_file (const gchar *filename,
+                                                      gint flags);
+
+/** Create a BSON stream reader over a buffer.
+ *
+ * @param data is the buffer of concatenated BSON documents. It is not
+ * copied, and must remain valid until the reader is freed.
+ * @param size is the size of @a data.
+ * @param flags is a combination of #bson_stream_reader_flags.
+ *
+ * @returns A newly allocated reader, or NULL on error, with errno
+ * set.
+ */
+bson_stream_reader *bson_stream_reader_new_from_data (const guint8 *data,
+                                                      gsize size,
+                                                      gint flags);
+
+/** Read the next document from a BSON stream.
+ *
+ * The framing of the document (its length, and its terminating NUL
+ * byte) is checked, but its contents are not: use bson_validate()
+ * when reading untrusted input.
+ *
+ * @param r is the reader to read from.
+ *
+ * @returns A finished, read-only view of the next document, or NULL
+ * at the end of the stream (with errno set to zero) or on error
+ * (with errno set to EINVAL). The view is owned by the reader, and is
+ * only valid until the next call on the reader.
+ */
+const bson *bson_stream_reader_next (bson_stream_reader *r);
+
+/** Get the offset of the next document in a BSON stream.
+ *
+ * @param r is the reader to query.
+ *
+ * @returns The offset the next call to bson_stream_reader_next() will
+ * read from, or -1 on error.
+ */
+gint64 bson_stream_reader_tell (const bson_stream_reader *r);
+
+/** Move a BSON stream reader to a given offset.
+ *
+ * @param r is the reader to move.
+ * @param offset is the offset to read the next document from. It
+ * should be a value previously returned by bson_stream_reader_tell().
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_stream_reader_seek (bson_stream_reader *r, gint64 offset);
+
+/** Count the documents in a BSON stream.
+ *
+ * Builds the offset index of the stream, unless it was built already.
+ *
+ * @param r is the reader to count the documents of.
+ *
+ * @returns The number of documents in the stream, or -1 on error,
+ * with errno set to EINVAL if the stream is malformed.
+ */
+gint64 bson_stream_reader_count (bson_stream_reader *r);
+
+/** Get the Nth document of a BSON stream.
+ *
+ * Builds the offset index of the stream, unless it was built already,
+ * and looks the document up in it. Subsequent calls to
+ * bson_stream_reader_next() continue with the document following it.
+ *
+ * @param r is the reader to read from.
+ * @param n is the number of the document to get, starting from zero.
+ *
+ * @returns A finished, read-only view of the document, like
+ * bson_stream_reader_next() does, or NULL on error, with errno set to
+ * ERANGE if @a n is out of range, or to EINVAL if the stream is
+ * malformed.
+ */
+const bson *bson_stream_reader_nth (bson_stream_reader *r, gint64 n);
+
+/** Free a BSON stream reader.
+ *
+ * Unmaps (or frees) the file the reader was created over. Views
+ * returned by the reader must not be used afterwards.
+ *
+ * @param r is the reader to free.
+ */
+void bson_stream_reader_free (bson_stream_reader *r);
+
+/** @} */
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,233 @@
+/* bson-struct.h - libmongo-client's C struct <-> BSON codecs
+ * Copyright 2011, 2012 Gergely Nagy <algernon@balabit.hu>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/** @file src/bson-struct.h
+ * Public header for generating C struct <-> BSON codecs at compile
+ * time.
+ */
+
+#ifndef LIBMONGO_CLIENT_BSON_STRUCT_H
+#define LIBMONGO_CLIENT_BSON_STRUCT_H 1
+
+#include <glib.h>
+#include <string.h>
+#include <bson.h>
+
+G_BEGIN_DECLS
+
+/** @defgroup bson_struct Struct Codecs
+ *
+ * Macros that generate an encoder and a decoder between a C structure
+ * of a known layout and BSON documents, entirely at compile time.
+ *
+ * The layout is described by an X-macro: a macro taking the name of
+ * another macro, and invoking it once for every field, with the type
+ * and the name of the field:
+ *
+ * @code
+ * #define HOST_RECORD_FIELDS(FIELD) \
+ *   FIELD (int64, ts)               \
+ *   FIELD (string, host)            \
+ *   FIELD (int32, port)
+ *
+ * BSON_STRUCT (host_record, HOST_RECORD_FIELDS)
+ * @endcode
+ *
+ * The above declares a host_record structure with the three members,
+ * and defines the following inline functions:
+ *
+ *  - host_record_bson_size(): returns the exact size of the encoded
+ *    document.
+ *  - host_record_encode(): appends the fields to an open BSON object.
+ *  - host_record_to_bson(): creates a new, finished BSON object from
+ *    a structure, with exactly as much memory allocated as needed.
+ *  - host_record_from_bson(): decodes a BSON object into a structure.
+ *
+ * The supported field types, and the C types they map to are: int32
+ * (gint32), int64 (gint64), double (gdouble), boolean (gboolean),
+ * utc_datetime (gint64), timestamp (gint64), string (const gchar *)
+ * and oid (const guint8 *, pointing to 12 bytes).
+ *
+ * The decoder does not copy strings and ObjectIDs: the decoded
+ * pointers point into the BSON object, and are only valid as long as
+ * that is. It expects the fields to appear in declaration order, and
+ * only searches for the ones that do not.
+ *
+ * @addtogroup bson_struct
+ * @{
+ */
+
+/** @internal The C types of the supported field types. */
+#define _BSON_STRUCT_CTYPE_int32 gint32
+#define _BSON_STRUCT_CTYPE_int64 gint64
+#define _BSON_STRUCT_CTYPE_double gdouble
+#define _BSON_STRUCT_CTYPE_boolean gboolean
+#define _BSON_STRUCT_CTYPE_utc_datetime gint64
+#define _BSON_STRUCT_CTYPE_timestamp gint64
+#define _BSON_STRUCT_CTYPE_string const gchar *
+#define _BSON_STRUCT_CTYPE_oid const guint8 *
+
+/** @internal The encoded sizes of the values of the field types. */
+#define _BSON_STRUCT_VSIZE_int32(v) ((gint32)sizeof (gint32))
+#define _BSON_STRUCT_VSIZE_int64(v) ((gint32)sizeof (gint64))
+#define _BSON_STRUCT_VSIZE_double(v) ((gint32)sizeof (gdouble))
+#define _BSON_STRUCT_VSIZE_boolean(v) 1
+#define _BSON_STRUCT_VSIZE_utc_datetime(v) ((gint32)sizeof (gint64))
+#define _BSON_STRUCT_VSIZE_timestamp(v) ((gint32)sizeof (gint64))
+#define _BSON_STRUCT_VSIZE_string(v) \
+  ((gint32)sizeof (gint32) + (gint32)((v) ? strlen (v) : 0) + 1)
+#define _BSON_STRUCT_VSIZE_oid(v) 12
+
+/** @internal The append functions of the field types. */
+#define _BSON_STRUCT_APPEND_int32(b,n,v) bson_append_int32 (b, n, v)
+#define _BSON_STRUCT_APPEND_int64(b,n,v) bson_append_int64 (b, n, v)
+#define _BSON_STRUCT_APPEND_double(b,n,v) bson_append_double (b, n, v)
+#define _BSON_STRUCT_APPEND_boolean(b,n,v) bson_append_boolean (b, n, v)
+#define _BSON_STRUCT_APPEND_utc_datetime(b,n,v) \
+  bson_append_utc_datetime (b, n, v)
+#define _BSON_STRUCT_APPEND_timestamp(b,n,v) bson_append_timestamp (b, n, v)
+#define _BSON_STRUCT_APPEND_string(b,n,v) bson_append_string (b, n, v, -1)
+#define _BSON_STRUCT_APPEND_oid(b,n,v) bson_append_oid (b, n, v)
+
+/** @internal The getters of the field types. */
+#define _BSON_STRUCT_GET_int32(i,d) bson_iter_get_int32 (i, d)
+#define _BSON_STRUCT_GET_int64(i,d) bson_iter_get_int64 (i, d)
+#define _BSON_STRUCT_GET_double(i,d) bson_iter_get_double (i, d)
+#define _BSON_STRUCT_GET_boolean(i,d) bson_iter_get_boolean (i, d)
+#define _BSON_STRUCT_GET_utc_datetime(i,d) bson_iter_get_utc_datetime (i, d)
+#define _BSON_STRUCT_GET_timestamp(i,d) bson_iter_get_timestamp (i, d)
+#define _BSON_STRUCT_GET_string(i,d) bson_iter_get_string (i, d)
+#define _BSON_STRUCT_GET_oid(i,d) bson_iter_get_oid (i, d)
+
+/** @internal Expand a field into a structure member. */
+#define _BSON_STRUCT_MEMBER(type,field) _BSON_STRUCT_CTYPE_##type field;
+
+/** @internal Expand a field into the size of its element. */
+#define _BSON_STRUCT_SIZE(type,field) \
+  + 1 + (gint32)sizeof (#field) + _BSON_STRUCT_VSIZE_##type (s->field)
+
+/** @internal Expand a field into its append call. */
+#define _BSON_STRUCT_APPEND(type,field) \
+  && _BSON_STRUCT_APPEND_##type (b, #field, s->field)
+
+/** @internal Expand a field into its lookup and decoding. */
+#define _BSON_STRUCT_DECODE(type,field)                 \
+  && _bson_struct_seek (&i, #field)                     \
+  && _BSON_STRUCT_GET_##type (&i, &s->field)
+
+/** @internal Position an iterator to the next field to decode.
+ *
+ * Tries the element following the current one first, and searches
+ * for the field only if that is not the one.
+ *
+ * @param i is the iterator to position.
+ * @param name is the name of the field.
+ *
+ * @returns TRUE if the field was found, FALSE otherwise.
+ */
+static __inline__ gboolean _bson_struct_seek (bson_iter *i, const gchar *name)
+{
+  bson_iter next = *i;
+
+  if (bson_iter_next (&next) && strcmp (bson_iter_key (&next), name) == 0)
+    {
+      *i = next;
+      return TRUE;
+    }
+  return bson_iter_find (i, name);
+}
+
+/** Declare a structure with a given layout.
+ *
+ * @param name is the name of the structure type to declare.
+ * @param FIELDS is the X-macro describing the fields of the
+ * structure.
+ */
+#define BSON_STRUCT_DECLARE(name,FIELDS)        \
+  typedef struct                                \
+  {                                             \
+    FIELDS (_BSON_STRUCT_MEMBER)                \
+  } name;
+
+/** Define the codec of a structure with a given layout.
+ *
+ * The structure may be declared with BSON_STRUCT_DECLARE(), or by
+ * hand, as long as it has members of the appropriate types and
+ * names.
+ *
+ * The generated name_encode() function returns TRUE on success,
+ * FALSE otherwise (in which case some of the fields may have been
+ * appended already). The name_to_bson() function returns a new
+ * finished BSON object, or NULL on error. The name_from_bson()
+ * function returns TRUE if every field was found with the right type,
+ * FALSE otherwise (in which case some of the fields may have been
+ * decoded already).
+ *
+ * @param name is the name of the structure type.
+ * @param FIELDS is the X-macro describing the fields of the
+ * structure.
+ */
+#define BSON_STRUCT_CODEC(name,FIELDS)                                  \
+  static __inline__ gint32 name##_bson_size (const name *s)             \
+  {                                                                     \
+    return (gint32)sizeof (gint32) + 1 FIELDS (_BSON_STRUCT_SIZE);      \
+  }                                                                     \
+                                                                        \
+  static __inline__ gboolean name##_encode (bson *b, const name *s)     \
+  {                                                                     \
+    return b && s FIELDS (_BSON_STRUCT_APPEND);                         \
+  }                                                                     \
+                                                                        \
+  static __inline__ bson *name##_to_bson (const name *s)                \
+  {                                                                     \
+    bson *b;                                                            \
+                                                                        \
+    if (!s)                                                             \
+      return NULL;                                                      \
+    b = bson_new_sized (name##_bson_size (s) -                          \
+                        (gint32)sizeof (gint32) - 1);                   \
+    if (!name##_encode (b, s) || !bson_finish (b))                      \
+      {                                                                 \
+        bson_free (b);                                                  \
+        return NULL;                                                    \
+      }                                                                 \
+    return b;                                                           \
+  }                                                                     \
+                                                                        \
+  static __inline__ gboolean name##_from_bson (const bson *b, name *s)  \
+  {                                                                     \
+    bson_iter i;                                                        \
+                                                                        \
+    return s && bson_iter_init (&i, b) FIELDS (_BSON_STRUCT_DECODE);    \
+  }
+
+/** Declare a structure, and define its codec.
+ *
+ * A shorthand for BSON_STRUCT_DECLARE() and BSON_STRUCT_CODEC().
+ *
+ * @param name is the name of the structure type.
+ * @param FIELDS is the X-macro describing the fields of the
+ * structure.
+ */
+#define BSON_STRUCT(name,FIELDS)                \
+  BSON_STRUCT_DECLARE (name, FIELDS)            \
+  BSON_STRUCT_CODEC (name, FIELDS)
+
+/** @} */
+
+G_END_DECLS
+
+#endif
@@ -22,6 +22,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdarg.h>
+#include <math.h>
 
 #include "bson.h"
 #include "libmongo-macros.h"
@@ -31,16 +32,182 @@
  */
 struct _bson_cursor
 {
-  const bson *obj; /**< The BSON object this is a cursor for. */
-  const gchar *key; /**< Pointer within the BSON object to the
-                       current key. */
-  size_t pos; /**< Position within the BSON object, pointing at the
-                 element type. */
-  size_t value_pos; /**< The start of the value within the BSON
-                       object, pointing right after the end of the
-                       key. */
+  bson_iter iter; /**< The iterator doing the actual work. */
+  bson *owned; /**< An object owned by the cursor, freed together
+                  with it. Used by cursors opened on embedded
+                  documents. */
+  const bson *top; /**< The object the cursor was created for, which
+                      owns the data it points into. */
 };
 
+/** @internal Alignment of memory handed out by BSON arenas. */
+#define BSON_ARENA_ALIGN 8
+
+/** @internal Allocate a new arena chunk.
+ *
+ * @param size is the usable size of the chunk.
+ *
+ * @returns A newly allocated chunk.
+ */
+static bson_arena_chunk *
+_bson_arena_chunk_new (gsize size)
+{
+  bson_arena_chunk *chunk;
+
+  chunk = (bson_arena_chunk *)g_malloc (sizeof (bson_arena_chunk) + size);
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->data = (guint8 *)(chunk + 1);
+
+  return chunk;
+}
+
+/** @internal Allocate memory from an arena.
+ *
+ * Tries to serve the allocation from the current chunk, moving on to
+ * the next ones (allocating a new chunk, if need be) when it does not
+ * fit.
+ *
+ * @param arena is the arena to allocate from.
+ * @param size is the number of bytes to allocate.
+ *
+ * @returns A pointer to the allocated memory.
+ */
+static guint8 *
+_bson_arena_alloc (bson_arena *arena, gsize size)
+{
+  bson_arena_chunk *chunk = arena->current;
+  gsize start;
+
+  for (;;)
+    {
+      start = (chunk->used + BSON_ARENA_ALIGN - 1) &
+        ~((gsize)BSON_ARENA_ALIGN - 1);
+      if (start + size <= chunk->size)
+        break;
+
+      if (!chunk->next)
+        chunk->next = _bson_arena_chunk_new (MAX (arena->chunk_size, size));
+      chunk = chunk->next;
+    }
+
+  arena->current = chunk;
+  chunk->used = start + size;
+
+  return chunk->data + start;
+}
+
+/** @internal Grow a block of memory allocated from an arena.
+ *
+ * If @a mem was the last allocation made from the current chunk, and
+ * the chunk has enough room left, the block is extended in place.
+ * Otherwise a new block is allocated, and the used part of the old
+ * one copied over.
+ *
+ * @param arena is the arena the memory was allocated from.
+ * @param mem is the block to grow.
+ * @param used is the number of bytes used within @a mem.
+ * @param old_size is the size of @a mem.
+ * @param new_size is the requested new size.
+ *
+ * @returns A pointer to the grown block.
+ */
+static guint8 *
+_bson_arena_grow (bson_arena *arena, guint8 *mem, gsize used,
+                  gsize old_size, gsize new_size)
+{
+  bson_arena_chunk *chunk = arena->current;
+  guint8 *new_mem;
+
+  if (mem + old_size == chunk->data + chunk->used &&
+      chunk->used - old_size + new_size <= chunk->size)
+    {
+      chunk->used += new_size - old_size;
+      return mem;
+    }
+
+  new_mem = _bson_arena_alloc (arena, new_size);
+  memcpy (new_mem, mem, used);
+  return new_mem;
+}
+
+/** @internal Grow the data buffer of a BSON object.
+ *
+ * Makes sure that at least @a size more bytes can be appended to the
+ * object, without having to grow the buffer again.
+ *
+ * @param b is the BSON object to grow.
+ * @param size is the number of bytes that are about to be appended.
+ */
+static void
+_bson_grow (bson *b, guint size)
+{
+  guint alloc = MAX (b->alloc * 2, b->len + size);
+
+  if (b->arena)
+    b->data = _bson_arena_grow (b->arena, b->data, b->len, b->alloc, alloc);
+  else
+    b->data = (guint8 *)g_realloc (b->data, alloc);
+  b->alloc = alloc;
+}
+
+/** @internal Give a BSON object its own copy of shared data.
+ *
+ * Used before the data of an object shared with bson_ref() is
+ * modified. If no other object uses the data anymore, it is simply
+ * taken over.
+ *
+ * @param b is the BSON object to unshare.
+ */
+static void
+_bson_unshare (bson *b)
+{
+  guint8 *data;
+
+  if (g_atomic_int_get (b->refs) == 1)
+    {
+      g_free (b->refs);
+      b->refs = NULL;
+      return;
+    }
+
+  /* Copy first, the others may let go of the data in the meantime,
+     and the last one to do so frees it. */
+  data = (guint8 *)g_malloc (b->alloc);
+  memcpy (data, b->data, b->len);
+  if (g_atomic_int_dec_and_test (b->refs))
+    {
+      g_free (b->refs);
+      g_free (b->data);
+    }
+  b->data = data;
+  b->refs = NULL;
+}
+
+/** @internal Append raw data to a BSON stream.
+ *
+ * @param b is the BSON stream to append to.
+ * @param data is the data to append.
+ * @param size is the size of the data.
+ */
+static inline void
+_bson_append_data (bson *b, const guint8 *data, guint size)
+{
+  /* Embedded documents built in place write to their root's buffer. */
+  if (G_UNLIKELY (b->root != NULL))
+    b = b->root;
+
+  if (G_UNLIKELY (b->refs != NULL))
+    _bson_unshare (b);
+
+  if (G_UNLIKELY (b->len + size > b->alloc))
+    _bson_grow (b, size);
+
+  memcpy (b->data + b->len, data, size);
+  b->len += size;
+}
+
 /** @internal Append a byte to a BSON stream.
  *
  * @param b is the BSON stream to append to.
@@ -49,7 +216,7 @@ struct _bson_cursor
 static inline void
 _bson_append_byte (bson *b, const guint8 byte)
 {
-  b->data = g_byte_array_append (b->data, &byte, sizeof (byte));
+  _bson_append_data (b, &byte, sizeof (byte));
 }
 
 /** @internal Append a 32-bit integer to a BSON stream.
@@ -60,7 +227,7 @@ _bson_append_byte (bson *b, const guint8 byte)
 static inline void
 _bson_append_int32 (bson *b, const gint32 i)
 {
-  b->data = g_byte_array_append (b->data, (const guint8 *)&i, sizeof (gint32));
+  _bson_append_data (b, (const guint8 *)&i, sizeof (gint32));
 }
 
 /** @internal Append a 64-bit integer to a BSON stream.
@@ -71,7 +238,7 @@ _bson_append_int32 (bson *b, const gint32 i)
 static inline void
 _bson_append_int64 (bson *b, const gint64 i)
 {
-  b->data = g_byte_array_append (b->data, (const guint8 *)&i, sizeof (gint64));
+  _bson_append_data (b, (const guint8 *)&i, sizeof (gint64));
 }
 
 /** @internal Append an element header to a BSON stream.
@@ -83,21 +250,23 @@ _bson_append_int64 (bson *b, const gint64 i)
  * @param b is the BSON object to append to.
  * @param type is the element type to append.
  * @param name is the key name.
+ * @param name_len is the length of @a name, or -1 to measure it.
  *
  * @returns TRUE on success, FALSE otherwise.
  */
 static inline gboolean
-_bson_append_element_header (bson *b, bson_type type, const gchar *name)
+_bson_append_element_header (bson *b, bson_type type, const gchar *name,
+                             gint32 name_len)
 {
   if (!name || !b)
     return FALSE;
 
-  if (b->finished)
+  if (b->finished || b->child)
     return FALSE;
 
   _bson_append_byte (b, (guint8) type);
-  b->data = g_byte_array_append (b->data, (const guint8 *)name,
-                                 strlen (name) + 1);
+  _bson_append_data (b, (const guint8 *)name,
+                     ((name_len == -1) ? strlen (name) : name_len) + 1);
 
   return TRUE;
 }
@@ -111,6 +280,7 @@ _bson_append_element_header (bson *b, bson_type type, const gchar *name)
  * @param b is the BSON object to append to.
  * @param type is the string-like type to append.
  * @param name is the key name.
+ * @param name_len is the length of @a name, or -1 to measure it.
  * @param val is the value to append.
  * @param length is the length of the value.
  *
@@ -121,7 +291,7 @@ _bson_append_element_header (bson *b, bson_type type, const gchar *name)
  */
 static gboolean
 _bson_append_string_element (bson *b, bson_type type, const gchar *name,
-                             const gchar *val, gint32 length)
+                             gint32 name_len, const gchar *val, gint32 length)
 {
   size_t len;
 
@@ -130,12 +300,12 @@ _bson_append_string_element (bson *b, bson_type type, const gchar *name,
 
   len = (length != -1) ? (size_t)length + 1: strlen (val) + 1;
 
-  if (!_bson_append_element_header (b, type, name))
+  if (!_bson_append_element_header (b, type, name, name_len))
     return FALSE;
 
   _bson_append_int32 (b, GINT32_TO_LE (len));
 
-  b->data = g_byte_array_append (b->data, (const guint8 *)val, len - 1);
+  _bson_append_data (b, (const guint8 *)val, len - 1);
   _bson_append_byte (b, 0);
 
   return TRUE;
@@ -152,6 +322,7 @@ _bson_append_string_element (bson *b, bson_type type, const gchar *name,
  * @param b is the BSON object to append to.
  * @param type is the document-like type to append.
  * @param name is the key name.
+ * @param name_len is the length of @a name, or -1 to measure it.
  * @param doc is the document-like object to append.
  *
  * @note The @a doc must be a finished BSON object.
@@ -160,15 +331,15 @@ _bson_append_string_element (bson *b, bson_type type, const gchar *name,
  */
 static gboolean
 _bson_append_document_element (bson *b, bson_type type, const gchar *name,
-                               const bson *doc)
+                               gint32 name_len, const bson *doc)
 {
   if (bson_size (doc) < 0)
     return FALSE;
 
-  if (!_bson_append_element_header (b, type, name))
+  if (!_bson_append_element_header (b, type, name, name_len))
     return FALSE;
 
-  b->data = g_byte_array_append (b->data, bson_data (doc), bson_size (doc));
+  _bson_append_data (b, bson_data (doc), bson_size (doc));
   return TRUE;
 }
 
@@ -177,21 +348,315 @@ _bson_append_document_element (bson *b, bson_type type, const gchar *name,
  * @param b is the BSON object to append to.
  * @param type is the int64-like type to append.
  * @param name is the key name.
+ * @param name_len is the length of @a name, or -1 to measure it.
  * @param i is the 64-bit value to append.
  *
  * @returns TRUE on success, FALSE otherwise.
  */
 static inline gboolean
 _bson_append_int64_element (bson *b, bson_type type, const gchar *name,
-                            gint64 i)
+                            gint32 name_len, gint64 i)
 {
-  if (!_bson_append_element_header (b, type, name))
+  if (!_bson_append_element_header (b, type, name, name_len))
     return FALSE;
 
   _bson_append_int64 (b, GINT64_TO_LE (i));
   return TRUE;
 }
 
+/** @internal Append a binary element to a BSON object.
+ *
+ * @param b is the BSON object to append to.
+ * @param name is the key name.
+ * @param name_len is the length of @a name, or -1 to measure it.
+ * @param subtype is the binary subtype to use.
+ * @param data is the binary data to append.
+ * @param size is the size of @a data.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_append_binary_element (bson *b, const gchar *name, gint32 name_len,
+                             bson_binary_subtype subtype,
+                             const guint8 *data, gint32 size)
+{
+  if (!data || !size || size <= 0)
+    return FALSE;
+
+  if (!_bson_append_element_header (b, BSON_TYPE_BINARY, name, name_len))
+    return FALSE;
+
+  _bson_append_int32 (b, GINT32_TO_LE (size));
+  _bson_append_byte (b, (guint8)subtype);
+
+  _bson_append_data (b, data, size);
+  return TRUE;
+}
+
+/** @internal Append a regular expression to a BSON object.
+ *
+ * @param b is the BSON object to append to.
+ * @param name is the key name.
+ * @param name_len is the length of @a name, or -1 to measure it.
+ * @param regexp is the regular expression to append.
+ * @param options are the options of the regular expression.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_append_regex_element (bson *b, const gchar *name, gint32 name_len,
+                            const gchar *regexp, const gchar *options)
+{
+  if (!regexp || !options)
+    return FALSE;
+
+  if (!_bson_append_element_header (b, BSON_TYPE_REGEXP, name, name_len))
+    return FALSE;
+
+  _bson_append_data (b, (const guint8 *)regexp,
+                     strlen (regexp) + 1);
+  _bson_append_data (b, (const guint8 *)options,
+                     strlen (options) + 1);
+
+  return TRUE;
+}
+
+/** @internal Append javascript code with scope to a BSON object.
+ *
+ * @param b is the BSON object to append to.
+ * @param name is the key name.
+ * @param name_len is the length of @a name, or -1 to measure it.
+ * @param js is the javascript code to append.
+ * @param len is the length of @a js, or -1 to use its full length.
+ * @param scope is the scope to append.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_append_js_code_w_scope_element (bson *b, const gchar *name,
+                                      gint32 name_len, const gchar *js,
+                                      gint32 len, const bson *scope)
+{
+  gint size;
+  size_t length;
+
+  if (!js || !scope || bson_size (scope) < 0 || len < -1)
+    return FALSE;
+
+  if (!_bson_append_element_header (b, BSON_TYPE_JS_CODE_W_SCOPE,
+                                    name, name_len))
+    return FALSE;
+
+  length = (len != -1) ? (size_t)len + 1: strlen (js) + 1;
+
+  size = length + sizeof (gint32) + sizeof (gint32) + bson_size (scope);
+
+  _bson_append_int32 (b, GINT32_TO_LE (size));
+
+  /* Append the JS code */
+  _bson_append_int32 (b, GINT32_TO_LE (length));
+  _bson_append_data (b, (const guint8 *)js, length - 1);
+  _bson_append_byte (b, 0);
+
+  /* Append the scope */
+  _bson_append_data (b, bson_data (scope),
+                     bson_size (scope));
+
+  return TRUE;
+}
+
+/** @internal Free the embedded documents open within an object.
+ *
+ * @param b is the BSON object whose open children to free.
+ */
+static void
+_bson_free_children (bson *b)
+{
+  bson *c = b->child, *next;
+
+  b->child = NULL;
+  while (c)
+    {
+      next = c->child;
+      if (!c->arena)
+        g_free (c);
+      c = next;
+    }
+}
+
+/** @internal Open an embedded document-like element in place.
+ *
+ * @param b is the BSON object to append to.
+ * @param type is the document-like type to append.
+ * @param name is the key name.
+ * @param child is a pointer to a variable to store the child in.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_append_document_begin (bson *b, bson_type type, const gchar *name,
+                             bson **child)
+{
+  bson *c;
+
+  if (!child)
+    return FALSE;
+
+  if (!_bson_append_element_header (b, type, name, -1))
+    return FALSE;
+
+  if (b->arena)
+    {
+      c = (bson *)_bson_arena_alloc (b->arena, sizeof (bson));
+      memset (c, 0, sizeof (bson));
+      c->arena = b->arena;
+    }
+  else
+    c = g_new0 (bson, 1);
+  c->root = (b->root) ? b->root : b;
+  c->start = c->root->len;
+  _bson_append_int32 (c->root, 0);
+
+  b->child = c;
+  *child = c;
+  return TRUE;
+}
+
+/** @internal Close an embedded document-like element built in place.
+ *
+ * Terminates the child, and fills in its length.
+ *
+ * @param b is the BSON object the child was opened in.
+ * @param child is the child to close.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_append_document_end (bson *b, bson *child)
+{
+  bson *root;
+  gint32 size;
+
+  if (!b || !child || b->child != child || child->child)
+    return FALSE;
+
+  root = child->root;
+  _bson_append_byte (root, 0);
+
+  size = GINT32_TO_LE ((gint32) (root->len - child->start));
+  memcpy (root->data + child->start, &size, sizeof (gint32));
+
+  b->child = NULL;
+  if (!child->arena)
+    g_free (child);
+  return TRUE;
+}
+
+/** @internal Hash a key name.
+ *
+ * Computes the FNV-1a hash of a key name, and its length at the same
+ * time.
+ *
+ * @param key is the key name to hash.
+ * @param len is a pointer to a variable where the length of the key
+ * will be stored.
+ *
+ * @returns The hash of the key.
+ */
+static inline guint32
+_bson_key_hash (const gchar *key, gint32 *len)
+{
+  const guint8 *p = (const guint8 *)key;
+  guint32 h = 2166136261U;
+
+  while (*p)
+    {
+      h ^= *p++;
+      h *= 16777619U;
+    }
+  *len = (const gchar *)p - key;
+
+  return h;
+}
+
+/** @internal Allocate memory for the key index of a BSON object.
+ *
+ * @param b is the BSON object the index belongs to.
+ * @param size is the number of bytes to allocate.
+ *
+ * @returns A pointer to zero-initialised memory.
+ */
+static gpointer
+_bson_key_index_alloc (bson *b, gsize size)
+{
+  gpointer mem;
+
+  if (!b->arena)
+    return g_malloc0 (size);
+
+  mem = _bson_arena_alloc (b->arena, size);
+  memset (mem, 0, size);
+  return mem;
+}
+
+/** @internal Release memory allocated by _bson_key_index_alloc().
+ *
+ * @param b is the BSON object the index belongs to.
+ * @param mem is the memory to release.
+ */
+static inline void
+_bson_key_index_release (bson *b, gpointer mem)
+{
+  if (!b->arena)
+    g_free (mem);
+}
+
+/** @internal Drop the key index of a BSON object, if it has one.
+ *
+ * @param b is the BSON object whose index to drop.
+ */
+static void
+_bson_key_index_free (bson *b)
+{
+  if (!b->index)
+    return;
+
+  _bson_key_index_release (b, b->index->slots);
+  _bson_key_index_release (b, b->index);
+  b->index = NULL;
+}
+
+/** @internal Grow the slot table of a BSON key index.
+ *
+ * @param b is the BSON object the index belongs to.
+ * @param idx is the index to grow.
+ */
+static void
+_bson_key_index_grow (bson *b, bson_key_index *idx)
+{
+  bson_key_index_slot *slots;
+  guint32 mask, i, j;
+
+  mask = idx->mask * 2 + 1;
+  slots = (bson_key_index_slot *)
+    _bson_key_index_alloc (b, (mask + 1) * sizeof (bson_key_index_slot));
+
+  for (i = 0; i <= idx->mask; i++)
+    {
+      if (!idx->slots[i].pos)
+        continue;
+
+      j = idx->slots[i].hash & mask;
+      while (slots[j].pos)
+        j = (j + 1) & mask;
+      slots[j] = idx->slots[i];
+    }
+
+  _bson_key_index_release (b, idx->slots);
+  idx->slots = slots;
+  idx->mask = mask;
+}
+
 /********************
  * Public interface *
  ********************/
@@ -259,7 +724,8 @@ bson_new_sized (gint32 size)
 {
   bson *b = g_new0 (bson, 1);
 
-  b->data = g_byte_array_sized_new (size + sizeof (gint32) + sizeof (guint8));
+  b->alloc = MAX (size, 0) + sizeof (gint32) + sizeof (guint8);
+  b->data = (guint8 *)g_malloc (b->alloc);
   _bson_append_int32 (b, 0);
 
   return b;
@@ -274,50 +740,136 @@ bson_new_from_data (const guint8 *data, gint32 size)
     return NULL;
 
   b = g_new0 (bson, 1);
-  b->data = g_byte_array_sized_new (size + sizeof (guint8));
-  b->data = g_byte_array_append (b->data, data, size);
+  b->alloc = size + sizeof (guint8);
+  b->data = (guint8 *)g_malloc (b->alloc);
+  _bson_append_data (b, data, size);
 
   return b;
 }
 
-/** @internal Add a single element of any type to a BSON object.
- *
- * Used internally by bson_build() and bson_build_full(), this
- * function adds a single element of any supported type to the target
- * BSON object.
- *
- * @param b is the target BSON object.
- * @param type is the element type to add.
- * @param name is the key name.
- * @param free_after signals whether to free the values after adding
- * them.
- * @param ap is the list of remaining parameters.
- *
- * @returns TRUE in @a single_result on success, FALSE otherwise.
- */
-#define _bson_build_add_single(b,type,name,free_after,ap)		\
-  {									\
-    single_result = TRUE;						\
-    switch (type)							\
-      {									\
-      case BSON_TYPE_NONE:						\
-      case BSON_TYPE_UNDEFINED:						\
-      case BSON_TYPE_DBPOINTER:						\
-        single_result = FALSE;						\
-        break;								\
-      case BSON_TYPE_MIN:						\
-      case BSON_TYPE_MAX:						\
-      default:								\
-        single_result = FALSE;						\
-        break;								\
-      case BSON_TYPE_DOUBLE:						\
-        {								\
-          gdouble d = (gdouble)va_arg (ap, gdouble);			\
-          bson_append_double (b, name, d);				\
-          break;							\
-        }								\
-      case BSON_TYPE_STRING:						\
-        {								\
+bson *
+bson_new_view (const guint8 *data, gint32 size)
+{
+  bson *b;
+
+  if (!data || size < (gint32)(sizeof (gint32) + sizeof (guint8)))
+    return NULL;
+
+  if (bson_stream_doc_size (data, 0) != size || data[size - 1] != 0)
+    return NULL;
+
+  b = g_new0 (bson, 1);
+  b->data = (guint8 *)data;
+  b->len = b->alloc = size;
+  b->view = TRUE;
+  b->finished = TRUE;
+
+  return b;
+}
+
+bson_arena *
+bson_arena_new (gint32 chunk_size)
+{
+  bson_arena *arena;
+
+  if (chunk_size <= 0)
+    return NULL;
+
+  arena = g_new0 (bson_arena, 1);
+  arena->chunk_size = chunk_size;
+  arena->head = arena->current = _bson_arena_chunk_new (chunk_size);
+
+  return arena;
+}
+
+gboolean
+bson_arena_reset (bson_arena *arena)
+{
+  bson_arena_chunk *chunk;
+
+  if (!arena)
+    return FALSE;
+
+  for (chunk = arena->head; chunk; chunk = chunk->next)
+    chunk->used = 0;
+  arena->current = arena->head;
+
+  return TRUE;
+}
+
+void
+bson_arena_free (bson_arena *arena)
+{
+  bson_arena_chunk *chunk, *next;
+
+  if (!arena)
+    return;
+
+  for (chunk = arena->head; chunk; chunk = next)
+    {
+      next = chunk->next;
+      g_free (chunk);
+    }
+  g_free (arena);
+}
+
+bson *
+bson_new_in_arena (bson_arena *arena, gint32 size)
+{
+  bson *b;
+
+  if (!arena)
+    return NULL;
+
+  b = (bson *)_bson_arena_alloc (arena, sizeof (bson));
+  memset (b, 0, sizeof (bson));
+
+  b->arena = arena;
+  b->alloc = MAX (size, 0) + sizeof (gint32) + sizeof (guint8);
+  b->data = _bson_arena_alloc (arena, b->alloc);
+  _bson_append_int32 (b, 0);
+
+  return b;
+}
+
+/** @internal Add a single element of any type to a BSON object.
+ *
+ * Used internally by bson_build() and bson_build_full(), this
+ * function adds a single element of any supported type to the target
+ * BSON object.
+ *
+ * @param b is the target BSON object.
+ * @param type is the element type to add.
+ * @param name is the key name.
+ * @param free_after signals whether to free the values after adding
+ * them.
+ * @param ap is the list of remaining parameters.
+ *
+ * @returns TRUE in @a single_result on success, FALSE otherwise.
+ */
+#define _bson_build_add_single(b,type,name,free_after,ap)		\
+  {									\
+    single_result = TRUE;						\
+    switch (type)							\
+      {									\
+      case BSON_TYPE_NONE:						\
+      case BSON_TYPE_UNDEFINED:						\
+      case BSON_TYPE_DBPOINTER:						\
+        single_result = FALSE;						\
+        break;								\
+      case BSON_TYPE_MIN:						\
+      case BSON_TYPE_MAX:						\
+      default:								\
+        single_result = FALSE;						\
+        break;								\
+      case BSON_TYPE_DOUBLE:						\
+        {								\
+          gdouble d = (gdouble)va_arg (ap, gdouble);			\
+          bson_append_double (b, name, d);				\
+          break;							\
+        }								\
+      case BSON_TYPE_STRING:						\
+        {								\
           gchar *s = (gchar *)va_arg (ap, gpointer);			\
           gint32 l = (gint32)va_arg (ap, gint32);			\
           bson_append_string (b, name, s, l);				\
@@ -444,17 +996,142 @@ bson_new_from_data (const guint8 *data, gint32 size)
       }									\
   }
 
+/** @internal Compute the size of the elements of a bson_build()
+ * argument list.
+ *
+ * The arguments are only looked at, nothing is appended or freed, so
+ * that the object can be allocated with the exact size before the
+ * elements are added in a second pass. Arguments that would make the
+ * append functions fail are counted as empty, and the computation
+ * stops at the first unsupported type.
+ *
+ * @param type is the type of the first element.
+ * @param name is the key name of the first element.
+ * @param full signals whether the list is for bson_build_full(), and
+ * has the free_after flags in it.
+ * @param ap is the list of remaining parameters, starting with the
+ * value of the first element.
+ *
+ * @returns The total size of the elements.
+ */
+static gint32
+_bson_build_size (bson_type type, const gchar *name, gboolean full,
+                  va_list ap)
+{
+  gint32 size = 0;
+
+  while (type != BSON_TYPE_NONE)
+    {
+      size += sizeof (guint8) + ((name) ? strlen (name) : 0) + 1;
+
+      switch (type)
+        {
+        case BSON_TYPE_DOUBLE:
+          (void)va_arg (ap, gdouble);
+          size += sizeof (gdouble);
+          break;
+        case BSON_TYPE_STRING:
+        case BSON_TYPE_JS_CODE:
+        case BSON_TYPE_SYMBOL:
+          {
+            gchar *s = (gchar *)va_arg (ap, gpointer);
+            gint32 l = (gint32)va_arg (ap, gint32);
+
+            if (s && l != 0)
+              size += sizeof (gint32) + ((l > 0) ? l : strlen (s)) + 1;
+            break;
+          }
+        case BSON_TYPE_DOCUMENT:
+        case BSON_TYPE_ARRAY:
+          {
+            bson *d = (bson *)va_arg (ap, gpointer);
+
+            /* Unfinished documents are finished by bson_build_full()
+               before appending, which adds the closing byte. */
+            if (d)
+              size += d->len + ((d->finished) ? 0 : 1);
+            break;
+          }
+        case BSON_TYPE_BINARY:
+          {
+            gint32 l;
+
+            (void)va_arg (ap, guint);
+            (void)va_arg (ap, gpointer);
+            l = (gint32)va_arg (ap, gint32);
+            if (l > 0)
+              size += sizeof (gint32) + sizeof (guint8) + l;
+            break;
+          }
+        case BSON_TYPE_OID:
+          (void)va_arg (ap, gpointer);
+          size += 12;
+          break;
+        case BSON_TYPE_BOOLEAN:
+          (void)va_arg (ap, guint);
+          size += sizeof (guint8);
+          break;
+        case BSON_TYPE_UTC_DATETIME:
+        case BSON_TYPE_TIMESTAMP:
+        case BSON_TYPE_INT64:
+          (void)va_arg (ap, gint64);
+          size += sizeof (gint64);
+          break;
+        case BSON_TYPE_NULL:
+          break;
+        case BSON_TYPE_REGEXP:
+          {
+            gchar *r = (gchar *)va_arg (ap, gpointer);
+            gchar *o = (gchar *)va_arg (ap, gpointer);
+
+            if (r && o)
+              size += strlen (r) + 1 + strlen (o) + 1;
+            break;
+          }
+        case BSON_TYPE_JS_CODE_W_SCOPE:
+          {
+            gchar *s = (gchar *)va_arg (ap, gpointer);
+            gint32 l = (gint32)va_arg (ap, gint32);
+            bson *scope = (bson *)va_arg (ap, gpointer);
+
+            if (s && scope && l != 0)
+              size += sizeof (gint32) * 2 + ((l > 0) ? l : strlen (s)) + 1 +
+                scope->len + ((scope->finished) ? 0 : 1);
+            break;
+          }
+        case BSON_TYPE_INT32:
+          (void)va_arg (ap, gint32);
+          size += sizeof (gint32);
+          break;
+        default:
+          return size;
+        }
+
+      type = (bson_type)va_arg (ap, gint);
+      if (type == BSON_TYPE_NONE)
+        break;
+      name = (const gchar *)va_arg (ap, gpointer);
+      if (full)
+        (void)va_arg (ap, gint);
+    }
+
+  return size;
+}
+
 bson *
 bson_build (bson_type type, const gchar *name, ...)
 {
   va_list ap;
   bson_type t;
   const gchar *n;
+  va_list aq;
   bson *b;
   gboolean single_result;
 
-  b = bson_new ();
   va_start (ap, name);
+  G_VA_COPY (aq, ap);
+  b = bson_new_sized (_bson_build_size (type, name, FALSE, aq));
+  va_end (aq);
   _bson_build_add_single (b, type, name, FALSE, ap);
 
   if (!single_result)
@@ -487,11 +1164,14 @@ bson_build_full (bson_type type, const gchar *name, gboolean free_after, ...)
   bson_type t;
   const gchar *n;
   gboolean f;
+  va_list aq;
   bson *b;
   gboolean single_result;
 
-  b = bson_new ();
   va_start (ap, free_after);
+  G_VA_COPY (aq, ap);
+  b = bson_new_sized (_bson_build_size (type, name, TRUE, aq));
+  va_end (aq);
   _bson_build_add_single (b, type, name, free_after, ap);
   if (!single_result)
     {
@@ -520,7 +1200,7 @@ bson_build_full (bson_type type, const gchar *name, gboolean free_after, ...)
 gboolean
 bson_finish (bson *b)
 {
-  gint32 *i;
+  gint32 i;
 
   if (!b)
     return FALSE;
@@ -528,10 +1208,13 @@ bson_finish (bson *b)
   if (b->finished)
     return TRUE;
 
+  if (b->root || b->child)
+    return FALSE;
+
   _bson_append_byte (b, 0);
 
-  i = (gint32 *) (&b->data->data[0]);
-  *i = GINT32_TO_LE ((gint32) (b->data->len));
+  i = GINT32_TO_LE ((gint32) (b->len));
+  memcpy (b->data, &i, sizeof (gint32));
 
   b->finished = TRUE;
 
@@ -545,7 +1228,7 @@ bson_size (const bson *b)
     return -1;
 
   if (b->finished)
-    return b->data->len;
+    return b->len;
   else
     return -1;
 }
@@ -557,19 +1240,44 @@ bson_data (const bson *b)
     return NULL;
 
   if (b->finished)
-    return b->data->data;
+    return b->data;
   else
     return NULL;
 }
 
+/** @internal The maximum number of objects in a thread's pool. */
+#define BSON_POOL_MAX_OBJECTS 64
+/** @internal The largest buffer a pooled object may keep. */
+#define BSON_POOL_MAX_ALLOC (64 * 1024)
+
+#if HAVE_TLS
+/** @internal The released objects of the calling thread. */
+static __thread bson *_bson_pool[BSON_POOL_MAX_OBJECTS];
+/** @internal The number of objects in #_bson_pool. */
+static __thread gint _bson_pool_len;
+#endif
+
+bson *
+bson_new_pooled (void)
+{
+#if HAVE_TLS
+  if (_bson_pool_len > 0)
+    return _bson_pool[--_bson_pool_len];
+#endif
+
+  return bson_new ();
+}
+
 gboolean
 bson_reset (bson *b)
 {
-  if (!b)
+  if (!b || b->view || b->root)
     return FALSE;
 
+  _bson_free_children (b);
+  _bson_key_index_free (b);
   b->finished = FALSE;
-  g_byte_array_set_size (b->data, 0);
+  b->len = 0;
   _bson_append_int32 (b, 0);
 
   return TRUE;
@@ -578,675 +1286,3591 @@ bson_reset (bson *b)
 void
 bson_free (bson *b)
 {
-  if (!b)
+  if (!b || b->root)
     return;
 
-  if (b->data)
-    g_byte_array_free (b->data, TRUE);
+  _bson_free_children (b);
+  if (b->arena)
+    return;
+
+  _bson_key_index_free (b);
+  if (b->refs && !g_atomic_int_dec_and_test (b->refs))
+    {
+      /* Others still use the data. */
+      g_free (b);
+      return;
+    }
+  g_free (b->refs);
+  if (!b->view)
+    g_free (b->data);
   g_free (b);
 }
 
-gboolean
-bson_validate_key (const gchar *key, gboolean forbid_dots,
-                   gboolean no_dollar)
+bson *
+bson_ref (bson *b)
 {
-  if (!key)
+  bson *r;
+
+  if (!b || b->arena || b->root || b->child)
+    return NULL;
+
+  if (!b->view)
     {
-      errno = EINVAL;
-      return FALSE;
+      if (!b->refs)
+        {
+          b->refs = g_new (gint, 1);
+          *b->refs = 1;
+        }
+      g_atomic_int_inc (b->refs);
     }
-  errno = 0;
-
-  if (no_dollar && key[0] == '$')
-    return FALSE;
 
-  if (forbid_dots && strchr (key, '.') != NULL)
-    return FALSE;
+  r = g_new0 (bson, 1);
+  r->data = b->data;
+  r->len = b->len;
+  r->alloc = b->alloc;
+  r->view = b->view;
+  r->indexed = b->indexed;
+  r->finished = b->finished;
+  r->refs = b->refs;
 
-  return TRUE;
+  return r;
 }
 
-/*
- * Append elements
- */
-
-gboolean
-bson_append_double (bson *b, const gchar *name, gdouble val)
+void
+bson_unref (bson *b)
 {
-  gdouble d = GDOUBLE_TO_LE (val);
-
-  if (!_bson_append_element_header (b, BSON_TYPE_DOUBLE, name))
-    return FALSE;
-
-  b->data = g_byte_array_append (b->data, (const guint8 *)&d, sizeof (val));
-  return TRUE;
+  bson_free (b);
 }
 
-gboolean
-bson_append_string (bson *b, const gchar *name, const gchar *val,
-                    gint32 length)
+void
+bson_release (bson *b)
 {
-  return _bson_append_string_element (b, BSON_TYPE_STRING, name, val, length);
-}
+#if HAVE_TLS
+  if (b && !b->view && !b->arena && !b->root && !b->refs &&
+      b->alloc <= BSON_POOL_MAX_ALLOC &&
+      _bson_pool_len < BSON_POOL_MAX_OBJECTS)
+    {
+      bson_reset (b);
+      b->indexed = FALSE;
+      _bson_pool[_bson_pool_len++] = b;
+      return;
+    }
+#endif
 
-gboolean
-bson_append_document (bson *b, const gchar *name, const bson *doc)
-{
-  return _bson_append_document_element (b, BSON_TYPE_DOCUMENT, name, doc);
+  bson_free (b);
 }
 
-gboolean
-bson_append_array (bson *b, const gchar *name, const bson *array)
+void
+bson_pool_flush (void)
 {
-  return _bson_append_document_element (b, BSON_TYPE_ARRAY, name, array);
+#if HAVE_TLS
+  while (_bson_pool_len > 0)
+    bson_free (_bson_pool[--_bson_pool_len]);
+#endif
 }
 
 gboolean
-bson_append_binary (bson *b, const gchar *name, bson_binary_subtype subtype,
-                    const guint8 *data, gint32 size)
+bson_set_key_index (bson *b, gboolean enable)
 {
-  if (!data || !size || size <= 0)
-    return FALSE;
-
-  if (!_bson_append_element_header (b, BSON_TYPE_BINARY, name))
+  if (!b)
     return FALSE;
 
-  _bson_append_int32 (b, GINT32_TO_LE (size));
-  _bson_append_byte (b, (guint8)subtype);
+  b->indexed = enable;
+  if (!enable)
+    _bson_key_index_free (b);
 
-  b->data = g_byte_array_append (b->data, data, size);
   return TRUE;
 }
 
 gboolean
-bson_append_oid (bson *b, const gchar *name, const guint8 *oid)
+bson_validate_key (const gchar *key, gboolean forbid_dots,
+                   gboolean no_dollar)
 {
-  if (!oid)
+  if (!key)
+    {
+      errno = EINVAL;
+      return FALSE;
+    }
+  errno = 0;
+
+  if (no_dollar && key[0] == '$')
     return FALSE;
 
-  if (!_bson_append_element_header (b, BSON_TYPE_OID, name))
+  if (forbid_dots && strchr (key, '.') != NULL)
     return FALSE;
 
-  b->data = g_byte_array_append (b->data, oid, 12);
   return TRUE;
 }
 
-gboolean
-bson_append_boolean (bson *b, const gchar *name, gboolean value)
+/** @internal Check whether a string is valid UTF-8.
+ *
+ * Runs of ASCII characters are skipped a machine word at a time,
+ * only multi-byte sequences are decoded one by one.
+ *
+ * @param s is the string to check.
+ * @param len is the length of the string.
+ *
+ * @returns TRUE if the string is valid UTF-8, FALSE otherwise.
+ */
+static gboolean
+_bson_validate_utf8 (const guint8 *s, gsize len)
 {
-  if (!_bson_append_element_header (b, BSON_TYPE_BOOLEAN, name))
-    return FALSE;
+  const guint8 *end = s + len;
+  guint64 w;
+  guint32 c;
+  gint n, i;
 
-  _bson_append_byte (b, (guint8)value);
+  while (s < end)
+    {
+      if ((gsize)(end - s) >= sizeof (w))
+        {
+          memcpy (&w, s, sizeof (w));
+          if ((w & G_GUINT64_CONSTANT (0x8080808080808080)) == 0)
+            {
+              s += sizeof (w);
+              continue;
+            }
+        }
+
+      c = *s;
+      if (c < 0x80)
+        {
+          s++;
+          continue;
+        }
+      else if ((c & 0xe0) == 0xc0)
+        {
+          n = 1;
+          c &= 0x1f;
+        }
+      else if ((c & 0xf0) == 0xe0)
+        {
+          n = 2;
+          c &= 0x0f;
+        }
+      else if ((c & 0xf8) == 0xf0)
+        {
+          n = 3;
+          c &= 0x07;
+        }
+      else
+        return FALSE;
+
+      if (end - s <= n)
+        return FALSE;
+      for (i = 1; i <= n; i++)
+        {
+          if ((s[i] & 0xc0) != 0x80)
+            return FALSE;
+          c = (c << 6) | (s[i] & 0x3f);
+        }
+
+      /* Reject overlong encodings, surrogates and out of range
+         code points. */
+      if ((n == 1 && c < 0x80) || (n == 2 && c < 0x800) ||
+          (n == 3 && (c < 0x10000 || c > 0x10ffff)) ||
+          (c >= 0xd800 && c <= 0xdfff))
+        return FALSE;
+
+      s += n + 1;
+    }
   return TRUE;
 }
 
-gboolean
-bson_append_utc_datetime (bson *b, const gchar *name, gint64 ts)
+/** @internal Validate a NULL terminated string.
+ *
+ * @param d is the start of the string.
+ * @param avail is the number of bytes available at @a d.
+ * @param flags are the validation flags.
+ *
+ * @returns The size of the string, including the terminating NUL
+ * byte, or -1 if it is invalid.
+ */
+static gint32
+_bson_validate_cstring (const guint8 *d, gint32 avail, gint flags)
 {
-  return _bson_append_int64_element (b, BSON_TYPE_UTC_DATETIME, name, ts);
-}
+  const guint8 *e;
 
-gboolean
-bson_append_null (bson *b, const gchar *name)
-{
-  return _bson_append_element_header (b, BSON_TYPE_NULL, name);
+  if (avail <= 0)
+    return -1;
+
+  e = memchr (d, 0, avail);
+  if (!e)
+    return -1;
+  if ((flags & BSON_VALIDATE_UTF8) && !_bson_validate_utf8 (d, e - d))
+    return -1;
+
+  return e - d + 1;
 }
 
-gboolean
-bson_append_regex (bson *b, const gchar *name, const gchar *regexp,
-                   const gchar *options)
+/** @internal Validate a length-prefixed string.
+ *
+ * @param d is the start of the string's length.
+ * @param avail is the number of bytes available at @a d.
+ * @param flags are the validation flags.
+ *
+ * @returns The size of the whole block, or -1 if it is invalid.
+ */
+static gint32
+_bson_validate_string (const guint8 *d, gint32 avail, gint flags)
 {
-  if (!regexp || !options)
-    return FALSE;
+  gint32 l;
 
-  if (!_bson_append_element_header (b, BSON_TYPE_REGEXP, name))
-    return FALSE;
+  if (avail < (gint32)sizeof (gint32) + 1)
+    return -1;
 
-  b->data = g_byte_array_append (b->data, (const guint8 *)regexp,
-                                 strlen (regexp) + 1);
-  b->data = g_byte_array_append (b->data, (const guint8 *)options,
-                                 strlen (options) + 1);
+  l = bson_stream_doc_size (d, 0);
+  if (l < 1 || l > avail - (gint32)sizeof (gint32) ||
+      d[sizeof (gint32) + l - 1] != 0)
+    return -1;
+  if ((flags & BSON_VALIDATE_UTF8) &&
+      !_bson_validate_utf8 (d + sizeof (gint32), l - 1))
+    return -1;
 
-  return TRUE;
+  return l + sizeof (gint32);
 }
 
-gboolean
-bson_append_javascript (bson *b, const gchar *name, const gchar *js,
-                        gint32 len)
+/** @internal Check whether an array key is the expected index.
+ *
+ * @param key is the key to check.
+ * @param len is the length of the key.
+ * @param index is the expected index.
+ *
+ * @returns TRUE if the key is the decimal form of @a index, FALSE
+ * otherwise.
+ */
+static gboolean
+_bson_validate_array_key (const guint8 *key, gint32 len, gint32 index)
 {
-  return _bson_append_string_element (b, BSON_TYPE_JS_CODE, name, js, len);
-}
+  gint64 v = 0;
+  gint32 i;
 
-gboolean
-bson_append_symbol (bson *b, const gchar *name, const gchar *symbol,
-                    gint32 len)
-{
-  return _bson_append_string_element (b, BSON_TYPE_SYMBOL, name, symbol, len);
-}
-
-gboolean
-bson_append_javascript_w_scope (bson *b, const gchar *name,
-                                const gchar *js, gint32 len,
-                                const bson *scope)
-{
-  gint size;
-  size_t length;
-
-  if (!js || !scope || bson_size (scope) < 0 || len < -1)
-    return FALSE;
-
-  if (!_bson_append_element_header (b, BSON_TYPE_JS_CODE_W_SCOPE, name))
-    return FALSE;
-
-  length = (len != -1) ? (size_t)len + 1: strlen (js) + 1;
-
-  size = length + sizeof (gint32) + sizeof (gint32) + bson_size (scope);
-
-  _bson_append_int32 (b, GINT32_TO_LE (size));
-
-  /* Append the JS code */
-  _bson_append_int32 (b, GINT32_TO_LE (length));
-  b->data = g_byte_array_append (b->data, (const guint8 *)js, length - 1);
-  _bson_append_byte (b, 0);
-
-  /* Append the scope */
-  b->data = g_byte_array_append (b->data, bson_data (scope),
-                                 bson_size (scope));
-
-  return TRUE;
-}
-
-gboolean
-bson_append_int32 (bson *b, const gchar *name, gint32 i)
-{
-  if (!_bson_append_element_header (b, BSON_TYPE_INT32, name))
+  if (len < 1 || len > 10 || (key[0] == '0' && len > 1))
     return FALSE;
 
-  _bson_append_int32 (b, GINT32_TO_LE (i));
-  return TRUE;
- }
-
-gboolean
-bson_append_timestamp (bson *b, const gchar *name, gint64 ts)
-{
-  return _bson_append_int64_element (b, BSON_TYPE_TIMESTAMP, name, ts);
-}
-
-gboolean
-bson_append_int64 (bson *b, const gchar *name, gint64 i)
-{
-  return _bson_append_int64_element (b, BSON_TYPE_INT64, name, i);
-}
-
-/*
- * Find & retrieve data
- */
-bson_cursor *
-bson_cursor_new (const bson *b)
-{
-  bson_cursor *c;
-
-  if (bson_size (b) == -1)
-    return NULL;
-
-  c = (bson_cursor *)g_new0 (bson_cursor, 1);
-  c->obj = b;
-
-  return c;
+  for (i = 0; i < len; i++)
+    {
+      if (key[i] < '0' || key[i] > '9')
+        return FALSE;
+      v = v * 10 + (key[i] - '0');
+    }
+  return v == index;
 }
 
-void
-bson_cursor_free (bson_cursor *c)
-{
-  g_free (c);
-}
+static gboolean _bson_validate_document (const guint8 *d, gint32 size,
+                                         gint flags, gint depth,
+                                         gboolean array);
 
-/** @internal Figure out the block size of a given type.
- *
- * Provided a #bson_type and some raw data, figures out the length of
- * the block, counted from rigth after the element name's position.
+/** @internal Validate the value of a single element.
  *
- * @param type is the type of object we need the size for.
- * @param data is the raw data (starting right after the element's
- * name).
+ * @param type is the type of the element.
+ * @param d is the start of the value.
+ * @param avail is the number of bytes available at @a d.
+ * @param flags are the validation flags.
+ * @param depth is the remaining nesting depth allowed.
  *
- * @returns The size of the block, or -1 on error.
+ * @returns The size of the value, or -1 if it is invalid.
  */
 static gint32
-_bson_get_block_size (bson_type type, const guint8 *data)
+_bson_validate_value (bson_type type, const guint8 *d, gint32 avail,
+                      gint flags, gint depth)
 {
-  glong l;
+  gint32 l, sl;
 
   switch (type)
     {
-    case BSON_TYPE_STRING:
-    case BSON_TYPE_JS_CODE:
-    case BSON_TYPE_SYMBOL:
-      return bson_stream_doc_size (data, 0) + sizeof (gint32);
-    case BSON_TYPE_DOCUMENT:
-    case BSON_TYPE_ARRAY:
-    case BSON_TYPE_JS_CODE_W_SCOPE:
-      return bson_stream_doc_size (data, 0);
     case BSON_TYPE_DOUBLE:
-      return sizeof (gdouble);
-    case BSON_TYPE_BINARY:
-      return bson_stream_doc_size (data, 0) +
-        sizeof (gint32) + sizeof (guint8);
-    case BSON_TYPE_OID:
-      return 12;
-    case BSON_TYPE_BOOLEAN:
-      return 1;
     case BSON_TYPE_UTC_DATETIME:
     case BSON_TYPE_TIMESTAMP:
     case BSON_TYPE_INT64:
-      return sizeof (gint64);
+      l = sizeof (gint64);
+      break;
+    case BSON_TYPE_INT32:
+      l = sizeof (gint32);
+      break;
+    case BSON_TYPE_OID:
+      l = 12;
+      break;
+    case BSON_TYPE_BOOLEAN:
+      if (avail < 1 || ((flags & BSON_VALIDATE_STRICT) && d[0] > 1))
+        return -1;
+      return 1;
     case BSON_TYPE_NULL:
-    case BSON_TYPE_UNDEFINED:
     case BSON_TYPE_MIN:
     case BSON_TYPE_MAX:
       return 0;
+    case BSON_TYPE_UNDEFINED:
+      return (flags & BSON_VALIDATE_NO_DEPRECATED) ? -1 : 0;
+    case BSON_TYPE_SYMBOL:
+      if (flags & BSON_VALIDATE_NO_DEPRECATED)
+        return -1;
+      /* Fall through */
+    case BSON_TYPE_STRING:
+    case BSON_TYPE_JS_CODE:
+      return _bson_validate_string (d, avail, flags);
+    case BSON_TYPE_DOCUMENT:
+    case BSON_TYPE_ARRAY:
+      if (depth <= 0 || avail < 5)
+        return -1;
+      l = bson_stream_doc_size (d, 0);
+      if (l < 5 || l > avail ||
+          !_bson_validate_document (d, l, flags, depth - 1,
+                                    type == BSON_TYPE_ARRAY))
+        return -1;
+      return l;
+    case BSON_TYPE_BINARY:
+      if (avail < (gint32)sizeof (gint32) + 1)
+        return -1;
+      l = bson_stream_doc_size (d, 0);
+      if (l < 0 || l > avail - (gint32)sizeof (gint32) - 1)
+        return -1;
+      return l + sizeof (gint32) + 1;
     case BSON_TYPE_REGEXP:
-      l = strlen((gchar *)data);
-      return l + strlen((gchar *)(data + l + 1)) + 2;
-    case BSON_TYPE_INT32:
-      return sizeof (gint32);
+      l = _bson_validate_cstring (d, avail, flags);
+      if (l < 0)
+        return -1;
+      sl = _bson_validate_cstring (d + l, avail - l, flags);
+      if (sl < 0)
+        return -1;
+      return l + sl;
     case BSON_TYPE_DBPOINTER:
-      return bson_stream_doc_size (data, 0) + sizeof (gint32) + 12;
+      if (flags & BSON_VALIDATE_NO_DEPRECATED)
+        return -1;
+      l = _bson_validate_string (d, avail, flags);
+      if (l < 0 || avail - l < 12)
+        return -1;
+      return l + 12;
+    case BSON_TYPE_JS_CODE_W_SCOPE:
+      if (depth <= 0 || avail < (gint32)sizeof (gint32) * 2 + 1 + 5)
+        return -1;
+      l = bson_stream_doc_size (d, 0);
+      if (l < (gint32)sizeof (gint32) * 2 + 1 + 5 || l > avail)
+        return -1;
+      sl = _bson_validate_string (d + sizeof (gint32),
+                                  l - sizeof (gint32), flags);
+      if (sl < 0 ||
+          !_bson_validate_document (d + sizeof (gint32) + sl,
+                                    l - sizeof (gint32) - sl,
+                                    flags, depth - 1, FALSE))
+        return -1;
+      return l;
     case BSON_TYPE_NONE:
     default:
       return -1;
     }
+
+  if (avail < l)
+    return -1;
+  return l;
 }
 
-gboolean
-bson_cursor_next (bson_cursor *c)
+/** @internal Validate a BSON document.
+ *
+ * @param d is the start of the document.
+ * @param size is the size the document must have.
+ * @param flags are the validation flags.
+ * @param depth is the remaining nesting depth allowed.
+ * @param array is whether the document is an array.
+ *
+ * @returns TRUE if the document is valid, FALSE otherwise.
+ */
+static gboolean
+_bson_validate_document (const guint8 *d, gint32 size, gint flags,
+                         gint depth, gboolean array)
 {
-  const guint8 *d;
-  gint32 pos, bs;
+  gint32 pos = sizeof (gint32), end = size - 1, index = 0;
+  gint32 kl, vl;
 
-  if (!c)
+  if (size < 5 || bson_stream_doc_size (d, 0) != size || d[end] != 0)
     return FALSE;
 
-  d = bson_data (c->obj);
-
-  if (c->pos == 0)
-    pos = sizeof (guint32);
-  else
+  while (pos < end)
     {
-      bs = _bson_get_block_size (bson_cursor_type (c), d + c->value_pos);
-      if (bs == -1)
+      kl = _bson_validate_cstring (d + pos + 1, end - pos - 1, flags);
+      if (kl < 0)
+        return FALSE;
+      if (array && (flags & BSON_VALIDATE_STRICT) &&
+          !_bson_validate_array_key (d + pos + 1, kl - 1, index++))
         return FALSE;
-      pos = c->value_pos + bs;
-    }
-
-  if (pos >= bson_size (c->obj) - 1)
-    return FALSE;
 
-  c->pos = pos;
-  c->key = (gchar *) &d[c->pos + 1];
-  c->value_pos = c->pos + strlen (c->key) + 2;
+      vl = _bson_validate_value ((bson_type)d[pos], d + pos + 1 + kl,
+                                 end - pos - 1 - kl, flags, depth);
+      if (vl < 0)
+        return FALSE;
+      pos += 1 + kl + vl;
+    }
 
   return TRUE;
 }
 
-static inline gboolean
-_bson_cursor_find (const bson *b, const gchar *name, size_t start_pos,
-                   guint32 end_pos, gboolean wrap_over, bson_cursor *dest_c)
+gboolean
+bson_validate_data (const guint8 *data, gint32 size, gint flags,
+                    gint max_depth)
 {
-  size_t pos = start_pos;
-  gint32 bs;
-  const guint8 *d;
-  gint32 name_len;
-
-  name_len = strlen (name);
-
-  d = bson_data (b);
-
-  while (pos < end_pos)
+  if (!data || max_depth < 0)
     {
-      bson_type t = (bson_type) d[pos];
-      const gchar *key = (gchar *) &d[pos + 1];
-      gint32 key_len = strlen (key);
-      gint32 value_pos = pos + key_len + 2;
-
-      if (key_len == name_len && memcmp (key, name, key_len) == 0)
-        {
-          dest_c->obj = b;
-          dest_c->key = key;
-          dest_c->pos = pos;
-          dest_c->value_pos = value_pos;
-
-          return TRUE;
-        }
-      bs = _bson_get_block_size (t, &d[value_pos]);
-      if (bs == -1)
-        return FALSE;
-      pos = value_pos + bs;
+      errno = EINVAL;
+      return FALSE;
     }
+  errno = 0;
 
-  if (wrap_over)
-    return _bson_cursor_find (b, name, sizeof (gint32), start_pos,
-                              FALSE, dest_c);
-
-  return FALSE;
+  return _bson_validate_document (data, size, flags, max_depth, FALSE);
 }
 
 gboolean
-bson_cursor_find (bson_cursor *c, const gchar *name)
+bson_validate (const bson *b, gint flags, gint max_depth)
 {
-  if (!c || !name)
-    return FALSE;
+  if (!b || !b->finished)
+    {
+      errno = EINVAL;
+      return FALSE;
+    }
 
-  return _bson_cursor_find (c->obj, name, c->pos, bson_size (c->obj) - 1,
-                            TRUE, c);
+  return bson_validate_data (b->data, b->len, flags, max_depth);
 }
 
+/*
+ * Append elements
+ */
+
 gboolean
-bson_cursor_find_next (bson_cursor *c, const gchar *name)
+bson_append_double (bson *b, const gchar *name, gdouble val)
 {
-  if (!c || !name)
+  gdouble d = GDOUBLE_TO_LE (val);
+
+  if (!_bson_append_element_header (b, BSON_TYPE_DOUBLE, name, -1))
     return FALSE;
 
-  return _bson_cursor_find (c->obj, name, c->pos, bson_size (c->obj) - 1,
-                            FALSE, c);
+  _bson_append_data (b, (const guint8 *)&d, sizeof (val));
+  return TRUE;
 }
 
-bson_cursor *
-bson_find (const bson *b, const gchar *name)
+gboolean
+bson_append_string (bson *b, const gchar *name, const gchar *val,
+                    gint32 length)
 {
-  bson_cursor *c;
-
-  if (bson_size (b) == -1 || !name)
-    return NULL;
-
-  c = bson_cursor_new (b);
-  if (_bson_cursor_find (b, name, sizeof (gint32), bson_size (c->obj) - 1,
-                         FALSE, c))
-    return c;
-  bson_cursor_free (c);
-  return NULL;
+  return _bson_append_string_element (b, BSON_TYPE_STRING, name, -1,
+                                      val, length);
 }
 
-bson_type
-bson_cursor_type (const bson_cursor *c)
+gboolean
+bson_append_document (bson *b, const gchar *name, const bson *doc)
 {
-  if (!c || c->pos < sizeof (gint32))
-    return BSON_TYPE_NONE;
+  return _bson_append_document_element (b, BSON_TYPE_DOCUMENT, name, -1,
+                                        doc);
+}
 
-  return (bson_type)(bson_data (c->obj)[c->pos]);
+gboolean
+bson_append_array (bson *b, const gchar *name, const bson *array)
+{
+  return _bson_append_document_element (b, BSON_TYPE_ARRAY, name, -1,
+                                        array);
 }
 
-const gchar *
-bson_cursor_type_as_string (const bson_cursor *c)
+gboolean
+bson_append_document_begin (bson *b, const gchar *name, bson **child)
 {
-  if (!c || c->pos < sizeof (gint32))
-    return NULL;
+  return _bson_append_document_begin (b, BSON_TYPE_DOCUMENT, name, child);
+}
 
-  return bson_type_as_string (bson_cursor_type (c));
+gboolean
+bson_append_document_end (bson *b, bson *child)
+{
+  return _bson_append_document_end (b, child);
 }
 
-const gchar *
-bson_cursor_key (const bson_cursor *c)
+gboolean
+bson_append_array_begin (bson *b, const gchar *name, bson **child)
 {
-  if (!c)
-    return NULL;
+  return _bson_append_document_begin (b, BSON_TYPE_ARRAY, name, child);
+}
 
-  return c->key;
+gboolean
+bson_append_array_end (bson *b, bson *child)
+{
+  return _bson_append_document_end (b, child);
 }
 
-/** @internal Convenience macro to verify a cursor's type.
- *
- * Verifies that the cursor's type is the same as the type requested
- * by the caller, and returns FALSE if there is a mismatch.
- */
-#define BSON_CURSOR_CHECK_TYPE(c,type)		\
-  if (bson_cursor_type(c) != type)		\
-    return FALSE;
+gboolean
+bson_append_binary (bson *b, const gchar *name, bson_binary_subtype subtype,
+                    const guint8 *data, gint32 size)
+{
+  return _bson_append_binary_element (b, name, -1, subtype, data, size);
+}
 
 gboolean
-bson_cursor_get_string (const bson_cursor *c, const gchar **dest)
+bson_append_oid (bson *b, const gchar *name, const guint8 *oid)
 {
-  if (!dest)
+  if (!oid)
     return FALSE;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_STRING);
-
-  *dest = (gchar *)(bson_data (c->obj) + c->value_pos + sizeof (gint32));
+  if (!_bson_append_element_header (b, BSON_TYPE_OID, name, -1))
+    return FALSE;
 
+  _bson_append_data (b, oid, 12);
   return TRUE;
 }
 
 gboolean
-bson_cursor_get_double (const bson_cursor *c, gdouble *dest)
+bson_append_boolean (bson *b, const gchar *name, gboolean value)
 {
-  if (!dest)
+  if (!_bson_append_element_header (b, BSON_TYPE_BOOLEAN, name, -1))
     return FALSE;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_DOUBLE);
-
-  memcpy (dest, bson_data (c->obj) + c->value_pos, sizeof (gdouble));
-  *dest = GDOUBLE_FROM_LE (*dest);
-
+  _bson_append_byte (b, (guint8)value);
   return TRUE;
 }
 
 gboolean
-bson_cursor_get_document (const bson_cursor *c, bson **dest)
+bson_append_utc_datetime (bson *b, const gchar *name, gint64 ts)
 {
-  bson *b;
-  gint32 size;
-
-  if (!dest)
-    return FALSE;
+  return _bson_append_int64_element (b, BSON_TYPE_UTC_DATETIME, name, -1,
+                                     ts);
+}
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_DOCUMENT);
+gboolean
+bson_append_null (bson *b, const gchar *name)
+{
+  return _bson_append_element_header (b, BSON_TYPE_NULL, name, -1);
+}
 
-  size = bson_stream_doc_size (bson_data(c->obj), c->value_pos) -
-    sizeof (gint32) - 1;
-  b = bson_new_sized (size);
-  b->data = g_byte_array_append (b->data,
-                                 bson_data (c->obj) + c->value_pos +
-                                 sizeof (gint32), size);
-  bson_finish (b);
+gboolean
+bson_append_regex (bson *b, const gchar *name, const gchar *regexp,
+                   const gchar *options)
+{
+  return _bson_append_regex_element (b, name, -1, regexp, options);
+}
 
-  *dest = b;
+gboolean
+bson_append_javascript (bson *b, const gchar *name, const gchar *js,
+                        gint32 len)
+{
+  return _bson_append_string_element (b, BSON_TYPE_JS_CODE, name, -1,
+                                      js, len);
+}
 
-  return TRUE;
+gboolean
+bson_append_symbol (bson *b, const gchar *name, const gchar *symbol,
+                    gint32 len)
+{
+  return _bson_append_string_element (b, BSON_TYPE_SYMBOL, name, -1,
+                                      symbol, len);
 }
 
 gboolean
-bson_cursor_get_array (const bson_cursor *c, bson **dest)
+bson_append_javascript_w_scope (bson *b, const gchar *name,
+                                const gchar *js, gint32 len,
+                                const bson *scope)
 {
-  bson *b;
-  gint32 size;
+  return _bson_append_js_code_w_scope_element (b, name, -1, js, len, scope);
+}
 
-  if (!dest)
+gboolean
+bson_append_int32 (bson *b, const gchar *name, gint32 i)
+{
+  if (!_bson_append_element_header (b, BSON_TYPE_INT32, name, -1))
     return FALSE;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_ARRAY);
-
-  size = bson_stream_doc_size (bson_data(c->obj), c->value_pos) -
-    sizeof (gint32) - 1;
-  b = bson_new_sized (size);
-  b->data = g_byte_array_append (b->data,
-                                 bson_data (c->obj) + c->value_pos +
-                                 sizeof (gint32), size);
-  bson_finish (b);
-
-  *dest = b;
-
+  _bson_append_int32 (b, GINT32_TO_LE (i));
   return TRUE;
+ }
+
+gboolean
+bson_append_timestamp (bson *b, const gchar *name, gint64 ts)
+{
+  return _bson_append_int64_element (b, BSON_TYPE_TIMESTAMP, name, -1, ts);
 }
 
 gboolean
-bson_cursor_get_binary (const bson_cursor *c,
-                        bson_binary_subtype *subtype,
-                        const guint8 **data, gint32 *size)
+bson_append_int64 (bson *b, const gchar *name, gint64 i)
 {
-  if (!subtype || !size || !data)
-    return FALSE;
+  return _bson_append_int64_element (b, BSON_TYPE_INT64, name, -1, i);
+}
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_BINARY);
+/*
+ * Pre-computed keys
+ */
 
-  *size = bson_stream_doc_size (bson_data(c->obj), c->value_pos);
-  *subtype = (bson_binary_subtype)(bson_data (c->obj)[c->value_pos +
-                                                      sizeof (gint32)]);
-  *data = (guint8 *)(bson_data (c->obj) + c->value_pos + sizeof (gint32) + 1);
+bson_key *
+bson_key_new (const gchar *name)
+{
+  bson_key *key;
 
-  return TRUE;
+  if (!name)
+    return NULL;
+
+  key = g_new0 (bson_key, 1);
+  key->hash = _bson_key_hash (name, &key->len);
+  key->name = g_strndup (name, key->len);
+
+  return key;
+}
+
+void
+bson_key_free (bson_key *key)
+{
+  if (!key)
+    return;
+
+  g_free (key->name);
+  g_free (key);
+}
+
+const gchar *
+bson_key_name (const bson_key *key)
+{
+  if (!key)
+    return NULL;
+  return key->name;
 }
 
 gboolean
-bson_cursor_get_oid (const bson_cursor *c, const guint8 **dest)
+bson_key_set_prediction (bson_key *key, gboolean enable)
 {
-  if (!dest)
+  if (!key)
     return FALSE;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_OID);
+  key->predict = enable;
+  key->hint = 0;
+  return TRUE;
+}
+
+gboolean
+bson_append_double_k (bson *b, const bson_key *key, gdouble val)
+{
+  gdouble d = GDOUBLE_TO_LE (val);
 
-  *dest = (guint8 *)(bson_data (c->obj) + c->value_pos);
+  if (!key ||
+      !_bson_append_element_header (b, BSON_TYPE_DOUBLE,
+                                    key->name, key->len))
+    return FALSE;
 
+  _bson_append_data (b, (const guint8 *)&d, sizeof (val));
   return TRUE;
 }
 
 gboolean
-bson_cursor_get_boolean (const bson_cursor *c, gboolean *dest)
+bson_append_string_k (bson *b, const bson_key *key, const gchar *val,
+                      gint32 length)
 {
-  if (!dest)
+  if (!key)
     return FALSE;
+  return _bson_append_string_element (b, BSON_TYPE_STRING,
+                                      key->name, key->len, val, length);
+}
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_BOOLEAN);
-
-  *dest = (gboolean)(bson_data (c->obj) + c->value_pos)[0];
+gboolean
+bson_append_document_k (bson *b, const bson_key *key, const bson *doc)
+{
+  if (!key)
+    return FALSE;
+  return _bson_append_document_element (b, BSON_TYPE_DOCUMENT,
+                                        key->name, key->len, doc);
+}
 
-  return TRUE;
+gboolean
+bson_append_array_k (bson *b, const bson_key *key, const bson *array)
+{
+  if (!key)
+    return FALSE;
+  return _bson_append_document_element (b, BSON_TYPE_ARRAY,
+                                        key->name, key->len, array);
 }
 
 gboolean
-bson_cursor_get_utc_datetime (const bson_cursor *c,
-                              gint64 *dest)
+bson_append_binary_k (bson *b, const bson_key *key,
+                      bson_binary_subtype subtype,
+                      const guint8 *data, gint32 size)
 {
-  if (!dest)
+  if (!key)
     return FALSE;
+  return _bson_append_binary_element (b, key->name, key->len,
+                                      subtype, data, size);
+}
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_UTC_DATETIME);
+gboolean
+bson_append_oid_k (bson *b, const bson_key *key, const guint8 *oid)
+{
+  if (!key || !oid)
+    return FALSE;
 
-  memcpy (dest, bson_data (c->obj) + c->value_pos, sizeof (gint64));
-  *dest = GINT64_FROM_LE (*dest);
+  if (!_bson_append_element_header (b, BSON_TYPE_OID, key->name, key->len))
+    return FALSE;
 
+  _bson_append_data (b, oid, 12);
   return TRUE;
 }
 
 gboolean
-bson_cursor_get_regex (const bson_cursor *c, const gchar **regex,
-                       const gchar **options)
+bson_append_boolean_k (bson *b, const bson_key *key, gboolean value)
 {
-  if (!regex || !options)
+  if (!key ||
+      !_bson_append_element_header (b, BSON_TYPE_BOOLEAN,
+                                    key->name, key->len))
     return FALSE;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_REGEXP);
-
-  *regex = (gchar *)(bson_data (c->obj) + c->value_pos);
-  *options = (gchar *)(*regex + strlen(*regex) + 1);
-
+  _bson_append_byte (b, (guint8)value);
   return TRUE;
 }
 
 gboolean
-bson_cursor_get_javascript (const bson_cursor *c, const gchar **dest)
+bson_append_utc_datetime_k (bson *b, const bson_key *key, gint64 ts)
 {
-  if (!dest)
+  if (!key)
     return FALSE;
+  return _bson_append_int64_element (b, BSON_TYPE_UTC_DATETIME,
+                                     key->name, key->len, ts);
+}
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_JS_CODE);
+gboolean
+bson_append_null_k (bson *b, const bson_key *key)
+{
+  if (!key)
+    return FALSE;
+  return _bson_append_element_header (b, BSON_TYPE_NULL,
+                                      key->name, key->len);
+}
 
-  *dest = (gchar *)(bson_data (c->obj) + c->value_pos + sizeof (gint32));
+gboolean
+bson_append_regex_k (bson *b, const bson_key *key, const gchar *regexp,
+                     const gchar *options)
+{
+  if (!key)
+    return FALSE;
+  return _bson_append_regex_element (b, key->name, key->len,
+                                     regexp, options);
+}
 
-  return TRUE;
+gboolean
+bson_append_javascript_k (bson *b, const bson_key *key, const gchar *js,
+                          gint32 len)
+{
+  if (!key)
+    return FALSE;
+  return _bson_append_string_element (b, BSON_TYPE_JS_CODE,
+                                      key->name, key->len, js, len);
 }
 
 gboolean
-bson_cursor_get_symbol (const bson_cursor *c, const gchar **dest)
+bson_append_symbol_k (bson *b, const bson_key *key, const gchar *symbol,
+                      gint32 len)
 {
-  if (!dest)
+  if (!key)
     return FALSE;
+  return _bson_append_string_element (b, BSON_TYPE_SYMBOL,
+                                      key->name, key->len, symbol, len);
+}
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_SYMBOL);
+gboolean
+bson_append_javascript_w_scope_k (bson *b, const bson_key *key,
+                                  const gchar *js, gint32 len,
+                                  const bson *scope)
+{
+  if (!key)
+    return FALSE;
+  return _bson_append_js_code_w_scope_element (b, key->name, key->len,
+                                               js, len, scope);
+}
 
-  *dest = (gchar *)(bson_data (c->obj) + c->value_pos + sizeof (gint32));
+gboolean
+bson_append_int32_k (bson *b, const bson_key *key, gint32 i)
+{
+  if (!key ||
+      !_bson_append_element_header (b, BSON_TYPE_INT32,
+                                    key->name, key->len))
+    return FALSE;
 
+  _bson_append_int32 (b, GINT32_TO_LE (i));
   return TRUE;
 }
 
 gboolean
-bson_cursor_get_javascript_w_scope (const bson_cursor *c,
-                                    const gchar **js,
-                                    bson **scope)
+bson_append_timestamp_k (bson *b, const bson_key *key, gint64 ts)
 {
-  bson *b;
-  gint32 size, docpos;
+  if (!key)
+    return FALSE;
+  return _bson_append_int64_element (b, BSON_TYPE_TIMESTAMP,
+                                     key->name, key->len, ts);
+}
 
-  if (!js || !scope)
+gboolean
+bson_append_int64_k (bson *b, const bson_key *key, gint64 i)
+{
+  if (!key)
     return FALSE;
+  return _bson_append_int64_element (b, BSON_TYPE_INT64,
+                                     key->name, key->len, i);
+}
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_JS_CODE_W_SCOPE);
+/*
+ * Find & retrieve data
+ */
 
-  docpos = bson_stream_doc_size (bson_data (c->obj),
-                                  c->value_pos + sizeof (gint32)) +
-    sizeof (gint32) * 2;
-  size = bson_stream_doc_size (bson_data (c->obj), c->value_pos + docpos) -
-    sizeof (gint32) - 1;
-  b = bson_new_sized (size);
-  b->data = g_byte_array_append (b->data,
-                                 bson_data (c->obj) + c->value_pos + docpos +
-                                 sizeof (gint32), size);
-  bson_finish (b);
+/** @internal Position an iterator before the first element of an
+ * object.
+ *
+ * @param i is the iterator to position.
+ * @param b is the finished BSON object to iterate over.
+ */
+static inline void
+_bson_iter_reset (bson_iter *i, const bson *b)
+{
+  i->obj = b;
+  i->data = b->data;
+  i->size = b->len;
+  i->key = NULL;
+  i->pos = 0;
+  i->value_pos = 0;
+}
 
-  *scope = b;
-  *js = (gchar *)(bson_data (c->obj) + c->value_pos + sizeof (gint32) * 2);
+gboolean
+bson_iter_init (bson_iter *i, const bson *b)
+{
+  if (!i || bson_size (b) == -1)
+    return FALSE;
+
+  _bson_iter_reset (i, b);
 
   return TRUE;
 }
 
-gboolean
-bson_cursor_get_int32 (const bson_cursor *c, gint32 *dest)
+bson_cursor *
+bson_cursor_new (const bson *b)
 {
-  if (!dest)
-    return FALSE;
+  bson_cursor *c;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_INT32);
+  if (bson_size (b) == -1)
+    return NULL;
 
-  memcpy (dest, bson_data (c->obj) + c->value_pos, sizeof (gint32));
-  *dest = GINT32_FROM_LE (*dest);
+  c = (bson_cursor *)g_new0 (bson_cursor, 1);
+  _bson_iter_reset (&c->iter, b);
+  c->top = b;
 
-  return TRUE;
+  return c;
 }
 
-gboolean
-bson_cursor_get_timestamp (const bson_cursor *c, gint64 *dest)
+bson_cursor *
+bson_cursor_new_child (const bson_cursor *c)
 {
-  if (!dest)
-    return FALSE;
+  bson *view;
+  bson_cursor *child;
+  bson_type type;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_TIMESTAMP);
+  type = bson_cursor_type (c);
+  if (type != BSON_TYPE_DOCUMENT && type != BSON_TYPE_ARRAY)
+    return NULL;
 
-  memcpy (dest, bson_data (c->obj) + c->value_pos, sizeof (gint64));
-  *dest = GINT64_FROM_LE (*dest);
+  view = bson_new_view (c->iter.data + c->iter.value_pos,
+                        bson_stream_doc_size (c->iter.data,
+                                              c->iter.value_pos));
+  if (!view)
+    return NULL;
 
-  return TRUE;
+  child = bson_cursor_new (view);
+  child->owned = view;
+  child->top = c->top;
+
+  return child;
 }
 
-gboolean
-bson_cursor_get_int64 (const bson_cursor *c, gint64 *dest)
+void
+bson_cursor_free (bson_cursor *c)
 {
-  if (!dest)
-    return FALSE;
+  if (!c)
+    return;
 
-  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_INT64);
+  bson_free (c->owned);
+  g_free (c);
+}
 
-  memcpy (dest, bson_data (c->obj) + c->value_pos, sizeof (gint64));
-  *dest = GINT64_FROM_LE (*dest);
+/** @internal Figure out the block size of a given type.
+ *
+ * Provided a #bson_type and some raw data, figures out the length of
+ * the block, counted from rigth after the element name's position.
+ *
+ * @param type is the type of object we need the size for.
+ * @param data is the raw data (starting right after the element's
+ * name).
+ *
+ * @returns The size of the block, or -1 on error.
+ */
+static gint32
+_bson_get_block_size (bson_type type, const guint8 *data)
+{
+  glong l;
 
-  return TRUE;
+  switch (type)
+    {
+    case BSON_TYPE_STRING:
+    case BSON_TYPE_JS_CODE:
+    case BSON_TYPE_SYMBOL:
+      return bson_stream_doc_size (data, 0) + sizeof (gint32);
+    case BSON_TYPE_DOCUMENT:
+    case BSON_TYPE_ARRAY:
+    case BSON_TYPE_JS_CODE_W_SCOPE:
+      return bson_stream_doc_size (data, 0);
+    case BSON_TYPE_DOUBLE:
+      return sizeof (gdouble);
+    case BSON_TYPE_BINARY:
+      return bson_stream_doc_size (data, 0) +
+        sizeof (gint32) + sizeof (guint8);
+    case BSON_TYPE_OID:
+      return 12;
+    case BSON_TYPE_BOOLEAN:
+      return 1;
+    case BSON_TYPE_UTC_DATETIME:
+    case BSON_TYPE_TIMESTAMP:
+    case BSON_TYPE_INT64:
+      return sizeof (gint64);
+    case BSON_TYPE_NULL:
+    case BSON_TYPE_UNDEFINED:
+    case BSON_TYPE_MIN:
+    case BSON_TYPE_MAX:
+      return 0;
+    case BSON_TYPE_REGEXP:
+      l = strlen((gchar *)data);
+      return l + strlen((gchar *)(data + l + 1)) + 2;
+    case BSON_TYPE_INT32:
+      return sizeof (gint32);
+    case BSON_TYPE_DBPOINTER:
+      return bson_stream_doc_size (data, 0) + sizeof (gint32) + 12;
+    case BSON_TYPE_NONE:
+    default:
+      return -1;
+    }
+}
+
+gboolean
+bson_iter_next (bson_iter *i)
+{
+  guint32 pos;
+  gint32 bs;
+
+  if (!i)
+    return FALSE;
+
+  if (i->pos == 0)
+    pos = sizeof (guint32);
+  else
+    {
+      bs = _bson_get_block_size (bson_iter_type (i), i->data + i->value_pos);
+      if (bs == -1)
+        return FALSE;
+      pos = i->value_pos + bs;
+    }
+
+  if (pos >= i->size - 1)
+    return FALSE;
+
+  i->pos = pos;
+  i->key = (gchar *) &i->data[pos + 1];
+  i->value_pos = pos + strlen (i->key) + 2;
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_next (bson_cursor *c)
+{
+  if (!c)
+    return FALSE;
+
+  return bson_iter_next (&c->iter);
+}
+
+gboolean
+bson_iter_recurse (const bson_iter *i, bson_iter *child)
+{
+  bson_type type;
+  gint32 size;
+
+  type = bson_iter_type (i);
+  if (!child || (type != BSON_TYPE_DOCUMENT && type != BSON_TYPE_ARRAY))
+    return FALSE;
+
+  size = bson_stream_doc_size (i->data, i->value_pos);
+  if (size < (gint32)(sizeof (gint32) + sizeof (guint8)) ||
+      i->value_pos + size > i->size - 1)
+    return FALSE;
+
+  child->obj = NULL;
+  child->data = i->data + i->value_pos;
+  child->size = size;
+  child->key = NULL;
+  child->pos = 0;
+  child->value_pos = 0;
+
+  return TRUE;
+}
+
+/** @internal Build the key index of a finished BSON object.
+ *
+ * Only the first element with any given name is indexed. If an
+ * element of unknown type is encountered, the elements before it
+ * remain indexed, just like a linear scan would only find those.
+ *
+ * @param b is the BSON object to index.
+ *
+ * @returns The newly built index.
+ */
+static bson_key_index *
+_bson_key_index_build (bson *b)
+{
+  bson_key_index *idx;
+  const guint8 *d = b->data;
+  guint32 pos = sizeof (gint32);
+  guint32 end = b->len - 1;
+
+  idx = (bson_key_index *)_bson_key_index_alloc (b, sizeof (bson_key_index));
+  idx->mask = 15;
+  idx->slots = (bson_key_index_slot *)
+    _bson_key_index_alloc (b, (idx->mask + 1) * sizeof (bson_key_index_slot));
+
+  while (pos < end)
+    {
+      const gchar *key = (const gchar *)&d[pos + 1];
+      gint32 key_len, bs;
+      guint32 h, i;
+
+      h = _bson_key_hash (key, &key_len);
+
+      if ((idx->count + 1) * 2 > idx->mask + 1)
+        _bson_key_index_grow (b, idx);
+
+      i = h & idx->mask;
+      while (idx->slots[i].pos &&
+             (idx->slots[i].hash != h ||
+              strcmp ((const gchar *)&d[idx->slots[i].pos + 1], key) != 0))
+        i = (i + 1) & idx->mask;
+
+      if (idx->slots[i].pos)
+        idx->duplicates = TRUE;
+      else
+        {
+          idx->slots[i].hash = h;
+          idx->slots[i].pos = pos;
+          idx->count++;
+        }
+
+      bs = _bson_get_block_size ((bson_type)d[pos], &d[pos + key_len + 2]);
+      if (bs == -1)
+        break;
+      pos += key_len + 2 + bs;
+    }
+
+  return idx;
+}
+
+/** @internal Look a key up in the key index of a BSON object.
+ *
+ * @param idx is the index to look the key up in.
+ * @param d is the data of the indexed object.
+ * @param name is the key name to look up.
+ * @param h is the hash of @a name.
+ *
+ * @returns The position of the first element named @a name, or zero
+ * if there is no such element.
+ */
+static inline guint32
+_bson_key_index_lookup (const bson_key_index *idx, const guint8 *d,
+                        const gchar *name, guint32 h)
+{
+  guint32 i = h & idx->mask;
+
+  while (idx->slots[i].pos)
+    {
+      if (idx->slots[i].hash == h &&
+          strcmp ((const gchar *)&d[idx->slots[i].pos + 1], name) == 0)
+        return idx->slots[i].pos;
+      i = (i + 1) & idx->mask;
+    }
+  return 0;
+}
+
+/** @internal Find a key within the document an iterator is on.
+ *
+ * @param i is the iterator to position, if the key is found. It is
+ * left untouched otherwise.
+ * @param name is the key to find.
+ * @param name_len is the length of @a name, or -1 to measure it.
+ * @param h is the hash of @a name, only used if @a name_len is not
+ * -1.
+ * @param start_pos is the position to start the search at.
+ * @param end_pos is the position to stop the search at.
+ * @param wrap_over toggles whether to continue the search from the
+ * start of the object, up to @a start_pos.
+ *
+ * @returns TRUE if the key was found, FALSE otherwise.
+ */
+static inline gboolean
+_bson_iter_find (bson_iter *i, const gchar *name, gint32 name_len,
+                 guint32 h, size_t start_pos, guint32 end_pos,
+                 gboolean wrap_over)
+{
+  const bson *b = i->obj;
+  size_t pos = start_pos;
+  gint32 bs;
+  const guint8 *d;
+
+  d = i->data;
+
+  if (b && b->indexed)
+    {
+      /* The index is a cache, building it does not change the
+         contents of the object. */
+      if (!b->index)
+        ((bson *)b)->index = _bson_key_index_build ((bson *)b);
+
+      if (name_len == -1)
+        h = _bson_key_hash (name, &name_len);
+
+      /* With duplicate keys, the index only knows about the first
+         occurrence, so it can only answer searches from the start. */
+      if (!b->index->duplicates || start_pos <= sizeof (gint32))
+        {
+          pos = _bson_key_index_lookup (b->index, d, name, h);
+          if (!pos)
+            return FALSE;
+          if (!wrap_over && (pos < start_pos || pos >= end_pos))
+            return FALSE;
+
+          i->key = (const gchar *)&d[pos + 1];
+          i->pos = pos;
+          i->value_pos = pos + name_len + 2;
+
+          return TRUE;
+        }
+    }
+  else if (name_len == -1)
+    name_len = strlen (name);
+
+  while (pos < end_pos)
+    {
+      bson_type t = (bson_type) d[pos];
+      const gchar *key = (gchar *) &d[pos + 1];
+      gint32 key_len = strlen (key);
+      gint32 value_pos = pos + key_len + 2;
+
+      if (key_len == name_len && memcmp (key, name, key_len) == 0)
+        {
+          i->key = key;
+          i->pos = pos;
+          i->value_pos = value_pos;
+
+          return TRUE;
+        }
+      bs = _bson_get_block_size (t, &d[value_pos]);
+      if (bs == -1)
+        return FALSE;
+      pos = value_pos + bs;
+    }
+
+  if (wrap_over)
+    return _bson_iter_find (i, name, name_len, h, sizeof (gint32),
+                            start_pos, FALSE);
+
+  return FALSE;
+}
+
+gboolean
+bson_iter_find (bson_iter *i, const gchar *name)
+{
+  if (!i || !name)
+    return FALSE;
+
+  return _bson_iter_find (i, name, -1, 0, MAX (i->pos, sizeof (gint32)),
+                          i->size - 1, TRUE);
+}
+
+gboolean
+bson_cursor_find (bson_cursor *c, const gchar *name)
+{
+  if (!c || !name)
+    return FALSE;
+
+  return _bson_iter_find (&c->iter, name, -1, 0, c->iter.pos,
+                          c->iter.size - 1, TRUE);
+}
+
+gboolean
+bson_cursor_find_next (bson_cursor *c, const gchar *name)
+{
+  if (!c || !name)
+    return FALSE;
+
+  return _bson_iter_find (&c->iter, name, -1, 0, c->iter.pos,
+                          c->iter.size - 1, FALSE);
+}
+
+bson_cursor *
+bson_find (const bson *b, const gchar *name)
+{
+  bson_cursor *c;
+
+  if (bson_size (b) == -1 || !name)
+    return NULL;
+
+  c = bson_cursor_new (b);
+  if (_bson_iter_find (&c->iter, name, -1, 0, sizeof (gint32),
+                       c->iter.size - 1, FALSE))
+    return c;
+  bson_cursor_free (c);
+  return NULL;
+}
+
+/** @internal Check whether a predicted position holds a key.
+ *
+ * The position is only accepted if it is an element boundary of the
+ * document, reached by stepping over the elements from @a start_pos,
+ * which must be one too, and if the value fits within the document.
+ * Stepping over elements is cheaper than searching, as keys are not
+ * compared on the way.
+ *
+ * @param d is the document to check in.
+ * @param key is the key to check for.
+ * @param pos is the predicted position.
+ * @param start_pos is an element boundary not after @a pos.
+ * @param end_pos is the position of the closing NUL byte.
+ *
+ * @returns TRUE if the key is at @a pos, FALSE otherwise.
+ */
+static gboolean
+_bson_key_predicted_at (const guint8 *d, const bson_key *key, size_t pos,
+                        size_t start_pos, size_t end_pos)
+{
+  gint32 bs;
+
+  if (pos + key->len + 2 > end_pos || d[pos] == 0 ||
+      memcmp (&d[pos + 1], key->name, key->len + 1) != 0)
+    return FALSE;
+
+  while (start_pos < pos)
+    {
+      size_t key_len = strlen ((const gchar *)&d[start_pos + 1]);
+
+      if (start_pos + key_len + 2 > end_pos)
+        return FALSE;
+      bs = _bson_get_block_size ((bson_type) d[start_pos],
+                                 &d[start_pos + key_len + 2]);
+      if (bs == -1)
+        return FALSE;
+      start_pos += key_len + 2 + bs;
+    }
+  if (start_pos != pos)
+    return FALSE;
+
+  bs = _bson_get_block_size ((bson_type) d[pos], &d[pos + key->len + 2]);
+  return (bs != -1 && pos + key->len + 2 + bs <= end_pos);
+}
+
+/** @internal Find a pre-computed key within the document an iterator
+ * is on.
+ *
+ * If the key has prediction enabled, its last known position is
+ * tried first, and updated after every successful search.
+ *
+ * @param i is the iterator to position, if the key is found.
+ * @param key is the key to find.
+ * @param start_pos is the position to start the search at.
+ * @param wrap_over toggles whether to wrap over.
+ *
+ * @returns TRUE if the key was found, FALSE otherwise.
+ */
+static gboolean
+_bson_iter_find_k (bson_iter *i, bson_key *key, size_t start_pos,
+                   gboolean wrap_over)
+{
+  const guint8 *d = i->data;
+  guint32 end_pos = i->size - 1;
+  guint32 pos = key->hint;
+
+  /* Step over the elements from the starting position if that is a
+     boundary before the prediction, from the first element
+     otherwise. */
+  if (key->predict && pos >= sizeof (gint32) &&
+      (wrap_over || pos >= start_pos) &&
+      _bson_key_predicted_at (d, key, pos,
+                              (start_pos >= sizeof (gint32) &&
+                               start_pos <= pos) ?
+                              start_pos : sizeof (gint32),
+                              end_pos))
+    {
+      i->key = (const gchar *)&d[pos + 1];
+      i->pos = pos;
+      i->value_pos = pos + key->len + 2;
+
+      return TRUE;
+    }
+
+  if (!_bson_iter_find (i, key->name, key->len, key->hash, start_pos,
+                        end_pos, wrap_over))
+    return FALSE;
+
+  if (key->predict)
+    key->hint = i->pos;
+  return TRUE;
+}
+
+gboolean
+bson_cursor_find_k (bson_cursor *c, bson_key *key)
+{
+  if (!c || !key)
+    return FALSE;
+
+  return _bson_iter_find_k (&c->iter, key, c->iter.pos, TRUE);
+}
+
+bson_cursor *
+bson_find_k (const bson *b, bson_key *key)
+{
+  bson_cursor *c;
+
+  if (bson_size (b) == -1 || !key)
+    return NULL;
+
+  c = bson_cursor_new (b);
+  if (_bson_iter_find_k (&c->iter, key, sizeof (gint32), FALSE))
+    return c;
+  bson_cursor_free (c);
+  return NULL;
+}
+
+/** @internal Find a key within a range of raw BSON data.
+ *
+ * @param d is the data to search in.
+ * @param pos is the position to start searching at.
+ * @param end is the position to stop searching at.
+ * @param name is the key to find, not necessarily NUL terminated.
+ * @param name_len is the length of @a name.
+ *
+ * @returns The position of the element, or zero if not found.
+ */
+static size_t
+_bson_find_segment (const guint8 *d, size_t pos, size_t end,
+                    const gchar *name, gint32 name_len)
+{
+  gint32 bs;
+
+  while (pos < end)
+    {
+      const gchar *key = (gchar *) &d[pos + 1];
+      gint32 key_len = strlen (key);
+
+      if (key_len == name_len && memcmp (key, name, key_len) == 0)
+        return pos;
+
+      bs = _bson_get_block_size ((bson_type) d[pos], &d[pos + key_len + 2]);
+      if (bs == -1)
+        return 0;
+      pos += key_len + 2 + bs;
+    }
+  return 0;
+}
+
+/** @internal Find a dotted path within a BSON object.
+ *
+ * The first segment is searched for between @a start_pos and the end
+ * of the object, wrapping over if @a wrap_over is set. On success, @a
+ * dest_c is positioned to the leaf element. If that is within an
+ * embedded document, the cursor will be opened on a view of it, owned
+ * by the cursor.
+ *
+ * @param b is the BSON object to search in.
+ * @param path is the dotted path to find.
+ * @param start_pos is the position to start the search at.
+ * @param wrap_over toggles wrapping over for the first segment.
+ * @param dest_c is the cursor to position.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_cursor_find_path (const bson *b, const gchar *path, size_t start_pos,
+                        gboolean wrap_over, bson_cursor *dest_c)
+{
+  const guint8 *d;
+  const gchar *seg, *dot;
+  size_t pos, doc_pos = 0, end;
+  gint32 seg_len, doc_size;
+  bson *view = NULL;
+
+  d = bson_data (b);
+  doc_size = bson_size (b);
+  end = doc_size - 1;
+  seg = path;
+
+  for (;;)
+    {
+      dot = strchr (seg, '.');
+      seg_len = (dot) ? dot - seg : (gint32) strlen (seg);
+      if (seg_len == 0)
+        return FALSE;
+
+      pos = _bson_find_segment (d, start_pos, end, seg, seg_len);
+      if (!pos && wrap_over)
+        pos = _bson_find_segment (d, doc_pos + sizeof (gint32), start_pos,
+                                  seg, seg_len);
+      if (!pos)
+        return FALSE;
+      if (!dot)
+        break;
+
+      if (d[pos] != BSON_TYPE_DOCUMENT && d[pos] != BSON_TYPE_ARRAY)
+        return FALSE;
+
+      doc_pos = pos + seg_len + 2;
+      doc_size = bson_stream_doc_size (d, doc_pos);
+      if (doc_size < 5 || doc_pos + doc_size > end)
+        return FALSE;
+      start_pos = doc_pos + sizeof (gint32);
+      end = doc_pos + doc_size - 1;
+      wrap_over = FALSE;
+      seg = dot + 1;
+    }
+
+  if (doc_pos)
+    {
+      view = bson_new_view (d + doc_pos, doc_size);
+      if (!view)
+        return FALSE;
+
+      /* The old view (if any) only borrowed its data, freeing it does
+         not invalidate the new one. */
+      bson_free (dest_c->owned);
+      dest_c->owned = view;
+    }
+
+  dest_c->iter.obj = (view) ? view : b;
+  dest_c->iter.data = d + doc_pos;
+  dest_c->iter.size = doc_size;
+  dest_c->iter.pos = pos - doc_pos;
+  dest_c->iter.key = (const gchar *) &d[pos + 1];
+  dest_c->iter.value_pos = dest_c->iter.pos + seg_len + 2;
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_find_path (bson_cursor *c, const gchar *path)
+{
+  if (!c || !path)
+    return FALSE;
+
+  return _bson_cursor_find_path (c->iter.obj, path,
+                                 MAX (c->iter.pos, sizeof (gint32)), TRUE, c);
+}
+
+bson_cursor *
+bson_find_path (const bson *b, const gchar *path)
+{
+  bson_cursor *c;
+
+  if (bson_size (b) == -1 || !path)
+    return NULL;
+
+  c = bson_cursor_new (b);
+  if (_bson_cursor_find_path (b, path, sizeof (gint32), FALSE, c))
+    return c;
+  bson_cursor_free (c);
+  return NULL;
+}
+
+/** @internal Number of keys bson_extract() handles without
+ * allocating memory for its bookkeeping. */
+#define BSON_EXTRACT_PREALLOC 16
+
+gint
+bson_extract (const bson *b, const gchar **keys, const bson_type *types,
+              gint n, bson_cursor **dest)
+{
+  gint32 lens_prealloc[BSON_EXTRACT_PREALLOC];
+  gint32 *lens;
+  const guint8 *d;
+  size_t pos, end;
+  gint i, pending, found = 0;
+
+  if (bson_size (b) == -1 || !keys || !dest || n <= 0)
+    return -1;
+
+  for (i = 0; i < n; i++)
+    if (!keys[i])
+      return -1;
+
+  lens = (n <= BSON_EXTRACT_PREALLOC) ? lens_prealloc : g_new (gint32, n);
+  for (i = 0; i < n; i++)
+    {
+      lens[i] = strlen (keys[i]);
+      dest[i] = NULL;
+    }
+  pending = n;
+
+  d = bson_data (b);
+  pos = sizeof (gint32);
+  end = bson_size (b) - 1;
+
+  while (pos < end && pending > 0)
+    {
+      bson_type t = (bson_type) d[pos];
+      const gchar *key = (gchar *) &d[pos + 1];
+      gint32 key_len = strlen (key);
+      size_t value_pos = pos + key_len + 2;
+      gint32 bs;
+
+      for (i = 0; i < n; i++)
+        {
+          /* Only the first element with a given name counts, just
+             like with bson_find(). Matched keys are marked with a
+             negative length. */
+          if (lens[i] != key_len || memcmp (key, keys[i], key_len) != 0)
+            continue;
+
+          lens[i] = -1;
+          pending--;
+
+          if (types && types[i] != BSON_TYPE_NONE && types[i] != t)
+            continue;
+
+          dest[i] = bson_cursor_new (b);
+          dest[i]->iter.key = key;
+          dest[i]->iter.pos = pos;
+          dest[i]->iter.value_pos = value_pos;
+          found++;
+        }
+
+      bs = _bson_get_block_size (t, &d[value_pos]);
+      if (bs == -1)
+        break;
+      pos = value_pos + bs;
+    }
+
+  if (lens != lens_prealloc)
+    g_free (lens);
+
+  return found;
+}
+
+bson_type
+bson_cursor_type (const bson_cursor *c)
+{
+  if (!c)
+    return BSON_TYPE_NONE;
+
+  return bson_iter_type (&c->iter);
+}
+
+const gchar *
+bson_cursor_type_as_string (const bson_cursor *c)
+{
+  if (!c || c->iter.pos < sizeof (gint32))
+    return NULL;
+
+  return bson_type_as_string (bson_cursor_type (c));
+}
+
+const gchar *
+bson_cursor_key (const bson_cursor *c)
+{
+  if (!c)
+    return NULL;
+
+  return c->iter.key;
+}
+
+/** @internal Convenience macro to verify a cursor's type.
+ *
+ * Verifies that the cursor's type is the same as the type requested
+ * by the caller, and returns FALSE if there is a mismatch.
+ */
+#define BSON_CURSOR_CHECK_TYPE(c,type)		\
+  if (bson_cursor_type(c) != type)		\
+    return FALSE;
+
+gboolean
+bson_cursor_get_string (const bson_cursor *c, const gchar **dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_STRING);
+
+  *dest = (gchar *)(c->iter.data + c->iter.value_pos + sizeof (gint32));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_double (const bson_cursor *c, gdouble *dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_DOUBLE);
+
+  memcpy (dest, c->iter.data + c->iter.value_pos, sizeof (gdouble));
+  *dest = GDOUBLE_FROM_LE (*dest);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_document (const bson_cursor *c, bson **dest)
+{
+  bson *b;
+  gint32 size;
+
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_DOCUMENT);
+
+  size = bson_stream_doc_size (c->iter.data, c->iter.value_pos) -
+    sizeof (gint32) - 1;
+  b = bson_new_sized (size);
+  _bson_append_data (b, c->iter.data + c->iter.value_pos + sizeof (gint32),
+                     size);
+  bson_finish (b);
+
+  *dest = b;
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_array (const bson_cursor *c, bson **dest)
+{
+  bson *b;
+  gint32 size;
+
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_ARRAY);
+
+  size = bson_stream_doc_size (c->iter.data, c->iter.value_pos) -
+    sizeof (gint32) - 1;
+  b = bson_new_sized (size);
+  _bson_append_data (b, c->iter.data + c->iter.value_pos + sizeof (gint32),
+                     size);
+  bson_finish (b);
+
+  *dest = b;
+
+  return TRUE;
+}
+
+/** @internal Get a view of a document-like element at the cursor.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param type is the document-like type expected at the cursor.
+ * @param dest is a pointer to a variable where the view can be
+ * stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_bson_cursor_get_document_view (const bson_cursor *c, bson_type type,
+                                bson **dest)
+{
+  bson *b;
+
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, type);
+
+  b = bson_new_view (c->iter.data + c->iter.value_pos,
+                     bson_stream_doc_size (c->iter.data,
+                                           c->iter.value_pos));
+  if (!b)
+    return FALSE;
+
+  *dest = b;
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_document_view (const bson_cursor *c, bson **dest)
+{
+  return _bson_cursor_get_document_view (c, BSON_TYPE_DOCUMENT, dest);
+}
+
+gboolean
+bson_cursor_get_array_view (const bson_cursor *c, bson **dest)
+{
+  return _bson_cursor_get_document_view (c, BSON_TYPE_ARRAY, dest);
+}
+
+/** @internal Decode a BSON array of numbers into a C array.
+ *
+ * @param c is the cursor pointing at the array.
+ * @param dest_type is the type of the elements of @a dest: one of
+ * #BSON_TYPE_INT32, #BSON_TYPE_INT64 or #BSON_TYPE_DOUBLE.
+ * @param dest is the array to store the values in.
+ * @param n is the number of elements @a dest has room for.
+ *
+ * @returns The number of elements in the BSON array, or -1 on error.
+ */
+static gint32
+_bson_cursor_get_numeric_array (const bson_cursor *c, bson_type dest_type,
+                                void *dest, gint32 n)
+{
+  const guint8 *d, *k_end;
+  size_t pos, end;
+  gint32 count = 0, i32;
+  gint64 i64;
+  gdouble f;
+  bson_type type;
+
+  if ((!dest && n) || n < 0)
+    return -1;
+  if (bson_cursor_type (c) != BSON_TYPE_ARRAY)
+    return -1;
+
+  d = c->iter.data + c->iter.value_pos;
+  end = bson_stream_doc_size (d, 0) - 1;
+
+  for (pos = sizeof (gint32); pos < end; count++)
+    {
+      type = (bson_type) d[pos];
+      k_end = memchr (d + pos + 1, 0, end - pos - 1);
+      if (!k_end)
+        return -1;
+      pos = k_end + 1 - d;
+
+      switch (type)
+        {
+        case BSON_TYPE_INT32:
+          if (pos + sizeof (gint32) > end)
+            return -1;
+          memcpy (&i32, d + pos, sizeof (gint32));
+          i64 = GINT32_FROM_LE (i32);
+          f = (gdouble) i64;
+          pos += sizeof (gint32);
+          break;
+        case BSON_TYPE_INT64:
+          if (pos + sizeof (gint64) > end)
+            return -1;
+          memcpy (&i64, d + pos, sizeof (gint64));
+          i64 = GINT64_FROM_LE (i64);
+          f = (gdouble) i64;
+          pos += sizeof (gint64);
+          break;
+        case BSON_TYPE_DOUBLE:
+          if (dest_type != BSON_TYPE_DOUBLE || pos + sizeof (gdouble) > end)
+            return -1;
+          memcpy (&f, d + pos, sizeof (gdouble));
+          f = GDOUBLE_FROM_LE (f);
+          pos += sizeof (gdouble);
+          break;
+        default:
+          return -1;
+        }
+
+      switch (dest_type)
+        {
+        case BSON_TYPE_INT32:
+          if (i64 < G_MININT32 || i64 > G_MAXINT32)
+            return -1;
+          if (count < n)
+            ((gint32 *)dest)[count] = (gint32) i64;
+          break;
+        case BSON_TYPE_INT64:
+          if (count < n)
+            ((gint64 *)dest)[count] = i64;
+          break;
+        default:
+          if (count < n)
+            ((gdouble *)dest)[count] = f;
+          break;
+        }
+    }
+
+  return count;
+}
+
+gint32
+bson_cursor_get_array_int32 (const bson_cursor *c, gint32 *dest, gint32 n)
+{
+  return _bson_cursor_get_numeric_array (c, BSON_TYPE_INT32, dest, n);
+}
+
+gint32
+bson_cursor_get_array_int64 (const bson_cursor *c, gint64 *dest, gint32 n)
+{
+  return _bson_cursor_get_numeric_array (c, BSON_TYPE_INT64, dest, n);
+}
+
+gint32
+bson_cursor_get_array_double (const bson_cursor *c, gdouble *dest, gint32 n)
+{
+  return _bson_cursor_get_numeric_array (c, BSON_TYPE_DOUBLE, dest, n);
+}
+
+gboolean
+bson_cursor_get_binary (const bson_cursor *c,
+                        bson_binary_subtype *subtype,
+                        const guint8 **data, gint32 *size)
+{
+  if (!subtype || !size || !data)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_BINARY);
+
+  *size = bson_stream_doc_size (c->iter.data, c->iter.value_pos);
+  *subtype = (bson_binary_subtype)(c->iter.data[c->iter.value_pos +
+                                                      sizeof (gint32)]);
+  *data = (guint8 *)(c->iter.data + c->iter.value_pos + sizeof (gint32) + 1);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_oid (const bson_cursor *c, const guint8 **dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_OID);
+
+  *dest = (guint8 *)(c->iter.data + c->iter.value_pos);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_boolean (const bson_cursor *c, gboolean *dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_BOOLEAN);
+
+  *dest = (gboolean)(c->iter.data + c->iter.value_pos)[0];
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_utc_datetime (const bson_cursor *c,
+                              gint64 *dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_UTC_DATETIME);
+
+  memcpy (dest, c->iter.data + c->iter.value_pos, sizeof (gint64));
+  *dest = GINT64_FROM_LE (*dest);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_regex (const bson_cursor *c, const gchar **regex,
+                       const gchar **options)
+{
+  if (!regex || !options)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_REGEXP);
+
+  *regex = (gchar *)(c->iter.data + c->iter.value_pos);
+  *options = (gchar *)(*regex + strlen(*regex) + 1);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_javascript (const bson_cursor *c, const gchar **dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_JS_CODE);
+
+  *dest = (gchar *)(c->iter.data + c->iter.value_pos + sizeof (gint32));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_symbol (const bson_cursor *c, const gchar **dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_SYMBOL);
+
+  *dest = (gchar *)(c->iter.data + c->iter.value_pos + sizeof (gint32));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_javascript_w_scope (const bson_cursor *c,
+                                    const gchar **js,
+                                    bson **scope)
+{
+  bson *b;
+  gint32 size, docpos;
+
+  if (!js || !scope)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_JS_CODE_W_SCOPE);
+
+  docpos = bson_stream_doc_size (c->iter.data,
+                                  c->iter.value_pos + sizeof (gint32)) +
+    sizeof (gint32) * 2;
+  size = bson_stream_doc_size (c->iter.data, c->iter.value_pos + docpos) -
+    sizeof (gint32) - 1;
+  b = bson_new_sized (size);
+  _bson_append_data (b, c->iter.data + c->iter.value_pos + docpos +
+                     sizeof (gint32), size);
+  bson_finish (b);
+
+  *scope = b;
+  *js = (gchar *)(c->iter.data + c->iter.value_pos + sizeof (gint32) * 2);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_int32 (const bson_cursor *c, gint32 *dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_INT32);
+
+  memcpy (dest, c->iter.data + c->iter.value_pos, sizeof (gint32));
+  *dest = GINT32_FROM_LE (*dest);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_timestamp (const bson_cursor *c, gint64 *dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_TIMESTAMP);
+
+  memcpy (dest, c->iter.data + c->iter.value_pos, sizeof (gint64));
+  *dest = GINT64_FROM_LE (*dest);
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_get_int64 (const bson_cursor *c, gint64 *dest)
+{
+  if (!dest)
+    return FALSE;
+
+  BSON_CURSOR_CHECK_TYPE (c, BSON_TYPE_INT64);
+
+  memcpy (dest, c->iter.data + c->iter.value_pos, sizeof (gint64));
+  *dest = GINT64_FROM_LE (*dest);
+
+  return TRUE;
+}
+
+/** @internal Find the value a cursor points at, for overwriting.
+ *
+ * The data of the object the cursor was created for must not be
+ * shared with others: cursors on embedded documents point into it
+ * too, and so do the other cursors on the same object, so it can not
+ * be copied from under them.
+ *
+ * @param c is the cursor pointing at the element.
+ * @param type is the type the element must have.
+ *
+ * @returns A pointer to the value of the element, or NULL if the
+ * cursor does not point at an element of @a type, or the data is
+ * shared.
+ */
+static guint8 *
+_bson_cursor_value_for_set (bson_cursor *c, bson_type type)
+{
+  if (bson_cursor_type (c) != type)
+    return NULL;
+
+  if (G_UNLIKELY (c->top->refs != NULL &&
+                  g_atomic_int_get (c->top->refs) > 1))
+    return NULL;
+
+  return (guint8 *)c->iter.data + c->iter.value_pos;
+}
+
+gboolean
+bson_cursor_set_int32 (bson_cursor *c, gint32 value)
+{
+  guint8 *d;
+
+  if (!(d = _bson_cursor_value_for_set (c, BSON_TYPE_INT32)))
+    return FALSE;
+
+  value = GINT32_TO_LE (value);
+  memcpy (d, &value, sizeof (gint32));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_set_int64 (bson_cursor *c, gint64 value)
+{
+  guint8 *d;
+
+  if (!(d = _bson_cursor_value_for_set (c, BSON_TYPE_INT64)))
+    return FALSE;
+
+  value = GINT64_TO_LE (value);
+  memcpy (d, &value, sizeof (gint64));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_set_double (bson_cursor *c, gdouble value)
+{
+  guint8 *d;
+
+  if (!(d = _bson_cursor_value_for_set (c, BSON_TYPE_DOUBLE)))
+    return FALSE;
+
+  value = GDOUBLE_TO_LE (value);
+  memcpy (d, &value, sizeof (gdouble));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_set_boolean (bson_cursor *c, gboolean value)
+{
+  guint8 *d;
+
+  if (!(d = _bson_cursor_value_for_set (c, BSON_TYPE_BOOLEAN)))
+    return FALSE;
+
+  d[0] = (value) ? 1 : 0;
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_set_utc_datetime (bson_cursor *c, gint64 value)
+{
+  guint8 *d;
+
+  if (!(d = _bson_cursor_value_for_set (c, BSON_TYPE_UTC_DATETIME)))
+    return FALSE;
+
+  value = GINT64_TO_LE (value);
+  memcpy (d, &value, sizeof (gint64));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_set_timestamp (bson_cursor *c, gint64 value)
+{
+  guint8 *d;
+
+  if (!(d = _bson_cursor_value_for_set (c, BSON_TYPE_TIMESTAMP)))
+    return FALSE;
+
+  value = GINT64_TO_LE (value);
+  memcpy (d, &value, sizeof (gint64));
+
+  return TRUE;
+}
+
+gboolean
+bson_cursor_set_oid (bson_cursor *c, const guint8 *oid)
+{
+  guint8 *d;
+
+  if (!oid)
+    return FALSE;
+  if (!(d = _bson_cursor_value_for_set (c, BSON_TYPE_OID)))
+    return FALSE;
+
+  memcpy (d, oid, 12);
+
+  return TRUE;
+}
+
+/*
+ * Visiting
+ */
+
+/** @internal Visit the elements of the document an iterator is on.
+ *
+ * @param i is the iterator, positioned before the first element.
+ * @param v is the visitor.
+ * @param flags is a combination of #bson_visit_flags.
+ * @param depth is the nesting depth of the document.
+ * @param user_data is passed to the callbacks.
+ *
+ * @returns TRUE if the whole document was visited, FALSE otherwise.
+ */
+static gboolean
+_bson_visit (bson_iter *i, const bson_visitor *v, gint flags, gint depth,
+             gpointer user_data)
+{
+  while (bson_iter_next (i))
+    {
+      const guint8 *d = i->data + i->value_pos;
+      bson_type type = bson_iter_type (i);
+      gboolean r = TRUE;
+
+      if (v->visit_before && !v->visit_before (i, depth, user_data))
+        return FALSE;
+
+      switch (type)
+        {
+        case BSON_TYPE_DOUBLE:
+          if (v->visit_double)
+            {
+              gdouble value;
+
+              bson_iter_get_double (i, &value);
+              r = v->visit_double (i, depth, value, user_data);
+            }
+          break;
+        case BSON_TYPE_STRING:
+          if (v->visit_string)
+            r = v->visit_string (i, depth,
+                                 (const gchar *)d + sizeof (gint32),
+                                 bson_stream_doc_size (d, 0) - 1,
+                                 user_data);
+          break;
+        case BSON_TYPE_DOCUMENT:
+        case BSON_TYPE_ARRAY:
+          {
+            bson_iter child;
+
+            if (!bson_iter_recurse (i, &child))
+              return FALSE;
+
+            if (type == BSON_TYPE_DOCUMENT && v->visit_document)
+              r = v->visit_document (i, depth, child.size, user_data);
+            else if (type == BSON_TYPE_ARRAY && v->visit_array)
+              r = v->visit_array (i, depth, child.size, user_data);
+            if (!r || !(flags & BSON_VISIT_RECURSE))
+              break;
+
+            if (depth >= BSON_VALIDATE_MAX_DEPTH ||
+                !_bson_visit (&child, v, flags, depth + 1, user_data))
+              return FALSE;
+
+            if (type == BSON_TYPE_DOCUMENT && v->visit_document_end)
+              r = v->visit_document_end (i, depth, user_data);
+            else if (type == BSON_TYPE_ARRAY && v->visit_array_end)
+              r = v->visit_array_end (i, depth, user_data);
+            break;
+          }
+        case BSON_TYPE_BINARY:
+          if (v->visit_binary)
+            r = v->visit_binary (i, depth, (bson_binary_subtype)d[4],
+                                 d + sizeof (gint32) + 1,
+                                 bson_stream_doc_size (d, 0), user_data);
+          break;
+        case BSON_TYPE_OID:
+          if (v->visit_oid)
+            r = v->visit_oid (i, depth, d, user_data);
+          break;
+        case BSON_TYPE_BOOLEAN:
+          if (v->visit_boolean)
+            r = v->visit_boolean (i, depth, (gboolean)d[0], user_data);
+          break;
+        case BSON_TYPE_UTC_DATETIME:
+          if (v->visit_utc_datetime)
+            {
+              gint64 value;
+
+              bson_iter_get_utc_datetime (i, &value);
+              r = v->visit_utc_datetime (i, depth, value, user_data);
+            }
+          break;
+        case BSON_TYPE_NULL:
+          if (v->visit_null)
+            r = v->visit_null (i, depth, user_data);
+          break;
+        case BSON_TYPE_REGEXP:
+          if (v->visit_regex)
+            r = v->visit_regex (i, depth, (const gchar *)d,
+                                (const gchar *)d + strlen ((gchar *)d) + 1,
+                                user_data);
+          break;
+        case BSON_TYPE_JS_CODE:
+          if (v->visit_javascript)
+            r = v->visit_javascript (i, depth,
+                                     (const gchar *)d + sizeof (gint32),
+                                     bson_stream_doc_size (d, 0) - 1,
+                                     user_data);
+          break;
+        case BSON_TYPE_SYMBOL:
+          if (v->visit_symbol)
+            r = v->visit_symbol (i, depth,
+                                 (const gchar *)d + sizeof (gint32),
+                                 bson_stream_doc_size (d, 0) - 1,
+                                 user_data);
+          break;
+        case BSON_TYPE_JS_CODE_W_SCOPE:
+          if (v->visit_javascript_w_scope)
+            {
+              bson_iter scope;
+              gint32 size, code_size;
+
+              size = bson_stream_doc_size (d, 0);
+              code_size = bson_stream_doc_size (d, sizeof (gint32));
+              if (code_size < 1 ||
+                  code_size > size - (gint32)sizeof (gint32) * 2)
+                return FALSE;
+
+              memset (&scope, 0, sizeof (scope));
+              scope.data = d + sizeof (gint32) * 2 + code_size;
+              scope.size = size - sizeof (gint32) * 2 - code_size;
+              if (scope.size < sizeof (gint32) + 1 ||
+                  (guint32)bson_stream_doc_size (scope.data, 0) !=
+                  scope.size)
+                return FALSE;
+
+              r = v->visit_javascript_w_scope
+                (i, depth, (const gchar *)d + sizeof (gint32) * 2,
+                 code_size - 1, &scope, user_data);
+            }
+          break;
+        case BSON_TYPE_INT32:
+          if (v->visit_int32)
+            {
+              gint32 value;
+
+              bson_iter_get_int32 (i, &value);
+              r = v->visit_int32 (i, depth, value, user_data);
+            }
+          break;
+        case BSON_TYPE_TIMESTAMP:
+          if (v->visit_timestamp)
+            {
+              gint64 value;
+
+              bson_iter_get_timestamp (i, &value);
+              r = v->visit_timestamp (i, depth, value, user_data);
+            }
+          break;
+        case BSON_TYPE_INT64:
+          if (v->visit_int64)
+            {
+              gint64 value;
+
+              bson_iter_get_int64 (i, &value);
+              r = v->visit_int64 (i, depth, value, user_data);
+            }
+          break;
+        default:
+          break;
+        }
+
+      if (!r)
+        return FALSE;
+      if (v->visit_after && !v->visit_after (i, depth, user_data))
+        return FALSE;
+    }
+
+  /* bson_iter_next() stops at the end of the document, as well as at
+     the first element it does not understand. */
+  return (i->pos == 0 ||
+          i->value_pos + _bson_get_block_size (bson_iter_type (i),
+                                               i->data + i->value_pos)
+          == i->size - 1);
+}
+
+gboolean
+bson_visit (const bson *b, const bson_visitor *visitor, gint flags,
+            gpointer user_data)
+{
+  bson_iter i;
+
+  if (!visitor || !bson_iter_init (&i, b))
+    return FALSE;
+
+  return _bson_visit (&i, visitor, flags, 0, user_data);
+}
+
+/*
+ * Splicing
+ */
+
+gboolean
+bson_append_element_from_cursor (bson *b, const gchar *name,
+                                 const bson_cursor *c)
+{
+  const guint8 *d;
+  bson_type type;
+  gint32 bs;
+
+  type = bson_cursor_type (c);
+  if (type == BSON_TYPE_NONE)
+    return FALSE;
+
+  d = c->iter.data;
+  bs = _bson_get_block_size (type, d + c->iter.value_pos);
+  if (bs < 0 || c->iter.value_pos + bs > (size_t)c->iter.size - 1)
+    return FALSE;
+
+  if (!name)
+    name = c->iter.key;
+
+  if (!_bson_append_element_header (b, type, name, -1))
+    return FALSE;
+  _bson_append_data (b, d + c->iter.value_pos, bs);
+
+  return TRUE;
+}
+
+/** @internal Append the elements of a BSON object to another.
+ *
+ * Walks the elements of @a src, and copies the ones selected by @a
+ * keys and @a exclude to @a dest. Consecutive selected elements are
+ * copied with a single memcpy().
+ *
+ * @param dest is the BSON object to append to.
+ * @param src is the finished BSON object to copy elements from.
+ * @param keys is the array of key names to select elements with, or
+ * NULL to select every element.
+ * @param n is the number of keys in @a keys.
+ * @param exclude selects whether @a keys lists the elements to skip.
+ *
+ * @returns TRUE on success, FALSE otherwise, in which case @a dest is
+ * left untouched.
+ */
+static gboolean
+_bson_splice (bson *dest, const bson *src, const gchar **keys, gint n,
+              gboolean exclude)
+{
+  const guint8 *d;
+  bson *target;
+  guint saved_len;
+  size_t pos, end, run_start = 0;
+  gint32 size;
+
+  if (!dest || dest->finished || dest->child)
+    return FALSE;
+  if ((size = bson_size (src)) == -1)
+    return FALSE;
+
+  d = bson_data (src);
+  end = size - 1;
+  target = (dest->root) ? dest->root : dest;
+  saved_len = target->len;
+
+  for (pos = sizeof (gint32); pos < end; )
+    {
+      const gchar *key = (const gchar *)(d + pos + 1);
+      const guint8 *k_end;
+      gboolean selected = TRUE;
+      gint32 bs;
+      gint i;
+
+      k_end = memchr (key, 0, end - pos - 1);
+      if (!k_end)
+        goto error;
+
+      if (keys)
+        {
+          for (i = 0; i < n; i++)
+            if (keys[i] && strcmp (keys[i], key) == 0)
+              break;
+          selected = (i < n) ^ exclude;
+        }
+
+      if (selected && !run_start)
+        run_start = pos;
+      else if (!selected && run_start)
+        {
+          _bson_append_data (dest, d + run_start, pos - run_start);
+          run_start = 0;
+        }
+
+      bs = _bson_get_block_size ((bson_type) d[pos], k_end + 1);
+      if (bs < 0)
+        goto error;
+      pos = (k_end + 1 - d) + bs;
+      if (pos > end)
+        goto error;
+    }
+
+  if (run_start)
+    _bson_append_data (dest, d + run_start, end - run_start);
+
+  return TRUE;
+
+ error:
+  target->len = saved_len;
+  return FALSE;
+}
+
+gboolean
+bson_copy_fields (bson *dest, const bson *src, const gchar **keys,
+                  gint n, gboolean exclude)
+{
+  if (!keys || n < 0)
+    return FALSE;
+
+  return _bson_splice (dest, src, keys, n, exclude);
+}
+
+gboolean
+bson_concat (bson *dest, const bson *src)
+{
+  return _bson_splice (dest, src, NULL, 0, FALSE);
+}
+
+/*
+ * Templates
+ */
+
+/** @internal The largest maximum length of string slots: the size
+ * of the largest document MongoDB accepts. */
+#define BSON_TEMPLATE_MAX_STRING (16 * 1024 * 1024)
+
+/** @internal BSON template slot.
+ */
+typedef struct
+{
+  bson_type type; /**< The type of the slot. */
+  guint32 pos; /**< The position of the value within the layout. */
+  gint32 max_len; /**< The maximum length of string slots. */
+  gint32 orig_len; /**< The length of the string in the layout. */
+  gint32 len; /**< The length of the current string value. */
+  gchar *value; /**< The current string value. */
+} bson_template_slot;
+
+/** @internal BSON template container.
+ *
+ * An embedded document (or the top-level object) that encloses at
+ * least one string slot, and as such, needs its length fixed up when
+ * rendering.
+ */
+typedef struct
+{
+  guint32 pos; /**< The position of the container within the layout. */
+  gint32 size; /**< The size of the container within the layout. */
+} bson_template_container;
+
+/** @internal BSON template structure.
+ */
+struct _bson_template
+{
+  bson *layout; /**< The layout, with fixed-width slots patched in
+                   place. */
+  bson_template_slot *slots; /**< The slots of the template. */
+  gint n_slots; /**< The number of slots. */
+  gint *strings; /**< Indexes of the string slots, in order of their
+                    position within the layout. */
+  gint n_strings; /**< The number of string slots. */
+  bson_template_container *containers; /**< Containers to fix up. */
+  gint n_containers; /**< The number of containers. */
+};
+
+bson_template *
+bson_template_new (const bson *b)
+{
+  bson_template *t;
+
+  if (!bson_validate (b, BSON_VALIDATE_NONE, BSON_VALIDATE_MAX_DEPTH))
+    return NULL;
+
+  t = g_new0 (bson_template, 1);
+  t->layout = bson_new_from_data (bson_data (b), bson_size (b) - 1);
+  bson_finish (t->layout);
+
+  return t;
+}
+
+void
+bson_template_free (bson_template *t)
+{
+  gint i;
+
+  if (!t)
+    return;
+
+  for (i = 0; i < t->n_slots; i++)
+    g_free (t->slots[i].value);
+  g_free (t->slots);
+  g_free (t->strings);
+  g_free (t->containers);
+  bson_free (t->layout);
+  g_free (t);
+}
+
+/** @internal Register a container that needs fixing up.
+ *
+ * @param t is the template to register the container in.
+ * @param pos is the position of the container.
+ * @param size is the size of the container.
+ */
+static void
+_bson_template_add_container (bson_template *t, guint32 pos, gint32 size)
+{
+  gint i;
+
+  for (i = 0; i < t->n_containers; i++)
+    if (t->containers[i].pos == pos)
+      return;
+
+  t->containers = g_renew (bson_template_container, t->containers,
+                           t->n_containers + 1);
+  t->containers[t->n_containers].pos = pos;
+  t->containers[t->n_containers].size = size;
+  t->n_containers++;
+}
+
+gint
+bson_template_add_slot (bson_template *t, const gchar *path, gint32 max_len)
+{
+  const guint8 *d;
+  const gchar *seg, *dot;
+  guint32 pos, end, doc_pos = 0, containers[BSON_VALIDATE_MAX_DEPTH + 1];
+  gint32 seg_len, l = 0;
+  gint depth = 0, i;
+  bson_template_slot *s;
+  bson_type type;
+
+  if (!t || !path)
+    return -1;
+
+  d = bson_data (t->layout);
+  end = bson_size (t->layout) - 1;
+  containers[depth++] = 0;
+
+  /* Descend the path, remembering the documents we pass through. */
+  for (seg = path; ; seg = dot + 1)
+    {
+      dot = strchr (seg, '.');
+      seg_len = (dot) ? dot - seg : (gint32) strlen (seg);
+      if (seg_len == 0)
+        return -1;
+
+      pos = _bson_find_segment (d, doc_pos + sizeof (gint32), end,
+                                seg, seg_len);
+      if (!pos)
+        return -1;
+      type = (bson_type) d[pos];
+      pos += seg_len + 2;
+      if (!dot)
+        break;
+
+      if (type != BSON_TYPE_DOCUMENT && type != BSON_TYPE_ARRAY)
+        return -1;
+      doc_pos = pos;
+      end = doc_pos + bson_stream_doc_size (d, doc_pos) - 1;
+      containers[depth++] = doc_pos;
+    }
+
+  for (i = 0; i < t->n_slots; i++)
+    if (t->slots[i].pos == pos)
+      return -1;
+
+  switch (type)
+    {
+    case BSON_TYPE_INT32:
+    case BSON_TYPE_INT64:
+    case BSON_TYPE_DOUBLE:
+    case BSON_TYPE_UTC_DATETIME:
+    case BSON_TYPE_TIMESTAMP:
+    case BSON_TYPE_OID:
+    case BSON_TYPE_BOOLEAN:
+      break;
+    case BSON_TYPE_STRING:
+      l = bson_stream_doc_size (d, pos) - 1;
+      if (max_len < 0 || max_len > BSON_TEMPLATE_MAX_STRING || l > max_len)
+        return -1;
+      break;
+    default:
+      return -1;
+    }
+
+  t->slots = g_renew (bson_template_slot, t->slots, t->n_slots + 1);
+  s = &t->slots[t->n_slots];
+  memset (s, 0, sizeof (bson_template_slot));
+  s->type = type;
+  s->pos = pos;
+
+  if (type == BSON_TYPE_STRING)
+    {
+      s->max_len = max_len;
+      s->orig_len = s->len = l;
+      s->value = g_malloc ((gsize) max_len + 1);
+      memcpy (s->value, d + pos + sizeof (gint32), l);
+
+      for (i = 0; i < depth; i++)
+        _bson_template_add_container (t, containers[i],
+                                      bson_stream_doc_size (d,
+                                                            containers[i]));
+
+      /* Keep the string slots ordered by their position. */
+      t->strings = g_renew (gint, t->strings, t->n_strings + 1);
+      for (i = t->n_strings;
+           i > 0 && t->slots[t->strings[i - 1]].pos > pos; i--)
+        t->strings[i] = t->strings[i - 1];
+      t->strings[i] = t->n_slots;
+      t->n_strings++;
+    }
+
+  return t->n_slots++;
+}
+
+/** @internal Patch a fixed-width slot of a template.
+ *
+ * @param t is the template to patch.
+ * @param slot is the slot to patch.
+ * @param type is the expected type of the slot.
+ * @param data is the new value, in little-endian byte order.
+ * @param size is the size of the value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static inline gboolean
+_bson_template_patch (bson_template *t, gint slot, bson_type type,
+                      const void *data, gsize size)
+{
+  if (!t || slot < 0 || slot >= t->n_slots || t->slots[slot].type != type)
+    return FALSE;
+
+  memcpy (t->layout->data + t->slots[slot].pos, data, size);
+  return TRUE;
+}
+
+gboolean
+bson_template_set_int32 (bson_template *t, gint slot, gint32 i)
+{
+  i = GINT32_TO_LE (i);
+  return _bson_template_patch (t, slot, BSON_TYPE_INT32, &i, sizeof (i));
+}
+
+gboolean
+bson_template_set_int64 (bson_template *t, gint slot, gint64 i)
+{
+  i = GINT64_TO_LE (i);
+  return _bson_template_patch (t, slot, BSON_TYPE_INT64, &i, sizeof (i));
+}
+
+gboolean
+bson_template_set_double (bson_template *t, gint slot, gdouble d)
+{
+  d = GDOUBLE_TO_LE (d);
+  return _bson_template_patch (t, slot, BSON_TYPE_DOUBLE, &d, sizeof (d));
+}
+
+gboolean
+bson_template_set_utc_datetime (bson_template *t, gint slot, gint64 ts)
+{
+  ts = GINT64_TO_LE (ts);
+  return _bson_template_patch (t, slot, BSON_TYPE_UTC_DATETIME,
+                               &ts, sizeof (ts));
+}
+
+gboolean
+bson_template_set_timestamp (bson_template *t, gint slot, gint64 ts)
+{
+  ts = GINT64_TO_LE (ts);
+  return _bson_template_patch (t, slot, BSON_TYPE_TIMESTAMP,
+                               &ts, sizeof (ts));
+}
+
+gboolean
+bson_template_set_oid (bson_template *t, gint slot, const guint8 *oid)
+{
+  if (!oid)
+    return FALSE;
+  return _bson_template_patch (t, slot, BSON_TYPE_OID, oid, 12);
+}
+
+gboolean
+bson_template_set_boolean (bson_template *t, gint slot, gboolean value)
+{
+  guint8 v = (guint8) value;
+
+  return _bson_template_patch (t, slot, BSON_TYPE_BOOLEAN, &v, 1);
+}
+
+gboolean
+bson_template_set_string (bson_template *t, gint slot, const gchar *val,
+                          gint32 length)
+{
+  bson_template_slot *s;
+
+  if (!t || slot < 0 || slot >= t->n_slots || !val || length < -1)
+    return FALSE;
+
+  s = &t->slots[slot];
+  if (s->type != BSON_TYPE_STRING)
+    return FALSE;
+
+  if (length == -1)
+    length = strlen (val);
+  if (length > s->max_len)
+    return FALSE;
+
+  memcpy (s->value, val, length);
+  s->len = length;
+  return TRUE;
+}
+
+gboolean
+bson_template_render (const bson_template *t, bson *dest)
+{
+  const guint8 *d;
+  guint32 pos = 0;
+  gint32 i, j, delta_before, delta_inside, size;
+  bson_template_slot *s;
+  bson_template_container *c;
+
+  if (!t || !dest || !bson_reset (dest))
+    return FALSE;
+
+  d = t->layout->data;
+  dest->len = 0;
+
+  if (t->n_strings == 0)
+    {
+      _bson_append_data (dest, d, t->layout->len);
+      dest->finished = TRUE;
+      return TRUE;
+    }
+
+  for (i = 0; i < t->n_strings; i++)
+    {
+      s = &t->slots[t->strings[i]];
+
+      _bson_append_data (dest, d + pos, s->pos - pos);
+      _bson_append_int32 (dest, GINT32_TO_LE (s->len + 1));
+      _bson_append_data (dest, (const guint8 *)s->value, s->len);
+      _bson_append_byte (dest, 0);
+
+      pos = s->pos + sizeof (gint32) + s->orig_len + 1;
+    }
+  _bson_append_data (dest, d + pos, t->layout->len - pos);
+
+  /* Fix up the lengths of every document that contains a string
+     slot, including the top-level one. */
+  for (i = 0; i < t->n_containers; i++)
+    {
+      c = &t->containers[i];
+      delta_before = delta_inside = 0;
+
+      for (j = 0; j < t->n_strings; j++)
+        {
+          s = &t->slots[t->strings[j]];
+          if (s->pos < c->pos)
+            delta_before += s->len - s->orig_len;
+          else if (s->pos < c->pos + c->size)
+            delta_inside += s->len - s->orig_len;
+        }
+
+      size = GINT32_TO_LE (c->size + delta_inside);
+      memcpy (dest->data + c->pos + delta_before, &size, sizeof (gint32));
+    }
+
+  dest->finished = TRUE;
+  return TRUE;
+}
+
+/** @internal Hash a block of memory.
+ *
+ * An implementation of MurmurHash64A, which processes the data eight
+ * bytes at a time.
+ *
+ * @param data is the data to hash.
+ * @param len is the length of @a data.
+ * @param seed is the seed of the hash.
+ *
+ * @returns The 64-bit hash of the data.
+ */
+static guint64
+_bson_hash_data (const guint8 *data, gsize len, guint64 seed)
+{
+  const guint64 m = G_GUINT64_CONSTANT (0xc6a4a7935bd1e995);
+  const guint8 *end = data + (len & ~(gsize)7);
+  guint64 h = seed ^ (len * m), k;
+
+  for (; data != end; data += sizeof (k))
+    {
+      memcpy (&k, data, sizeof (k));
+      k = GUINT64_FROM_LE (k) * m;
+      k ^= k >> 47;
+      h = (h ^ (k * m)) * m;
+    }
+
+  switch (len & 7)
+    {
+    case 7:
+      h ^= (guint64)data[6] << 48;
+      /* fall through */
+    case 6:
+      h ^= (guint64)data[5] << 40;
+      /* fall through */
+    case 5:
+      h ^= (guint64)data[4] << 32;
+      /* fall through */
+    case 4:
+      h ^= (guint64)data[3] << 24;
+      /* fall through */
+    case 3:
+      h ^= (guint64)data[2] << 16;
+      /* fall through */
+    case 2:
+      h ^= (guint64)data[1] << 8;
+      /* fall through */
+    case 1:
+      h = (h ^ data[0]) * m;
+    }
+
+  h ^= h >> 47;
+  h *= m;
+  h ^= h >> 47;
+  return h;
+}
+
+/** @internal Hash a document, ignoring the order of its keys.
+ *
+ * Every element is hashed separately, seeded with the hash of its
+ * type and key name, and the element hashes are summed. Embedded
+ * documents and arrays are hashed the same way, recursively: array
+ * elements keep their order through their index keys.
+ *
+ * @param d is the document to hash.
+ * @param seed is the seed of the hash.
+ *
+ * @returns The 64-bit hash of the document.
+ */
+static guint64
+_bson_hash_unordered (const guint8 *d, guint64 seed)
+{
+  gint32 size = bson_stream_doc_size (d, 0);
+  gint32 pos = sizeof (gint32), key_len, value_size;
+  guint64 h = 0, kh;
+  guint64 n = 0;
+  bson_type type;
+
+  while (pos < size - 1)
+    {
+      type = (bson_type)d[pos];
+      key_len = strlen ((const gchar *)d + pos + 1);
+      value_size = _bson_get_block_size (type, d + pos + key_len + 2);
+      if (value_size < 0)
+        break;
+
+      kh = _bson_hash_data (d + pos, key_len + 2, seed);
+      if (type == BSON_TYPE_DOCUMENT || type == BSON_TYPE_ARRAY)
+        h += _bson_hash_unordered (d + pos + key_len + 2, kh);
+      else
+        h += _bson_hash_data (d + pos + key_len + 2, value_size, kh);
+
+      pos += key_len + 2 + value_size;
+      n++;
+    }
+
+  h = GUINT64_TO_LE (h);
+  return _bson_hash_data ((const guint8 *)&h, sizeof (h), seed ^ n);
+}
+
+guint64
+bson_hash (const bson *b, gint flags)
+{
+  const guint8 *d = bson_data (b);
+
+  if (!d)
+    return 0;
+
+  if (flags & BSON_HASH_UNORDERED)
+    return _bson_hash_unordered (d, 0);
+  return _bson_hash_data (d, bson_size (b), 0);
+}
+
+guint
+bson_hash_func (gconstpointer b)
+{
+  guint64 h = bson_hash ((const bson *)b, BSON_HASH_DEFAULT);
+
+  return (guint)(h ^ (h >> 32));
+}
+
+gboolean
+bson_equal (const bson *a, const bson *b)
+{
+  if (!a || !b || !a->finished || !b->finished)
+    return FALSE;
+
+  return a->len == b->len && memcmp (a->data, b->data, a->len) == 0;
+}
+
+/** @internal Get the position of a type in MongoDB's sort order.
+ *
+ * @param type is the type whose position we seek.
+ *
+ * @returns The position of the type. Types that sort together share
+ * the same position.
+ */
+static gint
+_bson_type_order (bson_type type)
+{
+  switch (type)
+    {
+    case BSON_TYPE_MIN:
+      return -1;
+    case BSON_TYPE_UNDEFINED:
+      return 0;
+    case BSON_TYPE_NULL:
+      return 5;
+    case BSON_TYPE_DOUBLE:
+    case BSON_TYPE_INT32:
+    case BSON_TYPE_INT64:
+      return 10;
+    case BSON_TYPE_STRING:
+    case BSON_TYPE_SYMBOL:
+      return 15;
+    case BSON_TYPE_DOCUMENT:
+      return 20;
+    case BSON_TYPE_ARRAY:
+      return 25;
+    case BSON_TYPE_BINARY:
+      return 30;
+    case BSON_TYPE_OID:
+      return 35;
+    case BSON_TYPE_BOOLEAN:
+      return 40;
+    case BSON_TYPE_UTC_DATETIME:
+      return 45;
+    case BSON_TYPE_TIMESTAMP:
+      return 47;
+    case BSON_TYPE_REGEXP:
+      return 50;
+    case BSON_TYPE_DBPOINTER:
+      return 55;
+    case BSON_TYPE_JS_CODE:
+      return 60;
+    case BSON_TYPE_JS_CODE_W_SCOPE:
+      return 65;
+    case BSON_TYPE_MAX:
+      return 127;
+    case BSON_TYPE_NONE:
+    default:
+      return 0;
+    }
+}
+
+/** @internal Compare two values of the same C type.
+ */
+#define _BSON_CMP(a, b) (((a) > (b)) - ((a) < (b)))
+
+/** @internal Compare two doubles, with NaN sorting first.
+ *
+ * @param a is the first double.
+ * @param b is the second double.
+ *
+ * @returns -1, 0 or 1, depending on whether @a a is smaller, equal to
+ * or larger than @a b.
+ */
+static gint
+_bson_compare_doubles (gdouble a, gdouble b)
+{
+  if (isnan (a) || isnan (b))
+    return (isnan (b) ? 1 : 0) - (isnan (a) ? 1 : 0);
+  return _BSON_CMP (a, b);
+}
+
+/** @internal Compare a 64-bit integer and a double, exactly.
+ *
+ * @param i is the integer.
+ * @param d is the double.
+ *
+ * @returns -1, 0 or 1, depending on whether @a i is smaller, equal to
+ * or larger than @a d.
+ */
+static gint
+_bson_compare_int64_double (gint64 i, gdouble d)
+{
+  gint64 di;
+
+  if (isnan (d) || d < -9223372036854775808.0)
+    return 1;
+  if (d >= 9223372036854775808.0)
+    return -1;
+
+  /* Doubles in this range truncate to an integer exactly, and the
+     difference is their (exact) fractional part. */
+  di = (gint64)d;
+  if (i != di)
+    return _BSON_CMP (i, di);
+  return _BSON_CMP (0.0, d - (gdouble)di);
+}
+
+/** @internal Read a numeric BSON value.
+ *
+ * @param type is the type of the value.
+ * @param d is the start of the value.
+ * @param i is where integers will be stored.
+ * @param f is where doubles will be stored.
+ *
+ * @returns TRUE if the value is an integer, FALSE if it is a double.
+ */
+static gboolean
+_bson_number_value (bson_type type, const guint8 *d, gint64 *i, gdouble *f)
+{
+  gint32 i32;
+
+  switch (type)
+    {
+    case BSON_TYPE_INT32:
+      memcpy (&i32, d, sizeof (i32));
+      *i = GINT32_FROM_LE (i32);
+      return TRUE;
+    case BSON_TYPE_INT64:
+      memcpy (i, d, sizeof (*i));
+      *i = GINT64_FROM_LE (*i);
+      return TRUE;
+    default:
+      memcpy (f, d, sizeof (*f));
+      *f = GDOUBLE_FROM_LE (*f);
+      return FALSE;
+    }
+}
+
+/** @internal Compare two length-prefixed strings.
+ *
+ * @param a is the first string, starting with its length.
+ * @param b is the second string, starting with its length.
+ *
+ * @returns A negative, zero or positive number, like memcmp().
+ */
+static gint
+_bson_compare_strings (const guint8 *a, const guint8 *b)
+{
+  gint32 la = bson_stream_doc_size (a, 0) - 1;
+  gint32 lb = bson_stream_doc_size (b, 0) - 1;
+  gint r;
+
+  r = memcmp (a + sizeof (gint32), b + sizeof (gint32), MIN (la, lb));
+  if (r)
+    return r;
+  return _BSON_CMP (la, lb);
+}
+
+static gint _bson_compare_documents (const guint8 *a, const guint8 *b);
+
+/** @internal Compare two BSON values of the same sort order position.
+ *
+ * @param ta is the type of the first value.
+ * @param a is the start of the first value.
+ * @param tb is the type of the second value.
+ * @param b is the start of the second value.
+ *
+ * @returns A negative, zero or positive number, like memcmp().
+ */
+static gint
+_bson_compare_values (bson_type ta, const guint8 *a, bson_type tb,
+                      const guint8 *b)
+{
+  gint64 ia, ib;
+  gdouble fa, fb;
+  gboolean int_a, int_b;
+  gint32 la, lb;
+  gint r;
+
+  switch (ta)
+    {
+    case BSON_TYPE_DOUBLE:
+    case BSON_TYPE_INT32:
+    case BSON_TYPE_INT64:
+      int_a = _bson_number_value (ta, a, &ia, &fa);
+      int_b = _bson_number_value (tb, b, &ib, &fb);
+      if (int_a && int_b)
+        return _BSON_CMP (ia, ib);
+      if (!int_a && !int_b)
+        return _bson_compare_doubles (fa, fb);
+      if (int_a)
+        return _bson_compare_int64_double (ia, fb);
+      return -_bson_compare_int64_double (ib, fa);
+    case BSON_TYPE_STRING:
+    case BSON_TYPE_SYMBOL:
+    case BSON_TYPE_JS_CODE:
+      return _bson_compare_strings (a, b);
+    case BSON_TYPE_DOCUMENT:
+    case BSON_TYPE_ARRAY:
+      return _bson_compare_documents (a, b);
+    case BSON_TYPE_BINARY:
+      la = bson_stream_doc_size (a, 0);
+      lb = bson_stream_doc_size (b, 0);
+      if (la != lb)
+        return _BSON_CMP (la, lb);
+      if (a[sizeof (gint32)] != b[sizeof (gint32)])
+        return _BSON_CMP (a[sizeof (gint32)], b[sizeof (gint32)]);
+      return memcmp (a + sizeof (gint32) + 1, b + sizeof (gint32) + 1, la);
+    case BSON_TYPE_OID:
+      return memcmp (a, b, 12);
+    case BSON_TYPE_BOOLEAN:
+      return _BSON_CMP (a[0] != 0, b[0] != 0);
+    case BSON_TYPE_UTC_DATETIME:
+      memcpy (&ia, a, sizeof (ia));
+      memcpy (&ib, b, sizeof (ib));
+      return _BSON_CMP (GINT64_FROM_LE (ia), GINT64_FROM_LE (ib));
+    case BSON_TYPE_TIMESTAMP:
+      memcpy (&ia, a, sizeof (ia));
+      memcpy (&ib, b, sizeof (ib));
+      return _BSON_CMP ((guint64)GINT64_FROM_LE (ia),
+                        (guint64)GINT64_FROM_LE (ib));
+    case BSON_TYPE_REGEXP:
+      r = strcmp ((const gchar *)a, (const gchar *)b);
+      if (r)
+        return r;
+      return strcmp ((const gchar *)a + strlen ((const gchar *)a) + 1,
+                     (const gchar *)b + strlen ((const gchar *)b) + 1);
+    case BSON_TYPE_DBPOINTER:
+      r = _bson_compare_strings (a, b);
+      if (r)
+        return r;
+      return memcmp (a + sizeof (gint32) + bson_stream_doc_size (a, 0),
+                     b + sizeof (gint32) + bson_stream_doc_size (b, 0), 12);
+    case BSON_TYPE_JS_CODE_W_SCOPE:
+      r = _bson_compare_strings (a + sizeof (gint32), b + sizeof (gint32));
+      if (r)
+        return r;
+      return _bson_compare_documents
+        (a + sizeof (gint32) * 2 + bson_stream_doc_size (a, sizeof (gint32)),
+         b + sizeof (gint32) * 2 + bson_stream_doc_size (b, sizeof (gint32)));
+    default:
+      return 0;
+    }
+}
+
+/** @internal Compare two BSON documents.
+ *
+ * Once an element of a type without a known size is reached, the
+ * rest of the documents are compared byte by byte.
+ *
+ * @param a is the first document.
+ * @param b is the second document.
+ *
+ * @returns A negative, zero or positive number, like memcmp().
+ */
+static gint
+_bson_compare_documents (const guint8 *a, const guint8 *b)
+{
+  gint32 sa = bson_stream_doc_size (a, 0), sb = bson_stream_doc_size (b, 0);
+  gint32 pa = sizeof (gint32), pb = sizeof (gint32), la, lb, ba, bb;
+  bson_type ta, tb;
+  gint r;
+
+  for (;;)
+    {
+      if (pa >= sa - 1 || pb >= sb - 1)
+        return _BSON_CMP (pa < sa - 1, pb < sb - 1);
+
+      ta = (bson_type)a[pa];
+      tb = (bson_type)b[pb];
+      r = _BSON_CMP (_bson_type_order (ta), _bson_type_order (tb));
+      if (r)
+        return r;
+
+      r = strcmp ((const gchar *)a + pa + 1, (const gchar *)b + pb + 1);
+      if (r)
+        return r;
+
+      la = strlen ((const gchar *)a + pa + 1) + 2;
+      lb = strlen ((const gchar *)b + pb + 1) + 2;
+      ba = _bson_get_block_size (ta, a + pa + la);
+      bb = _bson_get_block_size (tb, b + pb + lb);
+      if (ba == -1 || bb == -1 || pa + la + ba > sa - 1 ||
+          pb + lb + bb > sb - 1)
+        {
+          r = memcmp (a + pa, b + pb, MIN (sa - pa, sb - pb));
+          if (r)
+            return r;
+          return _BSON_CMP (sa - pa, sb - pb);
+        }
+
+      r = _bson_compare_values (ta, a + pa + la, tb, b + pb + lb);
+      if (r)
+        return r;
+
+      pa += la + ba;
+      pb += lb + bb;
+    }
+}
+
+gint
+bson_compare (const bson *a, const bson *b)
+{
+  const guint8 *da = bson_data (a), *db = bson_data (b);
+
+  if (!da || !db)
+    return (da != NULL) - (db != NULL);
+
+  return _bson_compare_documents (da, db);
+}
+
+/** @internal A column of a columnar decoder.
+ */
+typedef struct
+{
+  gchar *path; /**< The name of the field, or a dotted path. */
+  gint32 len; /**< The length of @a path. */
+  gboolean dotted; /**< Whether @a path has more than one segment. */
+  bson_type type; /**< The type of the column. */
+  gsize width; /**< The size of a single value. */
+  guint8 *values; /**< The values of the column. */
+  guint8 *validity; /**< The validity bitmap of the column. */
+} bson_columns_column;
+
+/** @internal Columnar decoder object.
+ */
+struct _bson_columns
+{
+  bson_columns_column *columns; /**< The columns. */
+  gint n_columns; /**< The number of columns. */
+  gint64 rows; /**< The number of rows decoded. */
+  gint64 alloc; /**< The number of rows memory is allocated for. */
+};
+
+bson_columns *
+bson_columns_new (void)
+{
+  return g_new0 (bson_columns, 1);
+}
+
+gint
+bson_columns_add (bson_columns *cols, const gchar *path, bson_type type)
+{
+  bson_columns_column *col;
+  gsize width;
+
+  if (!cols || !path || !*path || cols->rows)
+    return -1;
+
+  switch (type)
+    {
+    case BSON_TYPE_INT32:
+      width = sizeof (gint32);
+      break;
+    case BSON_TYPE_INT64:
+    case BSON_TYPE_UTC_DATETIME:
+    case BSON_TYPE_TIMESTAMP:
+      width = sizeof (gint64);
+      break;
+    case BSON_TYPE_DOUBLE:
+      width = sizeof (gdouble);
+      break;
+    case BSON_TYPE_BOOLEAN:
+      width = sizeof (guint8);
+      break;
+    default:
+      return -1;
+    }
+
+  cols->columns = g_renew (bson_columns_column, cols->columns,
+                           cols->n_columns + 1);
+  col = &cols->columns[cols->n_columns];
+  memset (col, 0, sizeof (*col));
+  col->path = g_strdup (path);
+  col->len = strlen (path);
+  col->dotted = (strchr (path, '.') != NULL);
+  col->type = type;
+  col->width = width;
+
+  if (cols->alloc)
+    {
+      col->values = (guint8 *)g_malloc0 (cols->alloc * width);
+      col->validity = (guint8 *)g_malloc0 ((cols->alloc + 7) / 8);
+    }
+
+  return cols->n_columns++;
+}
+
+/** @internal Make room for one more row in a columnar decoder.
+ *
+ * @param cols is the decoder to grow.
+ */
+static void
+_bson_columns_grow (bson_columns *cols)
+{
+  gint64 alloc;
+  gint i;
+
+  if (cols->rows < cols->alloc)
+    return;
+
+  alloc = MAX (cols->alloc * 2, 64);
+  for (i = 0; i < cols->n_columns; i++)
+    {
+      bson_columns_column *col = &cols->columns[i];
+
+      col->values = (guint8 *)g_realloc (col->values, alloc * col->width);
+      col->validity = (guint8 *)g_realloc (col->validity, (alloc + 7) / 8);
+      memset (col->validity + (cols->alloc + 7) / 8, 0,
+              (alloc + 7) / 8 - (cols->alloc + 7) / 8);
+    }
+  cols->alloc = alloc;
+}
+
+/** @internal Find the field of a column within a document.
+ *
+ * Single segment paths are searched for starting right after the
+ * element the previous column was found at, wrapping over, as
+ * columns are usually added in the order their fields appear in the
+ * documents.
+ *
+ * @param col is the column whose field to find.
+ * @param d is the document to search in.
+ * @param size is the size of the document.
+ * @param next is the position following the element the previous
+ * column was found at, updated when a single segment path is found.
+ *
+ * @returns The position of the element, or zero if not found, or if
+ * its value does not fit within the document.
+ */
+static size_t
+_bson_columns_locate (bson_columns_column *col, const guint8 *d,
+                      gint32 size, size_t *next)
+{
+  const gchar *seg = col->path, *dot;
+  size_t pos, start = sizeof (gint32), end = size - 1;
+  gint32 seg_len, doc_size, bs;
+
+  if (!col->dotted)
+    {
+      pos = _bson_find_segment (d, *next, end, col->path, col->len);
+      if (!pos && *next > start)
+        pos = _bson_find_segment (d, start, *next, col->path, col->len);
+      if (!pos)
+        return 0;
+
+      bs = _bson_get_block_size ((bson_type) d[pos], &d[pos + col->len + 2]);
+      if (bs == -1 || pos + col->len + 2 + bs > end)
+        return 0;
+      *next = pos + col->len + 2 + bs;
+      return pos;
+    }
+
+  for (;;)
+    {
+      dot = strchr (seg, '.');
+      seg_len = (dot) ? dot - seg : (gint32) strlen (seg);
+      if (seg_len == 0)
+        return 0;
+
+      pos = _bson_find_segment (d, start, end, seg, seg_len);
+      if (!pos)
+        return 0;
+      if (!dot)
+        {
+          bs = _bson_get_block_size ((bson_type) d[pos],
+                                     &d[pos + seg_len + 2]);
+          if (bs == -1 || pos + seg_len + 2 + bs > end)
+            return 0;
+          return pos;
+        }
+
+      if (d[pos] != BSON_TYPE_DOCUMENT && d[pos] != BSON_TYPE_ARRAY)
+        return 0;
+      doc_size = bson_stream_doc_size (d, pos + seg_len + 2);
+      if (doc_size < 5 || pos + seg_len + 2 + doc_size > end)
+        return 0;
+      start = pos + seg_len + 2 + sizeof (gint32);
+      end = pos + seg_len + 2 + doc_size - 1;
+      seg = dot + 1;
+    }
+}
+
+/** @internal Store a value in a column.
+ *
+ * @param col is the column to store the value in.
+ * @param row is the row to store the value in.
+ * @param type is the type of the BSON value.
+ * @param d is the start of the BSON value.
+ *
+ * @returns TRUE if the value was stored, FALSE if its type is not
+ * compatible with the column.
+ */
+static gboolean
+_bson_columns_store (bson_columns_column *col, gint64 row, bson_type type,
+                     const guint8 *d)
+{
+  guint8 *dest = col->values + row * col->width;
+  gint32 i32;
+  gint64 i64;
+  gdouble f;
+
+  switch (col->type)
+    {
+    case BSON_TYPE_INT32:
+      if (type != BSON_TYPE_INT32)
+        return FALSE;
+      memcpy (&i32, d, sizeof (i32));
+      i32 = GINT32_FROM_LE (i32);
+      memcpy (dest, &i32, sizeof (i32));
+      return TRUE;
+    case BSON_TYPE_INT64:
+      if (type != BSON_TYPE_INT32 && type != BSON_TYPE_INT64)
+        return FALSE;
+      _bson_number_value (type, d, &i64, &f);
+      memcpy (dest, &i64, sizeof (i64));
+      return TRUE;
+    case BSON_TYPE_DOUBLE:
+      if (type != BSON_TYPE_INT32 && type != BSON_TYPE_INT64 &&
+          type != BSON_TYPE_DOUBLE)
+        return FALSE;
+      if (_bson_number_value (type, d, &i64, &f))
+        f = (gdouble)i64;
+      memcpy (dest, &f, sizeof (f));
+      return TRUE;
+    case BSON_TYPE_UTC_DATETIME:
+    case BSON_TYPE_TIMESTAMP:
+      if (type != col->type)
+        return FALSE;
+      memcpy (&i64, d, sizeof (i64));
+      i64 = GINT64_FROM_LE (i64);
+      memcpy (dest, &i64, sizeof (i64));
+      return TRUE;
+    case BSON_TYPE_BOOLEAN:
+      if (type != BSON_TYPE_BOOLEAN)
+        return FALSE;
+      *dest = (d[0] != 0);
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+/** @internal Decode a document into a new row.
+ *
+ * @param cols is the decoder to append to.
+ * @param d is the document to decode.
+ * @param size is the size of the document.
+ */
+static void
+_bson_columns_append (bson_columns *cols, const guint8 *d, gint32 size)
+{
+  gint64 row;
+  size_t pos, next = sizeof (gint32);
+  gint i;
+
+  _bson_columns_grow (cols);
+  row = cols->rows++;
+
+  for (i = 0; i < cols->n_columns; i++)
+    {
+      bson_columns_column *col = &cols->columns[i];
+      guint8 bit = 1 << (row % 8);
+
+      pos = _bson_columns_locate (col, d, size, &next);
+      if (pos &&
+          _bson_columns_store (col, row, (bson_type)d[pos],
+                               d + pos + strlen ((const gchar *)d + pos + 1)
+                               + 2))
+        col->validity[row / 8] |= bit;
+      else
+        {
+          memset (col->values + row * col->width, 0, col->width);
+          col->validity[row / 8] &= ~bit;
+        }
+    }
+}
+
+gboolean
+bson_columns_append (bson_columns *cols, const guint8 *data, gint32 size)
+{
+  if (!cols || !data || size < 5 || bson_stream_doc_size (data, 0) != size ||
+      data[size - 1] != 0)
+    return FALSE;
+
+  _bson_columns_append (cols, data, size);
+  return TRUE;
+}
+
+gint32
+bson_columns_append_stream (bson_columns *cols, const guint8 *data,
+                            gint32 size)
+{
+  gint64 rows;
+  gint32 pos = 0, doc_size, n = 0;
+
+  if (!cols || (!data && size) || size < 0)
+    return -1;
+
+  rows = cols->rows;
+  while (pos < size)
+    {
+      if (size - pos < 5 ||
+          (doc_size = bson_stream_doc_size (data, pos)) < 5 ||
+          doc_size > size - pos || data[pos + doc_size - 1] != 0)
+        {
+          cols->rows = rows;
+          return -1;
+        }
+
+      _bson_columns_append (cols, data + pos, doc_size);
+      pos += doc_size;
+      n++;
+    }
+
+  return n;
+}
+
+gint64
+bson_columns_rows (const bson_columns *cols)
+{
+  if (!cols)
+    return -1;
+  return cols->rows;
+}
+
+gconstpointer
+bson_columns_values (const bson_columns *cols, gint column)
+{
+  if (!cols || column < 0 || column >= cols->n_columns || !cols->rows)
+    return NULL;
+  return cols->columns[column].values;
+}
+
+const guint8 *
+bson_columns_validity (const bson_columns *cols, gint column)
+{
+  if (!cols || column < 0 || column >= cols->n_columns || !cols->rows)
+    return NULL;
+  return cols->columns[column].validity;
+}
+
+gboolean
+bson_columns_reset (bson_columns *cols)
+{
+  if (!cols)
+    return FALSE;
+
+  cols->rows = 0;
+  return TRUE;
+}
+
+void
+bson_columns_free (bson_columns *cols)
+{
+  gint i;
+
+  if (!cols)
+    return;
+
+  for (i = 0; i < cols->n_columns; i++)
+    {
+      g_free (cols->columns[i].path);
+      g_free (cols->columns[i].values);
+      g_free (cols->columns[i].validity);
+    }
+  g_free (cols->columns);
+  g_free (cols);
 }
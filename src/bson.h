@@ -58,6 +58,13 @@ typedef struct _bson bson;
  */
 typedef struct _bson_cursor bson_cursor;
 
+/** Opaque BSON arena.
+ * An arena is a bump allocator, that BSON objects can be built
+ * in. Objects allocated from an arena share its memory, and are all
+ * released at once, when the arena is reset or freed.
+ */
+typedef struct _bson_arena bson_arena;
+
 /** Supported BSON object types.
  */
 typedef enum
@@ -114,6 +121,36 @@ typedef enum
                                                the structure. */
   } bson_binary_subtype;
 
+/** BSON validation flags.
+ *
+ * These flags can be combined to make bson_validate() stricter than
+ * its default structural checks.
+ */
+typedef enum
+  {
+    BSON_VALIDATE_NONE = 0, /**< Structural checks only. */
+    BSON_VALIDATE_UTF8 = 1 << 0, /**< Keys and string values must be
+                                    valid UTF-8. */
+    BSON_VALIDATE_NO_DEPRECATED = 1 << 1, /**< Reject deprecated
+                                             element types. */
+    BSON_VALIDATE_STRICT = 1 << 2 /**< Booleans must be 0 or 1, and
+                                     array keys must be consecutive
+                                     indexes, starting from zero. */
+  } bson_validate_flags;
+
+/** The default maximum nesting depth for bson_validate(). */
+#define BSON_VALIDATE_MAX_DEPTH 100
+
+/** BSON hashing flags.
+ */
+typedef enum
+  {
+    BSON_HASH_DEFAULT = 0, /**< Hash the raw bytes of the object. */
+    BSON_HASH_UNORDERED = 1 << 0 /**< Ignore the order of keys within
+                                    documents, including embedded
+                                    ones. */
+  } bson_hash_flags;
+
 /** @} */
 
 /** @defgroup bson_object_access Object Access
@@ -173,6 +210,102 @@ bson *bson_new_sized (gint32 size);
  */
 bson *bson_new_from_data (const guint8 *data, gint32 size);
 
+/** Create a read-only BSON object view over existing data.
+ *
+ * Unlike bson_new_from_data(), this function does not copy @a data:
+ * the returned object points directly into it. This is useful when
+ * the data lives in memory the caller manages anyway, such as a reply
+ * packet, a memory mapped file, or a shared buffer.
+ *
+ * The returned object is finished, and can be read from and iterated
+ * over like any other finished object, but it cannot be reset or
+ * appended to.
+ *
+ * @param data is the BSON document to create a view for.
+ * @param size is the full size of the document, including the
+ * trailing zero byte.
+ *
+ * @note @a data must remain valid, and must not be modified, for as
+ * long as the view is in use. Freeing the view with bson_free() does
+ * not free @a data.
+ *
+ * @returns A newly allocated, finished object pointing into @a data,
+ * or NULL on error.
+ */
+bson *bson_new_view (const guint8 *data, gint32 size);
+
+/** Create a new BSON arena.
+ *
+ * Arenas are useful when a large number of short-lived BSON objects
+ * need to be built, for example when preparing a batch of documents
+ * for insertion: instead of allocating and freeing each object
+ * separately, they can all be built in the arena, and released in
+ * one go with bson_arena_reset() or bson_arena_free().
+ *
+ * @param chunk_size is the size of the memory chunks the arena will
+ * allocate. Objects larger than this will get a chunk of their own.
+ *
+ * @returns A newly allocated arena, or NULL on error.
+ */
+bson_arena *bson_arena_new (gint32 chunk_size);
+
+/** Reset a BSON arena.
+ *
+ * Releases every object built in the arena at once, while keeping the
+ * memory allocated by the arena around for reuse.
+ *
+ * @param arena is the arena to reset.
+ *
+ * @note Objects built in the arena must not be used after the arena
+ * was reset.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_arena_reset (bson_arena *arena);
+
+/** Free a BSON arena.
+ *
+ * Frees up all memory associated with the arena, including all the
+ * objects built in it.
+ *
+ * @param arena is the arena to free.
+ */
+void bson_arena_free (bson_arena *arena);
+
+/** Create a new BSON object within an arena.
+ *
+ * Works like bson_new_sized(), but both the object and its data are
+ * allocated from @a arena, and growing the object does not involve
+ * the system allocator as long as the arena has room.
+ *
+ * @param arena is the arena to allocate the object from.
+ * @param size is the space to pre-allocate for data.
+ *
+ * @note Calling bson_free() on an object built in an arena is
+ * allowed, but it does nothing: its memory is only released when the
+ * arena is reset or freed.
+ *
+ * @returns A newly allocated object, or NULL on error.
+ */
+bson *bson_new_in_arena (bson_arena *arena, gint32 size);
+
+/** Create a new BSON object, recycling a pooled one if possible.
+ *
+ * Works like bson_new(), but first tries to take an object off the
+ * calling thread's pool, which is filled by bson_release(). Objects
+ * taken from the pool keep the buffer they had grown to, so encoding
+ * loops that create and release objects of similar size stop
+ * allocating memory once the pool is warm.
+ *
+ * @note Pooling needs compiler support for thread-local storage. When
+ * that is not available, this function is the same as bson_new().
+ *
+ * @returns A new, empty BSON object. It is the responsibility of the
+ * caller to release it with bson_release() or bson_free() once it is
+ * not used anymore.
+ */
+bson *bson_new_pooled (void);
+
 /** Build a BSON object in one go, with full control.
  *
  * This function can be used to build a BSON object in one simple
@@ -195,6 +328,10 @@ bson *bson_new_from_data (const guint8 *data, gint32 size);
  * name and @a free_after parameters are not needed for the closing
  * entry.
  *
+ * The size of the resulting object is computed from the argument list
+ * before anything is added, so it is allocated once, with exactly
+ * the size it will have once finished.
+ *
  * @param type is the element type we'll be adding.
  * @param name is the key name.
  * @param free_after determines whether the original variable will be
@@ -241,21 +378,107 @@ gboolean bson_finish (bson *b);
  * size to zero. Resetting is most useful when wants to keep the
  * already allocated memory around for reuse.
  *
+ * @note Views created with bson_new_view() cannot be reset.
+ *
  * @param b is the BSON object to reset.
  *
  * @returns TRUE on success, FALSE otherwise.
  */
 gboolean bson_reset (bson *b);
 
+/** Toggle the key index of a BSON object.
+ *
+ * When enabled, the first key lookup (bson_find(),
+ * bson_cursor_find() or bson_cursor_find_next()) on the finished
+ * object builds an index of its keys, and all further lookups use
+ * that, instead of scanning the whole object. This is worth it for
+ * wide documents, where many keys are looked up.
+ *
+ * The index is dropped when the object is reset or freed.
+ *
+ * @param b is the BSON object to toggle the index of.
+ * @param enable toggles whether the index should be used.
+ *
+ * @note Building the index modifies the object, even though lookups
+ * take a constant object. Lookups on an indexed object must not run
+ * concurrently from multiple threads until the index has been built.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_set_key_index (bson *b, gboolean enable);
+
 /** Free the memory associated with a BSON object.
  *
  * Frees up all memory associated with a BSON object. The variable
  * shall not be used afterwards.
  *
+ * If the data of the object is shared with others (see bson_ref()),
+ * only the object itself is freed, and the data stays with the rest.
+ *
  * @param b is the BSON object to free.
  */
 void bson_free (bson *b);
 
+/** Create a new reference to a BSON object.
+ *
+ * The new reference is a separate object, sharing the data of @a b
+ * instead of copying it. The data is reference counted atomically,
+ * so references can be handed out to, and freed by, different
+ * threads, as long as each object is used by one thread at a time.
+ *
+ * Shared data is never modified: appending to, finishing, or resetting
+ * any of the objects sharing it gives that object its own copy of the
+ * data first (copy-on-write), and the others are not affected. The
+ * in-place setters (bson_cursor_set_int32() and friends) can not copy
+ * the data from under other cursors, so they fail on cursors created
+ * for any of the objects while the data is shared, including cursors
+ * opened on their embedded documents.
+ *
+ * References to views share the borrowed data, which must outlive
+ * all of them, just like it must outlive the view itself.
+ *
+ * @param b is the BSON object to reference. It can be open or
+ * finished, but not allocated from an arena, nor an embedded
+ * document built in place, nor have one of those open.
+ *
+ * @returns A new object sharing the data of @a b, or NULL on
+ * error. It must be freed with bson_unref() or bson_free().
+ */
+bson *bson_ref (bson *b);
+
+/** Drop a reference to a BSON object.
+ *
+ * Frees the object, and its data too, unless the data is still
+ * shared by other references. This is the same as bson_free().
+ *
+ * @param b is the BSON object to drop.
+ */
+void bson_unref (bson *b);
+
+/** Release a BSON object into the calling thread's pool.
+ *
+ * Resets the object with bson_reset() and puts it into the pool of
+ * the calling thread, for bson_new_pooled() to hand out again. The
+ * pool is capped both in the number of objects it holds and in the
+ * size of their buffers; objects that do not fit, along with views,
+ * embedded documents and objects built in an arena, are passed to
+ * bson_free() instead.
+ *
+ * Any object, pooled or not, may be released this way, from any
+ * thread. The variable shall not be used afterwards.
+ *
+ * @param b is the BSON object to release.
+ */
+void bson_release (bson *b);
+
+/** Free the calling thread's BSON object pool.
+ *
+ * Frees every object held in the pool of the calling thread. Threads
+ * that used bson_release() should call this before they exit, as the
+ * pool is not freed automatically.
+ */
+void bson_pool_flush (void);
+
 /** Return the size of a finished BSON object.
  *
  * @param b is the finished BSON object.
@@ -300,6 +523,46 @@ const guint8 *bson_data (const bson *b);
 gboolean bson_validate_key (const gchar *key, gboolean forbid_dots,
                             gboolean no_dollar);
 
+/** Validate a BSON object.
+ *
+ * Walks the whole object, verifying that all lengths are within
+ * bounds and consistent, all strings and documents are properly
+ * terminated, every element is of a known type, and that embedded
+ * documents are not nested deeper than allowed. Further checks can
+ * be enabled with @a flags.
+ *
+ * Once an object passed validation, it is safe to walk it with a
+ * cursor.
+ *
+ * @param b is the BSON object to validate.
+ * @param flags is a combination of #bson_validate_flags.
+ * @param max_depth is the maximum nesting depth allowed, where the
+ * top-level object is at depth zero. #BSON_VALIDATE_MAX_DEPTH is a
+ * sensible default.
+ *
+ * @returns TRUE if the object is valid, FALSE otherwise. If the
+ * arguments were invalid (including an unfinished object), errno
+ * will be set to EINVAL, otherwise it will be set to zero.
+ */
+gboolean bson_validate (const bson *b, gint flags, gint max_depth);
+
+/** Validate a BSON document in a raw byte stream.
+ *
+ * Same as bson_validate(), but works on raw data, without the need
+ * to create a BSON object first.
+ *
+ * @param data is the start of the document.
+ * @param size is the number of bytes available at @a data. It must
+ * match the size recorded in the document itself.
+ * @param flags is a combination of #bson_validate_flags.
+ * @param max_depth is the maximum nesting depth allowed.
+ *
+ * @returns TRUE if the document is valid, FALSE otherwise, with
+ * errno set the same way as bson_validate() does.
+ */
+gboolean bson_validate_data (const guint8 *data, gint32 size,
+                             gint flags, gint max_depth);
+
 /** Reads out the 32-bit documents size from a BSON bytestream.
  *
  * This function can be used when reading data from a stream, and one
@@ -394,6 +657,67 @@ gboolean bson_append_document (bson *b, const gchar *name, const bson *doc);
  */
 gboolean bson_append_array (bson *b, const gchar *name, const bson *array);
 
+/** Start building an embedded document in place.
+ *
+ * Instead of building a separate object and copying it over with
+ * bson_append_document(), this function opens an embedded document
+ * within @a b, and returns a handle to it in @a child. Everything
+ * appended to @a child is written directly into the buffer of @a b,
+ * and the document's length is filled in by
+ * bson_append_document_end().
+ *
+ * While the child is open, @a b itself cannot be appended to or
+ * finished. Children can have children of their own, to any depth.
+ *
+ * @param b is the BSON object to append to.
+ * @param name is the key name.
+ * @param child is a pointer to a variable where the handle of the
+ * embedded document will be stored.
+ *
+ * @note The @a child handle is owned by @a b: it must not be
+ * finished, reset or freed, only closed with
+ * bson_append_document_end(), after which it is not valid anymore.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_append_document_begin (bson *b, const gchar *name,
+                                     bson **child);
+
+/** Finish an embedded document built in place.
+ *
+ * @param b is the BSON object the document was opened in.
+ * @param child is the handle returned by
+ * bson_append_document_begin().
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_append_document_end (bson *b, bson *child);
+
+/** Start building an embedded array in place.
+ *
+ * Works the same way as bson_append_document_begin(), but opens an
+ * array. Just like with bson_append_array(), it is the caller's
+ * responsibility to use increasing numbers as keys.
+ *
+ * @param b is the BSON object to append to.
+ * @param name is the key name.
+ * @param child is a pointer to a variable where the handle of the
+ * embedded array will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_append_array_begin (bson *b, const gchar *name,
+                                  bson **child);
+
+/** Finish an embedded array built in place.
+ *
+ * @param b is the BSON object the array was opened in.
+ * @param child is the handle returned by bson_append_array_begin().
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_append_array_end (bson *b, bson *child);
+
 /** Append a BSON binary blob to a BSON object.
  *
  * @param b is the BSON object to append to.
@@ -544,6 +868,59 @@ gboolean bson_append_timestamp (bson *b, const gchar *name, gint64 ts);
  */
 gboolean bson_append_int64 (bson *b, const gchar *name, gint64 i);
 
+/** Append the element a cursor points at to a BSON object.
+ *
+ * Copies the element as-is, without decoding and re-encoding its
+ * value, which makes it considerably cheaper than retrieving the
+ * value and appending it with the appropriate typed function.
+ *
+ * @param b is the BSON object to append to.
+ * @param name is the key name to use, or NULL to keep the name of the
+ * original element.
+ * @param c is the cursor pointing at the element to copy.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_append_element_from_cursor (bson *b, const gchar *name,
+                                          const bson_cursor *c);
+
+/** Copy a subset of the elements of a BSON object to another.
+ *
+ * Appends the top-level elements of @a src whose key is (or, if @a
+ * exclude is set, is not) one of @a keys to @a dest, in the order
+ * they appear in @a src. The elements are copied as-is, like with
+ * bson_append_element_from_cursor().
+ *
+ * @param dest is the BSON object to append to.
+ * @param src is the finished BSON object to copy elements from.
+ * @param keys is the array of key names to copy or to skip.
+ * @param n is the number of keys in @a keys.
+ * @param exclude selects whether @a keys lists the elements to skip,
+ * rather than the ones to copy.
+ *
+ * @note If @a src turns out to be malformed, @a dest is left as it
+ * was before the call.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_copy_fields (bson *dest, const bson *src, const gchar **keys,
+                           gint n, gboolean exclude);
+
+/** Append every element of a BSON object to another.
+ *
+ * Copies all the elements of @a src to the end of @a dest in one go,
+ * without decoding them.
+ *
+ * @param dest is the BSON object to append to.
+ * @param src is the finished BSON object to copy the elements of.
+ *
+ * @note No attempt is made to detect keys present in both objects:
+ * in that case @a dest will end up with duplicate keys.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_concat (bson *dest, const bson *src);
+
 /** @} */
 
 /** @defgroup bson_cursor Cursor & Retrieval
@@ -589,6 +966,67 @@ bson_cursor *bson_cursor_new (const bson *b);
  */
 bson_cursor *bson_find (const bson *b, const gchar *name);
 
+/** Find a key by its dotted path, descending into embedded documents.
+ *
+ * Each segment of @a path, separated by dots, names a key within the
+ * document the previous segment pointed to. Arrays are descended into
+ * the same way, using their numeric indexes as segments (for example,
+ * "doc.list.2.name"). Embedded documents are not copied: the returned
+ * cursor points into the data of @a b.
+ *
+ * @param b is the BSON object to search in.
+ * @param path is the dotted path of the key to find.
+ *
+ * @returns A cursor pointing at the leaf element, or NULL if the path
+ * was not found. The cursor must be freed with bson_cursor_free(),
+ * before @a b is freed or modified.
+ *
+ * @note Moving the returned cursor with bson_cursor_next() or
+ * bson_cursor_find() will move it within the innermost document only.
+ */
+bson_cursor *bson_find_path (const bson *b, const gchar *path);
+
+/** Create a new cursor on an embedded document or array.
+ *
+ * Creates a new cursor, positioned to the beginning of the document
+ * or array the cursor @a c points at. The embedded document is not
+ * copied, the new cursor iterates over it in place.
+ *
+ * @param c is the cursor pointing at a document or array element.
+ *
+ * @note The object @a c is a cursor for must not be freed or
+ * modified while the new cursor is in use.
+ *
+ * @returns A newly allocated cursor, or NULL on error.
+ */
+bson_cursor *bson_cursor_new_child (const bson_cursor *c);
+
+/** Find multiple keys in a BSON object in one go.
+ *
+ * Scans the BSON object once, and creates a cursor for each of the
+ * requested keys, positioned at the first element with that
+ * name. This is considerably cheaper than calling bson_find() for
+ * every key, when more than a few keys are needed from the same
+ * object.
+ *
+ * @param b is the BSON object to extract the keys from.
+ * @param keys is the array of key names to find.
+ * @param types is an optional array of the expected types of the
+ * keys. Keys whose type does not match are treated as missing. Use
+ * #BSON_TYPE_NONE for keys of any type, or pass NULL to accept any
+ * type for all keys.
+ * @param n is the number of keys in @a keys (and @a types).
+ * @param dest is an array of @a n cursors, where the results will be
+ * stored. Elements for keys that were not found are set to NULL.
+ *
+ * @note Each cursor in @a dest is newly allocated, it is the
+ * responsibility of the caller to free them.
+ *
+ * @returns The number of keys found, or -1 on error.
+ */
+gint bson_extract (const bson *b, const gchar **keys,
+                   const bson_type *types, gint n, bson_cursor **dest);
+
 /** Delete a cursor, and free up all resources used by it.
  *
  * @param c is the cursor to free.
@@ -629,6 +1067,23 @@ gboolean bson_cursor_find_next (bson_cursor *c, const gchar *name);
  */
 gboolean bson_cursor_find (bson_cursor *c, const gchar *name);
 
+/** Move the cursor to a given dotted path.
+ *
+ * Like bson_cursor_find(), the first segment of @a path is searched
+ * for starting at the current position, wrapping over if need be.
+ * The rest of the segments are looked up within the embedded
+ * documents (or arrays) the previous segments point to, as with
+ * bson_find_path(). On success, the cursor will point at the leaf
+ * element, within the innermost document.
+ *
+ * @param c is the cursor to move.
+ * @param path is the dotted path to position to.
+ *
+ * @returns TRUE on success, FALSE otherwise. On failure, the cursor
+ * is left untouched.
+ */
+gboolean bson_cursor_find_path (bson_cursor *c, const gchar *path);
+
 /** Determine the type of the current element.
  *
  * @param c is the cursor pointing at the appropriate element.
@@ -708,6 +1163,95 @@ gboolean bson_cursor_get_document (const bson_cursor *c, bson **dest);
  */
 gboolean bson_cursor_get_array (const bson_cursor *c, bson **dest);
 
+/** Get the value stored at the cursor, as a BSON document view.
+ *
+ * Like bson_cursor_get_document(), but instead of copying the
+ * embedded document, the returned object is a read-only view sharing
+ * the data of the object the cursor points into (see
+ * bson_new_view()).
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param dest is a pointer to a variable where the value can be
+ * stored.
+ *
+ * @note The @a dest pointer will be a newly allocated, finished
+ * object: it is the responsibility of the caller to free it, before
+ * the object the cursor points into is freed or modified.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_get_document_view (const bson_cursor *c, bson **dest);
+
+/** Get the value stored at the cursor, as a BSON array view.
+ *
+ * Like bson_cursor_get_array(), but instead of copying the embedded
+ * array, the returned object is a read-only view sharing the data of
+ * the object the cursor points into (see bson_new_view()).
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param dest is a pointer to a variable where the value can be
+ * stored.
+ *
+ * @note The @a dest pointer will be a newly allocated, finished
+ * object: it is the responsibility of the caller to free it, before
+ * the object the cursor points into is freed or modified.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_get_array_view (const bson_cursor *c, bson **dest);
+
+/** Get the value stored at the cursor, as an array of 32-bit integers.
+ *
+ * Decodes a BSON array of numbers straight into a C array, in a
+ * single pass, without creating an object for the embedded array or
+ * a cursor to walk it. The keys of the array elements are ignored.
+ *
+ * Every element must be a 32-bit integer, or a 64-bit integer whose
+ * value fits into 32 bits.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param dest is the array to store the values in. May be NULL if @a
+ * n is zero.
+ * @param n is the number of elements @a dest has room for.
+ *
+ * @returns The number of elements in the BSON array, or -1 on
+ * error. Only the first @a n elements are stored, so if the return
+ * value is larger than @a n, the array did not fit, and a larger
+ * buffer is needed to get all of it.
+ */
+gint32 bson_cursor_get_array_int32 (const bson_cursor *c, gint32 *dest,
+                                    gint32 n);
+
+/** Get the value stored at the cursor, as an array of 64-bit integers.
+ *
+ * Works like bson_cursor_get_array_int32(), but every element must be
+ * a 32- or 64-bit integer.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param dest is the array to store the values in. May be NULL if @a
+ * n is zero.
+ * @param n is the number of elements @a dest has room for.
+ *
+ * @returns The number of elements in the BSON array, or -1 on error.
+ */
+gint32 bson_cursor_get_array_int64 (const bson_cursor *c, gint64 *dest,
+                                    gint32 n);
+
+/** Get the value stored at the cursor, as an array of doubles.
+ *
+ * Works like bson_cursor_get_array_int32(), but every element must be
+ * a double, or a 32- or 64-bit integer, which is converted to double.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param dest is the array to store the values in. May be NULL if @a
+ * n is zero.
+ * @param n is the number of elements @a dest has room for.
+ *
+ * @returns The number of elements in the BSON array, or -1 on error.
+ */
+gint32 bson_cursor_get_array_double (const bson_cursor *c, gdouble *dest,
+                                     gint32 n);
+
 /** Get the value stored at the cursor, as binary data.
  *
  * @param c is the cursor pointing at the appropriate element.
@@ -847,6 +1391,1081 @@ gboolean bson_cursor_get_timestamp (const bson_cursor *c, gint64 *dest);
  */
 gboolean bson_cursor_get_int64 (const bson_cursor *c, gint64 *dest);
 
+/** Set the 32-bit integer value stored at the cursor.
+ *
+ * Overwrites the value of the element the cursor points at, in place,
+ * without re-encoding the object. This, and the other in-place
+ * setters only work when the element is already of the matching
+ * type, as they never change the size of the object.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param value is the new value.
+ *
+ * @note Cursors opened on embedded documents, and those moved with
+ * bson_cursor_find_path() share the memory of the object they were
+ * created for, so the new value is visible there too. Views created
+ * with bson_new_view() share the memory they were created from, which
+ * must be writable for the setters to be used on them. The setters
+ * fail while the data of the object is shared with bson_ref().
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_set_int32 (bson_cursor *c, gint32 value);
+
+/** Set the 64-bit integer value stored at the cursor.
+ *
+ * See bson_cursor_set_int32() for the details of in-place setters.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param value is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_set_int64 (bson_cursor *c, gint64 value);
+
+/** Set the double value stored at the cursor.
+ *
+ * See bson_cursor_set_int32() for the details of in-place setters.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param value is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_set_double (bson_cursor *c, gdouble value);
+
+/** Set the boolean value stored at the cursor.
+ *
+ * See bson_cursor_set_int32() for the details of in-place setters.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param value is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_set_boolean (bson_cursor *c, gboolean value);
+
+/** Set the UTC datetime value stored at the cursor.
+ *
+ * See bson_cursor_set_int32() for the details of in-place setters.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param value is the new value, in milliseconds since the epoch.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_set_utc_datetime (bson_cursor *c, gint64 value);
+
+/** Set the timestamp value stored at the cursor.
+ *
+ * See bson_cursor_set_int32() for the details of in-place setters.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param value is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_set_timestamp (bson_cursor *c, gint64 value);
+
+/** Set the ObjectID value stored at the cursor.
+ *
+ * See bson_cursor_set_int32() for the details of in-place setters.
+ *
+ * @param c is the cursor pointing at the appropriate element.
+ * @param oid is the new ObjectID, 12 bytes long.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_cursor_set_oid (bson_cursor *c, const guint8 *oid);
+
+/** @} */
+
+/** @defgroup bson_iter Stack Iterators
+ *
+ * Iterators do the same job as cursors, but unlike those, they are
+ * not opaque: their structure is public and of fixed size, so they
+ * can live on the stack (or be embedded into other structures), and
+ * using them involves no memory allocation whatsoever.
+ *
+ * Iterators are initialised with bson_iter_init(), and moved with
+ * bson_iter_next() and bson_iter_find(). Embedded documents and
+ * arrays can be iterated over with bson_iter_recurse(), which does
+ * not allocate either. The most common values can be retrieved with
+ * the inline getters below.
+ *
+ * An iterator does not own anything, so it needs no freeing, but the
+ * object it iterates over must not be freed or modified while the
+ * iterator is in use.
+ *
+ * @addtogroup bson_iter
+ * @{
+ */
+
+/** BSON iterator.
+ *
+ * The members are public only so that iterators can be allocated on
+ * the stack: they are not meant to be accessed directly.
+ */
+typedef struct
+{
+  const bson *obj; /**< The BSON object iterated over, or NULL for
+                      iterators opened with bson_iter_recurse(). */
+  const guint8 *data; /**< The data of the document iterated over. */
+  guint32 size; /**< The size of @a data. */
+  const gchar *key; /**< The key of the current element. */
+  guint32 pos; /**< Position of the current element within @a data,
+                  pointing at the element type, or zero before the
+                  first element. */
+  guint32 value_pos; /**< Position of the value of the current
+                        element within @a data. */
+} bson_iter;
+
+/** Initialise an iterator.
+ *
+ * Positions the iterator before the first element of the object, so
+ * that the first call to bson_iter_next() moves it to the first
+ * element.
+ *
+ * @param i is the iterator to initialise.
+ * @param b is the finished BSON object to iterate over.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_iter_init (bson_iter *i, const bson *b);
+
+/** Position an iterator to the next element.
+ *
+ * @param i is the iterator to move.
+ *
+ * @returns TRUE if the iterator was moved, FALSE if there are no more
+ * elements, or on error.
+ */
+gboolean bson_iter_next (bson_iter *i);
+
+/** Position an iterator to a given key.
+ *
+ * The search starts at the current position of the iterator, and
+ * wraps over to the start of the document if need be, just like with
+ * bson_cursor_find(). The key index of the object is used, if it has
+ * one.
+ *
+ * @param i is the iterator to move.
+ * @param name is the key to find.
+ *
+ * @returns TRUE if the key was found, FALSE otherwise, in which case
+ * the iterator is left where it was.
+ */
+gboolean bson_iter_find (bson_iter *i, const gchar *name);
+
+/** Open an iterator on an embedded document or array.
+ *
+ * The embedded document is not copied, nor is any memory allocated.
+ *
+ * @param i is the iterator pointing at a document or array element.
+ * @param child is the iterator to initialise, positioned before the
+ * first element of the embedded document.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_iter_recurse (const bson_iter *i, bson_iter *child);
+
+/** Determine the type of the current element.
+ *
+ * @param i is the iterator to check.
+ *
+ * @returns The type of the element, or #BSON_TYPE_NONE if the
+ * iterator does not point at an element.
+ */
+static __inline__ bson_type bson_iter_type (const bson_iter *i)
+{
+  if (!i || i->pos < sizeof (gint32))
+    return BSON_TYPE_NONE;
+  return (bson_type)i->data[i->pos];
+}
+
+/** Determine the key of the current element.
+ *
+ * @param i is the iterator to check.
+ *
+ * @returns The key of the element, or NULL if the iterator does not
+ * point at an element.
+ */
+static __inline__ const gchar *bson_iter_key (const bson_iter *i)
+{
+  if (!i)
+    return NULL;
+  return i->key;
+}
+
+/** Get the value of the current element, as a 32-bit integer.
+ *
+ * @param i is the iterator pointing at an int32 element.
+ * @param dest is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_int32 (const bson_iter *i,
+                                                gint32 *dest)
+{
+  if (!dest || bson_iter_type (i) != BSON_TYPE_INT32)
+    return FALSE;
+  memcpy (dest, i->data + i->value_pos, sizeof (gint32));
+  *dest = GINT32_FROM_LE (*dest);
+  return TRUE;
+}
+
+/** @internal Read a 64-bit little-endian value of a given type.
+ *
+ * @param i is the iterator pointing at the element.
+ * @param type is the type the element must have.
+ * @param dest is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean _bson_iter_get_64 (const bson_iter *i,
+                                              bson_type type,
+                                              guint64 *dest)
+{
+  if (!dest || bson_iter_type (i) != type)
+    return FALSE;
+  memcpy (dest, i->data + i->value_pos, sizeof (guint64));
+  *dest = GUINT64_FROM_LE (*dest);
+  return TRUE;
+}
+
+/** Get the value of the current element, as a 64-bit integer.
+ *
+ * @param i is the iterator pointing at an int64 element.
+ * @param dest is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_int64 (const bson_iter *i,
+                                                gint64 *dest)
+{
+  return _bson_iter_get_64 (i, BSON_TYPE_INT64, (guint64 *)dest);
+}
+
+/** Get the value of the current element, as a UTC datetime.
+ *
+ * @param i is the iterator pointing at a UTC datetime element.
+ * @param dest is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_utc_datetime (const bson_iter *i,
+                                                       gint64 *dest)
+{
+  return _bson_iter_get_64 (i, BSON_TYPE_UTC_DATETIME, (guint64 *)dest);
+}
+
+/** Get the value of the current element, as a timestamp.
+ *
+ * @param i is the iterator pointing at a timestamp element.
+ * @param dest is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_timestamp (const bson_iter *i,
+                                                    gint64 *dest)
+{
+  return _bson_iter_get_64 (i, BSON_TYPE_TIMESTAMP, (guint64 *)dest);
+}
+
+/** Get the value of the current element, as a double.
+ *
+ * @param i is the iterator pointing at a double element.
+ * @param dest is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_double (const bson_iter *i,
+                                                 gdouble *dest)
+{
+  union
+  {
+    guint64 i;
+    gdouble d;
+  } v;
+
+  if (!dest || !_bson_iter_get_64 (i, BSON_TYPE_DOUBLE, &v.i))
+    return FALSE;
+  *dest = v.d;
+  return TRUE;
+}
+
+/** Get the value of the current element, as a boolean.
+ *
+ * @param i is the iterator pointing at a boolean element.
+ * @param dest is where the value will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_boolean (const bson_iter *i,
+                                                  gboolean *dest)
+{
+  if (!dest || bson_iter_type (i) != BSON_TYPE_BOOLEAN)
+    return FALSE;
+  *dest = (gboolean)i->data[i->value_pos];
+  return TRUE;
+}
+
+/** Get the value of the current element, as a string.
+ *
+ * @param i is the iterator pointing at a string element.
+ * @param dest is where a pointer to the string will be stored. The
+ * string is not copied, and is only valid as long as the object
+ * iterated over is.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_string (const bson_iter *i,
+                                                 const gchar **dest)
+{
+  if (!dest || bson_iter_type (i) != BSON_TYPE_STRING)
+    return FALSE;
+  *dest = (const gchar *)(i->data + i->value_pos + sizeof (gint32));
+  return TRUE;
+}
+
+/** Get the value of the current element, as binary data.
+ *
+ * @param i is the iterator pointing at a binary element.
+ * @param subtype is where the subtype will be stored.
+ * @param data is where a pointer to the data will be stored. It is
+ * not copied, and is only valid as long as the object iterated over
+ * is.
+ * @param size is where the size of the data will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_binary (const bson_iter *i,
+                                                 bson_binary_subtype *subtype,
+                                                 const guint8 **data,
+                                                 gint32 *size)
+{
+  if (!subtype || !data || !size || bson_iter_type (i) != BSON_TYPE_BINARY)
+    return FALSE;
+  memcpy (size, i->data + i->value_pos, sizeof (gint32));
+  *size = GINT32_FROM_LE (*size);
+  *subtype = (bson_binary_subtype)i->data[i->value_pos + sizeof (gint32)];
+  *data = i->data + i->value_pos + sizeof (gint32) + 1;
+  return TRUE;
+}
+
+/** Get the value of the current element, as an ObjectID.
+ *
+ * @param i is the iterator pointing at an ObjectID element.
+ * @param dest is where a pointer to the 12-byte ObjectID will be
+ * stored. It is not copied, and is only valid as long as the object
+ * iterated over is.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static __inline__ gboolean bson_iter_get_oid (const bson_iter *i,
+                                              const guint8 **dest)
+{
+  if (!dest || bson_iter_type (i) != BSON_TYPE_OID)
+    return FALSE;
+  *dest = i->data + i->value_pos;
+  return TRUE;
+}
+
+/** @} */
+
+/** @defgroup bson_visit Visitors
+ *
+ * A visitor walks a document from start to end, and calls a callback
+ * for every element it finds, with the value of the element already
+ * decoded. Embedded documents and arrays can be recursed into in
+ * place, without copying them.
+ *
+ * Every callback receives the iterator pointing at the element (so
+ * that its key and type can be retrieved with bson_iter_key() and
+ * bson_iter_type()), the nesting depth of the element (zero for the
+ * elements of the visited document itself), and the user data passed
+ * to bson_visit(). Callbacks return TRUE to continue the walk, or
+ * FALSE to stop it.
+ *
+ * Any callback may be left NULL, in which case elements of that type
+ * are skipped (apart from the @a visit_before and @a visit_after
+ * callbacks being called for them).
+ *
+ * @addtogroup bson_visit
+ * @{
+ */
+
+/** BSON visitor flags.
+ */
+typedef enum
+  {
+    BSON_VISIT_DEFAULT = 0, /**< Only visit the top-level elements. */
+    BSON_VISIT_RECURSE = 1 << 0 /**< Recurse into embedded documents
+                                   and arrays. */
+  } bson_visit_flags;
+
+/** BSON visitor callback table.
+ *
+ * It is best initialised with designated initialisers, so that the
+ * callbacks not used are NULL.
+ */
+typedef struct
+{
+  /** Called for every element, before the type-specific callback. */
+  gboolean (*visit_before) (const bson_iter *i, gint depth,
+                            gpointer user_data);
+  /** Called for every element, after the type-specific callback,
+   * and after the elements of embedded documents were visited. */
+  gboolean (*visit_after) (const bson_iter *i, gint depth,
+                           gpointer user_data);
+
+  /** Called for double elements. */
+  gboolean (*visit_double) (const bson_iter *i, gint depth,
+                            gdouble value, gpointer user_data);
+  /** Called for string elements, with the length of the string,
+   * excluding the terminating NUL byte. */
+  gboolean (*visit_string) (const bson_iter *i, gint depth,
+                            const gchar *value, gint32 length,
+                            gpointer user_data);
+  /** Called for embedded documents, with the size of the document,
+   * before its elements are visited. */
+  gboolean (*visit_document) (const bson_iter *i, gint depth,
+                              gint32 size, gpointer user_data);
+  /** Called for embedded documents, after their elements were
+   * visited. Only used with #BSON_VISIT_RECURSE. */
+  gboolean (*visit_document_end) (const bson_iter *i, gint depth,
+                                  gpointer user_data);
+  /** Called for arrays, with the size of the array, before its
+   * elements are visited. */
+  gboolean (*visit_array) (const bson_iter *i, gint depth,
+                           gint32 size, gpointer user_data);
+  /** Called for arrays, after their elements were visited. Only used
+   * with #BSON_VISIT_RECURSE. */
+  gboolean (*visit_array_end) (const bson_iter *i, gint depth,
+                               gpointer user_data);
+  /** Called for binary elements. */
+  gboolean (*visit_binary) (const bson_iter *i, gint depth,
+                            bson_binary_subtype subtype,
+                            const guint8 *data, gint32 size,
+                            gpointer user_data);
+  /** Called for ObjectID elements, with the 12-byte ObjectID. */
+  gboolean (*visit_oid) (const bson_iter *i, gint depth,
+                         const guint8 *oid, gpointer user_data);
+  /** Called for boolean elements. */
+  gboolean (*visit_boolean) (const bson_iter *i, gint depth,
+                             gboolean value, gpointer user_data);
+  /** Called for UTC datetime elements. */
+  gboolean (*visit_utc_datetime) (const bson_iter *i, gint depth,
+                                  gint64 value, gpointer user_data);
+  /** Called for NULL elements. */
+  gboolean (*visit_null) (const bson_iter *i, gint depth,
+                          gpointer user_data);
+  /** Called for regular expressions. */
+  gboolean (*visit_regex) (const bson_iter *i, gint depth,
+                           const gchar *regex, const gchar *options,
+                           gpointer user_data);
+  /** Called for JavaScript code, with the length of the code. */
+  gboolean (*visit_javascript) (const bson_iter *i, gint depth,
+                                const gchar *code, gint32 length,
+                                gpointer user_data);
+  /** Called for symbols, with the length of the symbol. */
+  gboolean (*visit_symbol) (const bson_iter *i, gint depth,
+                            const gchar *symbol, gint32 length,
+                            gpointer user_data);
+  /** Called for JavaScript code with scope, with an iterator
+   * positioned before the first element of the scope. The scope is
+   * never recursed into. */
+  gboolean (*visit_javascript_w_scope) (const bson_iter *i, gint depth,
+                                        const gchar *code,
+                                        gint32 length,
+                                        const bson_iter *scope,
+                                        gpointer user_data);
+  /** Called for 32-bit integers. */
+  gboolean (*visit_int32) (const bson_iter *i, gint depth,
+                           gint32 value, gpointer user_data);
+  /** Called for timestamps. */
+  gboolean (*visit_timestamp) (const bson_iter *i, gint depth,
+                               gint64 value, gpointer user_data);
+  /** Called for 64-bit integers. */
+  gboolean (*visit_int64) (const bson_iter *i, gint depth,
+                           gint64 value, gpointer user_data);
+} bson_visitor;
+
+/** Visit the elements of a BSON object.
+ *
+ * The elements are visited in order, and with #BSON_VISIT_RECURSE,
+ * embedded documents and arrays are visited depth-first, right after
+ * the callback for the embedding element.
+ *
+ * Only the framing of embedded documents is checked: use
+ * bson_validate() before visiting untrusted input.
+ *
+ * @param b is the finished BSON object to visit.
+ * @param visitor is the table of callbacks to call.
+ * @param flags is a combination of #bson_visit_flags.
+ * @param user_data is passed to every callback as-is.
+ *
+ * @returns TRUE if the whole object was visited, FALSE if a callback
+ * stopped the walk, or on error. Documents nested deeper than
+ * #BSON_VALIDATE_MAX_DEPTH are treated as errors.
+ */
+gboolean bson_visit (const bson *b, const bson_visitor *visitor,
+                     gint flags, gpointer user_data);
+
+/** @} */
+
+/** @defgroup bson_key Pre-computed Keys
+ *
+ * When the same key names are used over and over again, to build or
+ * to look into objects of the same layout, the work of measuring and
+ * hashing them can be done once, up front, by creating a #bson_key
+ * for each of them.
+ *
+ * Every append function has a counterpart with a @a _k suffix, which
+ * takes a #bson_key instead of a key name, and otherwise behaves
+ * exactly the same. Similarly, bson_find_k() and bson_cursor_find_k()
+ * are the counterparts of bson_find() and bson_cursor_find().
+ *
+ * @addtogroup bson_key
+ * @{
+ */
+
+/** Opaque pre-computed key object. */
+typedef struct _bson_key bson_key;
+
+/** Create a new pre-computed key.
+ *
+ * @param name is the key name.
+ *
+ * @returns A newly allocated key, which must be freed with
+ * bson_key_free(), or NULL on error.
+ */
+bson_key *bson_key_new (const gchar *name);
+
+/** Free a pre-computed key.
+ *
+ * @param key is the key to free.
+ */
+void bson_key_free (bson_key *key);
+
+/** Return the name of a pre-computed key.
+ *
+ * @param key is the key whose name to return.
+ *
+ * @returns The name of the key, or NULL on error.
+ *
+ * @note The name points to an internal structure, it must not be
+ * freed or modified.
+ */
+const gchar *bson_key_name (const bson_key *key);
+
+/** Toggle position prediction for a pre-computed key.
+ *
+ * With prediction enabled, the key remembers the position it was last
+ * found at, and lookups check that position first, before falling
+ * back to a normal search. The position is verified by stepping over
+ * the elements before it, without comparing their keys, which makes
+ * looking up the same key in a series of objects with the same
+ * layout cheaper.
+ *
+ * @param key is the key to toggle prediction for.
+ * @param enable is whether to enable or disable prediction.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ *
+ * @note A predicting key is modified by lookups, and must not be used
+ * from multiple threads at the same time. If an object has duplicate
+ * keys, the prediction may find any of them.
+ */
+gboolean bson_key_set_prediction (bson_key *key, gboolean enable);
+
+/** Append a double to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_double()
+ */
+gboolean bson_append_double_k (bson *b, const bson_key *key, gdouble d);
+
+/** Append a string to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_string()
+ */
+gboolean bson_append_string_k (bson *b, const bson_key *key,
+                               const gchar *val, gint32 length);
+
+/** Append a document to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_document()
+ */
+gboolean bson_append_document_k (bson *b, const bson_key *key,
+                                 const bson *doc);
+
+/** Append an array to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_array()
+ */
+gboolean bson_append_array_k (bson *b, const bson_key *key,
+                              const bson *array);
+
+/** Append binary data to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_binary()
+ */
+gboolean bson_append_binary_k (bson *b, const bson_key *key,
+                               bson_binary_subtype subtype,
+                               const guint8 *data, gint32 size);
+
+/** Append an ObjectID to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_oid()
+ */
+gboolean bson_append_oid_k (bson *b, const bson_key *key,
+                            const guint8 *oid);
+
+/** Append a boolean to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_boolean()
+ */
+gboolean bson_append_boolean_k (bson *b, const bson_key *key,
+                                gboolean value);
+
+/** Append an UTC datetime to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_utc_datetime()
+ */
+gboolean bson_append_utc_datetime_k (bson *b, const bson_key *key,
+                                     gint64 ts);
+
+/** Append a NULL value to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_null()
+ */
+gboolean bson_append_null_k (bson *b, const bson_key *key);
+
+/** Append a regexp to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_regex()
+ */
+gboolean bson_append_regex_k (bson *b, const bson_key *key,
+                              const gchar *regexp, const gchar *options);
+
+/** Append Javascript code to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_javascript()
+ */
+gboolean bson_append_javascript_k (bson *b, const bson_key *key,
+                                   const gchar *js, gint32 len);
+
+/** Append a symbol to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_symbol()
+ */
+gboolean bson_append_symbol_k (bson *b, const bson_key *key,
+                               const gchar *symbol, gint32 len);
+
+/** Append Javascript code with scope to a BSON object, using a
+ * pre-computed key.
+ *
+ * @see bson_append_javascript_w_scope()
+ */
+gboolean bson_append_javascript_w_scope_k (bson *b, const bson_key *key,
+                                           const gchar *js, gint32 len,
+                                           const bson *scope);
+
+/** Append a 32-bit integer to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_int32()
+ */
+gboolean bson_append_int32_k (bson *b, const bson_key *key, gint32 i);
+
+/** Append a timestamp to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_timestamp()
+ */
+gboolean bson_append_timestamp_k (bson *b, const bson_key *key,
+                                  gint64 ts);
+
+/** Append a 64-bit integer to a BSON object, using a pre-computed key.
+ *
+ * @see bson_append_int64()
+ */
+gboolean bson_append_int64_k (bson *b, const bson_key *key, gint64 i);
+
+/** Find a pre-computed key in a BSON object.
+ *
+ * @param b is the BSON object to search in.
+ * @param key is the key to find.
+ *
+ * @returns A newly allocated cursor pointing at the element, or NULL
+ * if it was not found.
+ *
+ * @see bson_find()
+ */
+bson_cursor *bson_find_k (const bson *b, bson_key *key);
+
+/** Move the cursor to a pre-computed key.
+ *
+ * @param c is the cursor to move.
+ * @param key is the key to position to.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ *
+ * @see bson_cursor_find()
+ */
+gboolean bson_cursor_find_k (bson_cursor *c, bson_key *key);
+
+/** @} */
+
+/** @defgroup bson_template Templates
+ *
+ * Templates speed up producing many documents of the same shape, by
+ * recording the layout of a finished object once, and only patching
+ * the values that change between documents.
+ *
+ * Values are addressed through slots: fixed-width values (integers,
+ * doubles, datetimes, timestamps, ObjectIDs and booleans) are patched
+ * in place, while string slots have a maximum length, and the
+ * document is re-laid out around them when rendered. Rendering a
+ * template without string slots is a single memcpy().
+ *
+ * @addtogroup bson_template
+ * @{
+ */
+
+/** Opaque BSON template object. */
+typedef struct _bson_template bson_template;
+
+/** Create a new template.
+ *
+ * @param b is the finished BSON object to use as the layout. It is
+ * copied, and can be freed after the template is created.
+ *
+ * @returns A newly allocated template, which must be freed with
+ * bson_template_free(), or NULL on error (including if @a b does not
+ * pass bson_validate()).
+ */
+bson_template *bson_template_new (const bson *b);
+
+/** Free a template.
+ *
+ * @param t is the template to free.
+ */
+void bson_template_free (bson_template *t);
+
+/** Add a slot to a template.
+ *
+ * @param t is the template to add the slot to.
+ * @param path is the dotted path of the element, as with
+ * bson_find_path(). The type of the element in the layout determines
+ * the type of the slot.
+ * @param max_len is the maximum length of the values a string slot
+ * will accept, and is ignored for other types. It can be at most 16
+ * MiB, and the string in the layout must not be longer than this.
+ *
+ * @returns The number of the new slot, to be used with the setter
+ * functions, or -1 on error.
+ */
+gint bson_template_add_slot (bson_template *t, const gchar *path,
+                             gint32 max_len);
+
+/** Set the value of a 32-bit integer slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param i is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_template_set_int32 (bson_template *t, gint slot, gint32 i);
+
+/** Set the value of a 64-bit integer slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param i is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_template_set_int64 (bson_template *t, gint slot, gint64 i);
+
+/** Set the value of a double slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param d is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_template_set_double (bson_template *t, gint slot, gdouble d);
+
+/** Set the value of an UTC datetime slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param ts is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_template_set_utc_datetime (bson_template *t, gint slot,
+                                         gint64 ts);
+
+/** Set the value of a timestamp slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param ts is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_template_set_timestamp (bson_template *t, gint slot,
+                                      gint64 ts);
+
+/** Set the value of an ObjectID slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param oid is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_template_set_oid (bson_template *t, gint slot,
+                                const guint8 *oid);
+
+/** Set the value of a boolean slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param value is the new value.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_template_set_boolean (bson_template *t, gint slot,
+                                    gboolean value);
+
+/** Set the value of a string slot.
+ *
+ * @param t is the template to set a value in.
+ * @param slot is the number of the slot.
+ * @param val is the new value.
+ * @param length is the length of the value, or -1 to use the whole
+ * string.
+ *
+ * @returns TRUE on success, FALSE otherwise (including if the value
+ * is longer than the maximum length of the slot).
+ */
+gboolean bson_template_set_string (bson_template *t, gint slot,
+                                   const gchar *val, gint32 length);
+
+/** Render a template into a BSON object.
+ *
+ * The object is reset, and filled with the layout of the template,
+ * with the current values of all slots.
+ *
+ * @param t is the template to render.
+ * @param dest is the BSON object to render into. Its buffer is
+ * reused, so using the same object for every rendering avoids
+ * allocations altogether.
+ *
+ * @returns TRUE on success, FALSE otherwise. On success, @a dest will
+ * be a finished object.
+ */
+gboolean bson_template_render (const bson_template *t, bson *dest);
+
+/** @} */
+
+/** @defgroup bson_compare Comparison & Hashing
+ *
+ * Functions to compare and hash BSON objects, without converting
+ * them to anything else first.
+ *
+ * bson_hash_func() and bson_equal() are consistent with each other,
+ * so BSON objects can be used as keys of a GHashTable:
+ *
+ * @code
+ *   GHashTable *seen = g_hash_table_new (bson_hash_func,
+ *                                        (GEqualFunc) bson_equal);
+ * @endcode
+ *
+ * @addtogroup bson_compare
+ * @{
+ */
+
+/** Hash a BSON object.
+ *
+ * Calculates a fast, non-cryptographic 64-bit hash of the object.
+ *
+ * @param b is the finished BSON object to hash.
+ * @param flags is a combination of #bson_hash_flags.
+ *
+ * @returns The hash of the object, or zero if it is NULL or
+ * unfinished.
+ *
+ * @note With #BSON_HASH_UNORDERED, objects that only differ in the
+ * order of their keys hash to the same value, but bson_equal() still
+ * considers them different.
+ */
+guint64 bson_hash (const bson *b, gint flags);
+
+/** Hash a BSON object, for use with GHashTable.
+ *
+ * @param b is the finished BSON object to hash.
+ *
+ * @returns The default hash of the object, folded to a guint.
+ */
+guint bson_hash_func (gconstpointer b);
+
+/** Check whether two BSON objects are identical.
+ *
+ * @param a is the first finished BSON object.
+ * @param b is the second finished BSON object.
+ *
+ * @returns TRUE if the objects are byte for byte identical, FALSE
+ * otherwise, or if either of them is NULL or unfinished.
+ */
+gboolean bson_equal (const bson *a, const bson *b);
+
+/** Compare two BSON objects.
+ *
+ * Objects are compared element by element, the way MongoDB orders
+ * documents: first by the type of the elements (following MongoDB's
+ * type ordering, where all numbers are the same type), then by their
+ * key names, then by their values.
+ *
+ * Numbers of different types are compared by their numeric value, so
+ * unlike bson_equal(), this may consider objects of different
+ * encodings equal.
+ *
+ * @param a is the first finished BSON object.
+ * @param b is the second finished BSON object.
+ *
+ * @returns A negative number if @a a sorts before @a b, zero if they
+ * are equal, and a positive number otherwise. NULL and unfinished
+ * objects sort before everything else.
+ */
+gint bson_compare (const bson *a, const bson *b);
+
+/** @} */
+
+/** @defgroup bson_columns Columnar Decoding
+ *
+ * A columnar decoder pulls the same set of fields out of a stream of
+ * documents, and appends their values to typed, contiguous column
+ * arrays, so that they can be processed without going through a
+ * cursor for every value.
+ *
+ * Every column has a validity bitmap alongside its values: bit @a i
+ * (bit @a i % 8 of byte @a i / 8) is set if row @a i has a value, and
+ * clear if the field was missing, or had an incompatible type.
+ *
+ * Columns can be of the following types, with values stored as:
+ *  - #BSON_TYPE_INT32: gint32.
+ *  - #BSON_TYPE_INT64: gint64, converted from 32-bit integers too.
+ *  - #BSON_TYPE_DOUBLE: gdouble, converted from integers too.
+ *  - #BSON_TYPE_UTC_DATETIME: gint64, milliseconds since the epoch.
+ *  - #BSON_TYPE_TIMESTAMP: gint64.
+ *  - #BSON_TYPE_BOOLEAN: guint8, zero or one.
+ *
+ * @addtogroup bson_columns
+ * @{
+ */
+
+/** Opaque columnar decoder object. */
+typedef struct _bson_columns bson_columns;
+
+/** Create a new columnar decoder.
+ *
+ * @returns A newly allocated decoder, without any columns. It must be
+ * freed with bson_columns_free().
+ */
+bson_columns *bson_columns_new (void);
+
+/** Add a column to a columnar decoder.
+ *
+ * Columns can only be added while the decoder has no rows.
+ *
+ * @param cols is the decoder to add the column to.
+ * @param path is the name of the field to decode, or a dotted path
+ * into embedded documents.
+ * @param type is the type of the column.
+ *
+ * @returns The index of the new column, or -1 on error.
+ */
+gint bson_columns_add (bson_columns *cols, const gchar *path,
+                       bson_type type);
+
+/** Decode a single document into a new row.
+ *
+ * @param cols is the decoder to append to.
+ * @param data is the raw BSON document.
+ * @param size is the size of @a data.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_columns_append (bson_columns *cols, const guint8 *data,
+                              gint32 size);
+
+/** Decode a stream of concatenated documents.
+ *
+ * Every document becomes a new row. If the stream is malformed, none
+ * of its documents are kept.
+ *
+ * @param cols is the decoder to append to.
+ * @param data is the raw BSON documents, one after the other.
+ * @param size is the size of @a data.
+ *
+ * @returns The number of documents decoded, or -1 on error.
+ */
+gint32 bson_columns_append_stream (bson_columns *cols, const guint8 *data,
+                                   gint32 size);
+
+/** Get the number of rows in a columnar decoder.
+ *
+ * @param cols is the decoder to query.
+ *
+ * @returns The number of rows, or -1 on error.
+ */
+gint64 bson_columns_rows (const bson_columns *cols);
+
+/** Get the values of a column.
+ *
+ * @param cols is the decoder to query.
+ * @param column is the index of the column.
+ *
+ * @returns The array of values, of the C type matching the column's
+ * type, or NULL on error, or if there are no rows. Values of rows
+ * without one are zero. The array is owned by the decoder, and is only
+ * valid until the next append, reset or free.
+ */
+gconstpointer bson_columns_values (const bson_columns *cols, gint column);
+
+/** Get the validity bitmap of a column.
+ *
+ * @param cols is the decoder to query.
+ * @param column is the index of the column.
+ *
+ * @returns The validity bitmap, or NULL on error, or if there are no
+ * rows. It is owned by the decoder, and is only valid until the next
+ * append, reset or free.
+ */
+const guint8 *bson_columns_validity (const bson_columns *cols,
+                                     gint column);
+
+/** Remove every row from a columnar decoder.
+ *
+ * The columns, and the memory allocated for them are kept, so the
+ * decoder can be reused without allocations.
+ *
+ * @param cols is the decoder to reset.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean bson_columns_reset (bson_columns *cols);
+
+/** Free a columnar decoder.
+ *
+ * @param cols is the decoder to free.
+ */
+void bson_columns_free (bson_columns *cols);
+
 /** @} */
 
 /** @} */
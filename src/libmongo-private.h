@@ -25,13 +25,93 @@
 #include "mongo.h"
 #include "compat.h"
 
+/** @internal BSON arena chunk.
+ *
+ * Arenas are made up of a singly linked list of chunks, memory is
+ * handed out from them in a bump-pointer fashion.
+ */
+typedef struct _bson_arena_chunk bson_arena_chunk;
+struct _bson_arena_chunk
+{
+  bson_arena_chunk *next; /**< The next chunk in the arena. */
+  gsize size; /**< The usable size of the chunk. */
+  gsize used; /**< The number of bytes handed out already. */
+  guint8 *data; /**< The start of the chunk's usable memory. */
+};
+
+/** @internal BSON arena structure.
+ */
+struct _bson_arena
+{
+  bson_arena_chunk *head; /**< The first chunk of the arena. */
+  bson_arena_chunk *current; /**< The chunk allocations are served
+                                from. */
+  gsize chunk_size; /**< The default size of new chunks. */
+};
+
+/** @internal BSON key index slot.
+ */
+typedef struct
+{
+  guint32 hash; /**< The hash of the key. */
+  guint32 pos; /**< The position of the element within the object,
+                  or zero if the slot is empty. */
+} bson_key_index_slot;
+
+/** @internal BSON key index.
+ *
+ * An open addressing hash table, mapping key names to the position
+ * of the first element with that name.
+ */
+typedef struct
+{
+  guint32 mask; /**< The number of slots, minus one. */
+  guint32 count; /**< The number of slots in use. */
+  gboolean duplicates; /**< Whether the object has duplicate keys. */
+  bson_key_index_slot *slots; /**< The slots themselves. */
+} bson_key_index;
+
+/** @internal Pre-computed BSON key.
+ */
+struct _bson_key
+{
+  gchar *name; /**< The key name. */
+  gint32 len; /**< The length of the key name. */
+  guint32 hash; /**< The hash of the key name, as used by the key
+                   index. */
+  gboolean predict; /**< Whether to predict the position of the key
+                       within objects. */
+  guint32 hint; /**< The position the key was last found at, if
+                   prediction is enabled. */
+};
+
 /** @internal BSON structure.
  */
 struct _bson
 {
-  GByteArray *data; /**< The actual data of the BSON object. */
+  guint8 *data; /**< The actual data of the BSON object. */
+  guint len; /**< The number of bytes used within @a data. */
+  guint alloc; /**< The number of bytes allocated for @a data. */
+  bson_arena *arena; /**< The arena the object lives in, or NULL if
+                        it was allocated on the heap. */
+  gboolean view; /**< Flag to indicate whether @a data is borrowed
+                    from somewhere else, instead of being owned by
+                    the object. */
+  gboolean indexed; /**< Flag to indicate whether key lookups should
+                       use (and build, if need be) @a index. */
+  bson_key_index *index; /**< The key index, built on the first
+                            lookup, if @a indexed is set. */
   gboolean finished; /**< Flag to indicate whether the object is open
                         or finished. */
+  bson *root; /**< For embedded documents built in place: the
+                 top-level object whose buffer they are written to,
+                 NULL otherwise. */
+  guint32 start; /**< For embedded documents built in place: their
+                    starting position within the buffer of @a root. */
+  bson *child; /**< The embedded document currently being built in
+                  place, if any. */
+  gint *refs; /**< The number of objects sharing @a data, if it was
+                 shared with bson_ref(), NULL otherwise. */
 };
 
 /** @internal Mongo Connection state object. */
@@ -116,3 +116,27 @@ mongo_sync_cursor_get_data (mongo_sync_cursor *cursor)
   bson_finish (r);
   return r;
 }
+
+gint32
+mongo_sync_cursor_decode_columns (mongo_sync_cursor *cursor,
+                                  bson_columns *cols)
+{
+  gint32 n;
+
+  if (!cursor || !cols)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (!mongo_sync_cursor_next (cursor))
+    return -1;
+
+  n = mongo_wire_reply_packet_decode_columns (cursor->results,
+                                              cursor->offset + 1, cols);
+  if (n == -1)
+    return -1;
+
+  cursor->offset += n - 1;
+  return n;
+}
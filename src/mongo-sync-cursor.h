@@ -84,6 +84,23 @@ gboolean mongo_sync_cursor_next (mongo_sync_cursor *cursor);
  */
 bson *mongo_sync_cursor_get_data (mongo_sync_cursor *cursor);
 
+/** Decode the rest of the cursor's current batch into columns.
+ *
+ * Advances the cursor (querying the database for the next batch if
+ * the current one is exhausted), then appends every remaining
+ * document of the batch to a columnar decoder, leaving the cursor
+ * positioned at the last of them. Calling this in a loop decodes the
+ * whole result set, one batch at a time.
+ *
+ * @param cursor is the cursor to decode documents from.
+ * @param cols is the columnar decoder to append to.
+ *
+ * @returns The number of documents decoded, or -1 if the cursor
+ * could not be advanced, or on error, with errno set appropriately.
+ */
+gint32 mongo_sync_cursor_decode_columns (mongo_sync_cursor *cursor,
+                                         bson_columns *cols);
+
 /** Free a MongoDB cursor.
  *
  * Freeing a MongoDB cursor involves destroying the active cursor the
@@ -700,29 +700,36 @@ _mongo_sync_packet_recv (mongo_sync_connection *conn, gint32 rid, gint32 flags)
       return NULL;
     }
 
+  if (!mongo_wire_reply_packet_validate (p, BSON_VALIDATE_NONE,
+                                         BSON_VALIDATE_MAX_DEPTH))
+    {
+      int e = errno;
+
+      mongo_wire_packet_free (p);
+      errno = e;
+      return NULL;
+    }
+
   return p;
 }
 
 static gboolean
 _mongo_sync_check_ok (bson *b)
 {
-  bson_cursor *c;
+  bson_iter i;
   gdouble d;
 
-  c = bson_find (b, "ok");
-  if (!c)
+  if (!bson_iter_init (&i, b) || !bson_iter_find (&i, "ok"))
     {
       errno = ENOENT;
       return FALSE;
     }
 
-  if (!bson_cursor_get_double (c, &d))
+  if (!bson_iter_get_double (&i, &d))
     {
-      bson_cursor_free (c);
       errno = EINVAL;
       return FALSE;
     }
-  bson_cursor_free (c);
   errno = (d == 1) ? 0 : EPROTO;
   return (d == 1);
 }
@@ -730,35 +737,29 @@ _mongo_sync_check_ok (bson *b)
 static gboolean
 _mongo_sync_get_error (const bson *rep, gchar **error)
 {
-  bson_cursor *c;
+  bson_iter i;
 
   if (!error)
     return FALSE;
 
-  c = bson_find (rep, "err");
-  if (!c)
+  if (!bson_iter_init (&i, rep) ||
+      (!bson_iter_find (&i, "err") && !bson_iter_find (&i, "errmsg")))
     {
-      c = bson_find (rep, "errmsg");
-      if (!c)
-        {
-          errno = EPROTO;
-          return FALSE;
-        }
+      errno = EPROTO;
+      return FALSE;
     }
-  if (bson_cursor_type (c) == BSON_TYPE_NONE ||
-      bson_cursor_type (c) == BSON_TYPE_NULL)
+  if (bson_iter_type (&i) == BSON_TYPE_NONE ||
+      bson_iter_type (&i) == BSON_TYPE_NULL)
     {
       *error = NULL;
-      bson_cursor_free (c);
       return TRUE;
     }
-  else if (bson_cursor_type (c) == BSON_TYPE_STRING)
+  else if (bson_iter_type (&i) == BSON_TYPE_STRING)
     {
       const gchar *err;
 
-      bson_cursor_get_string (c, &err);
+      bson_iter_get_string (&i, &err);
       *error = g_strdup (err);
-      bson_cursor_free (c);
       return TRUE;
     }
   errno = EPROTO;
@@ -775,13 +776,12 @@ _mongo_sync_packet_check_error (mongo_sync_connection *conn, mongo_packet *p,
   if (!p)
     return NULL;
 
-  if (!mongo_wire_reply_packet_get_nth_document (p, 1, &b))
+  if (!mongo_wire_reply_packet_get_nth_document_view (p, 1, &b))
     {
       mongo_wire_packet_free (p);
       errno = EPROTO;
       return NULL;
     }
-  bson_finish (b);
 
   if (check_ok)
     {
@@ -1126,7 +1126,7 @@ mongo_sync_cmd_count (mongo_sync_connection *conn,
 {
   mongo_packet *p;
   bson *cmd;
-  bson_cursor *c;
+  bson_iter i;
   gdouble d;
 
   cmd = bson_new_sized (bson_size (query) + 32);
@@ -1157,21 +1157,18 @@ mongo_sync_cmd_count (mongo_sync_connection *conn,
   mongo_wire_packet_free (p);
   bson_finish (cmd);
 
-  c = bson_find (cmd, "n");
-  if (!c)
+  if (!bson_iter_init (&i, cmd) || !bson_iter_find (&i, "n"))
     {
       bson_free (cmd);
       errno = ENOENT;
       return -1;
     }
-  if (!bson_cursor_get_double (c, &d))
+  if (!bson_iter_get_double (&i, &d))
     {
       bson_free (cmd);
-      bson_cursor_free (c);
       errno = EINVAL;
       return -1;
     }
-  bson_cursor_free (c);
   bson_free (cmd);
 
   return d;
@@ -1466,9 +1463,9 @@ mongo_sync_cmd_reset_error (mongo_sync_connection *conn,
 gboolean
 mongo_sync_cmd_is_master (mongo_sync_connection *conn)
 {
-  bson *cmd, *res, *hosts;
+  bson *cmd, *res;
+  bson_iter i, h;
   mongo_packet *p;
-  bson_cursor *c;
   gboolean b;
 
   cmd = bson_new_sized (32);
@@ -1497,15 +1494,13 @@ mongo_sync_cmd_is_master (mongo_sync_connection *conn)
   mongo_wire_packet_free (p);
   bson_finish (res);
 
-  c = bson_find (res, "ismaster");
-  if (!bson_cursor_get_boolean (c, &b))
+  if (!bson_iter_init (&i, res) || !bson_iter_find (&i, "ismaster") ||
+      !bson_iter_get_boolean (&i, &b))
     {
-      bson_cursor_free (c);
       bson_free (res);
       errno = EPROTO;
       return FALSE;
     }
-  bson_cursor_free (c);
 
   if (!b)
     {
@@ -1513,65 +1508,46 @@ mongo_sync_cmd_is_master (mongo_sync_connection *conn)
 
       /* We're not the master, so we should have a 'primary' key in
          the response. */
-      c = bson_find (res, "primary");
-      if (bson_cursor_get_string (c, &s))
+      if (bson_iter_find (&i, "primary") && bson_iter_get_string (&i, &s))
         {
           g_free (conn->rs.primary);
           conn->rs.primary = g_strdup (s);
         }
-      bson_cursor_free (c);
     }
 
   /* Find all the members of the set, and cache them. */
-  c = bson_find (res, "hosts");
-  if (!c)
-    {
-      bson_free (res);
-      errno = 0;
-      return b;
-    }
-
-  if (!bson_cursor_get_array (c, &hosts))
+  if (!bson_iter_find (&i, "hosts") ||
+      bson_iter_type (&i) != BSON_TYPE_ARRAY ||
+      !bson_iter_recurse (&i, &h))
     {
-      bson_cursor_free (c);
       bson_free (res);
       errno = 0;
       return b;
     }
-  bson_cursor_free (c);
-  bson_finish (hosts);
 
   /* Delete the old host list. */
   _list_free_full (&conn->rs.hosts);
 
-  c = bson_cursor_new (hosts);
-  while (bson_cursor_next (c))
+  while (bson_iter_next (&h))
     {
       const gchar *s;
 
-      if (bson_cursor_get_string (c, &s))
+      if (bson_iter_get_string (&h, &s))
         conn->rs.hosts = g_list_append (conn->rs.hosts, g_strdup (s));
     }
-  bson_cursor_free (c);
-  bson_free (hosts);
 
-  c = bson_find (res, "passives");
-  if (bson_cursor_get_array (c, &hosts))
+  if (bson_iter_find (&i, "passives") &&
+      bson_iter_type (&i) == BSON_TYPE_ARRAY &&
+      bson_iter_recurse (&i, &h))
     {
-      bson_cursor_free (c);
-      bson_finish (hosts);
-
-      c = bson_cursor_new (hosts);
-      while (bson_cursor_next (c))
+      while (bson_iter_next (&h))
         {
           const gchar *s;
 
-          if (bson_cursor_get_string (c, &s))
+          if (bson_iter_get_string (&h, &s))
             conn->rs.hosts = g_list_append (conn->rs.hosts, g_strdup (s));
         }
-      bson_free (hosts);
     }
-  bson_cursor_free (c);
 
   bson_free (res);
   errno = 0;
@@ -1627,7 +1603,7 @@ mongo_sync_cmd_user_add_with_roles (mongo_sync_connection *conn,
                                     const gchar *pw,
                                     const bson *roles)
 {
-  bson *s, *u;
+  bson *s, *u, *set;
   gchar *userns;
   gchar *hex_digest;
 
@@ -1644,10 +1620,10 @@ mongo_sync_cmd_user_add_with_roles (mongo_sync_connection *conn,
   s = bson_build (BSON_TYPE_STRING, "user", user, -1,
                   BSON_TYPE_NONE);
   bson_finish (s);
-  u = bson_build_full (BSON_TYPE_DOCUMENT, "$set", TRUE,
-                       bson_build (BSON_TYPE_STRING, "pwd", hex_digest, -1,
-                                   BSON_TYPE_NONE),
-                       BSON_TYPE_NONE);
+  u = bson_new ();
+  bson_append_document_begin (u, "$set", &set);
+  bson_append_string (set, "pwd", hex_digest, -1);
+  bson_append_document_end (u, set);
   if (roles)
     bson_append_array (u, "roles", roles);
   bson_finish (u);
@@ -1725,7 +1701,7 @@ mongo_sync_cmd_authenticate (mongo_sync_connection *conn,
   mongo_packet *p;
   const gchar *s;
   gchar *nonce;
-  bson_cursor *c;
+  bson_iter i;
 
   GChecksum *chk;
   gchar *hex_digest;
@@ -1765,21 +1741,14 @@ mongo_sync_cmd_authenticate (mongo_sync_connection *conn,
   mongo_wire_packet_free (p);
   bson_finish (b);
 
-  c = bson_find (b, "nonce");
-  if (!c)
-    {
-      bson_free (b);
-      errno = EPROTO;
-      return FALSE;
-    }
-  if (!bson_cursor_get_string (c, &s))
+  if (!bson_iter_init (&i, b) || !bson_iter_find (&i, "nonce") ||
+      !bson_iter_get_string (&i, &s))
     {
       bson_free (b);
       errno = EPROTO;
       return FALSE;
     }
   nonce = g_strdup (s);
-  bson_cursor_free (c);
   bson_free (b);
 
   /* Generate the password digest. */
@@ -1837,25 +1806,26 @@ mongo_sync_cmd_authenticate (mongo_sync_connection *conn,
 static GString *
 _mongo_index_gen_name (const bson *key)
 {
-  bson_cursor *c;
+  bson_iter i;
   GString *name;
 
   name = g_string_new ("_");
-  c = bson_cursor_new (key);
-  while (bson_cursor_next (c))
+  if (!bson_iter_init (&i, key))
+    return name;
+  while (bson_iter_next (&i))
     {
       gint64 v = 0;
 
-      g_string_append (name, bson_cursor_key (c));
+      g_string_append (name, bson_iter_key (&i));
       g_string_append_c (name, '_');
 
-      switch (bson_cursor_type (c))
+      switch (bson_iter_type (&i))
         {
         case BSON_TYPE_BOOLEAN:
           {
             gboolean vb;
 
-            bson_cursor_get_boolean (c, &vb);
+            bson_iter_get_boolean (&i, &vb);
             v = vb;
             break;
           }
@@ -1863,7 +1833,7 @@ _mongo_index_gen_name (const bson *key)
           {
             gint32 vi;
 
-            bson_cursor_get_int32 (c, &vi);
+            bson_iter_get_int32 (&i, &vi);
             v = vi;
             break;
           }
@@ -1871,7 +1841,7 @@ _mongo_index_gen_name (const bson *key)
           {
             gint64 vl;
 
-            bson_cursor_get_int64 (c, &vl);
+            bson_iter_get_int64 (&i, &vl);
             v = vl;
             break;
           }
@@ -1879,19 +1849,17 @@ _mongo_index_gen_name (const bson *key)
           {
             gdouble vd;
 
-            bson_cursor_get_double (c, &vd);
+            bson_iter_get_double (&i, &vd);
             v = (gint64)vd;
             break;
           }
         default:
-          bson_cursor_free (c);
           g_string_free (name, TRUE);
           return NULL;
         }
       if (v != 0)
         g_string_append_printf (name, "%" G_GINT64_FORMAT "_", v);
     }
-  bson_cursor_free (c);
 
   return name;
 }
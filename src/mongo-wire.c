@@ -603,10 +603,19 @@ mongo_wire_reply_packet_get_data (const mongo_packet *p,
   return TRUE;
 }
 
-gboolean
-mongo_wire_reply_packet_get_nth_document (const mongo_packet *p,
-                                          gint32 n,
-                                          bson **doc)
+/** @internal Locate the Nth document within a reply packet.
+ *
+ * @param p is the packet to locate the document in.
+ * @param n is the number of the document to locate.
+ * @param doc is a pointer to a variable where the start of the
+ * document will be stored.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+static gboolean
+_mongo_wire_reply_packet_find_nth_document (const mongo_packet *p,
+                                            gint32 n,
+                                            const guint8 **doc)
 {
   const guint8 *d;
   mongo_reply_packet_header h;
@@ -640,6 +649,140 @@ mongo_wire_reply_packet_get_nth_document (const mongo_packet *p,
   for (i = 1; i < n; i++)
     pos += bson_stream_doc_size (d, pos);
 
-  *doc = bson_new_from_data (d + pos, bson_stream_doc_size (d, pos) - 1);
+  *doc = d + pos;
+  return TRUE;
+}
+
+gboolean
+mongo_wire_reply_packet_get_nth_document (const mongo_packet *p,
+                                          gint32 n,
+                                          bson **doc)
+{
+  const guint8 *d;
+
+  if (!doc)
+    {
+      errno = EINVAL;
+      return FALSE;
+    }
+
+  if (!_mongo_wire_reply_packet_find_nth_document (p, n, &d))
+    return FALSE;
+
+  *doc = bson_new_from_data (d, bson_stream_doc_size (d, 0) - 1);
+  return TRUE;
+}
+
+gboolean
+mongo_wire_reply_packet_get_nth_document_view (const mongo_packet *p,
+                                               gint32 n,
+                                               bson **doc)
+{
+  const guint8 *d;
+  bson *b;
+
+  if (!doc)
+    {
+      errno = EINVAL;
+      return FALSE;
+    }
+
+  if (!_mongo_wire_reply_packet_find_nth_document (p, n, &d))
+    return FALSE;
+
+  b = bson_new_view (d, bson_stream_doc_size (d, 0));
+  if (!b)
+    {
+      errno = EPROTO;
+      return FALSE;
+    }
+
+  *doc = b;
+  return TRUE;
+}
+
+gint32
+mongo_wire_reply_packet_decode_columns (const mongo_packet *p, gint32 n,
+                                        bson_columns *cols)
+{
+  const guint8 *d, *doc;
+  gint32 decoded;
+
+  if (!cols)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  if (!_mongo_wire_reply_packet_find_nth_document (p, n, &doc) ||
+      !mongo_wire_reply_packet_get_data (p, &d))
+    return -1;
+
+  decoded = bson_columns_append_stream
+    (cols, doc, p->data_size - sizeof (mongo_reply_packet_header) -
+     (doc - d));
+  if (decoded == -1)
+    {
+      errno = EPROTO;
+      return -1;
+    }
+  return decoded;
+}
+
+gboolean
+mongo_wire_reply_packet_validate (const mongo_packet *p, gint flags,
+                                  gint max_depth)
+{
+  mongo_reply_packet_header h;
+  const guint8 *d;
+  gint32 pos = 0, size, doc_size, i;
+
+  if (!p || max_depth < 0)
+    {
+      errno = EINVAL;
+      return FALSE;
+    }
+
+  if (p->header.opcode != OP_REPLY ||
+      p->data_size < (gint32)sizeof (mongo_reply_packet_header))
+    {
+      errno = EPROTO;
+      return FALSE;
+    }
+
+  if (!mongo_wire_reply_packet_get_header (p, &h) ||
+      !mongo_wire_reply_packet_get_data (p, &d))
+    return FALSE;
+
+  size = p->data_size - sizeof (mongo_reply_packet_header);
+  if (h.returned < 0)
+    {
+      errno = EPROTO;
+      return FALSE;
+    }
+
+  for (i = 0; i < h.returned; i++)
+    {
+      if (size - pos < 5)
+        {
+          errno = EPROTO;
+          return FALSE;
+        }
+      doc_size = bson_stream_doc_size (d, pos);
+      if (doc_size < 5 || doc_size > size - pos ||
+          !bson_validate_data (d + pos, doc_size, flags, max_depth))
+        {
+          errno = EPROTO;
+          return FALSE;
+        }
+      pos += doc_size;
+    }
+
+  if (pos != size)
+    {
+      errno = EPROTO;
+      return FALSE;
+    }
+
   return TRUE;
 }
@@ -228,6 +228,59 @@ gboolean mongo_wire_reply_packet_get_nth_document (const mongo_packet *p,
                                                    gint32 n,
                                                    bson **doc);
 
+/** Get a view of the Nth document from a reply packet.
+ *
+ * Like mongo_wire_reply_packet_get_nth_document(), but instead of
+ * copying the document, the returned object is a read-only view
+ * pointing into the packet (see bson_new_view()).
+ *
+ * @param p is the packet to retrieve a document from.
+ * @param n is the number of the document to retrieve.
+ * @param doc is a pointer to a variable to hold the BSON document.
+ *
+ * @note The @a doc variable will be a newly allocated, finished
+ * object, which must be freed with bson_free() once not needed
+ * anymore, and before the packet itself is freed.
+ *
+ * @returns TRUE on success, FALSE otherwise.
+ */
+gboolean mongo_wire_reply_packet_get_nth_document_view (const mongo_packet *p,
+                                                        gint32 n,
+                                                        bson **doc);
+
+/** Validate the documents within a reply packet.
+ *
+ * Verifies that the packet holds exactly as many documents as its
+ * header claims, that they fill the packet completely, and that each
+ * of them passes bson_validate(). Once a packet passed validation,
+ * its documents are safe to walk with cursors.
+ *
+ * @param p is the packet to validate.
+ * @param flags is a combination of #bson_validate_flags.
+ * @param max_depth is the maximum nesting depth allowed within the
+ * documents.
+ *
+ * @returns TRUE if the packet is valid, FALSE otherwise.
+ */
+gboolean mongo_wire_reply_packet_validate (const mongo_packet *p,
+                                           gint flags, gint max_depth);
+
+/** Decode the documents of a reply packet into columns.
+ *
+ * Appends the n-th document of the reply, and every one after it, to
+ * a columnar decoder, without copying any of them.
+ *
+ * @param p is the packet to decode.
+ * @param n is the index of the first document to decode, starting
+ * from one.
+ * @param cols is the columnar decoder to append to.
+ *
+ * @returns The number of documents decoded, or -1 on error.
+ */
+gint32 mongo_wire_reply_packet_decode_columns (const mongo_packet *p,
+                                               gint32 n,
+                                               bson_columns *cols);
+
 /** @}*/
 
 /** @defgroup mongo_wire_cmd Commands
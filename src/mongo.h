@@ -22,6 +22,9 @@
  */
 
 #include <bson.h>
+#include <bson-json.h>
+#include <bson-stream.h>
+#include <bson-struct.h>
 #include <mongo-wire.h>
 #include <mongo-client.h>
 #include <mongo-utils.h>
@@ -41,9 +41,13 @@ mongo_sync_gridfs_chunked_file_free (mongo_sync_gridfs_chunked_file *gfile)
 mongo_sync_gridfs_chunked_file *
 mongo_sync_gridfs_chunked_find (mongo_sync_gridfs *gfs, const bson *query)
 {
+  static const gchar *keys[] =
+    { "_id", "length", "chunkSize", "uploadDate", "md5" };
   mongo_sync_gridfs_chunked_file *f;
   mongo_packet *p;
-  bson_cursor *c;
+  bson_cursor *c[G_N_ELEMENTS (keys)];
+  gboolean valid;
+  guint i;
 
   if (!gfs)
     {
@@ -68,55 +72,34 @@ mongo_sync_gridfs_chunked_find (mongo_sync_gridfs *gfs, const bson *query)
   bson_finish (f->meta.metadata);
   mongo_wire_packet_free (p);
 
-  c = bson_find (f->meta.metadata, "_id");
-  if (!bson_cursor_get_oid (c, &f->meta.oid))
-    {
-      mongo_sync_gridfs_chunked_file_free (f);
-      bson_cursor_free (c);
-      errno = EPROTO;
-      return NULL;
-    }
+  bson_extract (f->meta.metadata, keys, NULL, G_N_ELEMENTS (keys), c);
 
-  bson_cursor_find (c, "length");
-  bson_cursor_get_int64 (c, &f->meta.length);
+  valid = bson_cursor_get_oid (c[0], &f->meta.oid);
 
+  bson_cursor_get_int64 (c[1], &f->meta.length);
   if (f->meta.length == 0)
     {
-      gint32 i = 0;
+      gint32 l = 0;
 
-      bson_cursor_get_int32 (c, &i);
-      f->meta.length = i;
+      bson_cursor_get_int32 (c[1], &l);
+      f->meta.length = l;
     }
 
-  bson_cursor_find (c, "chunkSize");
-  bson_cursor_get_int32 (c, &f->meta.chunk_size);
+  bson_cursor_get_int32 (c[2], &f->meta.chunk_size);
 
-  if (f->meta.length == 0 || f->meta.chunk_size == 0)
-    {
-      bson_cursor_free (c);
-      mongo_sync_gridfs_chunked_file_free (f);
-      errno = EPROTO;
-      return NULL;
-    }
+  valid = valid && f->meta.length != 0 && f->meta.chunk_size != 0 &&
+    bson_cursor_get_utc_datetime (c[3], &f->meta.date) &&
+    bson_cursor_get_string (c[4], &f->meta.md5);
 
-  bson_cursor_find (c, "uploadDate");
-  if (!bson_cursor_get_utc_datetime (c, &f->meta.date))
-    {
-      mongo_sync_gridfs_chunked_file_free (f);
-      bson_cursor_free (c);
-      errno = EPROTO;
-      return NULL;
-    }
+  for (i = 0; i < G_N_ELEMENTS (keys); i++)
+    bson_cursor_free (c[i]);
 
-  bson_cursor_find (c, "md5");
-  if (!bson_cursor_get_string (c, &f->meta.md5))
+  if (!valid)
     {
       mongo_sync_gridfs_chunked_file_free (f);
-      bson_cursor_free (c);
       errno = EPROTO;
       return NULL;
     }
-  bson_cursor_free (c);
 
   return f;
 }
@@ -125,7 +108,7 @@ mongo_sync_cursor *
 mongo_sync_gridfs_chunked_file_cursor_new (mongo_sync_gridfs_chunked_file *gfile,
                                            gint start, gint num)
 {
-  bson *q;
+  bson *q, *sub;
   mongo_sync_cursor *cursor;
   mongo_packet *p;
 
@@ -140,11 +123,13 @@ mongo_sync_gridfs_chunked_file_cursor_new (mongo_sync_gridfs_chunked_file *gfile
       return NULL;
     }
 
-  q = bson_build_full (BSON_TYPE_DOCUMENT, "$query", TRUE,
-                         bson_build (BSON_TYPE_OID, "files_id", gfile->meta.oid, BSON_TYPE_NONE),
-                       BSON_TYPE_DOCUMENT, "$orderby", TRUE,
-                         bson_build (BSON_TYPE_INT32, "n", 1, BSON_TYPE_NONE),
-                       BSON_TYPE_NONE);
+  q = bson_new_sized (64);
+  bson_append_document_begin (q, "$query", &sub);
+  bson_append_oid (sub, "files_id", gfile->meta.oid);
+  bson_append_document_end (q, sub);
+  bson_append_document_begin (q, "$orderby", &sub);
+  bson_append_int32 (sub, "n", 1);
+  bson_append_document_end (q, sub);
   bson_finish (q);
 
   p = mongo_sync_cmd_query (gfile->gfs->conn, gfile->gfs->ns.chunks, 0,
@@ -161,7 +146,7 @@ mongo_sync_gridfs_chunked_file_cursor_get_chunk (mongo_sync_cursor *cursor,
                                                  gint32 *size)
 {
   bson *b;
-  bson_cursor *c;
+  bson_iter i;
   const guint8 *d;
   guint8 *data;
   gint32 s;
@@ -175,16 +160,14 @@ mongo_sync_gridfs_chunked_file_cursor_get_chunk (mongo_sync_cursor *cursor,
     }
 
   b = mongo_sync_cursor_get_data (cursor);
-  c = bson_find (b, "data");
-  r = bson_cursor_get_binary (c, &sub, &d, &s);
+  r = bson_iter_init (&i, b) && bson_iter_find (&i, "data") &&
+    bson_iter_get_binary (&i, &sub, &d, &s);
   if (!r || (sub != BSON_BINARY_SUBTYPE_GENERIC &&
              sub != BSON_BINARY_SUBTYPE_BINARY))
     {
-      bson_cursor_free (c);
       errno = EPROTO;
       return NULL;
     }
-  bson_cursor_free (c);
 
   if (sub == BSON_BINARY_SUBTYPE_BINARY)
     {
@@ -213,7 +196,7 @@ mongo_sync_gridfs_chunked_file_new_from_buffer (mongo_sync_gridfs *gfs,
 {
   mongo_sync_gridfs_chunked_file *gfile;
   bson *meta;
-  bson_cursor *c;
+  bson_iter i;
   guint8 *oid;
   gint64 pos = 0, chunk_n = 0, upload_date;
   GTimeVal tv;
@@ -316,12 +299,13 @@ mongo_sync_gridfs_chunked_file_new_from_buffer (mongo_sync_gridfs *gfs,
   gfile->meta.date = 0;
   gfile->meta.type = LMC_GRIDFS_FILE_CHUNKED;
 
-  c = bson_find (meta, "_id");
-  bson_cursor_get_oid (c, &gfile->meta.oid);
-
-  bson_cursor_find (c, "md5");
-  bson_cursor_get_string (c, &gfile->meta.md5);
-  bson_cursor_free (c);
+  if (bson_iter_init (&i, meta))
+    {
+      if (bson_iter_find (&i, "_id"))
+        bson_iter_get_oid (&i, &gfile->meta.oid);
+      if (bson_iter_find (&i, "md5"))
+        bson_iter_get_string (&i, &gfile->meta.md5);
+    }
 
   g_free (oid);
 
@@ -30,7 +30,7 @@ mongo_sync_gridfs_stream_find (mongo_sync_gridfs *gfs,
 {
   mongo_sync_gridfs_stream *stream;
   bson *meta = NULL;
-  bson_cursor *c;
+  bson_iter i;
   mongo_packet *p;
   const guint8 *oid;
 
@@ -57,10 +57,9 @@ mongo_sync_gridfs_stream_find (mongo_sync_gridfs *gfs,
   bson_finish (meta);
   mongo_wire_packet_free (p);
 
-  c = bson_find (meta, "_id");
-  if (!bson_cursor_get_oid (c, &oid))
+  if (!bson_iter_init (&i, meta) || !bson_iter_find (&i, "_id") ||
+      !bson_iter_get_oid (&i, &oid))
     {
-      bson_cursor_free (c);
       bson_free (meta);
       g_free (stream);
 
@@ -70,20 +69,21 @@ mongo_sync_gridfs_stream_find (mongo_sync_gridfs *gfs,
   stream->file.id = g_malloc (12);
   memcpy (stream->file.id, oid, 12);
 
-  bson_cursor_find (c, "length");
-  bson_cursor_get_int64 (c, &stream->file.length);
-  if (stream->file.length == 0)
+  if (bson_iter_find (&i, "length"))
     {
-      gint32 i = 0;
+      bson_iter_get_int64 (&i, &stream->file.length);
+      if (stream->file.length == 0)
+        {
+          gint32 l = 0;
 
-      bson_cursor_get_int32 (c, &i);
-      stream->file.length = i;
+          bson_iter_get_int32 (&i, &l);
+          stream->file.length = l;
+        }
     }
 
-  bson_cursor_find (c, "chunkSize");
-  bson_cursor_get_int32 (c, &stream->file.chunk_size);
+  if (bson_iter_find (&i, "chunkSize"))
+    bson_iter_get_int32 (&i, &stream->file.chunk_size);
 
-  bson_cursor_free (c);
   bson_free (meta);
 
   if (stream->file.length == 0 ||
@@ -104,7 +104,7 @@ mongo_sync_gridfs_stream_new (mongo_sync_gridfs *gfs,
                               const bson *metadata)
 {
   mongo_sync_gridfs_stream *stream;
-  bson_cursor *c;
+  bson_iter i;
 
   if (!gfs)
     {
@@ -121,8 +121,7 @@ mongo_sync_gridfs_stream_new (mongo_sync_gridfs *gfs,
   stream->writer.metadata = bson_new_from_data (bson_data (metadata),
                                                 bson_size (metadata) - 1);
 
-  c = bson_find (metadata, "_id");
-  if (!c)
+  if (!bson_iter_init (&i, metadata) || !bson_iter_find (&i, "_id"))
     {
       stream->file.id = mongo_util_oid_new
         (mongo_connection_get_requestid ((mongo_connection *)gfs->conn));
@@ -140,9 +139,8 @@ mongo_sync_gridfs_stream_new (mongo_sync_gridfs *gfs,
     {
       const guint8 *oid;
 
-      if (!bson_cursor_get_oid (c, &oid))
+      if (!bson_iter_get_oid (&i, &oid))
         {
-          bson_cursor_free (c);
           bson_free (stream->writer.metadata);
           g_free (stream);
 
@@ -153,7 +151,6 @@ mongo_sync_gridfs_stream_new (mongo_sync_gridfs *gfs,
       stream->file.id = g_malloc (12);
       memcpy (stream->file.id, oid, 12);
     }
-  bson_cursor_free (c);
   bson_finish (stream->writer.metadata);
 
   stream->writer.buffer = g_malloc (stream->file.chunk_size);
@@ -168,7 +165,7 @@ _stream_seek_chunk (mongo_sync_gridfs_stream *stream,
 {
   bson *b;
   mongo_packet *p;
-  bson_cursor *c;
+  bson_iter i;
   bson_binary_subtype subt = BSON_BINARY_SUBTYPE_USER_DEFINED;
   gboolean r;
 
@@ -190,13 +187,13 @@ _stream_seek_chunk (mongo_sync_gridfs_stream *stream,
   mongo_wire_packet_free (p);
   bson_finish (stream->reader.bson);
 
-  c = bson_find (stream->reader.bson, "data");
-  r = bson_cursor_get_binary (c, &subt, &stream->reader.chunk.data,
-                              &stream->reader.chunk.size);
+  r = bson_iter_init (&i, stream->reader.bson) &&
+    bson_iter_find (&i, "data") &&
+    bson_iter_get_binary (&i, &subt, &stream->reader.chunk.data,
+                          &stream->reader.chunk.size);
   if (!r || (subt != BSON_BINARY_SUBTYPE_GENERIC &&
              subt != BSON_BINARY_SUBTYPE_BINARY))
     {
-      bson_cursor_free (c);
       bson_free (stream->reader.bson);
       stream->reader.bson = NULL;
       stream->reader.chunk.data = NULL;
@@ -204,7 +201,6 @@ _stream_seek_chunk (mongo_sync_gridfs_stream *stream,
       errno = EPROTO;
       return FALSE;
     }
-  bson_cursor_free (c);
 
   if (subt == BSON_BINARY_SUBTYPE_BINARY)
     {
@@ -297,21 +297,19 @@ mongo_sync_gridfs_remove (mongo_sync_gridfs *gfs,
   while (mongo_sync_cursor_next (fc))
     {
       bson *meta = mongo_sync_cursor_get_data (fc), *q;
-      bson_cursor *c;
+      bson_iter i;
       const guint8 *ooid;
       guint8 oid[12];
 
-      c = bson_find (meta, "_id");
-      if (!bson_cursor_get_oid (c, &ooid))
+      if (!bson_iter_init (&i, meta) || !bson_iter_find (&i, "_id") ||
+          !bson_iter_get_oid (&i, &ooid))
         {
           bson_free (meta);
-          bson_cursor_free (c);
           mongo_sync_cursor_free (fc);
 
           errno = EPROTO;
           return FALSE;
         }
-      bson_cursor_free (c);
       memcpy (oid, ooid, 12);
       bson_free (meta);
 
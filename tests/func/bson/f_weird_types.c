@@ -6,6 +6,15 @@
 
 #include <string.h>
 
+static void
+_bson_append_raw (bson *b, const guint8 *data, guint size)
+{
+  b->data = g_realloc (b->data, b->len + size);
+  b->alloc = b->len + size;
+  memcpy (b->data + b->len, data, size);
+  b->len += size;
+}
+
 static void
 test_func_weird_types (void)
 {
@@ -18,15 +27,15 @@ test_func_weird_types (void)
   bson_append_int32 (b, "int32", 42);
 
   /* Append weird stuff */
-  b->data = g_byte_array_append (b->data, (const guint8 *)&type, sizeof (type));
-  b->data = g_byte_array_append (b->data, (const guint8 *)"dbpointer",
-                                 strlen ("dbpointer") + 1);
+  _bson_append_raw (b, (const guint8 *)&type, sizeof (type));
+  _bson_append_raw (b, (const guint8 *)"dbpointer",
+                    strlen ("dbpointer") + 1);
   slen = GINT32_TO_LE (strlen ("refname") + 1);
-  b->data = g_byte_array_append (b->data, (const guint8 *)&slen, sizeof (gint32));
-  b->data = g_byte_array_append (b->data, (const guint8 *)"refname",
-                                 strlen ("refname") + 1);
-  b->data = g_byte_array_append (b->data, (const guint8 *)"0123456789ABCDEF",
-                                 12);
+  _bson_append_raw (b, (const guint8 *)&slen, sizeof (gint32));
+  _bson_append_raw (b, (const guint8 *)"refname",
+                    strlen ("refname") + 1);
+  _bson_append_raw (b, (const guint8 *)"0123456789ABCDEF",
+                    12);
 
   bson_append_boolean (b, "Here be dragons?", TRUE);
   bson_finish (b);
@@ -43,11 +52,11 @@ test_func_weird_types (void)
 
   /* Append BSON_TYPE_NONE */
   type = BSON_TYPE_NONE;
-  b->data = g_byte_array_append (b->data, (const guint8 *)&type, sizeof (type));
-  b->data = g_byte_array_append (b->data, (const guint8 *)"dbpointer",
-                                 strlen ("dbpointer") + 1);
-  b->data = g_byte_array_append (b->data, (const guint8 *)"0123456789ABCDEF",
-                                 12);
+  _bson_append_raw (b, (const guint8 *)&type, sizeof (type));
+  _bson_append_raw (b, (const guint8 *)"dbpointer",
+                    strlen ("dbpointer") + 1);
+  _bson_append_raw (b, (const guint8 *)"0123456789ABCDEF",
+                    12);
 
   bson_append_boolean (b, "Here be dragons?", TRUE);
   bson_finish (b);
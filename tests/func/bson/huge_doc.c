@@ -42,10 +42,15 @@ test_bson_huge_doc (void)
 
   cmp_ok (bson_size (b), "==", ds1,
           "The embedded document has the correct, huge size");
+  bson_free (b);
+
+  bson_cursor_get_document_view (c, &b);
+  cmp_ok (bson_size (b), "==", ds1,
+          "The embedded document view has the correct, huge size");
+  bson_free (b);
 
   bson_cursor_free (c);
   bson_free (s);
-  bson_free (b);
 }
 
-RUN_TEST (2, bson_huge_doc);
+RUN_TEST (3, bson_huge_doc);
@@ -0,0 +1,583 @@
+/* bson_bench.c - BSON layer microbenchmarks
+ * Copyright 2011, 2012 Gergely Nagy <algernon@balabit.hu>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs a set of microbenchmarks against the BSON layer, and prints
+ * the results as a JSON document to the standard output. Each result
+ * carries the time and the number of allocations per operation, and
+ * where it makes sense, the throughput in bytes per second.
+ *
+ * Usage: bson_bench [-i ITERATIONS] [-s SIZE[,SIZE...]] [-f FILTER]
+ *
+ * ITERATIONS is the number of operations each benchmark runs, SIZE
+ * is the list of document widths (number of elements) to run the
+ * width-dependent benchmarks with, and FILTER restricts the run to
+ * the benchmarks whose name contains it.
+ */
+
+#include <mongo.h>
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Allocation counting.
+ *
+ * On glibc, the allocator entry points can be interposed by the
+ * program itself, which lets us count the allocations made by the
+ * library (and GLib) without any help from them. Elsewhere, the
+ * allocation counts are reported as null.
+ */
+#if defined(__GLIBC__)
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static guint64 bench_allocs;
+
+void *
+malloc (size_t size)
+{
+  bench_allocs++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+  bench_allocs++;
+  return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  bench_allocs++;
+  return __libc_realloc (ptr, size);
+}
+
+#define BENCH_HAVE_ALLOC_COUNT 1
+#else
+static guint64 bench_allocs;
+#define BENCH_HAVE_ALLOC_COUNT 0
+#endif
+
+/** The state of a single benchmark run. */
+typedef struct
+{
+  const gchar *name; /**< The name of the benchmark. */
+  gint size; /**< The document width, or 0 if not applicable. */
+  GTimer *timer; /**< The timer measuring the run. */
+  guint64 allocs; /**< The allocation counter at the start. */
+} bench_run;
+
+static guint64 bench_iterations = 100000;
+static const gchar *bench_filter = NULL;
+static gboolean bench_first = TRUE;
+
+static gboolean
+bench_begin (bench_run *run, const gchar *name, gint size)
+{
+  if (bench_filter && !strstr (name, bench_filter))
+    return FALSE;
+
+  run->name = name;
+  run->size = size;
+  run->allocs = bench_allocs;
+  run->timer = g_timer_new ();
+
+  return TRUE;
+}
+
+static void
+bench_end (bench_run *run, guint64 ops, guint64 bytes)
+{
+  gdouble elapsed;
+  guint64 allocs;
+
+  elapsed = g_timer_elapsed (run->timer, NULL);
+  allocs = bench_allocs - run->allocs;
+  g_timer_destroy (run->timer);
+
+  if (ops == 0)
+    ops = 1;
+
+  printf ("%s    {\"name\": \"%s\", \"size\": %d, \"ops\": %" G_GUINT64_FORMAT
+          ", \"ns_per_op\": %.3f, ",
+          (bench_first) ? "" : ",\n", run->name, run->size, ops,
+          elapsed * 1e9 / ops);
+  if (BENCH_HAVE_ALLOC_COUNT)
+    printf ("\"allocs_per_op\": %.3f, ", (gdouble) allocs / ops);
+  else
+    printf ("\"allocs_per_op\": null, ");
+  if (bytes && elapsed > 0)
+    printf ("\"bytes_per_sec\": %.0f}", bytes / elapsed);
+  else
+    printf ("\"bytes_per_sec\": null}");
+
+  bench_first = FALSE;
+}
+
+/* Builds a finished document of @a size int32 elements, keyed
+ * "k0", "k1", and so on. */
+static bson *
+bench_doc_int32 (gint size)
+{
+  bson *b;
+  gchar key[32];
+  gint i;
+
+  b = bson_new ();
+  for (i = 0; i < size; i++)
+    {
+      g_snprintf (key, sizeof (key), "k%d", i);
+      bson_append_int32 (b, key, i);
+    }
+  bson_finish (b);
+
+  return b;
+}
+
+/* Builds a finished document of @a size elements of mixed types. */
+static bson *
+bench_doc_mixed (gint size)
+{
+  bson *b;
+  gchar key[32];
+  gint i;
+
+  b = bson_new ();
+  for (i = 0; i < size; i++)
+    {
+      g_snprintf (key, sizeof (key), "k%d", i);
+      switch (i % 4)
+        {
+        case 0:
+          bson_append_int32 (b, key, i);
+          break;
+        case 1:
+          bson_append_string (b, key, "hello world", -1);
+          break;
+        case 2:
+          bson_append_double (b, key, i * 0.5);
+          break;
+        default:
+          bson_append_int64 (b, key, i);
+          break;
+        }
+    }
+  bson_finish (b);
+
+  return b;
+}
+
+/*
+ * Appending
+ */
+
+static void
+bench_append (bson_type type, const gchar *name, gint size)
+{
+  static const guint8 oid[] = "1234567890ab";
+  static const guint8 bin[] = "binary\0data";
+  bench_run run;
+  bson *b, *sub, *scope;
+  guint64 i;
+
+  sub = bench_doc_int32 (4);
+  scope = bench_doc_int32 (1);
+  b = bson_new ();
+
+  if (!bench_begin (&run, name, size))
+    goto out;
+
+  for (i = 0; i < bench_iterations; i++)
+    {
+      if (i % size == 0)
+        bson_reset (b);
+
+      switch (type)
+        {
+        case BSON_TYPE_DOUBLE:
+          bson_append_double (b, "double", 3.14);
+          break;
+        case BSON_TYPE_STRING:
+          bson_append_string (b, "string", "hello world", -1);
+          break;
+        case BSON_TYPE_DOCUMENT:
+          bson_append_document (b, "document", sub);
+          break;
+        case BSON_TYPE_ARRAY:
+          bson_append_array (b, "array", sub);
+          break;
+        case BSON_TYPE_BINARY:
+          bson_append_binary (b, "binary", BSON_BINARY_SUBTYPE_GENERIC,
+                              bin, sizeof (bin) - 1);
+          break;
+        case BSON_TYPE_OID:
+          bson_append_oid (b, "_id", oid);
+          break;
+        case BSON_TYPE_BOOLEAN:
+          bson_append_boolean (b, "boolean", TRUE);
+          break;
+        case BSON_TYPE_UTC_DATETIME:
+          bson_append_utc_datetime (b, "date", 1294860709000);
+          break;
+        case BSON_TYPE_NULL:
+          bson_append_null (b, "null");
+          break;
+        case BSON_TYPE_REGEXP:
+          bson_append_regex (b, "regex", "s/foo.*bar/", "i");
+          break;
+        case BSON_TYPE_JS_CODE:
+          bson_append_javascript (b, "js", "alert (\"hello\");", -1);
+          break;
+        case BSON_TYPE_SYMBOL:
+          bson_append_symbol (b, "symbol", "symbol", -1);
+          break;
+        case BSON_TYPE_JS_CODE_W_SCOPE:
+          bson_append_javascript_w_scope (b, "js", "alert (k0);", -1,
+                                          scope);
+          break;
+        case BSON_TYPE_INT32:
+          bson_append_int32 (b, "int32", 42);
+          break;
+        case BSON_TYPE_TIMESTAMP:
+          bson_append_timestamp (b, "ts", 1294860709000);
+          break;
+        case BSON_TYPE_INT64:
+          bson_append_int64 (b, "int64", 42);
+          break;
+        default:
+          break;
+        }
+    }
+
+  bench_end (&run, bench_iterations, 0);
+
+ out:
+  bson_free (b);
+  bson_free (scope);
+  bson_free (sub);
+}
+
+static void
+bench_build (void)
+{
+  static const guint8 oid[] = "1234567890ab";
+  bench_run run;
+  bson *b;
+  guint64 i, bytes = 0;
+
+  if (!bench_begin (&run, "build", 0))
+    return;
+
+  for (i = 0; i < bench_iterations; i++)
+    {
+      b = bson_build (BSON_TYPE_OID, "_id", oid,
+                      BSON_TYPE_STRING, "name", "hello world", -1,
+                      BSON_TYPE_INT32, "count", 42,
+                      BSON_TYPE_DOUBLE, "score", 3.14,
+                      BSON_TYPE_UTC_DATETIME, "date", 1294860709000,
+                      BSON_TYPE_BOOLEAN, "active", TRUE,
+                      BSON_TYPE_NONE);
+      bson_finish (b);
+      bytes += bson_size (b);
+      bson_free (b);
+    }
+
+  bench_end (&run, bench_iterations, bytes);
+}
+
+static void
+bench_finish (void)
+{
+  bench_run run;
+  bson *b;
+  guint64 i;
+
+  b = bson_new ();
+  if (bench_begin (&run, "finish", 0))
+    {
+      for (i = 0; i < bench_iterations; i++)
+        {
+          bson_reset (b);
+          bson_finish (b);
+        }
+      bench_end (&run, bench_iterations, 0);
+    }
+  bson_free (b);
+}
+
+/*
+ * Retrieval
+ */
+
+static void
+bench_cursor_next (gint size)
+{
+  bench_run run;
+  bson *b;
+  bson_cursor *c;
+  guint64 ops = 0, bytes = 0;
+
+  b = bench_doc_mixed (size);
+  if (bench_begin (&run, "cursor_next", size))
+    {
+      while (ops < bench_iterations)
+        {
+          c = bson_cursor_new (b);
+          while (bson_cursor_next (c))
+            ops++;
+          bson_cursor_free (c);
+          bytes += bson_size (b);
+        }
+      bench_end (&run, ops, bytes);
+    }
+  bson_free (b);
+}
+
+static gboolean
+_bench_visit_count (const bson_iter *i, gint depth, gpointer user_data)
+{
+  (*(guint64 *)user_data)++;
+  return TRUE;
+}
+
+static void
+bench_visit (gint size)
+{
+  bench_run run;
+  bson *b;
+  bson_visitor v;
+  guint64 ops = 0, bytes = 0;
+
+  memset (&v, 0, sizeof (v));
+  v.visit_before = _bench_visit_count;
+
+  b = bench_doc_mixed (size);
+  if (bench_begin (&run, "visit", size))
+    {
+      while (ops < bench_iterations)
+        {
+          bson_visit (b, &v, BSON_VISIT_RECURSE, &ops);
+          bytes += bson_size (b);
+        }
+      bench_end (&run, ops, bytes);
+    }
+  bson_free (b);
+}
+
+static void
+bench_find (gint size, gboolean indexed)
+{
+  bench_run run;
+  bson *b;
+  bson_cursor *c;
+  gchar **keys;
+  guint64 i;
+  gint k;
+
+  b = bench_doc_int32 (size);
+  bson_set_key_index (b, indexed);
+
+  keys = g_new (gchar *, size);
+  for (k = 0; k < size; k++)
+    keys[k] = g_strdup_printf ("k%d", k);
+
+  if (bench_begin (&run, (indexed) ? "find_indexed" : "find", size))
+    {
+      for (i = 0; i < bench_iterations; i++)
+        {
+          c = bson_find (b, keys[i % size]);
+          bson_cursor_free (c);
+        }
+      bench_end (&run, bench_iterations, 0);
+    }
+
+  for (k = 0; k < size; k++)
+    g_free (keys[k]);
+  g_free (keys);
+  bson_free (b);
+}
+
+static void
+bench_subdocument (gint size)
+{
+  bench_run run;
+  bson *b, *sub, *view;
+  bson_cursor *c;
+  gchar key[32];
+  guint64 i;
+  gint32 v;
+  gint k;
+
+  sub = bench_doc_int32 (size);
+  b = bson_new ();
+  for (k = 0; k < size; k++)
+    {
+      g_snprintf (key, sizeof (key), "k%d", k);
+      bson_append_int32 (b, key, k);
+    }
+  bson_append_document (b, "sub", sub);
+  bson_finish (b);
+  g_snprintf (key, sizeof (key), "sub.k%d", size - 1);
+
+  if (bench_begin (&run, "find_path", size))
+    {
+      for (i = 0; i < bench_iterations; i++)
+        {
+          c = bson_find_path (b, key);
+          bson_cursor_get_int32 (c, &v);
+          bson_cursor_free (c);
+        }
+      bench_end (&run, bench_iterations, 0);
+    }
+
+  if (bench_begin (&run, "get_document_view", size))
+    {
+      for (i = 0; i < bench_iterations; i++)
+        {
+          c = bson_find (b, "sub");
+          bson_cursor_get_document_view (c, &view);
+          bson_free (view);
+          bson_cursor_free (c);
+        }
+      bench_end (&run, bench_iterations, 0);
+    }
+
+  if (bench_begin (&run, "get_document", size))
+    {
+      for (i = 0; i < bench_iterations; i++)
+        {
+          c = bson_find (b, "sub");
+          bson_cursor_get_document (c, &view);
+          bson_free (view);
+          bson_cursor_free (c);
+        }
+      bench_end (&run, bench_iterations, (guint64)bson_size (sub) *
+                 bench_iterations);
+    }
+
+  bson_free (b);
+  bson_free (sub);
+}
+
+static void
+bench_new_from_data (gint size)
+{
+  bench_run run;
+  bson *b, *copy;
+  guint64 i;
+
+  b = bench_doc_mixed (size);
+  if (bench_begin (&run, "new_from_data", size))
+    {
+      for (i = 0; i < bench_iterations; i++)
+        {
+          copy = bson_new_from_data (bson_data (b), bson_size (b) - 1);
+          bson_finish (copy);
+          bson_free (copy);
+        }
+      bench_end (&run, bench_iterations,
+                 (guint64)bson_size (b) * bench_iterations);
+    }
+  bson_free (b);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const struct
+  {
+    bson_type type;
+    const gchar *name;
+  } append_types[] = {
+    { BSON_TYPE_DOUBLE, "append_double" },
+    { BSON_TYPE_STRING, "append_string" },
+    { BSON_TYPE_DOCUMENT, "append_document" },
+    { BSON_TYPE_ARRAY, "append_array" },
+    { BSON_TYPE_BINARY, "append_binary" },
+    { BSON_TYPE_OID, "append_oid" },
+    { BSON_TYPE_BOOLEAN, "append_boolean" },
+    { BSON_TYPE_UTC_DATETIME, "append_utc_datetime" },
+    { BSON_TYPE_NULL, "append_null" },
+    { BSON_TYPE_REGEXP, "append_regex" },
+    { BSON_TYPE_JS_CODE, "append_javascript" },
+    { BSON_TYPE_SYMBOL, "append_symbol" },
+    { BSON_TYPE_JS_CODE_W_SCOPE, "append_javascript_w_scope" },
+    { BSON_TYPE_INT32, "append_int32" },
+    { BSON_TYPE_TIMESTAMP, "append_timestamp" },
+    { BSON_TYPE_INT64, "append_int64" }
+  };
+  const gchar *size_list = "10,100,1000";
+  gchar **sizes;
+  gint opt, i, s, size;
+
+  while ((opt = getopt (argc, argv, "i:s:f:")) != -1)
+    {
+      switch (opt)
+        {
+        case 'i':
+          bench_iterations = g_ascii_strtoull (optarg, NULL, 10);
+          break;
+        case 's':
+          size_list = optarg;
+          break;
+        case 'f':
+          bench_filter = optarg;
+          break;
+        default:
+          fprintf (stderr, "Usage: %s [-i ITERATIONS] [-s SIZE[,SIZE...]] "
+                   "[-f FILTER]\n", argv[0]);
+          return 1;
+        }
+    }
+  if (bench_iterations == 0)
+    bench_iterations = 1;
+
+  sizes = g_strsplit (size_list, ",", -1);
+
+  printf ("{\n  \"library\": \"libmongo-client\",\n"
+          "  \"iterations\": %" G_GUINT64_FORMAT ",\n"
+          "  \"results\": [\n", bench_iterations);
+
+  for (s = 0; sizes[s]; s++)
+    {
+      size = atoi (sizes[s]);
+      if (size <= 0)
+        continue;
+
+      for (i = 0; i < (gint) G_N_ELEMENTS (append_types); i++)
+        bench_append (append_types[i].type, append_types[i].name, size);
+      bench_cursor_next (size);
+      bench_visit (size);
+      bench_find (size, FALSE);
+      bench_find (size, TRUE);
+      bench_subdocument (size);
+      bench_new_from_data (size);
+    }
+  bench_build ();
+  bench_finish ();
+
+  printf ("\n  ]\n}\n");
+
+  g_strfreev (sizes);
+
+  return 0;
+}
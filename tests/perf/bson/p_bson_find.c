@@ -5,39 +5,66 @@
 
 #define MAX_KEYS 10000
 
-void
-test_p_bson_find (void)
+static gboolean
+_p_bson_find (gint nkeys, gboolean indexed, gdouble *elapsed)
 {
   bson *b;
   bson_cursor *c;
   gint i;
   gchar **keys;
   gboolean ret = TRUE;
+  GTimer *timer;
 
-  keys = g_new(gchar *, MAX_KEYS);
+  keys = g_new(gchar *, nkeys);
 
   b = bson_new ();
-  for (i = 0; i < MAX_KEYS; i++)
+  for (i = 0; i < nkeys; i++)
     {
       keys[i] = g_strdup_printf ("tmp_key_%d", i);
       bson_append_int32 (b, keys[i], i);
     }
   bson_finish (b);
+  bson_set_key_index (b, indexed);
 
-  for (i = 1; i <= MAX_KEYS; i++)
+  timer = g_timer_new ();
+  for (i = 1; i <= nkeys; i++)
     {
       c = bson_find (b, keys[i - 1]);
       if (!c)
         ret = FALSE;
       bson_cursor_free (c);
-      g_free (keys[i - 1]);
     }
+  *elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
 
+  for (i = 0; i < nkeys; i++)
+    g_free (keys[i]);
   bson_free (b);
   g_free (keys);
 
+  return ret;
+}
+
+void
+test_p_bson_find (void)
+{
+  gint nkeys;
+  gdouble plain, indexed;
+  gboolean ret = TRUE, ret_indexed = TRUE;
+
+  for (nkeys = 10; nkeys <= MAX_KEYS; nkeys *= 10)
+    {
+      ret &= _p_bson_find (nkeys, FALSE, &plain);
+      ret_indexed &= _p_bson_find (nkeys, TRUE, &indexed);
+
+      note ("%5d keys: %10.3f us/lookup linear, %10.3f us/lookup indexed",
+            nkeys, plain * 1e6 / nkeys, indexed * 1e6 / nkeys);
+    }
+
   ok (ret == TRUE,
       "bson_find() performance test ok");
+  ok (ret_indexed == TRUE,
+      "indexed bson_find() performance test ok");
 }
 
-RUN_TEST (1, p_bson_find);
+RUN_TEST (2, p_bson_find);
@@ -0,0 +1,49 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_append_array_begin (void)
+{
+  bson *b, *e, *a, *child;
+  bson_cursor *c;
+
+  a = bson_new ();
+  bson_append_int32 (a, "0", 32);
+  bson_append_int64 (a, "1", (gint64)-42);
+  bson_finish (a);
+  e = bson_new ();
+  bson_append_array (e, "array", a);
+  bson_finish (e);
+  bson_free (a);
+
+  ok (bson_append_array_begin (NULL, "array", &child) == FALSE,
+      "bson_append_array_begin() fails with a NULL object");
+
+  b = bson_new ();
+  ok (bson_append_array_begin (b, "array", &child),
+      "bson_append_array_begin() works");
+  bson_append_int32 (child, "0", 32);
+  bson_append_int64 (child, "1", (gint64)-42);
+  ok (bson_append_array_end (NULL, child) == FALSE &&
+      bson_append_array_end (b, NULL) == FALSE,
+      "bson_append_array_end() fails with NULL arguments");
+  ok (bson_append_array_end (b, child),
+      "bson_append_array_end() works");
+  bson_finish (b);
+
+  ok (bson_size (b) == bson_size (e) &&
+      memcmp (bson_data (b), bson_data (e), bson_size (b)) == 0,
+      "The object is the same as one built with bson_append_array()");
+
+  c = bson_find (b, "array");
+  cmp_ok (bson_cursor_type (c), "==", BSON_TYPE_ARRAY,
+          "The element has the array type");
+  bson_cursor_free (c);
+
+  bson_free (b);
+  bson_free (e);
+}
+
+RUN_TEST (6, bson_append_array_begin);
@@ -0,0 +1,104 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_append_document_begin (void)
+{
+  bson *b, *e, *d, *inner, *child, *grandchild;
+  bson_arena *arena;
+  gint i;
+
+  /* The expected result, built the old way. */
+  inner = bson_new ();
+  bson_append_int32 (inner, "deep", 42);
+  bson_finish (inner);
+  d = bson_new ();
+  bson_append_string (d, "name", "sub-document", -1);
+  bson_append_document (d, "inner", inner);
+  bson_finish (d);
+  e = bson_new ();
+  bson_append_int32 (e, "before", 1);
+  bson_append_document (e, "doc", d);
+  bson_append_int32 (e, "after", 2);
+  bson_finish (e);
+  bson_free (inner);
+  bson_free (d);
+
+  ok (bson_append_document_begin (NULL, "doc", &child) == FALSE,
+      "bson_append_document_begin() fails with a NULL object");
+
+  b = bson_new_sized (8);
+  ok (bson_append_document_begin (b, NULL, &child) == FALSE,
+      "bson_append_document_begin() fails with a NULL key");
+  ok (bson_append_document_begin (b, "doc", NULL) == FALSE,
+      "bson_append_document_begin() fails with a NULL destination");
+
+  bson_append_int32 (b, "before", 1);
+  ok (bson_append_document_begin (b, "doc", &child),
+      "bson_append_document_begin() works");
+  ok (bson_append_int32 (b, "oops", 1) == FALSE &&
+      bson_finish (b) == FALSE,
+      "The parent cannot be appended to or finished while a child is open");
+  ok (bson_finish (child) == FALSE && bson_reset (child) == FALSE,
+      "Children cannot be finished or reset");
+
+  bson_append_string (child, "name", "sub-document", -1);
+  ok (bson_append_document_begin (child, "inner", &grandchild),
+      "Children can have children of their own");
+  bson_append_int32 (grandchild, "deep", 42);
+  ok (bson_append_document_end (b, grandchild) == FALSE &&
+      bson_append_document_end (b, child) == FALSE,
+      "bson_append_document_end() fails with the wrong parent, or with "
+      "open children");
+  ok (bson_append_document_end (child, grandchild) &&
+      bson_append_document_end (b, child),
+      "bson_append_document_end() works");
+  ok (bson_append_document_end (b, child) == FALSE,
+      "bson_append_document_end() fails if there is no open child");
+
+  bson_append_int32 (b, "after", 2);
+  bson_finish (b);
+
+  ok (bson_size (b) == bson_size (e) &&
+      memcmp (bson_data (b), bson_data (e), bson_size (b)) == 0,
+      "The object is the same as one built with bson_append_document()");
+  bson_free (b);
+
+  /* Children large enough to make the parent grow. */
+  b = bson_new_sized (8);
+  bson_append_document_begin (b, "doc", &child);
+  for (i = 0; i < 1000; i++)
+    bson_append_int32 (child, "some-key", i);
+  bson_append_document_end (b, child);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_NONE, BSON_VALIDATE_MAX_DEPTH) &&
+      bson_size (b) == 4 + 1 + 4 + 4 + 1000 * 14 + 1 + 1,
+      "The parent grows as the child is written to");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_document_begin (b, "doc", &child);
+  bson_append_document_begin (child, "inner", &grandchild);
+  bson_free (grandchild);
+  bson_free (b);
+  pass ("Freeing the parent frees the open children");
+
+  arena = bson_arena_new (64);
+  b = bson_new_in_arena (arena, 8);
+  bson_append_document_begin (b, "doc", &child);
+  bson_append_string (child, "name", "sub-document", -1);
+  bson_append_document_begin (child, "inner", &grandchild);
+  bson_append_int32 (grandchild, "deep", 42);
+  bson_append_document_end (child, grandchild);
+  bson_append_document_end (b, child);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_NONE, BSON_VALIDATE_MAX_DEPTH),
+      "Children can be built in place within arenas");
+  bson_arena_free (arena);
+
+  bson_free (e);
+}
+
+RUN_TEST (14, bson_append_document_begin);
@@ -0,0 +1,67 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_append_element_from_cursor (void)
+{
+  bson *src, *b, *child;
+  bson_cursor *c;
+  gint32 i;
+
+  src = test_bson_generate_full ();
+  b = bson_new ();
+
+  ok (bson_append_element_from_cursor (b, NULL, NULL) == FALSE,
+      "bson_append_element_from_cursor() with a NULL cursor fails");
+
+  c = bson_cursor_new (src);
+  ok (bson_append_element_from_cursor (b, NULL, c) == FALSE,
+      "bson_append_element_from_cursor() at the initial position fails");
+
+  while (bson_cursor_next (c))
+    if (!bson_append_element_from_cursor (b, NULL, c))
+      break;
+  bson_cursor_free (c);
+  bson_finish (b);
+  ok (bson_equal (b, src),
+      "Copying every element of an object yields an identical object");
+
+  c = bson_find (src, "int32");
+  ok (bson_append_element_from_cursor (b, NULL, c) == FALSE,
+      "bson_append_element_from_cursor() to a finished object fails");
+  bson_free (b);
+
+  b = bson_new ();
+  ok (bson_append_element_from_cursor (b, "renamed", c),
+      "bson_append_element_from_cursor() with a new name works");
+  bson_finish (b);
+  bson_cursor_free (c);
+
+  c = bson_find (b, "renamed");
+  ok (bson_cursor_get_int32 (c, &i) && i == 32,
+      "The copied element has the new name and the original value");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_document_begin (b, "sub", &child);
+  c = bson_find (src, "doc");
+  ok (bson_append_element_from_cursor (child, NULL, c),
+      "bson_append_element_from_cursor() into an embedded document works");
+  bson_cursor_free (c);
+  bson_append_document_end (b, child);
+  bson_finish (b);
+
+  c = bson_find_path (b, "sub.doc.answer");
+  ok (bson_cursor_get_int32 (c, &i) && i == 42,
+      "Embedded documents are copied whole");
+  bson_cursor_free (c);
+
+  bson_free (b);
+  bson_free (src);
+}
+
+RUN_TEST (8, bson_append_element_from_cursor);
@@ -0,0 +1,104 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_append_k (void)
+{
+  bson *b, *e, *d, *scope;
+  bson_key *k[16];
+  const gchar *names[] = { "double", "str", "doc", "array", "binary",
+                           "_id", "TRUE", "date", "null", "regex",
+                           "js", "symbol", "js_w_scope", "int32",
+                           "ts", "int64" };
+  guint8 oid[] = "1234567890ab";
+  gint i;
+
+  for (i = 0; i < 16; i++)
+    k[i] = bson_key_new (names[i]);
+
+  d = bson_new ();
+  bson_append_int32 (d, "answer", 42);
+  bson_finish (d);
+
+  scope = bson_new ();
+  bson_append_string (scope, "v", "hello world", -1);
+  bson_finish (scope);
+
+  e = bson_new ();
+  bson_append_double (e, "double", 3.14);
+  bson_append_string (e, "str", "hello world", 5);
+  bson_append_document (e, "doc", d);
+  bson_append_array (e, "array", d);
+  bson_append_binary (e, "binary", BSON_BINARY_SUBTYPE_GENERIC,
+                      (guint8 *)"foo\0bar", 7);
+  bson_append_oid (e, "_id", oid);
+  bson_append_boolean (e, "TRUE", TRUE);
+  bson_append_utc_datetime (e, "date", 1294860709000);
+  bson_append_null (e, "null");
+  bson_append_regex (e, "regex", "s/foo.*bar/", "i");
+  bson_append_javascript (e, "js", "alert (\"hello world!\");", -1);
+  bson_append_symbol (e, "symbol", "Marilyn Monroe", -1);
+  bson_append_javascript_w_scope (e, "js_w_scope", "alert (v);", -1, scope);
+  bson_append_int32 (e, "int32", 32);
+  bson_append_timestamp (e, "ts", 1294860709000);
+  bson_append_int64 (e, "int64", (gint64)-42);
+  bson_finish (e);
+
+  b = bson_new ();
+  ok (bson_append_double_k (b, k[0], 3.14) &&
+      bson_append_string_k (b, k[1], "hello world", 5) &&
+      bson_append_document_k (b, k[2], d) &&
+      bson_append_array_k (b, k[3], d) &&
+      bson_append_binary_k (b, k[4], BSON_BINARY_SUBTYPE_GENERIC,
+                            (guint8 *)"foo\0bar", 7) &&
+      bson_append_oid_k (b, k[5], oid) &&
+      bson_append_boolean_k (b, k[6], TRUE) &&
+      bson_append_utc_datetime_k (b, k[7], 1294860709000) &&
+      bson_append_null_k (b, k[8]) &&
+      bson_append_regex_k (b, k[9], "s/foo.*bar/", "i") &&
+      bson_append_javascript_k (b, k[10], "alert (\"hello world!\");", -1) &&
+      bson_append_symbol_k (b, k[11], "Marilyn Monroe", -1) &&
+      bson_append_javascript_w_scope_k (b, k[12], "alert (v);", -1,
+                                        scope) &&
+      bson_append_int32_k (b, k[13], 32) &&
+      bson_append_timestamp_k (b, k[14], 1294860709000) &&
+      bson_append_int64_k (b, k[15], (gint64)-42),
+      "bson_append_*_k() work");
+  bson_finish (b);
+
+  cmp_ok (bson_size (b), "==", bson_size (e),
+          "The object has the same size as one built without keys");
+  ok (memcmp (bson_data (b), bson_data (e), bson_size (b)) == 0,
+      "The object is identical to one built without keys");
+
+  ok (bson_append_int32_k (b, k[13], 1) == FALSE,
+      "bson_append_*_k() fail with a finished object");
+  bson_free (b);
+
+  b = bson_new ();
+  ok (bson_append_int32_k (b, NULL, 1) == FALSE &&
+      bson_append_string_k (b, NULL, "s", -1) == FALSE &&
+      bson_append_null_k (b, NULL) == FALSE &&
+      bson_append_oid_k (b, NULL, oid) == FALSE,
+      "bson_append_*_k() fail with a NULL key");
+  ok (bson_append_int32_k (NULL, k[13], 1) == FALSE,
+      "bson_append_*_k() fail with a NULL object");
+  ok (bson_append_string_k (b, k[1], NULL, -1) == FALSE &&
+      bson_append_binary_k (b, k[4], BSON_BINARY_SUBTYPE_GENERIC,
+                            NULL, 1) == FALSE,
+      "bson_append_*_k() validate their values the same way");
+  bson_finish (b);
+  cmp_ok (bson_size (b), "==", 5,
+          "Failed appends leave the object untouched");
+  bson_free (b);
+
+  for (i = 0; i < 16; i++)
+    bson_key_free (k[i]);
+  bson_free (d);
+  bson_free (e);
+  bson_free (scope);
+}
+
+RUN_TEST (8, bson_append_k);
@@ -0,0 +1,43 @@
+#include "bson.h"
+#include "test.h"
+#include "tap.h"
+
+void
+test_bson_arena_reset (void)
+{
+  bson_arena *arena;
+  bson *b;
+  const guint8 *first;
+  gint i;
+
+  ok (bson_arena_reset (NULL) == FALSE,
+      "bson_arena_reset(NULL) should fail");
+
+  arena = bson_arena_new (1024);
+
+  b = bson_new_in_arena (arena, 0);
+  bson_append_int32 (b, "int32", 32);
+  bson_finish (b);
+  first = bson_data (b);
+
+  for (i = 0; i < 100; i++)
+    {
+      b = bson_new_in_arena (arena, 0);
+      bson_append_string (b, "str", "hello world", -1);
+      bson_finish (b);
+    }
+
+  ok (bson_arena_reset (arena), "bson_arena_reset() works");
+
+  b = bson_new_in_arena (arena, 0);
+  bson_append_int32 (b, "int32", 32);
+  bson_finish (b);
+  ok (bson_data (b) == first,
+      "Memory is reused after bson_arena_reset()");
+  cmp_ok (bson_size (b), "==", 16,
+          "Objects built after a reset are correct");
+
+  bson_arena_free (arena);
+}
+
+RUN_TEST (4, bson_arena_reset);
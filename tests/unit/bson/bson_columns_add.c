@@ -0,0 +1,49 @@
+#include "tap.h"
+#include "test.h"
+
+#include <bson.h>
+#include <string.h>
+
+void
+test_bson_columns_add (void)
+{
+  bson_columns *cols;
+  bson *b;
+
+  cols = bson_columns_new ();
+  ok (cols != NULL, "bson_columns_new() works");
+
+  ok (bson_columns_add (NULL, "a", BSON_TYPE_INT32) == -1,
+      "bson_columns_add() fails with a NULL decoder");
+  ok (bson_columns_add (cols, NULL, BSON_TYPE_INT32) == -1,
+      "bson_columns_add() fails with a NULL path");
+  ok (bson_columns_add (cols, "", BSON_TYPE_INT32) == -1,
+      "bson_columns_add() fails with an empty path");
+  ok (bson_columns_add (cols, "a", BSON_TYPE_STRING) == -1,
+      "bson_columns_add() fails with unsupported types");
+
+  ok (bson_columns_add (cols, "a", BSON_TYPE_INT32) == 0 &&
+      bson_columns_add (cols, "b.c", BSON_TYPE_DOUBLE) == 1,
+      "bson_columns_add() returns the index of the new column");
+
+  b = bson_new ();
+  bson_append_int32 (b, "a", 1);
+  bson_finish (b);
+  bson_columns_append (cols, bson_data (b), bson_size (b));
+  ok (bson_columns_add (cols, "c", BSON_TYPE_INT64) == -1,
+      "bson_columns_add() fails when the decoder has rows");
+
+  bson_columns_reset (cols);
+  ok (bson_columns_add (cols, "c", BSON_TYPE_INT64) == 2,
+      "bson_columns_add() works again after a reset");
+  bson_columns_append (cols, bson_data (b), bson_size (b));
+  ok (bson_columns_rows (cols) == 1 &&
+      bson_columns_values (cols, 2) != NULL &&
+      (bson_columns_validity (cols, 2)[0] & 1) == 0,
+      "Columns added after a reset are usable");
+
+  bson_free (b);
+  bson_columns_free (cols);
+}
+
+RUN_TEST (9, bson_columns_add);
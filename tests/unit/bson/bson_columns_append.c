@@ -0,0 +1,146 @@
+#include "tap.h"
+#include "test.h"
+
+#include <bson.h>
+#include <string.h>
+
+#define VALID(cols, col, row) \
+  ((bson_columns_validity (cols, col)[(row) / 8] >> ((row) % 8)) & 1)
+
+void
+test_bson_columns_append (void)
+{
+  bson_columns *cols;
+  bson *b;
+  const gint32 *i32;
+  const gint64 *i64, *date, *ts;
+  const gdouble *dbl, *sub;
+  const guint8 *bools;
+  gint i;
+  gboolean all_ok = TRUE;
+
+  cols = bson_columns_new ();
+  bson_columns_add (cols, "int32", BSON_TYPE_INT32);
+  bson_columns_add (cols, "int64", BSON_TYPE_INT64);
+  bson_columns_add (cols, "double", BSON_TYPE_DOUBLE);
+  bson_columns_add (cols, "date", BSON_TYPE_UTC_DATETIME);
+  bson_columns_add (cols, "ts", BSON_TYPE_TIMESTAMP);
+  bson_columns_add (cols, "TRUE", BSON_TYPE_BOOLEAN);
+  bson_columns_add (cols, "doc.answer", BSON_TYPE_DOUBLE);
+  bson_columns_add (cols, "str", BSON_TYPE_INT32);
+  bson_columns_add (cols, "missing", BSON_TYPE_INT32);
+
+  b = test_bson_generate_full ();
+
+  ok (bson_columns_append (NULL, bson_data (b), bson_size (b)) == FALSE,
+      "bson_columns_append() fails with a NULL decoder");
+  ok (bson_columns_append (cols, NULL, 0) == FALSE,
+      "bson_columns_append() fails with NULL data");
+  ok (bson_columns_append (cols, bson_data (b), bson_size (b) - 1) == FALSE,
+      "bson_columns_append() fails if the size does not match");
+  ok (bson_columns_values (cols, 0) == NULL,
+      "bson_columns_values() returns NULL without rows");
+
+  ok (bson_columns_append (cols, bson_data (b), bson_size (b)),
+      "bson_columns_append() works");
+
+  i32 = bson_columns_values (cols, 0);
+  i64 = bson_columns_values (cols, 1);
+  dbl = bson_columns_values (cols, 2);
+  date = bson_columns_values (cols, 3);
+  ts = bson_columns_values (cols, 4);
+  bools = bson_columns_values (cols, 5);
+  sub = bson_columns_values (cols, 6);
+
+  ok (i32[0] == 32 && i64[0] == -42 && dbl[0] == 3.14 &&
+      date[0] == 1294860709000 && ts[0] == 1294860709000 &&
+      bools[0] == 0,
+      "Top-level values are decoded");
+  ok (sub[0] == 42.0 && VALID (cols, 6, 0),
+      "Dotted paths are decoded, with numeric conversion");
+  ok (!VALID (cols, 7, 0) && !VALID (cols, 8, 0) && VALID (cols, 0, 0),
+      "Missing fields and mismatching types are marked invalid");
+  ok (bson_columns_values (cols, 9) == NULL &&
+      bson_columns_validity (cols, -1) == NULL,
+      "Out of range columns are rejected");
+  bson_free (b);
+
+  /* Many rows, with the field moving around. */
+  for (i = 1; i < 1000; i++)
+    {
+      b = bson_new ();
+      if (i % 3)
+        bson_append_int32 (b, "pad", i);
+      if (i % 7)
+        bson_append_int32 (b, "int32", i);
+      bson_finish (b);
+      bson_columns_append (cols, bson_data (b), bson_size (b));
+      bson_free (b);
+    }
+  i32 = bson_columns_values (cols, 0);
+  for (i = 1; i < 1000; i++)
+    {
+      if ((i % 7) && (!VALID (cols, 0, i) || i32[i] != i))
+        all_ok = FALSE;
+      if (!(i % 7) && (VALID (cols, 0, i) || i32[i] != 0))
+        all_ok = FALSE;
+    }
+  ok (bson_columns_rows (cols) == 1000 && all_ok,
+      "Columns grow, and follow fields between documents");
+
+  bson_columns_free (cols);
+
+  /* Fields named like the column within other values. */
+  cols = bson_columns_new ();
+  bson_columns_add (cols, "x", BSON_TYPE_INT64);
+
+  b = bson_build (BSON_TYPE_INT32, "a", 1,
+                  BSON_TYPE_INT32, "x", 5,
+                  BSON_TYPE_NONE);
+  bson_finish (b);
+  bson_columns_append (cols, bson_data (b), bson_size (b));
+  bson_free (b);
+
+  b = bson_build_full (BSON_TYPE_DOCUMENT, "a", TRUE,
+                       bson_build (BSON_TYPE_INT32, "x", 7, BSON_TYPE_NONE),
+                       BSON_TYPE_INT32, "x", FALSE, 5,
+                       BSON_TYPE_NONE);
+  bson_finish (b);
+  bson_columns_append (cols, bson_data (b), bson_size (b));
+  bson_free (b);
+
+  b = bson_build_full (BSON_TYPE_DOCUMENT, "a", TRUE,
+                       bson_build (BSON_TYPE_INT32, "x", 7, BSON_TYPE_NONE),
+                       BSON_TYPE_NONE);
+  bson_finish (b);
+  bson_columns_append (cols, bson_data (b), bson_size (b));
+  bson_free (b);
+
+  i64 = bson_columns_values (cols, 0);
+  ok (i64[0] == 5 && VALID (cols, 0, 0) &&
+      i64[1] == 5 && VALID (cols, 0, 1) &&
+      !VALID (cols, 0, 2),
+      "Fields within embedded documents are not mistaken for the column");
+
+  b = bson_new ();
+  bson_append_int32 (b, "pads", 0);
+  bson_append_int32 (b, "x", 1);
+  bson_finish (b);
+  bson_columns_append (cols, bson_data (b), bson_size (b));
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_binary (b, "bin", BSON_BINARY_SUBTYPE_GENERIC,
+                      (const guint8 *)"\x12x", 3);
+  bson_finish (b);
+  bson_columns_append (cols, bson_data (b), bson_size (b));
+  bson_free (b);
+
+  i64 = bson_columns_values (cols, 0);
+  ok (i64[3] == 1 && VALID (cols, 0, 3) && !VALID (cols, 0, 4),
+      "Fields within binary values are not mistaken for the column");
+
+  bson_columns_free (cols);
+}
+
+RUN_TEST (12, bson_columns_append);
@@ -0,0 +1,47 @@
+#include "tap.h"
+#include "test.h"
+
+#include <bson.h>
+#include <string.h>
+
+void
+test_bson_columns_append_stream (void)
+{
+  bson_columns *cols;
+  bson *b;
+  guint8 *stream;
+  gint32 size, i;
+  const gint64 *v;
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+  stream = g_malloc (size * 3);
+  for (i = 0; i < 3; i++)
+    memcpy (stream + i * size, bson_data (b), size);
+  bson_free (b);
+
+  cols = bson_columns_new ();
+  bson_columns_add (cols, "int64", BSON_TYPE_INT64);
+
+  ok (bson_columns_append_stream (NULL, stream, size * 3) == -1,
+      "bson_columns_append_stream() fails with a NULL decoder");
+  ok (bson_columns_append_stream (cols, NULL, 10) == -1,
+      "bson_columns_append_stream() fails with NULL data");
+  ok (bson_columns_append_stream (cols, stream, 0) == 0,
+      "bson_columns_append_stream() works with an empty stream");
+
+  ok (bson_columns_append_stream (cols, stream, size * 3) == 3,
+      "bson_columns_append_stream() works");
+  v = bson_columns_values (cols, 0);
+  ok (bson_columns_rows (cols) == 3 && v[0] == -42 && v[2] == -42,
+      "bson_columns_append_stream() decodes every document");
+
+  ok (bson_columns_append_stream (cols, stream, size * 3 - 1) == -1 &&
+      bson_columns_rows (cols) == 3,
+      "bson_columns_append_stream() rolls back truncated streams");
+
+  g_free (stream);
+  bson_columns_free (cols);
+}
+
+RUN_TEST (6, bson_columns_append_stream);
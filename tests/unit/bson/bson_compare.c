@@ -0,0 +1,134 @@
+#include "tap.h"
+#include "test.h"
+
+#include <bson.h>
+#include <math.h>
+#include <string.h>
+
+static bson *
+_int32 (const gchar *name, gint32 v)
+{
+  bson *b = bson_new ();
+
+  bson_append_int32 (b, name, v);
+  bson_finish (b);
+  return b;
+}
+
+static bson *
+_double (gdouble v)
+{
+  bson *b = bson_new ();
+
+  bson_append_double (b, "a", v);
+  bson_finish (b);
+  return b;
+}
+
+static bson *
+_int64 (gint64 v)
+{
+  bson *b = bson_new ();
+
+  bson_append_int64 (b, "a", v);
+  bson_finish (b);
+  return b;
+}
+
+static gint
+_cmp (bson *a, bson *b)
+{
+  gint r = bson_compare (a, b);
+
+  bson_free (a);
+  bson_free (b);
+  return (r > 0) - (r < 0);
+}
+
+void
+test_bson_compare (void)
+{
+  static const guint8 dec_a[] =
+    "\x1f\x00\x00\x00"
+    "\x13" "d\0" "\x01\x02\x03\x04\x05\x06\x07\x08"
+    "\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+    "\x10" "x\0" "\x01\x00\x00\x00";
+  static const guint8 dec_b[] =
+    "\x1f\x00\x00\x00"
+    "\x13" "d\0" "\x01\x02\x03\x04\x05\x06\x07\x08"
+    "\x09\x0a\x0b\x0c\x0d\x0e\x0f\x11"
+    "\x10" "x\0" "\x01\x00\x00\x00";
+  bson *a, *b;
+
+  a = test_bson_generate_full ();
+  b = test_bson_generate_full ();
+  ok (bson_compare (a, b) == 0, "bson_compare() works");
+  ok (bson_compare (NULL, a) < 0 && bson_compare (a, NULL) > 0 &&
+      bson_compare (NULL, NULL) == 0,
+      "NULL sorts before everything else");
+  bson_free (a);
+  bson_free (b);
+
+  cmp_ok (_cmp (_int32 ("a", 1), _int32 ("a", 2)), "==", -1,
+          "Values are compared");
+  cmp_ok (_cmp (_int32 ("b", 1), _int32 ("a", 2)), "==", 1,
+          "Keys are compared before values");
+  cmp_ok (_cmp (_int32 ("a", 1), _double (1.0)), "==", 0,
+          "Numbers of different types compare by value");
+  cmp_ok (_cmp (_int64 (G_GINT64_CONSTANT (9007199254740993)),
+                _double (9007199254740992.0)), "==", 1,
+          "64-bit integers and doubles are compared exactly");
+  cmp_ok (_cmp (_double (NAN), _double (-INFINITY)), "==", -1,
+          "NaN sorts before every other number");
+  cmp_ok (_cmp (_int32 ("a", -5), _double (-4.5)), "==", -1,
+          "Fractional parts are taken into account");
+
+  /* Type ordering: null < numbers < strings < documents < booleans */
+  a = bson_new ();
+  bson_append_null (a, "a");
+  bson_finish (a);
+  cmp_ok (_cmp (a, _int32 ("a", -100)), "==", -1,
+          "null sorts before numbers");
+
+  a = bson_new ();
+  bson_append_string (a, "a", "1", -1);
+  cmp_ok (_cmp ((bson_finish (a), a), _int32 ("a", 100)), "==", 1,
+          "Strings sort after numbers");
+
+  a = bson_new ();
+  bson_append_boolean (a, "a", FALSE);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_string (b, "a", "zzz", -1);
+  bson_finish (b);
+  cmp_ok (_cmp (a, b), "==", 1, "Booleans sort after strings");
+
+  a = bson_new ();
+  bson_append_string (a, "a", "abc", -1);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_symbol (b, "a", "abd", -1);
+  bson_finish (b);
+  cmp_ok (_cmp (a, b), "==", -1,
+          "Strings and symbols compare by content");
+
+  a = _int32 ("a", 1);
+  b = bson_new ();
+  bson_append_int32 (b, "a", 1);
+  bson_append_int32 (b, "b", 1);
+  bson_finish (b);
+  cmp_ok (_cmp (a, b), "==", -1, "Shorter objects sort first");
+
+  /* Decimal128 is not known, its elements are compared as bytes. */
+  cmp_ok (_cmp (bson_new_view (dec_a, sizeof (dec_a)),
+                bson_new_view (dec_a, sizeof (dec_a))), "==", 0,
+          "Elements of unknown types compare equal to themselves");
+  cmp_ok (_cmp (bson_new_view (dec_a, sizeof (dec_a)),
+                bson_new_view (dec_b, sizeof (dec_b))), "==", -1,
+          "Elements of unknown types are compared as bytes");
+  cmp_ok (_cmp (bson_new_view (dec_b, sizeof (dec_b)),
+                bson_new_view (dec_a, sizeof (dec_a))), "==", 1,
+          "Comparing elements of unknown types is antisymmetric");
+}
+
+RUN_TEST (16, bson_compare);
@@ -0,0 +1,74 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_concat (void)
+{
+  bson *a, *b, *dest, *expected, *child, *empty;
+  bson_cursor *c;
+  gint32 i;
+
+  a = bson_new ();
+  bson_append_int32 (a, "a", 1);
+  bson_append_string (a, "s", "hello", -1);
+  bson_finish (a);
+
+  b = bson_new ();
+  bson_append_boolean (b, "b", TRUE);
+  bson_append_double (b, "d", 0.5);
+  bson_finish (b);
+
+  expected = bson_new ();
+  bson_append_int32 (expected, "a", 1);
+  bson_append_string (expected, "s", "hello", -1);
+  bson_append_boolean (expected, "b", TRUE);
+  bson_append_double (expected, "d", 0.5);
+  bson_finish (expected);
+
+  empty = bson_new ();
+  bson_finish (empty);
+
+  dest = bson_new ();
+  ok (bson_concat (NULL, a) == FALSE,
+      "bson_concat() with a NULL destination fails");
+  ok (bson_concat (dest, NULL) == FALSE,
+      "bson_concat() with a NULL source fails");
+  ok (bson_concat (dest, a) && bson_concat (dest, empty) &&
+      bson_concat (dest, b),
+      "bson_concat() works");
+  bson_finish (dest);
+  ok (bson_equal (dest, expected),
+      "bson_concat() appends every element of the source");
+  ok (bson_concat (dest, a) == FALSE,
+      "bson_concat() to a finished object fails");
+  bson_free (dest);
+
+  dest = bson_new ();
+  bson_append_document_begin (dest, "sub", &child);
+  ok (bson_concat (child, a),
+      "bson_concat() into an embedded document works");
+  bson_append_document_end (dest, child);
+  bson_finish (dest);
+  c = bson_find_path (dest, "sub.a");
+  ok (bson_cursor_get_int32 (c, &i) && i == 1,
+      "bson_concat() into an embedded document appends the elements");
+  bson_cursor_free (c);
+  bson_free (dest);
+
+  dest = bson_new ();
+  bson_free (empty);
+  empty = bson_new ();
+  ok (bson_concat (dest, empty) == FALSE,
+      "bson_concat() with an unfinished source fails");
+  bson_free (dest);
+
+  bson_free (empty);
+  bson_free (expected);
+  bson_free (b);
+  bson_free (a);
+}
+
+RUN_TEST (8, bson_concat);
@@ -0,0 +1,69 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_copy_fields (void)
+{
+  bson *src, *b, *broken;
+  bson_cursor *c;
+  const gchar *keys[] = { "int32", "str", "nonexistent" };
+  const gchar *skip_keys[] = { "doc", "array" };
+  gint n = 0;
+
+  src = test_bson_generate_full ();
+  b = bson_new ();
+
+  ok (bson_copy_fields (b, src, NULL, 1, FALSE) == FALSE,
+      "bson_copy_fields() with NULL keys fails");
+  ok (bson_copy_fields (NULL, src, keys, 3, FALSE) == FALSE,
+      "bson_copy_fields() with a NULL destination fails");
+
+  ok (bson_copy_fields (b, src, keys, 3, FALSE),
+      "bson_copy_fields() works");
+  bson_finish (b);
+  ok (bson_copy_fields (b, src, keys, 3, FALSE) == FALSE,
+      "bson_copy_fields() to a finished object fails");
+
+  c = bson_cursor_new (b);
+  ok (bson_cursor_next (c) && strcmp (bson_cursor_key (c), "str") == 0 &&
+      bson_cursor_next (c) && strcmp (bson_cursor_key (c), "int32") == 0 &&
+      !bson_cursor_next (c),
+      "bson_copy_fields() copies the selected keys, in their original "
+      "order");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = bson_new ();
+  ok (bson_copy_fields (b, src, skip_keys, 2, TRUE),
+      "bson_copy_fields() with exclusion works");
+  bson_finish (b);
+
+  c = bson_cursor_new (b);
+  while (bson_cursor_next (c))
+    n++;
+  bson_cursor_free (c);
+  c = bson_find (b, "doc");
+  ok (n == 14 && c == NULL,
+      "bson_copy_fields() with exclusion skips the listed keys");
+  bson_free (b);
+
+  broken = bson_new_view ((const guint8 *)
+                          "\023\000\000\000\020a\000\001\000\000\000"
+                          "\177b\000\000\000\000\000\000", 19);
+  b = bson_new ();
+  bson_append_int32 (b, "int32", 1);
+  ok (bson_copy_fields (b, broken, skip_keys, 2, TRUE) == FALSE,
+      "bson_copy_fields() with a malformed source fails");
+  bson_finish (b);
+  cmp_ok (bson_size (b), "==", 16,
+          "A failed bson_copy_fields() leaves the destination untouched");
+  bson_free (b);
+  bson_free (broken);
+
+  bson_free (src);
+}
+
+RUN_TEST (9, bson_copy_fields);
@@ -0,0 +1,46 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_find_k (void)
+{
+  bson *b;
+  bson_cursor *c;
+  bson_key *sex, *str, *missing;
+
+  b = test_bson_generate_full ();
+  c = bson_find (b, "TRUE");
+  sex = bson_key_new ("sex");
+  str = bson_key_new ("str");
+  missing = bson_key_new ("-invalid-key-");
+
+  ok (bson_cursor_find_k (c, NULL) == FALSE,
+      "bson_cursor_find_k() fails with a NULL key");
+  ok (bson_cursor_find_k (NULL, sex) == FALSE,
+      "bson_cursor_find_k() fails with a NULL cursor");
+
+  ok (bson_cursor_find_k (c, sex) &&
+      strcmp (bson_cursor_key (c), "sex") == 0,
+      "bson_cursor_find_k() works");
+  ok (bson_cursor_find_k (c, str) &&
+      strcmp (bson_cursor_key (c), "str") == 0,
+      "bson_cursor_find_k() wraps over if necessary");
+  ok (bson_cursor_find_k (c, missing) == FALSE,
+      "bson_cursor_find_k() fails when the key is not found");
+
+  bson_key_set_prediction (sex, TRUE);
+  ok (bson_cursor_find_k (c, sex) && bson_cursor_find_k (c, str) &&
+      bson_cursor_find_k (c, sex) &&
+      strcmp (bson_cursor_key (c), "sex") == 0,
+      "bson_cursor_find_k() works with prediction");
+
+  bson_cursor_free (c);
+  bson_key_free (sex);
+  bson_key_free (str);
+  bson_key_free (missing);
+  bson_free (b);
+}
+
+RUN_TEST (6, bson_cursor_find_k);
@@ -0,0 +1,53 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_find_path (void)
+{
+  bson *b;
+  bson_cursor *c;
+  const gchar *s;
+  gint32 i;
+
+  b = test_bson_generate_full ();
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_find_path (NULL, "doc.name") == FALSE,
+      "bson_cursor_find_path() fails with a NULL cursor");
+  ok (bson_cursor_find_path (c, NULL) == FALSE,
+      "bson_cursor_find_path() fails with a NULL path");
+
+  ok (bson_cursor_find_path (c, "int32") &&
+      bson_cursor_get_int32 (c, &i) && i == 32,
+      "bson_cursor_find_path() works with a single segment");
+
+  ok (bson_cursor_find_path (c, "doc.name") &&
+      bson_cursor_get_string (c, &s) && strcmp (s, "sub-document") == 0,
+      "bson_cursor_find_path() wraps over for the first segment");
+
+  ok (bson_cursor_find_path (c, "doc.missing") == FALSE &&
+      strcmp (bson_cursor_key (c), "name") == 0,
+      "bson_cursor_find_path() leaves the cursor alone on failure");
+
+  ok (bson_cursor_find_path (c, "answer") &&
+      bson_cursor_get_int32 (c, &i) && i == 42,
+      "bson_cursor_find_path() searches within the current document");
+
+  ok (bson_cursor_find_path (c, "str") == FALSE,
+      "bson_cursor_find_path() does not leave the current document");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "array");
+  ok (bson_cursor_find_path (c, "array.0") &&
+      bson_cursor_get_int32 (c, &i) && i == 32 &&
+      bson_cursor_find_path (c, "1") &&
+      strcmp (bson_cursor_key (c), "1") == 0,
+      "bson_cursor_find_path() works on cursors already descended");
+  bson_cursor_free (c);
+
+  bson_free (b);
+}
+
+RUN_TEST (8, bson_cursor_find_path);
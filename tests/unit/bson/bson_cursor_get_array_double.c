@@ -0,0 +1,81 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_get_array_double (void)
+{
+  bson *b, *a;
+  bson_cursor *c;
+  gdouble v[1024];
+  gint i;
+  gchar key[8];
+
+  a = bson_build (BSON_TYPE_DOUBLE, "0", 0.5,
+                  BSON_TYPE_INT32, "1", 2,
+                  BSON_TYPE_INT64, "2", (gint64)-3,
+                  BSON_TYPE_NONE);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "a", a);
+  bson_finish (b);
+  bson_free (a);
+
+  ok (bson_cursor_get_array_double (NULL, v, 4) == -1,
+      "bson_cursor_get_array_double() with a NULL cursor fails");
+
+  c = bson_find (b, "a");
+  cmp_ok (bson_cursor_get_array_double (c, v, 4), "==", 3,
+          "bson_cursor_get_array_double() works");
+  ok (v[0] == 0.5 && v[1] == 2.0 && v[2] == -3.0,
+      "bson_cursor_get_array_double() converts integers to doubles");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  a = bson_new ();
+  for (i = 0; i < 1024; i++)
+    {
+      g_snprintf (key, sizeof (key), "%d", i);
+      bson_append_double (a, key, i * 0.25);
+    }
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "samples", a);
+  bson_append_string (b, "str", "hello", -1);
+  bson_finish (b);
+  bson_free (a);
+
+  c = bson_find (b, "samples");
+  cmp_ok (bson_cursor_get_array_double (c, v, 1024), "==", 1024,
+          "bson_cursor_get_array_double() works on large arrays");
+  ok (v[0] == 0.0 && v[1023] == 1023 * 0.25,
+      "bson_cursor_get_array_double() decodes large arrays correctly");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  c = bson_find (b, "str");
+  ok (bson_cursor_get_array_double (c, v, 4) == -1,
+      "bson_cursor_get_array_double() should fail when the cursor points "
+      "to non-array data");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  a = bson_build (BSON_TYPE_DOUBLE, "0", 1.0,
+                  BSON_TYPE_STRING, "1", "two", -1,
+                  BSON_TYPE_NONE);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "a", a);
+  bson_finish (b);
+  bson_free (a);
+  c = bson_find (b, "a");
+  ok (bson_cursor_get_array_double (c, v, 4) == -1,
+      "bson_cursor_get_array_double() fails on non-numeric elements");
+  bson_cursor_free (c);
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_cursor_get_array_double);
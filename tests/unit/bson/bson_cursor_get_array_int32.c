@@ -0,0 +1,78 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_get_array_int32 (void)
+{
+  bson *b, *a, *e;
+  bson_cursor *c;
+  gint32 v[4] = { 0, 0, 0, 12345 };
+
+  a = bson_build (BSON_TYPE_INT32, "0", 1,
+                  BSON_TYPE_INT64, "1", (gint64)-2,
+                  BSON_TYPE_INT32, "2", 3,
+                  BSON_TYPE_NONE);
+  bson_finish (a);
+  e = bson_new ();
+  bson_finish (e);
+  b = bson_new ();
+  bson_append_array (b, "a", a);
+  bson_append_array (b, "empty", e);
+  bson_finish (b);
+  bson_free (e);
+  bson_free (a);
+
+  ok (bson_cursor_get_array_int32 (NULL, v, 4) == -1,
+      "bson_cursor_get_array_int32() with a NULL cursor fails");
+
+  c = bson_find (b, "a");
+  ok (bson_cursor_get_array_int32 (c, NULL, 4) == -1,
+      "bson_cursor_get_array_int32() with a NULL destination fails");
+  cmp_ok (bson_cursor_get_array_int32 (c, NULL, 0), "==", 3,
+          "bson_cursor_get_array_int32() can be used to count elements");
+  cmp_ok (bson_cursor_get_array_int32 (c, v, 4), "==", 3,
+          "bson_cursor_get_array_int32() works");
+  ok (v[0] == 1 && v[1] == -2 && v[2] == 3 && v[3] == 12345,
+      "bson_cursor_get_array_int32() decodes the array correctly");
+
+  memset (v, 0, sizeof (v));
+  cmp_ok (bson_cursor_get_array_int32 (c, v, 2), "==", 3,
+          "bson_cursor_get_array_int32() with a short buffer returns "
+          "the full count");
+  ok (v[0] == 1 && v[1] == -2 && v[2] == 0,
+      "bson_cursor_get_array_int32() does not overflow the buffer");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "empty");
+  cmp_ok (bson_cursor_get_array_int32 (c, v, 4), "==", 0,
+          "bson_cursor_get_array_int32() on an empty array works");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  a = bson_build (BSON_TYPE_INT32, "0", 1,
+                  BSON_TYPE_INT64, "1", G_GINT64_CONSTANT (1) << 40,
+                  BSON_TYPE_NONE);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "a", a);
+  bson_finish (b);
+  bson_free (a);
+  c = bson_find (b, "a");
+  ok (bson_cursor_get_array_int32 (c, v, 4) == -1,
+      "bson_cursor_get_array_int32() fails on out of range values");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  c = bson_find (b, "int32");
+  ok (bson_cursor_get_array_int32 (c, v, 4) == -1,
+      "bson_cursor_get_array_int32() should fail when the cursor points "
+      "to non-array data");
+  bson_cursor_free (c);
+  bson_free (b);
+}
+
+RUN_TEST (10, bson_cursor_get_array_int32);
@@ -0,0 +1,64 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_get_array_int64 (void)
+{
+  bson *b, *a;
+  bson_cursor *c;
+  gint64 v[4];
+
+  a = bson_build (BSON_TYPE_INT32, "0", 1,
+                  BSON_TYPE_INT64, "1", G_GINT64_CONSTANT (1) << 40,
+                  BSON_TYPE_NONE);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "a", a);
+  bson_finish (b);
+  bson_free (a);
+
+  ok (bson_cursor_get_array_int64 (NULL, v, 4) == -1,
+      "bson_cursor_get_array_int64() with a NULL cursor fails");
+
+  c = bson_find (b, "a");
+  cmp_ok (bson_cursor_get_array_int64 (c, v, 4), "==", 2,
+          "bson_cursor_get_array_int64() works");
+  ok (v[0] == 1 && v[1] == G_GINT64_CONSTANT (1) << 40,
+      "bson_cursor_get_array_int64() decodes the array correctly");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  c = bson_find (b, "array");
+  cmp_ok (bson_cursor_get_array_int64 (c, v, 4), "==", 2,
+          "bson_cursor_get_array_int64() works on mixed integer arrays");
+  ok (v[0] == 32 && v[1] == -42,
+      "bson_cursor_get_array_int64() decodes mixed integer arrays");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "doc");
+  ok (bson_cursor_get_array_int64 (c, v, 4) == -1,
+      "bson_cursor_get_array_int64() should fail when the cursor points "
+      "to non-array data");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  a = bson_build (BSON_TYPE_INT32, "0", 1,
+                  BSON_TYPE_DOUBLE, "1", 2.5,
+                  BSON_TYPE_NONE);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "a", a);
+  bson_finish (b);
+  bson_free (a);
+  c = bson_find (b, "a");
+  ok (bson_cursor_get_array_int64 (c, v, 4) == -1,
+      "bson_cursor_get_array_int64() fails on arrays with doubles");
+  bson_cursor_free (c);
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_cursor_get_array_int64);
@@ -0,0 +1,50 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_get_array_view (void)
+{
+  bson *b, *a = NULL;
+  bson_cursor *c, *ac;
+  gint64 i;
+
+  ok (bson_cursor_get_array_view (NULL, &a) == FALSE,
+      "bson_cursor_get_array_view() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_get_array_view (c, NULL) == FALSE,
+      "bson_cursor_get_array_view() with a NULL destination fails");
+  ok (bson_cursor_get_array_view (c, &a) == FALSE,
+      "bson_cursor_get_array_view() at the initial position fails");
+  ok (a == NULL,
+      "destination remains unchanged after failed cursor operations");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "array");
+  ok (bson_cursor_get_array_view (c, &a),
+      "bson_cursor_get_array_view() works");
+  cmp_ok (bson_size (a), ">", 0,
+          "the returned view is finished");
+
+  ac = bson_find (a, "1");
+  ok (bson_cursor_get_int64 (ac, &i) && i == -42,
+      "the returned view can be read from");
+  bson_cursor_free (ac);
+  bson_free (a);
+
+  bson_cursor_next (c);
+
+  ok (bson_cursor_get_array_view (c, &a) == FALSE,
+      "bson_cursor_get_array_view() fails if the cursor points to "
+      "non-array data");
+
+  bson_cursor_free (c);
+  bson_free (b);
+}
+
+RUN_TEST (8, bson_cursor_get_array_view);
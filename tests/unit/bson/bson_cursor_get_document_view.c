@@ -0,0 +1,50 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_get_document_view (void)
+{
+  bson *b, *d = NULL, *copy;
+  bson_cursor *c;
+
+  ok (bson_cursor_get_document_view (NULL, &d) == FALSE,
+      "bson_cursor_get_document_view() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_get_document_view (c, NULL) == FALSE,
+      "bson_cursor_get_document_view() with a NULL destination fails");
+  ok (bson_cursor_get_document_view (c, &d) == FALSE,
+      "bson_cursor_get_document_view() at the initial position fails");
+  ok (d == NULL,
+      "destination remains unchanged after failed cursor operations");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "doc");
+  ok (bson_cursor_get_document_view (c, &d),
+      "bson_cursor_get_document_view() works");
+  bson_cursor_get_document (c, &copy);
+  cmp_ok (bson_size (d), "==", bson_size (copy),
+          "the returned view is finished, and has the right size");
+  ok (memcmp (bson_data (d), bson_data (copy), bson_size (d)) == 0,
+      "the returned view has the same contents as a copy");
+  ok (bson_data (d) > bson_data (b) &&
+      bson_data (d) < bson_data (b) + bson_size (b),
+      "the returned view points into the parent");
+  bson_free (copy);
+  bson_free (d);
+
+  bson_cursor_next (c);
+  ok (bson_cursor_get_document_view (c, &d) == FALSE,
+      "bson_cursor_get_document_view() fails if the cursor points to "
+      "non-document data");
+
+  bson_cursor_free (c);
+  bson_free (b);
+}
+
+RUN_TEST (9, bson_cursor_get_document_view);
@@ -0,0 +1,58 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_new_child (void)
+{
+  bson *b;
+  bson_cursor *c, *child;
+  const gchar *s;
+  gint32 i;
+
+  ok (bson_cursor_new_child (NULL) == NULL,
+      "bson_cursor_new_child(NULL) should fail");
+
+  b = test_bson_generate_full ();
+  c = bson_cursor_new (b);
+  ok (bson_cursor_new_child (c) == NULL,
+      "bson_cursor_new_child() at the initial position fails");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "str");
+  ok (bson_cursor_new_child (c) == NULL,
+      "bson_cursor_new_child() fails on non-document elements");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "doc");
+  child = bson_cursor_new_child (c);
+  ok (child != NULL,
+      "bson_cursor_new_child() works on documents");
+
+  ok (bson_cursor_next (child) &&
+      strcmp (bson_cursor_key (child), "name") == 0 &&
+      bson_cursor_get_string (child, &s) &&
+      strcmp (s, "sub-document") == 0,
+      "The child cursor iterates over the embedded document");
+  ok (bson_cursor_find (child, "answer") &&
+      bson_cursor_get_int32 (child, &i) && i == 42,
+      "bson_cursor_find() works on the child cursor");
+  ok (bson_cursor_next (child) == FALSE,
+      "The child cursor stops at the end of the embedded document");
+  bson_cursor_free (child);
+  bson_cursor_free (c);
+
+  c = bson_find (b, "array");
+  child = bson_cursor_new_child (c);
+  ok (child != NULL && bson_cursor_next (child) &&
+      bson_cursor_get_int32 (child, &i) && i == 32,
+      "bson_cursor_new_child() works on arrays");
+  bson_cursor_free (child);
+  bson_cursor_free (c);
+
+  bson_free (b);
+}
+
+RUN_TEST (8, bson_cursor_new_child);
@@ -0,0 +1,49 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_set_boolean (void)
+{
+  bson *b;
+  bson_cursor *c;
+  gboolean v;
+  gint32 size;
+
+  ok (bson_cursor_set_boolean (NULL, TRUE) == FALSE,
+      "bson_cursor_set_boolean() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_set_boolean (c, TRUE) == FALSE,
+      "bson_cursor_set_boolean() at the initial position fails");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int32");
+  ok (bson_cursor_set_boolean (c, TRUE) == FALSE,
+      "bson_cursor_set_boolean() should fail when the cursor points to "
+      "non-boolean data");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "TRUE");
+  ok (bson_cursor_set_boolean (c, TRUE),
+      "bson_cursor_set_boolean() works");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "TRUE");
+  ok (bson_cursor_get_boolean (c, &v),
+      "The modified element can be retrieved");
+  ok (v == TRUE,
+      "bson_cursor_set_boolean() sets the correct value");
+  bson_cursor_free (c);
+  cmp_ok (bson_size (b), "==", size,
+          "bson_cursor_set_boolean() does not change the object size");
+
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_cursor_set_boolean);
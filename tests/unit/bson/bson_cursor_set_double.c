@@ -0,0 +1,49 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_set_double (void)
+{
+  bson *b;
+  bson_cursor *c;
+  gdouble v;
+  gint32 size;
+
+  ok (bson_cursor_set_double (NULL, 2.71) == FALSE,
+      "bson_cursor_set_double() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_set_double (c, 2.71) == FALSE,
+      "bson_cursor_set_double() at the initial position fails");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int32");
+  ok (bson_cursor_set_double (c, 2.71) == FALSE,
+      "bson_cursor_set_double() should fail when the cursor points to "
+      "non-double data");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "double");
+  ok (bson_cursor_set_double (c, 2.71),
+      "bson_cursor_set_double() works");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "double");
+  ok (bson_cursor_get_double (c, &v),
+      "The modified element can be retrieved");
+  ok (v == 2.71,
+      "bson_cursor_set_double() sets the correct value");
+  bson_cursor_free (c);
+  cmp_ok (bson_size (b), "==", size,
+          "bson_cursor_set_double() does not change the object size");
+
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_cursor_set_double);
@@ -0,0 +1,59 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_set_int32 (void)
+{
+  bson *b;
+  bson_cursor *c;
+  gint32 v;
+  gint32 size;
+
+  ok (bson_cursor_set_int32 (NULL, -1234567) == FALSE,
+      "bson_cursor_set_int32() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_set_int32 (c, -1234567) == FALSE,
+      "bson_cursor_set_int32() at the initial position fails");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int64");
+  ok (bson_cursor_set_int32 (c, -1234567) == FALSE,
+      "bson_cursor_set_int32() should fail when the cursor points to "
+      "non-int32 data");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int32");
+  ok (bson_cursor_set_int32 (c, -1234567),
+      "bson_cursor_set_int32() works");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int32");
+  ok (bson_cursor_get_int32 (c, &v),
+      "The modified element can be retrieved");
+  cmp_ok (v, "==", -1234567,
+          "bson_cursor_set_int32() sets the correct value");
+  bson_cursor_free (c);
+  cmp_ok (bson_size (b), "==", size,
+          "bson_cursor_set_int32() does not change the object size");
+
+  c = bson_find_path (b, "doc.answer");
+  ok (bson_cursor_set_int32 (c, 43),
+      "bson_cursor_set_int32() works on an embedded document");
+  bson_cursor_free (c);
+  c = bson_find_path (b, "doc.answer");
+  bson_cursor_get_int32 (c, &v);
+  cmp_ok (v, "==", 43,
+          "bson_cursor_set_int32() changes the containing object");
+  bson_cursor_free (c);
+
+  bson_free (b);
+}
+
+RUN_TEST (9, bson_cursor_set_int32);
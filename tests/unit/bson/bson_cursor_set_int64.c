@@ -0,0 +1,49 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_set_int64 (void)
+{
+  bson *b;
+  bson_cursor *c;
+  gint64 v;
+  gint32 size;
+
+  ok (bson_cursor_set_int64 (NULL, G_GINT64_CONSTANT (9876543210)) == FALSE,
+      "bson_cursor_set_int64() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_set_int64 (c, G_GINT64_CONSTANT (9876543210)) == FALSE,
+      "bson_cursor_set_int64() at the initial position fails");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int32");
+  ok (bson_cursor_set_int64 (c, G_GINT64_CONSTANT (9876543210)) == FALSE,
+      "bson_cursor_set_int64() should fail when the cursor points to "
+      "non-int64 data");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int64");
+  ok (bson_cursor_set_int64 (c, G_GINT64_CONSTANT (9876543210)),
+      "bson_cursor_set_int64() works");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int64");
+  ok (bson_cursor_get_int64 (c, &v),
+      "The modified element can be retrieved");
+  ok (v == G_GINT64_CONSTANT (9876543210),
+      "bson_cursor_set_int64() sets the correct value");
+  bson_cursor_free (c);
+  cmp_ok (bson_size (b), "==", size,
+          "bson_cursor_set_int64() does not change the object size");
+
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_cursor_set_int64);
@@ -0,0 +1,50 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_set_oid (void)
+{
+  bson *b;
+  bson_cursor *c;
+  const guint8 *oid = (const guint8 *)"abcdefghijkl";
+  const guint8 *v;
+  gint32 size;
+
+  ok (bson_cursor_set_oid (NULL, oid) == FALSE,
+      "bson_cursor_set_oid() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+
+  c = bson_find (b, "_id");
+  ok (bson_cursor_set_oid (c, NULL) == FALSE,
+      "bson_cursor_set_oid() with a NULL ObjectID fails");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "int32");
+  ok (bson_cursor_set_oid (c, oid) == FALSE,
+      "bson_cursor_set_oid() should fail when the cursor points to "
+      "non-oid data");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "_id");
+  ok (bson_cursor_set_oid (c, oid),
+      "bson_cursor_set_oid() works");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "_id");
+  ok (bson_cursor_get_oid (c, &v),
+      "The modified element can be retrieved");
+  ok (memcmp (v, oid, 12) == 0,
+      "bson_cursor_set_oid() sets the correct value");
+  bson_cursor_free (c);
+  cmp_ok (bson_size (b), "==", size,
+          "bson_cursor_set_oid() does not change the object size");
+
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_cursor_set_oid);
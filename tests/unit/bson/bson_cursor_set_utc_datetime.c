@@ -0,0 +1,49 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_cursor_set_utc_datetime (void)
+{
+  bson *b;
+  bson_cursor *c;
+  gint64 v;
+  gint32 size;
+
+  ok (bson_cursor_set_utc_datetime (NULL, G_GINT64_CONSTANT (1300000000000)) == FALSE,
+      "bson_cursor_set_utc_datetime() with a NULL cursor fails");
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+  c = bson_cursor_new (b);
+
+  ok (bson_cursor_set_utc_datetime (c, G_GINT64_CONSTANT (1300000000000)) == FALSE,
+      "bson_cursor_set_utc_datetime() at the initial position fails");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "ts");
+  ok (bson_cursor_set_utc_datetime (c, G_GINT64_CONSTANT (1300000000000)) == FALSE,
+      "bson_cursor_set_utc_datetime() should fail when the cursor points to "
+      "non-utc_datetime data");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "date");
+  ok (bson_cursor_set_utc_datetime (c, G_GINT64_CONSTANT (1300000000000)),
+      "bson_cursor_set_utc_datetime() works");
+  bson_cursor_free (c);
+
+  c = bson_find (b, "date");
+  ok (bson_cursor_get_utc_datetime (c, &v),
+      "The modified element can be retrieved");
+  ok (v == G_GINT64_CONSTANT (1300000000000),
+      "bson_cursor_set_utc_datetime() sets the correct value");
+  bson_cursor_free (c);
+  cmp_ok (bson_size (b), "==", size,
+          "bson_cursor_set_utc_datetime() does not change the object size");
+
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_cursor_set_utc_datetime);
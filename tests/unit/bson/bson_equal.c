@@ -0,0 +1,44 @@
+#include "tap.h"
+#include "test.h"
+
+#include <bson.h>
+#include <string.h>
+
+void
+test_bson_equal (void)
+{
+  bson *a, *b;
+
+  a = test_bson_generate_full ();
+  b = test_bson_generate_full ();
+
+  ok (bson_equal (NULL, b) == FALSE && bson_equal (a, NULL) == FALSE,
+      "bson_equal() fails with NULL objects");
+  ok (bson_equal (a, b), "bson_equal() works");
+  ok (bson_equal (a, a), "bson_equal() finds an object equal to itself");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_double (b, "double", 3.14);
+  bson_finish (b);
+  ok (bson_equal (a, b) == FALSE,
+      "bson_equal() finds different objects different");
+  bson_free (a);
+
+  a = bson_new ();
+  bson_append_int32 (a, "double", 3);
+  bson_finish (a);
+  ok (bson_equal (a, b) == FALSE,
+      "bson_equal() compares types too");
+  bson_free (a);
+
+  a = bson_new ();
+  bson_append_double (a, "double", 3.14);
+  ok (bson_equal (a, b) == FALSE,
+      "bson_equal() fails with unfinished objects");
+
+  bson_free (a);
+  bson_free (b);
+}
+
+RUN_TEST (6, bson_equal);
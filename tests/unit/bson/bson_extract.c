@@ -0,0 +1,59 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_extract (void)
+{
+  const gchar *keys[] = { "int32", "str", "-invalid-key-", "_id", "str" };
+  bson_type types[] = { BSON_TYPE_INT32, BSON_TYPE_NONE, BSON_TYPE_NONE,
+                        BSON_TYPE_STRING, BSON_TYPE_STRING };
+  const gchar *null_keys[] = { "int32", NULL };
+  bson_cursor *c[5];
+  bson *b;
+  const gchar *s;
+  gint32 i;
+  gint n;
+
+  b = test_bson_generate_full ();
+
+  ok (bson_extract (NULL, keys, NULL, 5, c) == -1,
+      "bson_extract() fails with a NULL object");
+  ok (bson_extract (b, NULL, NULL, 5, c) == -1,
+      "bson_extract() fails with NULL keys");
+  ok (bson_extract (b, keys, NULL, 5, NULL) == -1,
+      "bson_extract() fails with a NULL destination");
+  ok (bson_extract (b, keys, NULL, 0, c) == -1,
+      "bson_extract() fails with zero keys");
+  ok (bson_extract (b, null_keys, NULL, 2, c) == -1,
+      "bson_extract() fails if any of the keys is NULL");
+
+  n = bson_extract (b, keys, NULL, 5, c);
+  cmp_ok (n, "==", 4,
+          "bson_extract() finds all existing keys");
+  ok (bson_cursor_get_int32 (c[0], &i) && i == 32,
+      "bson_extract() positions cursors to the right keys");
+  ok (bson_cursor_get_string (c[1], &s) && strcmp (s, "hello world") == 0 &&
+      bson_cursor_get_string (c[4], &s) && strcmp (s, "hello world") == 0,
+      "bson_extract() handles the same key requested twice");
+  ok (c[2] == NULL,
+      "bson_extract() sets missing keys to NULL");
+  ok (bson_cursor_next (c[1]) &&
+      strcmp (bson_cursor_key (c[1]), "doc") == 0,
+      "cursors returned by bson_extract() can be moved");
+  for (i = 0; i < 5; i++)
+    bson_cursor_free (c[i]);
+
+  n = bson_extract (b, keys, types, 5, c);
+  cmp_ok (n, "==", 3,
+          "bson_extract() with types skips keys of the wrong type");
+  ok (c[0] != NULL && c[1] != NULL && c[3] == NULL && c[4] != NULL,
+      "bson_extract() with types sets mismatching keys to NULL");
+  for (i = 0; i < 5; i++)
+    bson_cursor_free (c[i]);
+
+  bson_free (b);
+}
+
+RUN_TEST (12, bson_extract);
@@ -0,0 +1,92 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_find_k (void)
+{
+  bson *b, *o;
+  bson_cursor *c;
+  bson_key *k, *missing;
+  gint32 i;
+
+  b = test_bson_generate_full ();
+  k = bson_key_new ("int32");
+  missing = bson_key_new ("-invalid-key-");
+
+  ok (bson_find_k (NULL, k) == NULL,
+      "bson_find_k() fails with a NULL object");
+  ok (bson_find_k (b, NULL) == NULL,
+      "bson_find_k() fails with a NULL key");
+
+  c = bson_find_k (b, k);
+  ok (c && bson_cursor_get_int32 (c, &i) && i == 32,
+      "bson_find_k() works");
+  bson_cursor_free (c);
+  ok (bson_find_k (b, missing) == NULL,
+      "bson_find_k() fails when the key is not found");
+
+  bson_set_key_index (b, TRUE);
+  c = bson_find_k (b, k);
+  ok (c && bson_cursor_get_int32 (c, &i) && i == 32,
+      "bson_find_k() works with an indexed object");
+  bson_cursor_free (c);
+  ok (bson_find_k (b, missing) == NULL,
+      "bson_find_k() fails on missing keys with an indexed object");
+  bson_set_key_index (b, FALSE);
+
+  bson_key_set_prediction (k, TRUE);
+  c = bson_find_k (b, k);
+  bson_cursor_free (c);
+  c = bson_find_k (b, k);
+  ok (c && bson_cursor_get_int32 (c, &i) && i == 32,
+      "bson_find_k() works with prediction");
+  bson_cursor_free (c);
+
+  o = bson_new ();
+  bson_append_string (o, "str", "a different layout", -1);
+  bson_append_int32 (o, "int32", 1);
+  bson_finish (o);
+  c = bson_find_k (o, k);
+  ok (c && bson_cursor_get_int32 (c, &i) && i == 1,
+      "bson_find_k() falls back to searching on mispredictions");
+  bson_cursor_free (c);
+  bson_free (o);
+
+  o = bson_new ();
+  bson_append_int64 (o, "int64", 1);
+  bson_finish (o);
+  ok (bson_find_k (o, k) == NULL,
+      "bson_find_k() fails when a predicting key is not found");
+  bson_free (o);
+
+  bson_key_free (k);
+
+  k = bson_key_new ("a");
+  bson_key_set_prediction (k, TRUE);
+  o = bson_build (BSON_TYPE_STRING, "s", "xxxxx", -1,
+                  BSON_TYPE_INT32, "a", 1,
+                  BSON_TYPE_NONE);
+  bson_finish (o);
+  c = bson_find_k (o, k);
+  bson_cursor_free (c);
+  bson_free (o);
+
+  o = bson_build_full (BSON_TYPE_DOCUMENT, "sss", TRUE,
+                       bson_build (BSON_TYPE_BOOLEAN, "z", TRUE,
+                                   BSON_TYPE_INT32, "a", 99,
+                                   BSON_TYPE_NONE),
+                       BSON_TYPE_INT32, "b", FALSE, 5,
+                       BSON_TYPE_NONE);
+  bson_finish (o);
+  ok (bson_find_k (o, k) == NULL,
+      "bson_find_k() does not predict keys within embedded documents");
+  bson_free (o);
+
+  bson_key_free (k);
+  bson_key_free (missing);
+  bson_free (b);
+}
+
+RUN_TEST (10, bson_find_k);
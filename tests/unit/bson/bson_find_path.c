@@ -0,0 +1,106 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+static bson *
+_generate_nested (void)
+{
+  bson *b, *a, *d, *e;
+
+  d = bson_build (BSON_TYPE_STRING, "name", "first", -1,
+                  BSON_TYPE_NONE);
+  e = bson_build (BSON_TYPE_STRING, "name", "second", -1,
+                  BSON_TYPE_INT32, "id", 2,
+                  BSON_TYPE_NONE);
+  bson_finish (d);
+  bson_finish (e);
+
+  a = bson_build (BSON_TYPE_DOCUMENT, "0", d,
+                  BSON_TYPE_DOCUMENT, "1", e,
+                  BSON_TYPE_NONE);
+  bson_finish (a);
+  bson_free (d);
+  bson_free (e);
+
+  d = bson_build (BSON_TYPE_ARRAY, "list", a,
+                  BSON_TYPE_NONE);
+  bson_finish (d);
+  bson_free (a);
+
+  b = bson_build (BSON_TYPE_DOCUMENT, "a", d,
+                  BSON_TYPE_NONE);
+  bson_finish (b);
+  bson_free (d);
+
+  return b;
+}
+
+void
+test_bson_find_path (void)
+{
+  bson *b;
+  bson_cursor *c;
+  const gchar *s;
+  gint32 i;
+  gint64 l;
+
+  b = test_bson_generate_full ();
+
+  ok (bson_find_path (NULL, "doc.name") == NULL,
+      "bson_find_path() fails with a NULL object");
+  ok (bson_find_path (b, NULL) == NULL,
+      "bson_find_path() fails with a NULL path");
+
+  c = bson_find_path (b, "str");
+  ok (c && bson_cursor_get_string (c, &s) && strcmp (s, "hello world") == 0,
+      "bson_find_path() works with a single segment");
+  bson_cursor_free (c);
+
+  c = bson_find_path (b, "doc.answer");
+  ok (c && bson_cursor_get_int32 (c, &i) && i == 42,
+      "bson_find_path() descends into embedded documents");
+  ok (strcmp (bson_cursor_key (c), "answer") == 0,
+      "bson_cursor_key() returns the leaf key");
+  bson_cursor_free (c);
+
+  c = bson_find_path (b, "array.1");
+  ok (c && bson_cursor_get_int64 (c, &l) && l == -42,
+      "bson_find_path() descends into arrays by index");
+  bson_cursor_free (c);
+
+  c = bson_find_path (b, "doc.name");
+  ok (c && bson_cursor_get_string (c, &s) &&
+      s > (const gchar *)bson_data (b) &&
+      s < (const gchar *)bson_data (b) + bson_size (b),
+      "bson_find_path() does not copy embedded documents");
+  ok (bson_cursor_next (c) && strcmp (bson_cursor_key (c), "answer") == 0 &&
+      bson_cursor_next (c) == FALSE,
+      "The returned cursor moves within the embedded document");
+  bson_cursor_free (c);
+
+  ok (bson_find_path (b, "str.name") == NULL,
+      "bson_find_path() fails when descending into a non-document");
+  ok (bson_find_path (b, "doc.missing") == NULL,
+      "bson_find_path() fails when the leaf is not found");
+  ok (bson_find_path (b, "doc.") == NULL &&
+      bson_find_path (b, ".doc") == NULL &&
+      bson_find_path (b, "doc..name") == NULL &&
+      bson_find_path (b, "") == NULL,
+      "bson_find_path() fails on empty segments");
+  ok (bson_find_path (b, "do.name") == NULL &&
+      bson_find_path (b, "doc.nam") == NULL,
+      "bson_find_path() does not match prefixes");
+  bson_free (b);
+
+  b = _generate_nested ();
+  c = bson_find_path (b, "a.list.1.name");
+  ok (c && bson_cursor_get_string (c, &s) && strcmp (s, "second") == 0,
+      "bson_find_path() works with mixed documents and arrays");
+  bson_cursor_free (c);
+  ok (bson_find_path (b, "a.list.2.name") == NULL,
+      "bson_find_path() fails on out of range array indexes");
+  bson_free (b);
+}
+
+RUN_TEST (14, bson_find_path);
@@ -0,0 +1,76 @@
+#include "tap.h"
+#include "test.h"
+
+#include <bson.h>
+#include <string.h>
+
+static bson *
+_doc (gboolean swap)
+{
+  bson *b, *child;
+
+  b = bson_new ();
+  bson_append_int32 (b, (swap) ? "b" : "a", (swap) ? 2 : 1);
+  bson_append_document_begin (b, "sub", &child);
+  bson_append_string (child, (swap) ? "y" : "x", (swap) ? "b" : "a", -1);
+  bson_append_string (child, (swap) ? "x" : "y", (swap) ? "a" : "b", -1);
+  bson_append_document_end (b, child);
+  bson_append_int32 (b, (swap) ? "a" : "b", (swap) ? 1 : 2);
+  bson_finish (b);
+
+  return b;
+}
+
+void
+test_bson_hash (void)
+{
+  bson *a, *b, *c;
+
+  a = _doc (FALSE);
+  b = _doc (FALSE);
+  c = _doc (TRUE);
+
+  ok (bson_hash (NULL, BSON_HASH_DEFAULT) == 0,
+      "bson_hash() returns zero for NULL");
+
+  cmp_ok (bson_hash (a, BSON_HASH_DEFAULT), "==",
+          bson_hash (b, BSON_HASH_DEFAULT),
+          "bson_hash() is the same for identical objects");
+  cmp_ok (bson_hash (a, BSON_HASH_DEFAULT), "!=",
+          bson_hash (c, BSON_HASH_DEFAULT),
+          "bson_hash() depends on the order of keys by default");
+  cmp_ok (bson_hash (a, BSON_HASH_UNORDERED), "==",
+          bson_hash (c, BSON_HASH_UNORDERED),
+          "bson_hash() can ignore the order of keys, recursively");
+  bson_free (b);
+
+  /* Same keys, but the values swapped between them. */
+  b = bson_new ();
+  bson_append_int32 (b, "a", 2);
+  bson_append_int32 (b, "b", 1);
+  bson_finish (b);
+  bson_free (c);
+  c = bson_new ();
+  bson_append_int32 (c, "a", 1);
+  bson_append_int32 (c, "b", 2);
+  bson_finish (c);
+  cmp_ok (bson_hash (b, BSON_HASH_UNORDERED), "!=",
+          bson_hash (c, BSON_HASH_UNORDERED),
+          "Unordered hashes still tie values to their keys");
+
+  ok (bson_hash_func (a) == bson_hash_func (a) &&
+      bson_hash_func (a) != bson_hash_func (c),
+      "bson_hash_func() works");
+
+  bson_free (a);
+  a = bson_new ();
+  bson_append_int32 (a, "a", 1);
+  ok (bson_hash (a, BSON_HASH_DEFAULT) == 0,
+      "bson_hash() returns zero for unfinished objects");
+
+  bson_free (a);
+  bson_free (b);
+  bson_free (c);
+}
+
+RUN_TEST (7, bson_hash);
@@ -0,0 +1,52 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_iter_find (void)
+{
+  bson *b;
+  bson_iter i;
+  gint32 v;
+
+  b = test_bson_generate_full ();
+  bson_iter_init (&i, b);
+
+  ok (bson_iter_find (&i, NULL) == FALSE,
+      "bson_iter_find() should fail with a NULL key");
+  ok (bson_iter_find (NULL, "int32") == FALSE,
+      "bson_iter_find() should fail with a NULL iterator");
+
+  ok (bson_iter_find (&i, "TRUE") &&
+      bson_iter_type (&i) == BSON_TYPE_BOOLEAN,
+      "bson_iter_find() works from the start of the object");
+  ok (bson_iter_find (&i, "sex") &&
+      strcmp (bson_iter_key (&i), "sex") == 0,
+      "bson_iter_find() works");
+  ok (bson_iter_find (&i, "str") &&
+      bson_iter_type (&i) == BSON_TYPE_STRING,
+      "bson_iter_find() should wrap over if neccessary");
+
+  ok (bson_iter_find (&i, "-invalid-key-") == FALSE,
+      "bson_iter_find() should fail when the key is not found");
+  ok (strcmp (bson_iter_key (&i), "str") == 0,
+      "a failed bson_iter_find() leaves the iterator in place");
+  ok (bson_iter_find (&i, "int6") == FALSE,
+      "bson_iter_find() does not match prefixes");
+
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  bson_set_key_index (b, TRUE);
+  bson_iter_init (&i, b);
+  ok (bson_iter_find (&i, "int32") && bson_iter_get_int32 (&i, &v) &&
+      v == 32,
+      "bson_iter_find() works with a key index");
+  ok (bson_iter_find (&i, "-invalid-key-") == FALSE,
+      "bson_iter_find() with a key index fails when the key is not found");
+  bson_free (b);
+}
+
+RUN_TEST (10, bson_iter_find);
@@ -0,0 +1,75 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_iter_get (void)
+{
+  bson *b;
+  bson_iter i;
+  gdouble d;
+  const gchar *s;
+  const guint8 *oid, *bin;
+  bson_binary_subtype subtype;
+  gboolean bv;
+  gint32 v32;
+  gint64 v64;
+
+  b = test_bson_generate_full ();
+  bson_iter_init (&i, b);
+
+  ok (bson_iter_get_double (&i, &d) == FALSE,
+      "getters fail before the first element");
+  ok (bson_iter_get_int32 (NULL, &v32) == FALSE,
+      "getters fail with a NULL iterator");
+
+  bson_iter_find (&i, "double");
+  ok (bson_iter_get_double (&i, NULL) == FALSE,
+      "getters fail with a NULL destination");
+  ok (bson_iter_get_double (&i, &d) && d == 3.14,
+      "bson_iter_get_double() works");
+  ok (bson_iter_get_int64 (&i, &v64) == FALSE,
+      "getters fail on type mismatch");
+
+  bson_iter_find (&i, "str");
+  ok (bson_iter_get_string (&i, &s) && strcmp (s, "hello world") == 0,
+      "bson_iter_get_string() works");
+
+  bson_iter_find (&i, "binary0");
+  ok (bson_iter_get_binary (&i, &subtype, &bin, &v32) &&
+      subtype == BSON_BINARY_SUBTYPE_GENERIC && v32 == 7 &&
+      memcmp (bin, "foo\0bar", 7) == 0,
+      "bson_iter_get_binary() works");
+
+  bson_iter_find (&i, "_id");
+  ok (bson_iter_get_oid (&i, &oid) &&
+      memcmp (oid, "1234567890ab", 12) == 0,
+      "bson_iter_get_oid() works");
+
+  bson_iter_find (&i, "TRUE");
+  bv = TRUE;
+  ok (bson_iter_get_boolean (&i, &bv) && bv == FALSE,
+      "bson_iter_get_boolean() works");
+
+  bson_iter_find (&i, "date");
+  ok (bson_iter_get_utc_datetime (&i, &v64) && v64 == 1294860709000,
+      "bson_iter_get_utc_datetime() works");
+
+  bson_iter_find (&i, "ts");
+  ok (bson_iter_get_timestamp (&i, &v64) && v64 == 1294860709000,
+      "bson_iter_get_timestamp() works");
+
+  bson_iter_find (&i, "int32");
+  ok (bson_iter_get_int32 (&i, &v32) && v32 == 32,
+      "bson_iter_get_int32() works");
+
+  bson_iter_find (&i, "int64");
+  ok (bson_iter_get_int64 (&i, &v64) && v64 == -42,
+      "bson_iter_get_int64() works");
+
+  bson_free (b);
+}
+
+RUN_TEST (13, bson_iter_get);
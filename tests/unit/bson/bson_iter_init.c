@@ -0,0 +1,36 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_iter_init (void)
+{
+  bson *b;
+  bson_iter i;
+
+  b = bson_new ();
+  ok (bson_iter_init (&i, NULL) == FALSE,
+      "bson_iter_init() should fail with a NULL object");
+  ok (bson_iter_init (&i, b) == FALSE,
+      "bson_iter_init() should fail with an unfinished object");
+  bson_finish (b);
+  ok (bson_iter_init (NULL, b) == FALSE,
+      "bson_iter_init() should fail with a NULL iterator");
+
+  ok (bson_iter_init (&i, b),
+      "bson_iter_init() works with an empty object");
+  ok (bson_iter_type (&i) == BSON_TYPE_NONE && bson_iter_key (&i) == NULL,
+      "bson_iter_init() positions the iterator before the first element");
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  memset (&i, 0xff, sizeof (i));
+  ok (bson_iter_init (&i, b) && bson_iter_next (&i) &&
+      strcmp (bson_iter_key (&i), "double") == 0,
+      "bson_iter_init() resets an iterator that was used before");
+  bson_free (b);
+}
+
+RUN_TEST (6, bson_iter_init);
@@ -0,0 +1,57 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_iter_next (void)
+{
+  bson *b;
+  bson_iter i;
+  bson_cursor *c;
+  gboolean same = TRUE;
+  gint n = 0;
+
+  ok (bson_iter_next (NULL) == FALSE,
+      "bson_iter_next (NULL) should fail");
+
+  b = bson_new ();
+  bson_finish (b);
+  bson_iter_init (&i, b);
+
+  ok (bson_iter_next (&i) == FALSE,
+      "bson_iter_next() should fail with an empty document");
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  bson_iter_init (&i, b);
+  ok (bson_iter_next (&i),
+      "initial bson_iter_next() works");
+  ok (bson_iter_type (&i) == BSON_TYPE_DOUBLE &&
+      strcmp (bson_iter_key (&i), "double") == 0,
+      "bson_iter_next() moves to the first element");
+
+  bson_iter_init (&i, b);
+  c = bson_cursor_new (b);
+  while (bson_iter_next (&i))
+    {
+      n++;
+      if (!bson_cursor_next (c) ||
+          bson_cursor_type (c) != bson_iter_type (&i) ||
+          strcmp (bson_cursor_key (c), bson_iter_key (&i)) != 0)
+        same = FALSE;
+    }
+  bson_cursor_free (c);
+
+  cmp_ok (n, "==", 16,
+          "bson_iter_next() visits every element");
+  ok (same,
+      "bson_iter_next() walks the same elements as bson_cursor_next()");
+  ok (bson_iter_next (&i) == FALSE,
+      "bson_iter_next() fails after the end of the BSON object");
+
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_iter_next);
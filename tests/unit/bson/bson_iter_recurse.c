@@ -0,0 +1,56 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_iter_recurse (void)
+{
+  bson *b;
+  bson_iter i, child;
+  const gchar *s;
+  gint32 v32;
+  gint64 v64;
+
+  b = test_bson_generate_full ();
+  bson_iter_init (&i, b);
+
+  ok (bson_iter_recurse (&i, &child) == FALSE,
+      "bson_iter_recurse() fails before the first element");
+  ok (bson_iter_recurse (NULL, &child) == FALSE,
+      "bson_iter_recurse() fails with a NULL iterator");
+
+  bson_iter_find (&i, "str");
+  ok (bson_iter_recurse (&i, &child) == FALSE,
+      "bson_iter_recurse() fails on non-document elements");
+
+  bson_iter_find (&i, "doc");
+  ok (bson_iter_recurse (&i, NULL) == FALSE,
+      "bson_iter_recurse() fails with a NULL child");
+  ok (bson_iter_recurse (&i, &child),
+      "bson_iter_recurse() works on documents");
+  ok (bson_iter_next (&child) && bson_iter_get_string (&child, &s) &&
+      strcmp (s, "sub-document") == 0,
+      "the child iterator walks the embedded document");
+  ok (bson_iter_find (&child, "answer") &&
+      bson_iter_get_int32 (&child, &v32) && v32 == 42,
+      "bson_iter_find() works on a child iterator");
+  ok (bson_iter_next (&child) == FALSE,
+      "the child iterator stops at the end of the embedded document");
+
+  bson_iter_find (&i, "array");
+  ok (bson_iter_recurse (&i, &child) && bson_iter_next (&child) &&
+      bson_iter_get_int32 (&child, &v32) && v32 == 32 &&
+      bson_iter_next (&child) &&
+      bson_iter_get_int64 (&child, &v64) && v64 == -42 &&
+      !bson_iter_next (&child),
+      "bson_iter_recurse() works on arrays");
+
+  ok (bson_iter_next (&i) && strcmp (bson_iter_key (&i), "binary0") == 0,
+      "the parent iterator is not affected by its child");
+
+  bson_free (b);
+}
+
+RUN_TEST (10, bson_iter_recurse);
@@ -0,0 +1,92 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-json.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static gint32
+_get_n (bson *b)
+{
+  bson_cursor *c;
+  gint32 n = -1;
+
+  c = bson_find (b, "n");
+  bson_cursor_get_int32 (c, &n);
+  bson_cursor_free (c);
+  bson_free (b);
+  return n;
+}
+
+void
+test_bson_json_reader_next (void)
+{
+  static const gchar input[] =
+    "{\"n\":1}\n"
+    "\n"
+    "  {\"n\":2}\r\n"
+    "{\"n\":\n"
+    "{\"n\":3}";
+  bson_json_reader *r;
+  bson *b;
+  gint i, n, expected = 0;
+  FILE *f;
+  GString *s;
+
+  errno = 0;
+  ok (bson_json_reader_next (NULL) == NULL && errno == EINVAL,
+      "bson_json_reader_next() fails with a NULL reader");
+  ok (bson_json_reader_new_from_data (NULL, 0) == NULL,
+      "bson_json_reader_new_from_data() fails with NULL data");
+  ok (bson_json_reader_new_from_fd (-1) == NULL,
+      "bson_json_reader_new_from_fd() fails with an invalid fd");
+
+  r = bson_json_reader_new_from_data (input, strlen (input));
+  ok (_get_n (bson_json_reader_next (r)) == 1,
+      "bson_json_reader_next() returns the first document");
+  ok (_get_n (bson_json_reader_next (r)) == 2,
+      "bson_json_reader_next() skips empty lines");
+  ok (bson_json_reader_next (r) == NULL && errno == EINVAL,
+      "bson_json_reader_next() reports invalid lines");
+  ok (_get_n (bson_json_reader_next (r)) == 3,
+      "bson_json_reader_next() continues after invalid lines, and "
+      "handles a missing final newline");
+  ok (bson_json_reader_next (r) == NULL && errno == 0,
+      "bson_json_reader_next() signals the end of the input");
+  bson_json_reader_free (r);
+
+  /* Enough data to need more than one read, and to grow the buffer
+     for the long line. */
+  s = g_string_new (NULL);
+  for (i = 0; i < 20000; i++)
+    g_string_append (s, "{\"n\":1,\"pad\":\"xxxxxxxxxxxxxxxxxxxxxxxx\"}\n");
+  g_string_append (s, "{\"n\":2,\"pad\":\"");
+  for (i = 0; i < 100000; i++)
+    g_string_append_c (s, 'y');
+  g_string_append (s, "\"}\n");
+
+  f = tmpfile ();
+  fwrite (s->str, 1, s->len, f);
+  fflush (f);
+  lseek (fileno (f), 0, SEEK_SET);
+
+  r = bson_json_reader_new_from_fd (fileno (f));
+  i = 0;
+  while ((b = bson_json_reader_next (r)) != NULL)
+    {
+      n = _get_n (b);
+      if (n == ((i < 20000) ? 1 : 2))
+        expected++;
+      i++;
+    }
+  ok (i == 20001 && expected == 20001 && errno == 0,
+      "bson_json_reader_next() reads documents from a file descriptor");
+  bson_json_reader_free (r);
+  fclose (f);
+  g_string_free (s, TRUE);
+}
+
+RUN_TEST (9, bson_json_reader_next);
@@ -0,0 +1,34 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_key_new (void)
+{
+  bson_key *k;
+  gchar name[] = "some_key";
+
+  ok (bson_key_new (NULL) == NULL,
+      "bson_key_new() fails with a NULL name");
+
+  k = bson_key_new (name);
+  ok (k != NULL,
+      "bson_key_new() works");
+  name[0] = 'S';
+  ok (strcmp (bson_key_name (k), "some_key") == 0,
+      "bson_key_name() returns a copy of the original name");
+  ok (bson_key_name (NULL) == NULL,
+      "bson_key_name() fails with a NULL key");
+
+  ok (bson_key_set_prediction (NULL, TRUE) == FALSE,
+      "bson_key_set_prediction() fails with a NULL key");
+  ok (bson_key_set_prediction (k, TRUE),
+      "bson_key_set_prediction() works");
+
+  bson_key_free (k);
+  bson_key_free (NULL);
+  pass ("bson_key_free() works, even with NULL");
+}
+
+RUN_TEST (7, bson_key_new);
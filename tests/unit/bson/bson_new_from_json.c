@@ -0,0 +1,169 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-json.h>
+#include <string.h>
+
+static gboolean
+_roundtrip (bson_json_mode mode)
+{
+  bson *b, *r;
+  gchar *json, *json2;
+  gboolean ok;
+
+  b = test_bson_generate_full ();
+  json = g_malloc (bson_to_json_buffer (b, mode, NULL, 0) + 1);
+  bson_to_json_buffer (b, mode, json, G_MAXINT32);
+
+  r = bson_new_from_json (json, -1);
+  if (!r)
+    {
+      g_free (json);
+      bson_free (b);
+      return FALSE;
+    }
+
+  if (mode == BSON_JSON_CANONICAL)
+    ok = bson_size (r) == bson_size (b) &&
+      memcmp (bson_data (r), bson_data (b), bson_size (b)) == 0;
+  else
+    {
+      /* Relaxed mode loses the distinction between integer types, so
+         compare the JSON instead. */
+      json2 = g_malloc (bson_to_json_buffer (r, mode, NULL, 0) + 1);
+      bson_to_json_buffer (r, mode, json2, G_MAXINT32);
+      ok = strcmp (json, json2) == 0;
+      g_free (json2);
+    }
+
+  g_free (json);
+  bson_free (b);
+  bson_free (r);
+  return ok;
+}
+
+void
+test_bson_new_from_json (void)
+{
+  bson *b;
+  bson_cursor *c;
+  const gchar *s;
+  gint32 i32;
+  gint64 i64;
+  gdouble d;
+  gboolean bool;
+  bson_binary_subtype subtype;
+  const guint8 *bin;
+  gint32 bin_size;
+
+  errno = 0;
+  ok (bson_new_from_json (NULL, -1) == NULL && errno == EINVAL,
+      "bson_new_from_json() fails with NULL input");
+
+  b = bson_new_from_json (" {\"a\" : 1, \"b\":-2147483649, \"c\":1.5e3,"
+                          "\"d\":true,\"e\":null,\"f\":\"\" } \n", -1);
+  ok (b != NULL, "bson_new_from_json() works");
+  c = bson_find (b, "a");
+  ok (bson_cursor_type (c) == BSON_TYPE_INT32 &&
+      bson_cursor_get_int32 (c, &i32) && i32 == 1,
+      "Small integers are parsed as int32");
+  bson_cursor_next (c);
+  ok (bson_cursor_type (c) == BSON_TYPE_INT64 &&
+      bson_cursor_get_int64 (c, &i64) && i64 == G_GINT64_CONSTANT (-2147483649),
+      "Large integers are parsed as int64");
+  bson_cursor_next (c);
+  ok (bson_cursor_get_double (c, &d) && d == 1500.0,
+      "Fractional numbers are parsed as doubles");
+  bson_cursor_next (c);
+  ok (bson_cursor_get_boolean (c, &bool) && bool == TRUE,
+      "Booleans are parsed");
+  bson_cursor_next (c);
+  ok (bson_cursor_type (c) == BSON_TYPE_NULL, "null is parsed");
+  bson_cursor_next (c);
+  ok (bson_cursor_get_string (c, &s) && strcmp (s, "") == 0,
+      "Empty strings are parsed");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = bson_new_from_json ("{\"k\\u00e9y\":\"a\\\"b\\\\c\\n\\ud83d\\ude00\","
+                          "\"n\":{\"x\":[1,[2,{\"y\":3}]]}}", -1);
+  c = bson_find (b, "k\xc3\xa9y");
+  ok (c && bson_cursor_get_string (c, &s) &&
+      strcmp (s, "a\"b\\c\n\xf0\x9f\x98\x80") == 0,
+      "Escape sequences, including surrogate pairs, are unescaped");
+  bson_cursor_free (c);
+  c = bson_find_path (b, "n.x.1.1.y");
+  ok (c && bson_cursor_get_int32 (c, &i32) && i32 == 3,
+      "Nested objects and arrays are parsed");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = bson_new_from_json ("{\"b\":{\"$binary\":{\"base64\":\"Zm9vYg==\","
+                          "\"subType\":\"80\"}},"
+                          "\"d\":{\"$date\":\"1970-01-02T00:00:01.5+01:00\"},"
+                          "\"o\":{\"$other\":1}}", -1);
+  c = bson_find (b, "b");
+  ok (c && bson_cursor_get_binary (c, &subtype, &bin, &bin_size) &&
+      subtype == BSON_BINARY_SUBTYPE_USER_DEFINED && bin_size == 4 &&
+      memcmp (bin, "foob", 4) == 0,
+      "Extended JSON binaries are parsed");
+  bson_cursor_next (c);
+  ok (bson_cursor_get_utc_datetime (c, &i64) && i64 == 82801500,
+      "Extended JSON dates with time zones are parsed");
+  bson_cursor_next (c);
+  ok (bson_cursor_type (c) == BSON_TYPE_DOCUMENT,
+      "Unknown extended JSON wrappers are kept as documents");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = bson_new_from_json ("{\"a\":{\"$code\":\"x\",\"$scope\":{\"zz\":1},"
+                          "\"extra\":2}}", -1);
+  c = bson_find_path (b, "a.extra");
+  ok (c && bson_cursor_get_int32 (c, &i32) && i32 == 2,
+      "Almost-$code wrappers keep their key");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = bson_new_from_json ("{\"a\":{\"$code\":\"x\",\"$scope\":"
+                          "{\"0123456789abcdef0123456789abcdef"
+                          "0123456789abcdef0123456789abcdef\":1},"
+                          "\"extra\":2}}", -1);
+  c = bson_find_path (b, "a.$scope.0123456789abcdef0123456789abcdef"
+                      "0123456789abcdef0123456789abcdef");
+  ok (c && bson_cursor_get_int32 (c, &i32) && i32 == 1,
+      "Almost-$code wrappers with long scope keys are parsed");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  b = bson_new_from_json ("{\"a\":{\"$binary\":{\"base64\":\"\","
+                          "\"subType\":\"80\"}}}", -1);
+  ok (b && bson_size (b) == 13 &&
+      memcmp (bson_data (b),
+              "\x0d\0\0\0" "\x05" "a\0" "\0\0\0\0" "\x80", 13) == 0,
+      "Extended JSON empty binaries are parsed");
+  bson_free (b);
+
+  ok (_roundtrip (BSON_JSON_RELAXED),
+      "Relaxed extended JSON round-trips");
+  ok (_roundtrip (BSON_JSON_CANONICAL),
+      "Canonical extended JSON round-trips");
+
+  ok (bson_new_from_json ("{\"a\":1,}", -1) == NULL && errno == EINVAL,
+      "bson_new_from_json() fails on trailing commas");
+  ok (bson_new_from_json ("{\"a\":01}", -1) == NULL,
+      "bson_new_from_json() fails on leading zeros");
+  ok (bson_new_from_json ("{\"a\":\"b\n\"}", -1) == NULL,
+      "bson_new_from_json() fails on unescaped control characters");
+  ok (bson_new_from_json ("[1,2]", -1) == NULL,
+      "bson_new_from_json() fails if the input is not an object");
+  ok (bson_new_from_json ("{\"a\":1} x", -1) == NULL,
+      "bson_new_from_json() fails on trailing garbage");
+  ok (bson_new_from_json ("{\"a\":1}", 6) == NULL,
+      "bson_new_from_json() honours the size");
+  ok (bson_new_from_json ("{\"a\\u0000\":1}", -1) == NULL,
+      "bson_new_from_json() fails on keys with NUL bytes");
+}
+
+RUN_TEST (25, bson_new_from_json);
@@ -0,0 +1,91 @@
+#include "bson.h"
+#include "test.h"
+#include "tap.h"
+
+#include <string.h>
+
+void
+test_bson_new_in_arena (void)
+{
+  bson_arena *arena;
+  bson *b, *b2, *orig;
+  bson_cursor *c;
+  gint i;
+
+  ok (bson_arena_new (0) == NULL,
+      "bson_arena_new() with a zero chunk size fails");
+  ok (bson_arena_new (-1) == NULL,
+      "bson_arena_new() with a negative chunk size fails");
+  ok (bson_new_in_arena (NULL, 0) == NULL,
+      "bson_new_in_arena() with a NULL arena fails");
+
+  arena = bson_arena_new (64);
+  ok (arena != NULL, "bson_arena_new() works");
+
+  ok ((b = bson_new_in_arena (arena, 0)) != NULL,
+      "bson_new_in_arena() works");
+  ok (bson_size (b) == -1,
+      "bson_size() with an unfinished object should fail");
+  ok (bson_finish (b), "bson_finish() works");
+  cmp_ok (bson_size (b), "==", 5,
+          "bson_size() of an empty arena object is correct");
+
+  /* Build the same document twice, interleaved, so that neither of
+     them can grow in place, and both outgrow the initial chunk. */
+  b = bson_new_in_arena (arena, 0);
+  b2 = bson_new_in_arena (arena, 0);
+  for (i = 0; i < 2; i++)
+    {
+      bson *t = (i == 0) ? b : b2;
+
+      bson_append_double (t, "double", 3.14);
+      bson_append_string (t, "str", "hello world", -1);
+    }
+  bson_finish (b);
+  bson_finish (b2);
+  cmp_ok (bson_size (b), "==", bson_size (b2),
+          "Interleaved arena objects have the same size");
+  ok (memcmp (bson_data (b), bson_data (b2), bson_size (b)) == 0,
+      "Interleaved arena objects have the same contents");
+
+  b = bson_new_in_arena (arena, 0);
+  bson_append_double (b, "double", 3.14);
+  bson_append_string (b, "str", "hello world", -1);
+  bson_append_int32 (b, "int32", 32);
+  bson_append_int64 (b, "int64", (gint64)-42);
+  bson_finish (b);
+
+  b2 = bson_new ();
+  bson_append_double (b2, "double", 3.14);
+  bson_append_string (b2, "str", "hello world", -1);
+  bson_append_int32 (b2, "int32", 32);
+  bson_append_int64 (b2, "int64", (gint64)-42);
+  bson_finish (b2);
+
+  cmp_ok (bson_size (b), "==", bson_size (b2),
+          "Arena and heap objects have the same size");
+  ok (memcmp (bson_data (b), bson_data (b2), bson_size (b)) == 0,
+      "Arena and heap objects have the same contents");
+
+  bson_free (b);
+  pass ("bson_free() on an arena object is a no-op");
+  bson_free (b2);
+
+  /* A document many times the size of a chunk. */
+  orig = test_bson_generate_full ();
+  b = bson_new_in_arena (arena, 0);
+  c = bson_cursor_new (orig);
+  while (bson_cursor_next (c))
+    bson_append_element_from_cursor (b, NULL, c);
+  bson_cursor_free (c);
+  bson_finish (b);
+  ok (bson_size (b) == bson_size (orig) &&
+      memcmp (bson_data (b), bson_data (orig), bson_size (orig)) == 0,
+      "Arena objects can be larger than a chunk");
+
+  bson_free (orig);
+  bson_arena_free (arena);
+  bson_arena_free (NULL);
+}
+
+RUN_TEST (14, bson_new_in_arena);
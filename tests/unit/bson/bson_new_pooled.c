@@ -0,0 +1,42 @@
+#include "config.h"
+#include "bson.h"
+#include "test.h"
+#include "tap.h"
+
+#ifndef HAVE_TLS
+#define HAVE_TLS 0
+#endif
+
+void
+test_bson_new_pooled (void)
+{
+  bson *b, *p;
+
+  b = bson_new_pooled ();
+  ok (b != NULL, "bson_new_pooled() works on an empty pool");
+  cmp_ok (bson_size (b), "==", -1,
+          "A pooled object starts out unfinished");
+  bson_append_int32 (b, "int32", 42);
+  bson_finish (b);
+  cmp_ok (bson_size (b), "==", 16,
+          "A pooled object can be appended to");
+  bson_release (b);
+
+  p = bson_new_pooled ();
+  skip (!HAVE_TLS, 1, "Thread-local storage is not supported");
+  ok (p == b, "bson_new_pooled() recycles released objects");
+  endskip;
+  cmp_ok (bson_size (p), "==", -1,
+          "A recycled object is reset");
+  bson_finish (p);
+  cmp_ok (bson_size (p), "==", 5,
+          "A recycled object is empty");
+  bson_release (p);
+
+  bson_pool_flush ();
+  b = bson_new_pooled ();
+  ok (b != NULL, "bson_new_pooled() works after bson_pool_flush()");
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_new_pooled);
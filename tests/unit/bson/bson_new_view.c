@@ -0,0 +1,49 @@
+#include "bson.h"
+#include "test.h"
+#include "tap.h"
+
+#include <string.h>
+
+void
+test_bson_new_view (void)
+{
+  bson *orig, *view;
+  bson_cursor *c;
+  const gchar *s;
+
+  orig = test_bson_generate_full ();
+
+  ok (bson_new_view (NULL, bson_size (orig)) == NULL,
+      "bson_new_view (NULL, size) fails");
+  ok (bson_new_view (bson_data (orig), 0) == NULL,
+      "bson_new_view (orig, 0) fails");
+  ok (bson_new_view (bson_data (orig), -1) == NULL,
+      "bson_new_view (orig, -1) fails");
+  ok (bson_new_view (bson_data (orig), bson_size (orig) - 1) == NULL,
+      "bson_new_view() fails if the size does not match the document");
+
+  ok ((view = bson_new_view (bson_data (orig), bson_size (orig))) != NULL,
+      "bson_new_view() works");
+  cmp_ok (bson_size (view), "==", bson_size (orig),
+          "The view is finished, and has the same size as the original");
+  ok (bson_data (view) == bson_data (orig),
+      "The view points into the original data");
+
+  c = bson_find (view, "str");
+  ok (bson_cursor_get_string (c, &s) && strcmp (s, "hello world") == 0,
+      "Cursors work on views");
+  bson_cursor_free (c);
+
+  ok (bson_append_int32 (view, "int32", 42) == FALSE,
+      "Appending to a view fails");
+  ok (bson_reset (view) == FALSE,
+      "Resetting a view fails");
+
+  bson_free (view);
+  cmp_ok (bson_size (orig), ">", 0,
+          "Freeing the view leaves the original intact");
+
+  bson_free (orig);
+}
+
+RUN_TEST (11, bson_new_view);
@@ -0,0 +1,96 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_ref (void)
+{
+  bson *b, *r, *sub;
+  bson_arena *arena;
+  bson_cursor *c, *c2, *sub_c;
+  gint32 i;
+
+  ok (bson_ref (NULL) == NULL,
+      "bson_ref(NULL) should fail");
+
+  arena = bson_arena_new (0);
+  b = bson_new_in_arena (arena, 0);
+  ok (bson_ref (b) == NULL,
+      "bson_ref() fails with objects allocated from an arena");
+  bson_arena_free (arena);
+
+  b = bson_new ();
+  bson_append_document_begin (b, "sub", &sub);
+  ok (bson_ref (b) == NULL && bson_ref (sub) == NULL,
+      "bson_ref() fails while an embedded document is built in place");
+  bson_append_document_end (b, sub);
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  r = bson_ref (b);
+  ok (r != NULL && r != b,
+      "bson_ref() works");
+  ok (bson_data (r) == bson_data (b) && bson_size (r) == bson_size (b),
+      "references share the data of the object");
+
+  c = bson_find (r, "int32");
+  c2 = bson_find (r, "int32");
+  ok (!bson_cursor_set_int32 (c, 64) && !bson_cursor_set_int32 (c2, 64) &&
+      bson_data (r) == bson_data (b),
+      "in-place setters fail on shared data, through any cursor");
+
+  sub_c = bson_find_path (r, "doc.answer");
+  ok (!bson_cursor_set_int32 (sub_c, 64),
+      "in-place setters fail on embedded documents of shared data");
+  bson_cursor_free (sub_c);
+
+  bson_cursor_free (c);
+  c = bson_find (r, "doc");
+  sub_c = bson_cursor_new_child (c);
+  bson_cursor_next (sub_c);
+  bson_cursor_find (sub_c, "answer");
+  ok (!bson_cursor_set_int32 (sub_c, 64),
+      "in-place setters fail on cursors opened on embedded documents");
+
+  bson_cursor_free (c);
+  c = bson_find (b, "int32");
+  bson_cursor_get_int32 (c, &i);
+  cmp_ok (i, "==", 32,
+          "other references are not affected by in-place setters");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  ok (bson_cursor_set_int32 (c2, 64) && bson_cursor_set_int32 (sub_c, 64),
+      "in-place setters work once the data is not shared anymore");
+  bson_cursor_get_int32 (c2, &i);
+  cmp_ok (i, "==", 64,
+          "in-place setters write to the data of the last reference");
+  bson_cursor_free (sub_c);
+  bson_cursor_free (c2);
+  bson_free (r);
+
+  b = bson_new ();
+  bson_append_int32 (b, "a", 1);
+  r = bson_ref (b);
+  bson_append_int32 (r, "b", 2);
+  bson_finish (r);
+  bson_finish (b);
+  ok (bson_size (b) == 12 && bson_size (r) == 19,
+      "appending to a shared open object copies the data first");
+
+  c = bson_find (b, "b");
+  ok (c == NULL,
+      "other references do not see the appended elements");
+  bson_cursor_free (c);
+  bson_free (b);
+
+  c = bson_find (r, "a");
+  ok (bson_cursor_get_int32 (c, &i) && i == 1,
+      "the copy keeps the elements appended before sharing");
+  bson_cursor_free (c);
+  bson_free (r);
+}
+
+RUN_TEST (14, bson_ref);
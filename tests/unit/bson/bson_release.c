@@ -0,0 +1,60 @@
+#include "config.h"
+#include "bson.h"
+#include "test.h"
+#include "tap.h"
+
+#include <string.h>
+
+#ifndef HAVE_TLS
+#define HAVE_TLS 0
+#endif
+
+void
+test_bson_release (void)
+{
+  bson *b, *p, *s, *v;
+  guint8 big[128 * 1024];
+
+  bson_release (NULL);
+  pass ("bson_release(NULL) works");
+
+  b = test_bson_generate_full ();
+  bson_set_key_index (b, TRUE);
+  bson_release (b);
+  p = bson_new_pooled ();
+  skip (!HAVE_TLS, 1, "Thread-local storage is not supported");
+  ok (p == b, "bson_release() puts objects into the pool");
+  endskip;
+  bson_finish (p);
+  cmp_ok (bson_size (p), "==", 5,
+          "Released objects are reset");
+  bson_free (p);
+
+  s = bson_new ();
+  bson_release (s);
+
+  b = bson_new ();
+  memset (big, 'x', sizeof (big));
+  bson_append_binary (b, "big", BSON_BINARY_SUBTYPE_GENERIC,
+                      big, sizeof (big));
+  bson_finish (b);
+  bson_release (b);
+
+  b = test_bson_generate_full ();
+  v = bson_new_view (bson_data (b), bson_size (b));
+  bson_release (v);
+  cmp_ok (bson_size (b), "!=", -1,
+          "Releasing a view leaves the original object intact");
+  bson_free (b);
+
+  p = bson_new_pooled ();
+  skip (!HAVE_TLS, 1, "Thread-local storage is not supported");
+  ok (p == s,
+      "bson_release() does not pool views or objects with large buffers");
+  endskip;
+  bson_free (p);
+
+  bson_pool_flush ();
+}
+
+RUN_TEST (5, bson_release);
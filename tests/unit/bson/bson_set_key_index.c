@@ -0,0 +1,88 @@
+#include "bson.h"
+#include "test.h"
+#include "tap.h"
+
+#include <string.h>
+
+static gboolean
+_test_lookups_match (bson *plain, bson *indexed)
+{
+  bson_cursor *c, *pc, *ic;
+  gboolean ret = TRUE;
+
+  c = bson_cursor_new (plain);
+  while (bson_cursor_next (c))
+    {
+      pc = bson_find (plain, bson_cursor_key (c));
+      ic = bson_find (indexed, bson_cursor_key (c));
+
+      if (!ic || bson_cursor_key (pc) - (const gchar *)bson_data (plain) !=
+          bson_cursor_key (ic) - (const gchar *)bson_data (indexed))
+        ret = FALSE;
+
+      bson_cursor_free (pc);
+      bson_cursor_free (ic);
+    }
+  bson_cursor_free (c);
+
+  return ret;
+}
+
+void
+test_bson_set_key_index (void)
+{
+  bson *plain, *b;
+  bson_cursor *c;
+  gint32 i;
+
+  ok (bson_set_key_index (NULL, TRUE) == FALSE,
+      "bson_set_key_index(NULL) should fail");
+
+  plain = test_bson_generate_full ();
+  b = test_bson_generate_full ();
+  ok (bson_set_key_index (b, TRUE), "bson_set_key_index() works");
+
+  ok (_test_lookups_match (plain, b),
+      "bson_find() finds the same elements with and without an index");
+  ok (bson_find (b, "-invalid-key-") == NULL,
+      "bson_find() on an indexed object fails for missing keys");
+  ok (bson_find (b, "int6") == NULL,
+      "bson_find() on an indexed object does not match prefixes");
+
+  c = bson_find (b, "TRUE");
+  ok (bson_cursor_find_next (c, "int32"),
+      "bson_cursor_find_next() works with an index");
+  ok (bson_cursor_find_next (c, "str") == FALSE,
+      "bson_cursor_find_next() does not wrap over with an index");
+  ok (bson_cursor_find (c, "str") &&
+      strcmp (bson_cursor_key (c), "str") == 0,
+      "bson_cursor_find() wraps over with an index");
+  bson_cursor_free (c);
+
+  ok (bson_reset (b), "bson_reset() works on an indexed object");
+  bson_append_int32 (b, "a", 1);
+  bson_append_int32 (b, "b", 2);
+  bson_append_int32 (b, "a", 3);
+  bson_finish (b);
+
+  c = bson_find (b, "a");
+  ok (bson_cursor_get_int32 (c, &i) && i == 1,
+      "bson_find() returns the first of duplicate keys, after a reset");
+  bson_cursor_next (c);
+  ok (bson_cursor_find_next (c, "a") && bson_cursor_get_int32 (c, &i) &&
+      i == 3,
+      "bson_cursor_find_next() finds later duplicates");
+  bson_cursor_free (c);
+
+  ok (bson_set_key_index (b, FALSE),
+      "bson_set_key_index() can turn the index off");
+  c = bson_find (b, "b");
+  ok (bson_cursor_get_int32 (c, &i) && i == 2,
+      "bson_find() works after the index is turned off");
+  bson_cursor_free (c);
+
+  bson_free (b);
+  bson_free (plain);
+}
+
+RUN_TEST (13, bson_set_key_index);
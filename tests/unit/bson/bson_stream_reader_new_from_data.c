@@ -0,0 +1,61 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-stream.h>
+#include <string.h>
+
+void
+test_bson_stream_reader_new_from_data (void)
+{
+  bson_stream_reader *r;
+  bson *b;
+  guint8 *data;
+  gint32 size;
+
+  errno = 0;
+  ok (bson_stream_reader_new_from_data (NULL, 10, 0) == NULL &&
+      errno == EINVAL,
+      "bson_stream_reader_new_from_data() with NULL data fails");
+
+  r = bson_stream_reader_new_from_data (NULL, 0, 0);
+  ok (r != NULL,
+      "bson_stream_reader_new_from_data() with an empty stream works");
+  errno = EINVAL;
+  ok (bson_stream_reader_next (r) == NULL && errno == 0,
+      "An empty stream has no documents");
+  bson_stream_reader_free (r);
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+  data = g_malloc (size * 2);
+  memcpy (data, bson_data (b), size);
+  memcpy (data + size, bson_data (b), size);
+
+  r = bson_stream_reader_new_from_data (data, size * 2,
+                                        BSON_STREAM_READER_INDEX);
+  ok (r != NULL,
+      "bson_stream_reader_new_from_data() with an index works");
+  cmp_ok (bson_stream_reader_count (r), "==", 2,
+          "The index covers every document");
+  bson_stream_reader_free (r);
+
+  errno = 0;
+  r = bson_stream_reader_new_from_data (data, size * 2 - 1,
+                                        BSON_STREAM_READER_INDEX);
+  ok (r == NULL && errno == EINVAL,
+      "bson_stream_reader_new_from_data() with an index fails on a "
+      "truncated stream");
+
+  r = bson_stream_reader_new_from_data (data, size * 2 - 1, 0);
+  ok (r != NULL,
+      "bson_stream_reader_new_from_data() without an index does not "
+      "check the stream up front");
+  bson_stream_reader_free (r);
+
+  g_free (data);
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_stream_reader_new_from_data);
@@ -0,0 +1,66 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-stream.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void
+test_bson_stream_reader_new_from_file (void)
+{
+  bson_stream_reader *r;
+  const bson *v;
+  bson *b;
+  gchar path[] = "bson_stream_reader_XXXXXX";
+  gint fd, i, n = 0;
+  gboolean match = TRUE;
+
+  errno = 0;
+  ok (bson_stream_reader_new_from_file (NULL, 0) == NULL &&
+      errno == EINVAL,
+      "bson_stream_reader_new_from_file() with a NULL filename fails");
+  ok (bson_stream_reader_new_from_file ("/nonexistent/file", 0) == NULL &&
+      errno == ENOENT,
+      "bson_stream_reader_new_from_file() with a missing file fails");
+
+  fd = mkstemp (path);
+  r = bson_stream_reader_new_from_file (path, 0);
+  ok (r != NULL && bson_stream_reader_next (r) == NULL && errno == 0,
+      "bson_stream_reader_new_from_file() works with an empty file");
+  bson_stream_reader_free (r);
+
+  b = test_bson_generate_full ();
+  for (i = 0; i < 3; i++)
+    if (write (fd, bson_data (b), bson_size (b)) != bson_size (b))
+      break;
+
+  r = bson_stream_reader_new_from_file (path, BSON_STREAM_READER_SEQUENTIAL);
+  ok (r != NULL,
+      "bson_stream_reader_new_from_file() works");
+  while ((v = bson_stream_reader_next (r)) != NULL)
+    {
+      match &= bson_equal (v, b);
+      n++;
+    }
+  ok (n == 3 && match && errno == 0,
+      "Every document is read back from the file");
+  bson_stream_reader_free (r);
+
+  if (write (fd, bson_data (b), 10) != 10)
+    fail ("Could not write the test file");
+  errno = 0;
+  r = bson_stream_reader_new_from_file (path, BSON_STREAM_READER_INDEX);
+  ok (r == NULL && errno == EINVAL,
+      "bson_stream_reader_new_from_file() with an index fails on a "
+      "truncated file");
+
+  close (fd);
+  unlink (path);
+  bson_free (b);
+}
+
+RUN_TEST (6, bson_stream_reader_new_from_file);
@@ -0,0 +1,70 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-stream.h>
+#include <string.h>
+
+void
+test_bson_stream_reader_next (void)
+{
+  bson_stream_reader *r;
+  const bson *v;
+  bson *b1, *b2;
+  guint8 *data;
+  gint32 s1, s2;
+  gint64 offset;
+
+  errno = 0;
+  ok (bson_stream_reader_next (NULL) == NULL && errno == EINVAL,
+      "bson_stream_reader_next() with a NULL reader fails");
+
+  b1 = test_bson_generate_full ();
+  b2 = bson_build (BSON_TYPE_INT32, "i", 42, BSON_TYPE_NONE);
+  bson_finish (b2);
+  s1 = bson_size (b1);
+  s2 = bson_size (b2);
+
+  data = g_malloc (s1 + s2 + 10);
+  memcpy (data, bson_data (b1), s1);
+  memcpy (data + s1, bson_data (b2), s2);
+  memcpy (data + s1 + s2, bson_data (b2), 10);
+
+  r = bson_stream_reader_new_from_data (data, s1 + s2 + 10, 0);
+  cmp_ok (bson_stream_reader_tell (r), "==", 0,
+          "A new reader starts at the beginning of the stream");
+
+  v = bson_stream_reader_next (r);
+  ok (v != NULL && bson_equal (v, b1),
+      "bson_stream_reader_next() works");
+  ok (bson_data (v) == data,
+      "bson_stream_reader_next() does not copy the document");
+  offset = bson_stream_reader_tell (r);
+  cmp_ok (offset, "==", s1,
+          "bson_stream_reader_tell() returns the offset of the next "
+          "document");
+
+  v = bson_stream_reader_next (r);
+  ok (v != NULL && bson_equal (v, b2),
+      "bson_stream_reader_next() returns the next document");
+
+  errno = 0;
+  ok (bson_stream_reader_next (r) == NULL && errno == EINVAL,
+      "bson_stream_reader_next() fails on a truncated document");
+
+  ok (bson_stream_reader_seek (r, s1 + s2 + 11) == FALSE,
+      "bson_stream_reader_seek() past the end of the stream fails");
+  ok (bson_stream_reader_seek (r, offset),
+      "bson_stream_reader_seek() works");
+  v = bson_stream_reader_next (r);
+  ok (v != NULL && bson_equal (v, b2),
+      "bson_stream_reader_next() continues from the new offset");
+
+  bson_stream_reader_free (r);
+  g_free (data);
+  bson_free (b2);
+  bson_free (b1);
+}
+
+RUN_TEST (10, bson_stream_reader_next);
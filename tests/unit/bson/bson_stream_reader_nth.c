@@ -0,0 +1,72 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-stream.h>
+#include <string.h>
+
+void
+test_bson_stream_reader_nth (void)
+{
+  bson_stream_reader *r;
+  const bson *v;
+  bson *b;
+  guint8 *data;
+  gint32 size, i, value;
+  bson_cursor *c;
+
+  errno = 0;
+  ok (bson_stream_reader_nth (NULL, 0) == NULL && errno == EINVAL,
+      "bson_stream_reader_nth() with a NULL reader fails");
+  cmp_ok (bson_stream_reader_count (NULL), "==", -1,
+          "bson_stream_reader_count() with a NULL reader fails");
+
+  b = bson_build (BSON_TYPE_INT32, "i", 0, BSON_TYPE_NONE);
+  bson_finish (b);
+  size = bson_size (b);
+  bson_free (b);
+
+  data = g_malloc (size * 100);
+  for (i = 0; i < 100; i++)
+    {
+      b = bson_build (BSON_TYPE_INT32, "i", i, BSON_TYPE_NONE);
+      bson_finish (b);
+      memcpy (data + i * size, bson_data (b), size);
+      bson_free (b);
+    }
+
+  r = bson_stream_reader_new_from_data (data, size * 100, 0);
+  cmp_ok (bson_stream_reader_count (r), "==", 100,
+          "bson_stream_reader_count() works");
+
+  v = bson_stream_reader_nth (r, 42);
+  c = bson_find (v, "i");
+  ok (bson_cursor_get_int32 (c, &value) && value == 42,
+      "bson_stream_reader_nth() works");
+  bson_cursor_free (c);
+
+  v = bson_stream_reader_next (r);
+  c = bson_find (v, "i");
+  ok (bson_cursor_get_int32 (c, &value) && value == 43,
+      "bson_stream_reader_next() continues after the Nth document");
+  bson_cursor_free (c);
+
+  errno = 0;
+  ok (bson_stream_reader_nth (r, 100) == NULL && errno == ERANGE,
+      "bson_stream_reader_nth() fails when out of range");
+  errno = 0;
+  ok (bson_stream_reader_nth (r, -1) == NULL && errno == ERANGE,
+      "bson_stream_reader_nth() fails with a negative index");
+  bson_stream_reader_free (r);
+
+  r = bson_stream_reader_new_from_data (data, size * 100 - 1, 0);
+  errno = 0;
+  ok (bson_stream_reader_count (r) == -1 && errno == EINVAL,
+      "bson_stream_reader_count() fails on a malformed stream");
+  bson_stream_reader_free (r);
+
+  g_free (data);
+}
+
+RUN_TEST (8, bson_stream_reader_nth);
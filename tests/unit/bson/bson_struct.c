@@ -0,0 +1,109 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+#include "bson-struct.h"
+
+#include <string.h>
+
+#define TEST_RECORD_FIELDS(FIELD)               \
+  FIELD (int64, ts)                             \
+  FIELD (string, host)                          \
+  FIELD (int32, port)                           \
+  FIELD (double, load)                          \
+  FIELD (boolean, primary)                      \
+  FIELD (utc_datetime, seen)                    \
+  FIELD (timestamp, optime)                     \
+  FIELD (oid, _id)
+
+BSON_STRUCT (test_record, TEST_RECORD_FIELDS)
+
+void
+test_bson_struct (void)
+{
+  test_record r, d;
+  bson *b;
+  bson_cursor *c;
+  gint32 size;
+  gint32 port;
+
+  memset (&r, 0, sizeof (r));
+  r.ts = 1294860709000;
+  r.host = "db.example.com";
+  r.port = 27017;
+  r.load = 0.75;
+  r.primary = TRUE;
+  r.seen = 1294860709001;
+  r.optime = 42;
+  r._id = (const guint8 *)"1234567890ab";
+
+  ok (test_record_to_bson (NULL) == NULL,
+      "test_record_to_bson() fails with a NULL structure");
+
+  size = test_record_bson_size (&r);
+  b = test_record_to_bson (&r);
+  ok (b != NULL,
+      "test_record_to_bson() works");
+  cmp_ok (bson_size (b), "==", size,
+          "test_record_bson_size() computes the exact size");
+
+  c = bson_find (b, "port");
+  ok (bson_cursor_get_int32 (c, &port) && port == 27017,
+      "the encoded document has the expected fields");
+  bson_cursor_free (c);
+
+  memset (&d, 0, sizeof (d));
+  ok (test_record_from_bson (b, NULL) == FALSE,
+      "test_record_from_bson() fails with a NULL structure");
+  ok (test_record_from_bson (b, &d),
+      "test_record_from_bson() works");
+  ok (d.ts == r.ts && strcmp (d.host, r.host) == 0 && d.port == r.port &&
+      d.load == r.load && d.primary == r.primary && d.seen == r.seen &&
+      d.optime == r.optime && memcmp (d._id, r._id, 12) == 0,
+      "test_record_from_bson() decodes every field");
+  ok (d.host > (const gchar *)bson_data (b) &&
+      d.host < (const gchar *)bson_data (b) + bson_size (b),
+      "strings are not copied by the decoder");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_oid (b, "_id", (const guint8 *)"abcdefghijkl");
+  bson_append_int32 (b, "port", 1);
+  bson_append_string (b, "host", "other", -1);
+  bson_append_boolean (b, "primary", FALSE);
+  bson_append_double (b, "load", 1.5);
+  bson_append_timestamp (b, "optime", 2);
+  bson_append_utc_datetime (b, "seen", 3);
+  bson_append_int64 (b, "ts", 4);
+  bson_finish (b);
+
+  memset (&d, 0, sizeof (d));
+  ok (test_record_from_bson (b, &d) && d.ts == 4 &&
+      strcmp (d.host, "other") == 0 && d.port == 1 && d.load == 1.5 &&
+      d.primary == FALSE && d.seen == 3 && d.optime == 2 &&
+      memcmp (d._id, "abcdefghijkl", 12) == 0,
+      "test_record_from_bson() works with fields out of order");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_int64 (b, "ts", 4);
+  bson_append_string (b, "host", "other", -1);
+  bson_finish (b);
+  ok (test_record_from_bson (b, &d) == FALSE,
+      "test_record_from_bson() fails when a field is missing");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_int64 (b, "ts", 4);
+  bson_append_string (b, "host", "other", -1);
+  bson_append_int64 (b, "port", 1);
+  bson_finish (b);
+  ok (test_record_from_bson (b, &d) == FALSE,
+      "test_record_from_bson() fails on type mismatch");
+  bson_free (b);
+
+  r.host = NULL;
+  ok (test_record_to_bson (&r) == NULL,
+      "test_record_to_bson() fails with a NULL string");
+}
+
+RUN_TEST (12, bson_struct);
@@ -0,0 +1,61 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_template_add_slot (void)
+{
+  bson *b;
+  bson_template *t;
+
+  b = test_bson_generate_full ();
+  t = bson_template_new (b);
+
+  ok (bson_template_add_slot (NULL, "int32", 0) == -1,
+      "bson_template_add_slot() fails with a NULL template");
+  ok (bson_template_add_slot (t, NULL, 0) == -1,
+      "bson_template_add_slot() fails with a NULL path");
+
+  cmp_ok (bson_template_add_slot (t, "int32", 0), "==", 0,
+          "bson_template_add_slot() works");
+  cmp_ok (bson_template_add_slot (t, "doc.answer", 0), "==", 1,
+          "bson_template_add_slot() works with embedded documents");
+  cmp_ok (bson_template_add_slot (t, "array.1", 0), "==", 2,
+          "bson_template_add_slot() works with arrays");
+  ok (bson_template_add_slot (t, "int32", 0) == -1,
+      "bson_template_add_slot() fails if the slot already exists");
+
+  ok (bson_template_add_slot (t, "-invalid-key-", 0) == -1 &&
+      bson_template_add_slot (t, "doc.missing", 0) == -1 &&
+      bson_template_add_slot (t, "int32.x", 0) == -1,
+      "bson_template_add_slot() fails on paths not in the layout");
+  ok (bson_template_add_slot (t, "regex", 0) == -1 &&
+      bson_template_add_slot (t, "doc", 0) == -1,
+      "bson_template_add_slot() fails on unsupported types");
+
+  ok (bson_template_add_slot (t, "str", -1) == -1 &&
+      bson_template_add_slot (t, "str", 5) == -1,
+      "bson_template_add_slot() fails if the string in the layout does "
+      "not fit the slot");
+  ok (bson_template_add_slot (t, "str", G_MAXINT32) == -1,
+      "bson_template_add_slot() fails with huge string slots");
+  cmp_ok (bson_template_add_slot (t, "str", 11), "==", 3,
+          "bson_template_add_slot() works with strings");
+  cmp_ok (bson_template_add_slot (t, "doc.name", 64), "==", 4,
+          "bson_template_add_slot() works with strings in embedded "
+          "documents");
+
+  ok (bson_template_add_slot (t, "_id", 0) >= 0 &&
+      bson_template_add_slot (t, "TRUE", 0) >= 0 &&
+      bson_template_add_slot (t, "date", 0) >= 0 &&
+      bson_template_add_slot (t, "ts", 0) >= 0 &&
+      bson_template_add_slot (t, "double", 0) >= 0 &&
+      bson_template_add_slot (t, "int64", 0) >= 0,
+      "bson_template_add_slot() supports every fixed-width type");
+
+  bson_template_free (t);
+  bson_free (b);
+}
+
+RUN_TEST (13, bson_template_add_slot);
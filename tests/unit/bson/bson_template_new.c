@@ -0,0 +1,36 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_template_new (void)
+{
+  bson *b, *r;
+  bson_template *t;
+
+  ok (bson_template_new (NULL) == NULL,
+      "bson_template_new() fails with a NULL object");
+
+  b = bson_new ();
+  bson_append_int32 (b, "int32", 32);
+  ok (bson_template_new (b) == NULL,
+      "bson_template_new() fails with an unfinished object");
+  bson_finish (b);
+
+  t = bson_template_new (b);
+  ok (t != NULL,
+      "bson_template_new() works");
+  bson_free (b);
+
+  r = bson_new ();
+  ok (bson_template_render (t, r) && bson_size (r) == 16,
+      "The template keeps a copy of the layout");
+  bson_free (r);
+
+  bson_template_free (t);
+  bson_template_free (NULL);
+  pass ("bson_template_free() works, even with NULL");
+}
+
+RUN_TEST (5, bson_template_new);
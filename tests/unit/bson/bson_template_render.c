@@ -0,0 +1,108 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+static bson *
+_generate (const gchar *host, gint32 pid, gint64 date, const gchar *msg,
+           const guint8 *oid, gboolean flag, gdouble d)
+{
+  bson *b, *meta;
+
+  meta = bson_new ();
+  bson_append_string (meta, "host", host, -1);
+  bson_append_int32 (meta, "pid", pid);
+  bson_finish (meta);
+
+  b = bson_new ();
+  bson_append_oid (b, "_id", oid);
+  bson_append_utc_datetime (b, "date", date);
+  bson_append_document (b, "meta", meta);
+  bson_append_string (b, "msg", msg, -1);
+  bson_append_boolean (b, "flag", flag);
+  bson_append_double (b, "d", d);
+  bson_append_int64 (b, "seq", date / 1000);
+  bson_append_timestamp (b, "ts", date);
+  bson_finish (b);
+
+  bson_free (meta);
+  return b;
+}
+
+void
+test_bson_template_render (void)
+{
+  bson *b, *r, *e;
+  bson_template *t;
+  gint s_id, s_date, s_host, s_pid, s_msg, s_flag, s_d, s_seq, s_ts;
+  guint8 oid1[] = "1234567890ab", oid2[] = "ba0987654321";
+
+  b = _generate ("localhost", 1, 1294860709000, "hello", oid1, FALSE, 1.0);
+  t = bson_template_new (b);
+  bson_free (b);
+
+  s_id = bson_template_add_slot (t, "_id", 0);
+  s_date = bson_template_add_slot (t, "date", 0);
+  s_host = bson_template_add_slot (t, "meta.host", 255);
+  s_pid = bson_template_add_slot (t, "meta.pid", 0);
+  s_msg = bson_template_add_slot (t, "msg", 1024);
+  s_flag = bson_template_add_slot (t, "flag", 0);
+  s_d = bson_template_add_slot (t, "d", 0);
+  s_seq = bson_template_add_slot (t, "seq", 0);
+  s_ts = bson_template_add_slot (t, "ts", 0);
+
+  r = bson_new ();
+  ok (bson_template_render (NULL, r) == FALSE,
+      "bson_template_render() fails with a NULL template");
+  ok (bson_template_render (t, NULL) == FALSE,
+      "bson_template_render() fails with a NULL destination");
+
+  ok (bson_template_set_oid (t, s_id, oid2) &&
+      bson_template_set_utc_datetime (t, s_date, 1300000000000) &&
+      bson_template_set_string (t, s_host, "a-much-longer-host-name", -1) &&
+      bson_template_set_int32 (t, s_pid, 4242) &&
+      bson_template_set_string (t, s_msg, "hi", -1) &&
+      bson_template_set_boolean (t, s_flag, TRUE) &&
+      bson_template_set_double (t, s_d, 3.14) &&
+      bson_template_set_int64 (t, s_seq, 1300000000) &&
+      bson_template_set_timestamp (t, s_ts, 1300000000000),
+      "The bson_template_set_*() functions work");
+  ok (bson_template_set_int32 (t, s_seq, 1) == FALSE &&
+      bson_template_set_int64 (t, s_pid, 1) == FALSE &&
+      bson_template_set_double (t, s_flag, 1) == FALSE &&
+      bson_template_set_boolean (t, s_d, TRUE) == FALSE &&
+      bson_template_set_utc_datetime (t, s_ts, 1) == FALSE &&
+      bson_template_set_timestamp (t, s_date, 1) == FALSE &&
+      bson_template_set_oid (t, s_msg, oid1) == FALSE,
+      "The bson_template_set_*() functions fail on mismatching types");
+  ok (bson_template_set_int32 (NULL, s_pid, 1) == FALSE &&
+      bson_template_set_int32 (t, 100, 1) == FALSE &&
+      bson_template_set_oid (t, s_id, NULL) == FALSE,
+      "The bson_template_set_*() functions fail with invalid arguments");
+
+  ok (bson_template_render (t, r),
+      "bson_template_render() works");
+  e = _generate ("a-much-longer-host-name", 4242, 1300000000000, "hi",
+                 oid2, TRUE, 3.14);
+  ok (bson_size (r) == bson_size (e) &&
+      memcmp (bson_data (r), bson_data (e), bson_size (e)) == 0,
+      "The rendered object is the same as one built from scratch");
+  ok (bson_validate (r, BSON_VALIDATE_STRICT, BSON_VALIDATE_MAX_DEPTH),
+      "The rendered object is valid");
+  bson_free (e);
+
+  bson_template_set_string (t, s_host, "", -1);
+  bson_template_set_int32 (t, s_pid, -1);
+  ok (bson_template_render (t, r),
+      "bson_template_render() can reuse the destination");
+  e = _generate ("", -1, 1300000000000, "hi", oid2, TRUE, 3.14);
+  ok (bson_size (r) == bson_size (e) &&
+      memcmp (bson_data (r), bson_data (e), bson_size (e)) == 0,
+      "Strings can shrink as well as grow");
+  bson_free (e);
+
+  bson_free (r);
+  bson_template_free (t);
+}
+
+RUN_TEST (10, bson_template_render);
@@ -0,0 +1,54 @@
+#include "test.h"
+#include "mongo.h"
+
+#include <string.h>
+
+void
+test_bson_template_set_string (void)
+{
+  bson *b, *r;
+  bson_template *t;
+  bson_cursor *c;
+  const gchar *s;
+  gint str, num;
+
+  b = bson_new ();
+  bson_append_string (b, "str", "hello", -1);
+  bson_append_int32 (b, "num", 1);
+  bson_finish (b);
+  t = bson_template_new (b);
+  bson_free (b);
+  str = bson_template_add_slot (t, "str", 10);
+  num = bson_template_add_slot (t, "num", 0);
+
+  ok (bson_template_set_string (NULL, str, "x", -1) == FALSE,
+      "bson_template_set_string() fails with a NULL template");
+  ok (bson_template_set_string (t, str, NULL, -1) == FALSE,
+      "bson_template_set_string() fails with a NULL value");
+  ok (bson_template_set_string (t, str, "x", -2) == FALSE,
+      "bson_template_set_string() fails with an invalid length");
+  ok (bson_template_set_string (t, 42, "x", -1) == FALSE &&
+      bson_template_set_string (t, -1, "x", -1) == FALSE,
+      "bson_template_set_string() fails with an invalid slot");
+  ok (bson_template_set_string (t, num, "x", -1) == FALSE,
+      "bson_template_set_string() fails on slots of other types");
+  ok (bson_template_set_string (t, str, "this is too long", -1) == FALSE,
+      "bson_template_set_string() fails if the value does not fit");
+
+  ok (bson_template_set_string (t, str, "0123456789", -1),
+      "bson_template_set_string() accepts values up to the maximum");
+  ok (bson_template_set_string (t, str, "world, hi", 5),
+      "bson_template_set_string() works with an explicit length");
+
+  r = bson_new ();
+  bson_template_render (t, r);
+  c = bson_find (r, "str");
+  ok (bson_cursor_get_string (c, &s) && strcmp (s, "world") == 0,
+      "The new value is used when rendering");
+  bson_cursor_free (c);
+  bson_free (r);
+
+  bson_template_free (t);
+}
+
+RUN_TEST (9, bson_template_set_string);
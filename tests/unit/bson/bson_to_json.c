@@ -0,0 +1,165 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-json.h>
+#include <string.h>
+
+static gboolean
+_collect (const gchar *data, gsize size, gpointer user_data)
+{
+  g_string_append_len ((GString *)user_data, data, size);
+  return TRUE;
+}
+
+static gboolean
+_abort (const gchar *data, gsize size, gpointer user_data)
+{
+  (*(gint *)user_data)++;
+  return FALSE;
+}
+
+static gchar *
+_to_json (const bson *b, bson_json_mode mode)
+{
+  GString *s = g_string_new (NULL);
+
+  if (!bson_to_json (b, mode, _collect, s))
+    {
+      g_string_free (s, TRUE);
+      return NULL;
+    }
+  return g_string_free (s, FALSE);
+}
+
+#define FULL_COMMON \
+  "\"str\":\"hello world\"," \
+  "\"doc\":{\"name\":\"sub-document\",\"answer\":%s}," \
+  "\"array\":[%s,%s]," \
+  "\"binary0\":{\"$binary\":{\"base64\":\"Zm9vAGJhcg==\"," \
+  "\"subType\":\"00\"}}," \
+  "\"_id\":{\"$oid\":\"313233343536373839306162\"}," \
+  "\"TRUE\":false," \
+  "\"date\":{\"$date\":%s}," \
+  "\"ts\":{\"$timestamp\":{\"t\":301,\"i\":2075552904}}," \
+  "\"null\":null," \
+  "\"foobar\":{\"$regularExpression\":{\"pattern\":\"s/foo.*bar/\"," \
+  "\"options\":\"i\"}}," \
+  "\"alert\":{\"$code\":\"alert (\\\"hello world!\\\");\"}," \
+  "\"sex\":{\"$symbol\":\"Marilyn Monroe\"}," \
+  "\"print\":{\"$code\":\"alert (v);\"," \
+  "\"$scope\":{\"v\":\"hello world\"}}," \
+  "\"int32\":%s,\"int64\":%s}"
+
+void
+test_bson_to_json (void)
+{
+  bson *b;
+  gchar *json, *expected;
+  GString *s;
+  gint calls = 0, i;
+
+  b = test_bson_generate_full ();
+
+  errno = 0;
+  ok (bson_to_json (NULL, BSON_JSON_RELAXED, _collect, NULL) == FALSE &&
+      errno == EINVAL,
+      "bson_to_json() fails with a NULL BSON object");
+  s = g_string_new (NULL);
+  errno = 0;
+  ok (bson_to_json (b, BSON_JSON_RELAXED, NULL, s) == FALSE &&
+      errno == EINVAL,
+      "bson_to_json() fails without a sink");
+
+  json = _to_json (b, BSON_JSON_RELAXED);
+  expected = g_strdup_printf ("{\"double\":3.14," FULL_COMMON,
+                              "42", "32", "-42",
+                              "\"2011-01-12T19:31:49Z\"", "32", "-42");
+  cmp_ok (strcmp (json, expected), "==", 0,
+          "bson_to_json() in relaxed mode works");
+  g_free (json);
+  g_free (expected);
+
+  json = _to_json (b, BSON_JSON_CANONICAL);
+  expected = g_strdup_printf
+    ("{\"double\":{\"$numberDouble\":\"3.14\"}," FULL_COMMON,
+     "{\"$numberInt\":\"42\"}",
+     "{\"$numberInt\":\"32\"}", "{\"$numberLong\":\"-42\"}",
+     "{\"$numberLong\":\"1294860709000\"}",
+     "{\"$numberInt\":\"32\"}", "{\"$numberLong\":\"-42\"}");
+  cmp_ok (strcmp (json, expected), "==", 0,
+          "bson_to_json() in canonical mode works");
+  g_free (json);
+  g_free (expected);
+  bson_free (b);
+
+  /* Strings */
+  b = bson_new ();
+  bson_append_string (b, "k\"ey", "quote\" backslash\\ newline\n tab\t "
+                      "bell\a unicode \xc3\xa9 and a long clean tail", -1);
+  bson_finish (b);
+  json = _to_json (b, BSON_JSON_RELAXED);
+  is (json, "{\"k\\\"ey\":\"quote\\\" backslash\\\\ newline\\n tab\\t "
+      "bell\\u0007 unicode \xc3\xa9 and a long clean tail\"}",
+      "bson_to_json() escapes strings properly");
+  g_free (json);
+  bson_free (b);
+
+  /* Doubles */
+  b = bson_new ();
+  bson_append_double (b, "a", 1.0);
+  bson_append_double (b, "b", 0.1);
+  bson_append_double (b, "c", 1e300);
+  bson_append_double (b, "d", 1.0 / 0.0);
+  bson_append_double (b, "e", -1.0 / 0.0);
+  bson_append_double (b, "f", 0.0 / 0.0);
+  bson_finish (b);
+  json = _to_json (b, BSON_JSON_RELAXED);
+  is (json, "{\"a\":1.0,\"b\":0.1,\"c\":1e+300,"
+      "\"d\":{\"$numberDouble\":\"Infinity\"},"
+      "\"e\":{\"$numberDouble\":\"-Infinity\"},"
+      "\"f\":{\"$numberDouble\":\"NaN\"}}",
+      "bson_to_json() writes doubles in their shortest form");
+  g_free (json);
+  bson_free (b);
+
+  /* Dates out of the ISO-8601 range, and millisecond precision */
+  b = bson_new ();
+  bson_append_utc_datetime (b, "a", -1);
+  bson_append_utc_datetime (b, "b", 1294860709123);
+  bson_finish (b);
+  json = _to_json (b, BSON_JSON_RELAXED);
+  is (json, "{\"a\":{\"$date\":{\"$numberLong\":\"-1\"}},"
+      "\"b\":{\"$date\":\"2011-01-12T19:31:49.123Z\"}}",
+      "bson_to_json() only uses ISO-8601 dates when representable");
+  g_free (json);
+  bson_free (b);
+
+  /* Sinks */
+  b = bson_new ();
+  for (i = 0; i < 1024; i++)
+    bson_append_string (b, "k", "some longer string to pad with", -1);
+  bson_finish (b);
+
+  g_string_truncate (s, 0);
+  ok (bson_to_json (b, BSON_JSON_RELAXED, _collect, s) &&
+      s->len > 16384 && s->str[0] == '{' && s->str[s->len - 1] == '}',
+      "bson_to_json() flushes large outputs in multiple chunks");
+
+  ok (bson_to_json (b, BSON_JSON_RELAXED, _abort, &calls) == FALSE &&
+      calls == 1,
+      "bson_to_json() stops when the sink aborts");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_int32 (b, "a", 1);
+  ok (bson_to_json (b, BSON_JSON_RELAXED, _collect, s) == FALSE &&
+      errno == EINVAL,
+      "bson_to_json() fails with an unfinished object");
+  bson_free (b);
+
+  g_string_free (s, TRUE);
+}
+
+RUN_TEST (10, bson_to_json);
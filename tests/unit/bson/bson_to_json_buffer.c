@@ -0,0 +1,50 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <bson-json.h>
+#include <string.h>
+
+void
+test_bson_to_json_buffer (void)
+{
+  bson *b;
+  gchar buf[64];
+  gssize len;
+
+  b = bson_new ();
+  bson_append_string (b, "hello", "world", -1);
+  bson_append_int32 (b, "answer", 42);
+  bson_finish (b);
+
+  errno = 0;
+  ok (bson_to_json_buffer (b, BSON_JSON_RELAXED, NULL, 10) == -1 &&
+      errno == EINVAL,
+      "bson_to_json_buffer() fails with a NULL buffer and non-zero size");
+  ok (bson_to_json_buffer (NULL, BSON_JSON_RELAXED, buf,
+                           sizeof (buf)) == -1,
+      "bson_to_json_buffer() fails with a NULL BSON object");
+
+  len = bson_to_json_buffer (b, BSON_JSON_RELAXED, buf, sizeof (buf));
+  cmp_ok (len, "==", 29,
+          "bson_to_json_buffer() returns the length of the output");
+  is (buf, "{\"hello\":\"world\",\"answer\":42}",
+      "bson_to_json_buffer() writes the output to the buffer");
+
+  cmp_ok (bson_to_json_buffer (b, BSON_JSON_RELAXED, NULL, 0), "==", 29,
+          "bson_to_json_buffer() can measure the output");
+
+  memset (buf, 'x', sizeof (buf));
+  len = bson_to_json_buffer (b, BSON_JSON_RELAXED, buf, 10);
+  ok (len == 29 && strcmp (buf, "{\"hello\":") == 0 && buf[10] == 'x',
+      "bson_to_json_buffer() truncates the output");
+
+  len = bson_to_json_buffer (b, BSON_JSON_RELAXED, buf, 1);
+  ok (len == 29 && buf[0] == '\0',
+      "bson_to_json_buffer() works with a one byte buffer");
+
+  bson_free (b);
+}
+
+RUN_TEST (7, bson_to_json_buffer);
@@ -0,0 +1,56 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_bson_unref (void)
+{
+  bson *b, *r1, *r2;
+  bson_cursor *c;
+  const gchar *s;
+
+  bson_unref (NULL);
+  pass ("bson_unref(NULL) works");
+
+  b = test_bson_generate_full ();
+  r1 = bson_ref (b);
+  r2 = bson_ref (r1);
+
+  bson_unref (b);
+  c = bson_find (r1, "str");
+  ok (bson_cursor_get_string (c, &s) && strcmp (s, "hello world") == 0,
+      "the data outlives the original object");
+  bson_cursor_free (c);
+
+  bson_unref (r1);
+  c = bson_find (r2, "str");
+  ok (bson_cursor_get_string (c, &s) && strcmp (s, "hello world") == 0,
+      "the data lives as long as it is referenced");
+  bson_cursor_free (c);
+
+  bson_unref (r2);
+  pass ("bson_unref() frees the data with the last reference");
+
+  b = bson_new ();
+  bson_append_int32 (b, "a", 1);
+  r1 = bson_ref (b);
+  bson_unref (b);
+  ok (bson_append_int32 (r1, "b", 2) && bson_finish (r1) &&
+      bson_size (r1) == 19,
+      "the last reference can be appended to");
+  bson_unref (r1);
+
+  b = bson_new_pooled ();
+  bson_append_int32 (b, "a", 1);
+  bson_finish (b);
+  r1 = bson_ref (b);
+  bson_release (b);
+  ok (bson_size (r1) == 12,
+      "bson_release() does not recycle shared objects");
+  bson_unref (r1);
+  bson_pool_flush ();
+}
+
+RUN_TEST (6, bson_unref);
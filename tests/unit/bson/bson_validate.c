@@ -0,0 +1,148 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <string.h>
+
+static bson *
+_nest (gint depth)
+{
+  bson *b, *c;
+
+  b = bson_new ();
+  bson_append_int32 (b, "leaf", depth);
+  bson_finish (b);
+
+  while (depth-- > 0)
+    {
+      c = bson_new ();
+      bson_append_document (c, "child", b);
+      bson_finish (c);
+      bson_free (b);
+      b = c;
+    }
+  return b;
+}
+
+void
+test_bson_validate (void)
+{
+  bson *b, *a;
+
+  ok (bson_validate (NULL, BSON_VALIDATE_NONE,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE && errno == EINVAL,
+      "bson_validate() fails with a NULL object");
+
+  b = bson_new ();
+  bson_append_int32 (b, "i", 1);
+  ok (bson_validate (b, BSON_VALIDATE_NONE,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE && errno == EINVAL,
+      "bson_validate() fails with an unfinished object");
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_NONE, -1) == FALSE && errno == EINVAL,
+      "bson_validate() fails with a negative depth");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_NONE, 0),
+      "bson_validate() accepts an empty object");
+  bson_free (b);
+
+  b = test_bson_generate_full ();
+  ok (bson_validate (b, BSON_VALIDATE_NONE, BSON_VALIDATE_MAX_DEPTH),
+      "bson_validate() accepts an object with every supported type");
+  ok (bson_validate (b, BSON_VALIDATE_UTF8 | BSON_VALIDATE_STRICT,
+                     BSON_VALIDATE_MAX_DEPTH),
+      "bson_validate() accepts the same with UTF-8 and strict checks");
+  ok (bson_validate (b, BSON_VALIDATE_NO_DEPRECATED,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE && errno == 0,
+      "bson_validate() rejects deprecated types when asked to");
+  ok (bson_validate (b, BSON_VALIDATE_NONE, 0) == FALSE,
+      "bson_validate() honours the maximum depth");
+  ok (bson_validate (b, BSON_VALIDATE_NONE, 1),
+      "bson_validate() accepts objects within the maximum depth");
+  bson_free (b);
+
+  b = _nest (10);
+  ok (bson_validate (b, BSON_VALIDATE_NONE, 9) == FALSE &&
+      bson_validate (b, BSON_VALIDATE_NONE, 10),
+      "bson_validate() counts the depth of deeply nested objects");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_string (b, "str", "This is a rather long ASCII prefix, "
+                      "followed by \xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 "
+                      "t\xc3\xbck\xc3\xb6rf\xc3\xbar\xc3\xb3g\xc3\xa9p "
+                      "\xe2\x82\xac \xf0\x9f\x8d\xba", -1);
+  bson_append_string (b, "\xc3\xa9kezet", "key", -1);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_UTF8, BSON_VALIDATE_MAX_DEPTH),
+      "bson_validate() accepts valid multi-byte UTF-8");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_string (b, "str", "invalid \xff utf-8", -1);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_NONE, BSON_VALIDATE_MAX_DEPTH),
+      "bson_validate() does not check UTF-8 by default");
+  ok (bson_validate (b, BSON_VALIDATE_UTF8,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate() rejects invalid UTF-8 strings");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_string (b, "overlong", "\xc0\xaf", -1);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_UTF8,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate() rejects overlong UTF-8 sequences");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_string (b, "surrogate", "\xed\xa0\x80", -1);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_UTF8,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate() rejects UTF-8 encoded surrogates");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_null (b, "a long key with a truncated sequence \xe2\x82");
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_UTF8,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate() rejects keys that are not valid UTF-8");
+  bson_free (b);
+
+  a = bson_new ();
+  bson_append_int32 (a, "1", 1);
+  bson_append_int32 (a, "0", 0);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "array", a);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_NONE, BSON_VALIDATE_MAX_DEPTH),
+      "bson_validate() does not check array keys by default");
+  ok (bson_validate (b, BSON_VALIDATE_STRICT,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate() rejects out of order array keys in strict mode");
+  bson_free (b);
+  bson_free (a);
+
+  a = bson_new ();
+  bson_append_int32 (a, "0", 0);
+  bson_append_int32 (a, "01", 1);
+  bson_finish (a);
+  b = bson_new ();
+  bson_append_array (b, "array", a);
+  bson_finish (b);
+  ok (bson_validate (b, BSON_VALIDATE_STRICT,
+                     BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate() rejects zero-padded array keys in strict mode");
+  bson_free (b);
+  bson_free (a);
+}
+
+RUN_TEST (19, bson_validate);
@@ -0,0 +1,122 @@
+#include "tap.h"
+#include "test.h"
+
+#include <errno.h>
+#include <bson.h>
+#include <string.h>
+
+static guint8 *
+_copy (const bson *b)
+{
+  return g_memdup (bson_data (b), bson_size (b));
+}
+
+static void
+_set_size (guint8 *data, gint32 size)
+{
+  size = GINT32_TO_LE (size);
+  memcpy (data, &size, sizeof (size));
+}
+
+void
+test_bson_validate_data (void)
+{
+  bson *b, *v;
+  guint8 *data;
+  gint32 size, i, accepted = 0;
+  gboolean walked = TRUE;
+  bson_cursor *c;
+
+  b = test_bson_generate_full ();
+  size = bson_size (b);
+
+  ok (bson_validate_data (NULL, size, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE &&
+      errno == EINVAL,
+      "bson_validate_data() fails with NULL data");
+  ok (bson_validate_data (bson_data (b), size, BSON_VALIDATE_NONE,
+                          -1) == FALSE && errno == EINVAL,
+      "bson_validate_data() fails with a negative depth");
+
+  ok (bson_validate_data (bson_data (b), size, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH),
+      "bson_validate_data() works");
+  ok (bson_validate_data (bson_data (b), size - 1, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE &&
+      errno == 0,
+      "bson_validate_data() fails if the size does not match");
+  ok (bson_validate_data (bson_data (b), 4, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate_data() fails if the data is too short");
+
+  data = _copy (b);
+  data[size - 1] = 1;
+  ok (bson_validate_data (data, size, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate_data() fails without a terminating NUL byte");
+  g_free (data);
+
+  /* The first element is "double", the second one is "str", with its
+     length at offset 25. */
+  data = _copy (b);
+  data[4] = 0x42;
+  ok (bson_validate_data (data, size, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate_data() fails on unknown element types");
+  g_free (data);
+
+  data = _copy (b);
+  _set_size (data + 25, 0x7fffffff);
+  ok (bson_validate_data (data, size, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate_data() fails on out of bounds string lengths");
+  _set_size (data + 25, 11);
+  ok (bson_validate_data (data, size, BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate_data() fails on unterminated strings");
+  g_free (data);
+
+  /* Every truncated copy of the document must either be rejected, or
+     be safe to walk. */
+  for (i = 5; i < size; i++)
+    {
+      data = g_memdup (bson_data (b), i);
+      _set_size (data, i);
+      data[i - 1] = 0;
+
+      if (bson_validate_data (data, i, BSON_VALIDATE_NONE,
+                              BSON_VALIDATE_MAX_DEPTH))
+        {
+          accepted++;
+          v = bson_new_view (data, i);
+          c = bson_cursor_new (v);
+          while (bson_cursor_next (c))
+            ;
+          walked &= (v != NULL);
+          bson_cursor_free (c);
+          bson_free (v);
+        }
+      g_free (data);
+    }
+  ok (accepted > 0 && accepted < size - 5 && walked,
+      "bson_validate_data() only accepts truncated documents that end "
+      "on an element boundary");
+  bson_free (b);
+
+  b = bson_new ();
+  bson_append_boolean (b, "b", TRUE);
+  bson_finish (b);
+  data = _copy (b);
+  data[7] = 2;
+  ok (bson_validate_data (data, bson_size (b), BSON_VALIDATE_NONE,
+                          BSON_VALIDATE_MAX_DEPTH),
+      "bson_validate_data() accepts any boolean value by default");
+  ok (bson_validate_data (data, bson_size (b), BSON_VALIDATE_STRICT,
+                          BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "bson_validate_data() rejects booleans other than 0 and 1 in "
+      "strict mode");
+  g_free (data);
+  bson_free (b);
+}
+
+RUN_TEST (12, bson_validate_data);
@@ -0,0 +1,197 @@
+#include "tap.h"
+#include "test.h"
+#include "bson.h"
+
+#include <string.h>
+
+typedef struct
+{
+  gint before;
+  gint after;
+  gint max_depth;
+  gint documents;
+  gint documents_end;
+  gint arrays;
+  gint stop_at;
+  gdouble d;
+  gchar *s;
+  gint32 slen;
+  gint64 i64;
+  gint32 i32;
+  gint32 scope_answer;
+  gint32 bin_size;
+} test_visit_state;
+
+static gboolean
+_visit_before (const bson_iter *i, gint depth, gpointer user_data)
+{
+  test_visit_state *st = (test_visit_state *)user_data;
+
+  st->before++;
+  if (depth > st->max_depth)
+    st->max_depth = depth;
+  return (st->before != st->stop_at);
+}
+
+static gboolean
+_visit_after (const bson_iter *i, gint depth, gpointer user_data)
+{
+  ((test_visit_state *)user_data)->after++;
+  return TRUE;
+}
+
+static gboolean
+_visit_double (const bson_iter *i, gint depth, gdouble value,
+               gpointer user_data)
+{
+  ((test_visit_state *)user_data)->d = value;
+  return TRUE;
+}
+
+static gboolean
+_visit_string (const bson_iter *i, gint depth, const gchar *value,
+               gint32 length, gpointer user_data)
+{
+  test_visit_state *st = (test_visit_state *)user_data;
+
+  if (depth == 0)
+    {
+      st->s = g_strdup (value);
+      st->slen = length;
+    }
+  return TRUE;
+}
+
+static gboolean
+_visit_document (const bson_iter *i, gint depth, gint32 size,
+                 gpointer user_data)
+{
+  ((test_visit_state *)user_data)->documents++;
+  return TRUE;
+}
+
+static gboolean
+_visit_document_end (const bson_iter *i, gint depth, gpointer user_data)
+{
+  ((test_visit_state *)user_data)->documents_end++;
+  return TRUE;
+}
+
+static gboolean
+_visit_array (const bson_iter *i, gint depth, gint32 size,
+              gpointer user_data)
+{
+  ((test_visit_state *)user_data)->arrays++;
+  return TRUE;
+}
+
+static gboolean
+_visit_binary (const bson_iter *i, gint depth, bson_binary_subtype subtype,
+               const guint8 *data, gint32 size, gpointer user_data)
+{
+  if (memcmp (data, "foo\0bar", 7) == 0)
+    ((test_visit_state *)user_data)->bin_size = size;
+  return TRUE;
+}
+
+static gboolean
+_visit_js_w_scope (const bson_iter *i, gint depth, const gchar *code,
+                   gint32 length, const bson_iter *scope,
+                   gpointer user_data)
+{
+  bson_iter s = *scope;
+  const gchar *v;
+
+  if (strcmp (code, "alert (v);") == 0 && length == 10 &&
+      bson_iter_find (&s, "v") && bson_iter_get_string (&s, &v) &&
+      strcmp (v, "hello world") == 0)
+    ((test_visit_state *)user_data)->scope_answer = 1;
+  return TRUE;
+}
+
+static gboolean
+_visit_int32 (const bson_iter *i, gint depth, gint32 value,
+              gpointer user_data)
+{
+  if (depth == 0)
+    ((test_visit_state *)user_data)->i32 = value;
+  return TRUE;
+}
+
+static gboolean
+_visit_int64 (const bson_iter *i, gint depth, gint64 value,
+              gpointer user_data)
+{
+  if (depth == 0)
+    ((test_visit_state *)user_data)->i64 = value;
+  return TRUE;
+}
+
+void
+test_bson_visit (void)
+{
+  bson *b;
+  bson_visitor v;
+  test_visit_state st;
+
+  memset (&v, 0, sizeof (v));
+  v.visit_before = _visit_before;
+  v.visit_after = _visit_after;
+  v.visit_double = _visit_double;
+  v.visit_string = _visit_string;
+  v.visit_document = _visit_document;
+  v.visit_document_end = _visit_document_end;
+  v.visit_array = _visit_array;
+  v.visit_binary = _visit_binary;
+  v.visit_javascript_w_scope = _visit_js_w_scope;
+  v.visit_int32 = _visit_int32;
+  v.visit_int64 = _visit_int64;
+
+  b = test_bson_generate_full ();
+  memset (&st, 0, sizeof (st));
+
+  ok (bson_visit (NULL, &v, BSON_VISIT_DEFAULT, &st) == FALSE,
+      "bson_visit() fails with a NULL object");
+  ok (bson_visit (b, NULL, BSON_VISIT_DEFAULT, &st) == FALSE,
+      "bson_visit() fails with a NULL visitor");
+
+  ok (bson_visit (b, &v, BSON_VISIT_DEFAULT, &st),
+      "bson_visit() works");
+  ok (st.before == 16 && st.after == 16 && st.max_depth == 0,
+      "bson_visit() visits the top-level elements only by default");
+  ok (st.documents == 1 && st.arrays == 1 && st.documents_end == 0,
+      "embedded documents are reported, but not recursed into");
+  ok (st.d == 3.14 && st.i32 == 32 && st.i64 == -42,
+      "numeric values are decoded");
+  ok (st.s && strcmp (st.s, "hello world") == 0 && st.slen == 11,
+      "strings are decoded, along with their length");
+  ok (st.bin_size == 7,
+      "binary elements are decoded");
+  ok (st.scope_answer == 1,
+      "JavaScript code with scope is decoded, scope included");
+  g_free (st.s);
+
+  memset (&st, 0, sizeof (st));
+  ok (bson_visit (b, &v, BSON_VISIT_RECURSE, &st) &&
+      st.before == 20 && st.max_depth == 1 && st.documents_end == 1,
+      "bson_visit() recurses into documents and arrays");
+  g_free (st.s);
+
+  memset (&st, 0, sizeof (st));
+  st.stop_at = 3;
+  ok (bson_visit (b, &v, BSON_VISIT_RECURSE, &st) == FALSE &&
+      st.before == 3 && st.after == 2,
+      "a callback can stop the walk");
+  g_free (st.s);
+
+  bson_free (b);
+
+  b = bson_new ();
+  bson_finish (b);
+  memset (&st, 0, sizeof (st));
+  ok (bson_visit (b, &v, BSON_VISIT_RECURSE, &st) && st.before == 0,
+      "bson_visit() works with an empty document");
+  bson_free (b);
+}
+
+RUN_TEST (12, bson_visit);
@@ -0,0 +1,53 @@
+#include "test.h"
+#include "mongo.h"
+#include "config.h"
+
+#include "libmongo-private.h"
+
+#include <errno.h>
+
+void
+test_mongo_sync_cursor_decode_columns (void)
+{
+  mongo_sync_connection *conn;
+  mongo_packet *p;
+  mongo_sync_cursor *c;
+  bson_columns *cols;
+  const gint64 *v;
+
+  test_env_setup ();
+
+  p = test_mongo_wire_generate_reply (TRUE, 2, TRUE);
+  conn = test_make_fake_sync_conn (-1, FALSE);
+  c = mongo_sync_cursor_new (conn, config.ns, p);
+
+  cols = bson_columns_new ();
+  bson_columns_add (cols, "int64", BSON_TYPE_INT64);
+
+  errno = 0;
+  ok (mongo_sync_cursor_decode_columns (NULL, cols) == -1 &&
+      errno == EINVAL,
+      "mongo_sync_cursor_decode_columns() fails with a NULL cursor");
+  errno = 0;
+  ok (mongo_sync_cursor_decode_columns (c, NULL) == -1 && errno == EINVAL,
+      "mongo_sync_cursor_decode_columns() fails without a decoder");
+
+  mongo_sync_cursor_next (c);
+  ok (mongo_sync_cursor_decode_columns (c, cols) == 1,
+      "mongo_sync_cursor_decode_columns() decodes the rest of the batch");
+  v = bson_columns_values (cols, 0);
+  ok (bson_columns_rows (cols) == 1 && v[0] == -42 && c->offset == 1,
+      "mongo_sync_cursor_decode_columns() leaves the cursor at the "
+      "last decoded document");
+
+  ok (mongo_sync_cursor_decode_columns (c, cols) == -1,
+      "mongo_sync_cursor_decode_columns() fails at the end of the "
+      "result set");
+
+  bson_columns_free (cols);
+  mongo_sync_cursor_free (c);
+  mongo_sync_disconnect (conn);
+  test_env_free ();
+}
+
+RUN_TEST (5, mongo_sync_cursor_decode_columns);
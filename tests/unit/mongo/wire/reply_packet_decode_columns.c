@@ -0,0 +1,55 @@
+#include "test.h"
+#include "tap.h"
+#include "mongo-wire.h"
+#include "bson.h"
+
+#include <errno.h>
+#include <string.h>
+
+void
+test_mongo_wire_reply_packet_decode_columns (void)
+{
+  mongo_packet *p;
+  bson_columns *cols;
+  const gint32 *v;
+
+  cols = bson_columns_new ();
+  bson_columns_add (cols, "int32", BSON_TYPE_INT32);
+
+  p = test_mongo_wire_generate_reply (TRUE, 2, TRUE);
+
+  errno = 0;
+  ok (mongo_wire_reply_packet_decode_columns (NULL, 1, cols) == -1 &&
+      errno == EINVAL,
+      "mongo_wire_reply_packet_decode_columns() fails with a NULL packet");
+  errno = 0;
+  ok (mongo_wire_reply_packet_decode_columns (p, 1, NULL) == -1 &&
+      errno == EINVAL,
+      "mongo_wire_reply_packet_decode_columns() fails without a decoder");
+  errno = 0;
+  ok (mongo_wire_reply_packet_decode_columns (p, 3, cols) == -1 &&
+      errno == ERANGE,
+      "mongo_wire_reply_packet_decode_columns() fails if out of range");
+
+  ok (mongo_wire_reply_packet_decode_columns (p, 1, cols) == 2,
+      "mongo_wire_reply_packet_decode_columns() works");
+  ok (mongo_wire_reply_packet_decode_columns (p, 2, cols) == 1,
+      "mongo_wire_reply_packet_decode_columns() can start mid-packet");
+
+  v = bson_columns_values (cols, 0);
+  ok (bson_columns_rows (cols) == 3 && v[0] == 32 && v[1] == 32 &&
+      v[2] == 32,
+      "mongo_wire_reply_packet_decode_columns() decodes the documents");
+  mongo_wire_packet_free (p);
+
+  p = test_mongo_wire_generate_reply (FALSE, 2, TRUE);
+  errno = 0;
+  ok (mongo_wire_reply_packet_decode_columns (p, 1, cols) == -1 &&
+      errno == EPROTO,
+      "mongo_wire_reply_packet_decode_columns() fails on non-replies");
+  mongo_wire_packet_free (p);
+
+  bson_columns_free (cols);
+}
+
+RUN_TEST (7, mongo_wire_reply_packet_decode_columns);
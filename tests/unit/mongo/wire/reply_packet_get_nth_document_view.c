@@ -0,0 +1,53 @@
+#include "test.h"
+#include "tap.h"
+#include "mongo-wire.h"
+#include "bson.h"
+
+#include <string.h>
+
+void
+test_mongo_wire_reply_packet_get_nth_document_view (void)
+{
+  mongo_packet *p;
+  bson *b, *doc;
+  const guint8 *data;
+
+  ok (mongo_wire_reply_packet_get_nth_document_view (NULL, 1, &doc) == FALSE,
+      "mongo_wire_reply_packet_get_nth_document_view() fails with a "
+      "NULL packet");
+
+  p = test_mongo_wire_generate_reply (TRUE, 0, FALSE);
+  ok (mongo_wire_reply_packet_get_nth_document_view (p, 1, &doc) == FALSE,
+      "mongo_wire_reply_packet_get_nth_document_view() fails if there "
+      "are no documents to return");
+  mongo_wire_packet_free (p);
+
+  p = test_mongo_wire_generate_reply (TRUE, 2, TRUE);
+  ok (mongo_wire_reply_packet_get_nth_document_view (p, 1, NULL) == FALSE,
+      "mongo_wire_reply_packet_get_nth_document_view() fails with a NULL "
+      "destination");
+  ok (mongo_wire_reply_packet_get_nth_document_view (p, 0, &doc) == FALSE,
+      "mongo_wire_reply_packet_get_nth_document_view() fails with n = 0");
+
+  ok (mongo_wire_reply_packet_get_nth_document_view (p, 2, &doc),
+      "mongo_wire_reply_packet_get_nth_document_view() works");
+  b = test_bson_generate_full ();
+  mongo_wire_reply_packet_get_data (p, &data);
+
+  cmp_ok (bson_size (doc), "==", bson_size (b),
+          "Returned document is finished");
+  ok (memcmp (bson_data (b), bson_data (doc), bson_size (doc)) == 0,
+      "Returned document is correct");
+  ok (bson_data (doc) == data + bson_size (b),
+      "Returned document points into the packet");
+  bson_free (doc);
+  bson_free (b);
+
+  ok (mongo_wire_reply_packet_get_nth_document_view (p, 3, &doc) == FALSE,
+      "mongo_wire_reply_packet_get_nth_document_view() fails if the "
+      "requested document does not exist");
+
+  mongo_wire_packet_free (p);
+}
+
+RUN_TEST (9, mongo_wire_reply_packet_get_nth_document_view);
@@ -0,0 +1,67 @@
+#include "test.h"
+#include "tap.h"
+#include "mongo-wire.h"
+#include "bson.h"
+
+#include <errno.h>
+#include <string.h>
+
+void
+test_mongo_wire_reply_packet_validate (void)
+{
+  mongo_packet *p;
+  const guint8 *data;
+  guint8 *corrupt;
+  gint32 size;
+
+  ok (mongo_wire_reply_packet_validate (NULL, BSON_VALIDATE_NONE,
+                                        BSON_VALIDATE_MAX_DEPTH) == FALSE &&
+      errno == EINVAL,
+      "mongo_wire_reply_packet_validate() fails with a NULL packet");
+
+  p = test_mongo_wire_generate_reply (FALSE, 0, FALSE);
+  ok (mongo_wire_reply_packet_validate (p, BSON_VALIDATE_NONE,
+                                        BSON_VALIDATE_MAX_DEPTH) == FALSE &&
+      errno == EPROTO,
+      "mongo_wire_reply_packet_validate() fails on non-reply packets");
+  mongo_wire_packet_free (p);
+
+  p = test_mongo_wire_generate_reply (TRUE, 0, FALSE);
+  ok (mongo_wire_reply_packet_validate (p, BSON_VALIDATE_NONE,
+                                        BSON_VALIDATE_MAX_DEPTH),
+      "mongo_wire_reply_packet_validate() accepts empty replies");
+  mongo_wire_packet_free (p);
+
+  p = test_mongo_wire_generate_reply (TRUE, 2, FALSE);
+  ok (mongo_wire_reply_packet_validate (p, BSON_VALIDATE_NONE,
+                                        BSON_VALIDATE_MAX_DEPTH) == FALSE &&
+      errno == EPROTO,
+      "mongo_wire_reply_packet_validate() fails if documents are missing");
+  mongo_wire_packet_free (p);
+
+  p = test_mongo_wire_generate_reply (TRUE, 1, TRUE);
+  ok (mongo_wire_reply_packet_validate (p, BSON_VALIDATE_NONE,
+                                        BSON_VALIDATE_MAX_DEPTH) == FALSE,
+      "mongo_wire_reply_packet_validate() fails on trailing garbage");
+  mongo_wire_packet_free (p);
+
+  p = test_mongo_wire_generate_reply (TRUE, 2, TRUE);
+  ok (mongo_wire_reply_packet_validate (p, BSON_VALIDATE_UTF8,
+                                        BSON_VALIDATE_MAX_DEPTH),
+      "mongo_wire_reply_packet_validate() works");
+
+  size = mongo_wire_packet_get_data (p, &data);
+  corrupt = g_memdup (data, size);
+  /* Make the first string of the second document overflow. */
+  mongo_wire_reply_packet_get_data (p, &data);
+  corrupt[size - bson_stream_doc_size (data, 0) + 25] = 0x7f;
+  mongo_wire_packet_set_data (p, corrupt, size);
+  g_free (corrupt);
+  ok (mongo_wire_reply_packet_validate (p, BSON_VALIDATE_NONE,
+                                        BSON_VALIDATE_MAX_DEPTH) == FALSE &&
+      errno == EPROTO,
+      "mongo_wire_reply_packet_validate() fails on corrupt documents");
+  mongo_wire_packet_free (p);
+}
+
+RUN_TEST (7, mongo_wire_reply_packet_validate);